@@ -7,11 +7,12 @@ SUBDIRS = \
     protlib \
     cryptolib \
     modelslib \
-    qt_quick_app
-#    test_tor \
-#    test_crypto \
-#    test_core \
-#    test_models
+    qt_quick_app \
+    faketor \
+    test_tor \
+    test_core \
+    test_crypto
+#    test_models \
 
 torlib.subdir = src/torlib
 corelib.subdir = src/corelib
@@ -27,15 +28,25 @@ modelslib.depends = corelib
 #protlib.depends = torlib
 #corelib.depends = torlib protlib cryptolib
 
-#test_core.subdir = tests/tests_core
-#test_core.depends = corelib torlib cryptolib protlib
+test_core.subdir = tests/tests_core
+test_core.depends = corelib torlib cryptolib protlib
 
-#test_tor.subdir = tests/tests_tor
-#test_tor.depends = torlib cryptolib
+# Stand-in for tor in the tests of the private tor instance
+faketor.subdir = tests/faketor
 
-#test_crypto.subdir = tests/tests_crypto
-#test_crypto.depends = cryptolib
+test_tor.subdir = tests/tests_tor
+test_tor.depends = torlib cryptolib corelib protlib faketor
+
+test_crypto.subdir = tests/tests_crypto
+test_crypto.depends = cryptolib
 
 #test_models.subdir = tests/tests_models
 #test_models.depends = modelslib
 
+# Protocol benchmarks. Build with: qmake CONFIG+=bench
+bench {
+    SUBDIRS += bench_prot
+    bench_prot.subdir = tests/bench_prot
+    bench_prot.depends = corelib torlib cryptolib protlib
+}
+
@@ -44,7 +44,15 @@ SOURCES += \
     src/filemanager.cpp \
     src/file.cpp \
     src/hashtask.cpp \
-    src/logutil.cpp
+    src/logutil.cpp \
+    src/ratelimiter.cpp \
+    src/metrics.cpp \
+    src/tracer.cpp \
+    src/asynclog.cpp \
+    src/reconnectscheduler.cpp \
+    src/timerwheel.cpp \
+    src/cryptoexecutor.cpp \
+    src/certcache.cpp
 
 HEADERS += \
     include/ds/dsengine.h \
@@ -69,7 +77,16 @@ HEADERS += \
     include/ds/file.h \
     include/ds/hashtask.h \
     include/ds/logutil.h \
-    include/ds/bytes.h
+    include/ds/bytes.h \
+    include/ds/transferscheduler.h \
+    include/ds/ratelimiter.h \
+    include/ds/metrics.h \
+    include/ds/tracer.h \
+    include/ds/asynclog.h \
+    include/ds/reconnectscheduler.h \
+    include/ds/timerwheel.h \
+    include/ds/cryptoexecutor.h \
+    include/ds/certcache.h
 
 INCLUDEPATH += \
     $$PWD/../../dependencies/logfault/include \
@@ -0,0 +1,73 @@
+#ifndef ASYNCLOG_H
+#define ASYNCLOG_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "logfault/logfault.h"
+
+namespace ds {
+namespace core {
+
+/*! Log handler that moves the work of another handler to a background thread
+ *
+ * Messages are copied into a lock-free multi-producer, single-consumer
+ * queue. A writer thread pops them and passes them to the wrapped
+ * handler, so formatting, file I/O and signals to the log model
+ * don't happen on the thread that logs.
+ *
+ * The queue is bounded. Messages that arrive when it is full are
+ * dropped, and counted in the "log.dropped" metric.
+ *
+ * Remaining messages are written when the handler is destroyed.
+ */
+class AsyncLogHandler : public logfault::Handler {
+public:
+    AsyncLogHandler(std::unique_ptr<logfault::Handler> handler,
+                    const size_t maxQueued = 10000);
+    ~AsyncLogHandler() override;
+
+    void LogMessage(const logfault::Message& msg) override;
+
+    size_t getDropped() const noexcept {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Node {
+        Node() = default;
+        explicit Node(const logfault::Message& msg)
+            : message{std::make_unique<logfault::Message>(msg)} {}
+
+        std::atomic<Node *> next{nullptr};
+        std::unique_ptr<logfault::Message> message;
+    };
+
+    void push(Node *node) noexcept;
+    Node *pop() noexcept;
+    void run();
+
+    std::unique_ptr<logfault::Handler> handler_;
+    const size_t maxQueued_;
+
+    // Vyukov's intrusive MPSC queue. Producers exchange the head,
+    // the writer thread owns the tail.
+    Node stub_;
+    std::atomic<Node *> head_{&stub_};
+    Node *tail_ = &stub_;
+
+    std::atomic<size_t> queued_{0};
+    std::atomic<size_t> dropped_{0};
+    std::atomic_bool sleeping_{false};
+    std::atomic_bool done_{false};
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread thread_;
+};
+
+}} // namespaces
+
+#endif // ASYNCLOG_H
@@ -0,0 +1,77 @@
+#ifndef CERTCACHE_H
+#define CERTCACHE_H
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include <QByteArray>
+#include <QHash>
+
+#include "ds/dscert.h"
+
+namespace ds {
+namespace core {
+
+/*! Cache for the certs of the peers that connect to us
+ *
+ * Creating a cert from a pubkey allocates locked memory, converts
+ * the Ed25519 key to Curve25519 and hashes the key. The same contacts
+ * reconnect all the time, so we keep the most recently used certs
+ * around, indexed by their pubkey.
+ *
+ * Only certs created from a pubkey are cached. They contain no
+ * secrets, and are never modified after they are created, so the
+ * same instance can be shared by all the connections to the peer.
+ *
+ * Thread-safe. The handshakes may run on the crypto executor.
+ */
+class CertCache
+{
+public:
+    static constexpr size_t default_capacity = 256;
+
+    static CertCache& instance();
+
+    explicit CertCache(const size_t capacity = default_capacity);
+
+    /*! Get the cert for a pubkey, creating it if it's not in the cache.
+     *
+     * A new cert is not added to the cache. Anyone can send us a
+     * pubkey, so call add() when the peer has proven that it holds
+     * the private key. Else, a flood of random pubkeys would evict
+     * the certs of our contacts.
+     *
+     * Throws if the pubkey is invalid.
+     */
+    crypto::DsCert::ptr_t getFromPubkey(const QByteArray& pubkey);
+
+    // Add a cert that was verified, or mark it as recently used
+    void add(const QByteArray& pubkey, const crypto::DsCert::ptr_t& cert);
+
+    // 0 disables the cache
+    void setCapacity(const size_t capacity);
+    size_t getCapacity() const;
+    size_t size() const;
+    void clear();
+
+private:
+    struct Hash {
+        size_t operator()(const QByteArray& key) const noexcept {
+            return qHash(key);
+        }
+    };
+
+    using lru_t = std::list<std::pair<QByteArray, crypto::DsCert::ptr_t>>;
+
+    void shrink();
+
+    mutable std::mutex mutex_;
+    lru_t lru_; // Most recently used first
+    std::unordered_map<QByteArray, lru_t::iterator, Hash> index_;
+    size_t capacity_;
+};
+
+}} // namespaces
+
+#endif // CERTCACHE_H
@@ -4,9 +4,11 @@
 #include <memory>
 #include <deque>
 #include <set>
+#include <vector>
 
 #include <QDateTime>
 #include <QString>
+#include <QTimer>
 #include <QUuid>
 #include <QVariant>
 #include <QtGui/QImage>
@@ -14,6 +16,8 @@
 #include "ds/dscert.h"
 #include "ds/peerconnection.h"
 #include "ds/message.h"
+#include "ds/transferscheduler.h"
+#include "ds/ratelimiter.h"
 
 class QSqlQuery;
 
@@ -104,6 +108,11 @@ public:
     Q_PROPERTY(bool peerVerified READ isPeerVerified WRITE setPeerVerified NOTIFY peerVerifiedChanged)
     Q_PROPERTY(Identity * identity READ getIdentity CONSTANT)
     Q_PROPERTY(bool sentAvatar READ isAvatarSent WRITE setSentAvatar NOTIFY sentAvatarChanged)
+    Q_PROPERTY(int rtt READ getRtt NOTIFY rttChanged)
+    Q_PROPERTY(int uploadRateLimit READ getUploadRateLimit WRITE setUploadRateLimit NOTIFY rateLimitsChanged)
+    Q_PROPERTY(int downloadRateLimit READ getDownloadRateLimit WRITE setDownloadRateLimit NOTIFY rateLimitsChanged)
+    Q_PROPERTY(int uploadRate READ getUploadRate NOTIFY transferRatesChanged)
+    Q_PROPERTY(int downloadRate READ getDownloadRate NOTIFY transferRatesChanged)
 
     Q_INVOKABLE void connectToContact();
     Q_INVOKABLE void disconnectFromContact(bool manual = false);
@@ -156,10 +165,34 @@ public:
     bool wasManuallyDisconnected() const noexcept;
     void setManuallyDisconnected(bool state);
 
+    // Round-trip time in milliseconds, measured by the keepalives. -1 if unknown.
+    int getRtt() const noexcept;
+
     void queueMessage(const Message::ptr_t& message);
     void queueFile(const std::shared_ptr<File>& file);
     void sendAvatar(const QImage& avatar);
 
+    /*! Bandwidth limits for file-transfers with this contact
+     *
+     * Rates are in bytes per second. 0 means unlimited.
+     * Saved in the settings for this contact. Until they are set,
+     * the "contactUploadRateLimit" and "contactDownloadRateLimit"
+     * settings are used. The limits for the identity and the global
+     * limits still apply.
+     */
+    int getUploadRateLimit();
+    void setUploadRateLimit(const int rate);
+    int getDownloadRateLimit();
+    void setDownloadRateLimit(const int rate);
+
+    /*! Current file-transfer rates with this contact
+     *
+     * In bytes per second. Updated every second while
+     * files are transferred.
+     */
+    int getUploadRate() const noexcept;
+    int getDownloadRate() const noexcept;
+
     /*! Add the new Identity to the database. */
     void addToDb();
 
@@ -190,9 +223,13 @@ signals:
     void sendAddMeLater();
     void sendAddmeAckLater();
     void processOnlineLater();
+    void processIncomingMessagesLater();
     void manuallyDisconnectedChanged();
     void sentAvatarChanged();
     void avatarUrlChanged();
+    void rttChanged();
+    void rateLimitsChanged();
+    void transferRatesChanged();
 
 public slots:
     void onConnectedToPeer(const std::shared_ptr<PeerConnection>& peer);
@@ -208,9 +245,11 @@ private slots:
     bool processFilesQueue();
     bool processFileBlocks();
     void onReceivedMessage(const PeerMessage& msg);
+    void onProcessIncomingMessagesLater();
     void onReceivedFileOffer(const PeerFileOffer& msg);
     void onReceivedAvatar(const PeerSetAvatarReq& avatar);
     void onOutputBufferEmptied();
+    void onRttMeasured(const int msec);
 
 private:
     static void bind(QSqlQuery& query, ContactData& data);
@@ -219,6 +258,27 @@ private:
     void queueTransfer(const std::shared_ptr<File>& file);
     void clearFileQueues();
     void prepareForNewConnection();
+    TokenBucket::ptr_t getUploadBucket();
+    TokenBucket::ptr_t getDownloadBucket();
+    QString getRateLimitKey(const QString& direction) const;
+    void setRateLimit(TokenBucket& bucket, const QString& direction, const int rate);
+    BandwidthShaper::ptr_t getUploadShaper();
+    BandwidthShaper::ptr_t getDownloadShaper();
+    void scheduleShapingRetry(const std::chrono::milliseconds& delay);
+    void updateTransferRates();
+    void expediteConnect();
+    void processQueues();
+
+    // Queue depths, as reported to the metrics
+    struct QueueDepths {
+        qint64 messages = 0;
+        qint64 unconfirmed = 0;
+        qint64 files = 0;
+        qint64 transfers = 0;
+    };
+
+    void updateQueueMetrics();
+    void reportQueueDepths(const QueueDepths& depths);
 
     // Sends reject message if the conversation is not the default and don't exist.
     Conversation *getRequestedOrDefaultConversation(const QByteArray& hash,
@@ -235,12 +295,23 @@ private:
     OnlineStatus onlineStatus_ = DISCONNECTED;
     bool sentAvatarPendingAck_ = false;
     bool avatarUrlChanging_ = false;
+    bool shapingRetryPending_ = false;
+    int rtt_ = -1;
+    int uploadRate_ = 0;
+    int downloadRate_ = 0;
 
     std::unique_ptr<Connection> connection_;
+    std::vector<PeerMessage> incomingMessages_; // Received, not yet verified
     std::deque<Message::ptr_t> messageQueue_;
     std::deque<Message::ptr_t> unconfirmedMessageQueue_; // Waiting for ack
     std::deque<std::shared_ptr<File>> fileQueue_;
-    std::set<std::shared_ptr<File>> transferringFileQueue_; // Currently transferring, (we have slots)
+    TransferScheduler<File> transferringFileQueue_; // Currently transferring, (we have slots)
+    TokenBucket::ptr_t uploadBucket_;
+    TokenBucket::ptr_t downloadBucket_;
+    BandwidthShaper::ptr_t uploadShaper_;
+    BandwidthShaper::ptr_t downloadShaper_;
+    QueueDepths reportedQueueDepths_;
+    QTimer rateTimer_;
 };
 
 struct ContactData {
@@ -2,6 +2,7 @@
 #define CONVERSATION_H
 
 #include <set>
+#include <vector>
 
 #include <QDir>
 #include <QObject>
@@ -45,6 +46,9 @@ public:
     Q_INVOKABLE void sendFile(const QVariantMap& args);
 
     void incomingMessage(Contact *contact, const MessageData& data);
+
+    // Messages that arrived together. Verified as one batch, and acknowledged in order.
+    void incomingMessages(Contact *contact, std::vector<MessageData> data);
     void incomingFileOffer(Contact *contact, const PeerFileOffer& offer);
 
     int getId() const noexcept;
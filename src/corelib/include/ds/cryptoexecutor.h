@@ -0,0 +1,76 @@
+#ifndef CRYPTOEXECUTOR_H
+#define CRYPTOEXECUTOR_H
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <QObject>
+
+namespace ds {
+namespace core {
+
+/*! Runs expensive crypto operations on a fixed pool of worker threads
+ *
+ * Used for the public key operations in the handshakes (sealed boxes
+ * and signatures), so that many peers connecting at the same time
+ * don't stall the GUI thread.
+ *
+ * Each job has a key, normally the address of the peer that owns
+ * it. Jobs with the same key run on the same worker, in the order
+ * they were posted, so work that depends on per-peer state is never
+ * reordered. When the job is done, the completion runs on the
+ * main thread. If the job threw, the exception is passed to the
+ * completion. If the context object is deleted first, the
+ * completion is dropped.
+ *
+ * Optional. With no threads, jobs and completions run immediately
+ * on the calling thread.
+ */
+class CryptoExecutor
+{
+public:
+    using fn_t = std::function<void ()>;
+
+    // Called with the exception thrown by the job, or nullptr if it succeeded
+    using done_t = std::function<void (const std::exception_ptr& failure)>;
+
+    static CryptoExecutor& instance();
+
+    ~CryptoExecutor();
+
+    /*! Set the number of worker threads. 0 disables the executor.
+     *
+     * Waits for the jobs already queued to finish.
+     */
+    void setThreads(const size_t threads);
+    size_t getThreads() const noexcept { return workers_.size(); }
+    bool isEnabled() const noexcept { return !workers_.empty(); }
+
+    // Run job on a worker, then done on the main thread if context is still alive
+    void post(const void *key, fn_t job, QObject *context, done_t done);
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<fn_t> jobs;
+        bool done = false;
+        std::thread thread;
+    };
+
+    CryptoExecutor() = default;
+    void stop();
+    static void run(Worker& worker);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+};
+
+}} // namespaces
+
+#endif // CRYPTOEXECUTOR_H
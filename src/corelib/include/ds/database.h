@@ -32,6 +32,13 @@ public:
 
     QSqlDatabase& getDb() { return db_; }
 
+    /*! Execute a prepared query.
+     *
+     * Same as query.exec(), but the time it takes
+     * is recorded in the metrics.
+     */
+    static bool exec(QSqlQuery& query);
+
 signals:
 
 public slots:
@@ -20,6 +20,7 @@
 #include "ds/conversationmanager.h"
 #include "ds/messagemanager.h"
 #include "ds/filemanager.h"
+#include "ds/ratelimiter.h"
 
 class QSqlDatabase;
 
@@ -74,6 +75,10 @@ public:
                                           const QByteArray& address);
     void whenOnline(const std::function<void ()>& fn);
 
+    // Global bandwidth limits for file-transfers
+    TokenBucket::ptr_t getUploadBucket();
+    TokenBucket::ptr_t getDownloadBucket();
+
     static QDateTime getSafeNow() noexcept;
     static QDateTime getSafeTime(const QDateTime& when) noexcept;
 
@@ -100,6 +105,7 @@ signals:
     void serviceFailed(const QUuid& uuid, const QByteArray& reason);
     void serviceStarted(const QUuid& uuid, const bool newService);
     void serviceStopped(const QUuid& uuid);
+    void servicePublished(const QUuid& uuid);
     void incomingPeer(const std::shared_ptr<PeerConnection>& peer);
 
 protected:
@@ -118,6 +124,8 @@ protected:
     ConversationManager *conversationManager_ = {};
     MessageManager *messageManager_ = {};
     FileManager *fileManager_ = {};
+    TokenBucket::ptr_t uploadBucket_;
+    TokenBucket::ptr_t downloadBucket_;
 };
 
 }} // namepsaces
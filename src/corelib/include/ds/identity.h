@@ -8,6 +8,7 @@
 #include "ds/protocolmanager.h"
 #include "ds/contact.h"
 #include "ds/conversation.h"
+#include "ds/reconnectscheduler.h"
 
 #include <QString>
 #include <QtGui/QImage>
@@ -88,6 +89,8 @@ signals:
     void nameChanged();
     void notesChanged();
     void autoConnectChanged();
+    void rateLimitsChanged();
+    void transferRatesChanged();
     void avatarChanged();
 
 public:
@@ -133,6 +136,10 @@ public:
     Q_PROPERTY(QByteArray b58identity READ getB58EncodedIdetity CONSTANT)
     Q_PROPERTY(QByteArray handle READ getHandle CONSTANT)
     Q_PROPERTY(bool autoConnect READ isAutoConnect WRITE setAutoConnect NOTIFY autoConnectChanged)
+    Q_PROPERTY(int uploadRateLimit READ getUploadRateLimit WRITE setUploadRateLimit NOTIFY rateLimitsChanged)
+    Q_PROPERTY(int downloadRateLimit READ getDownloadRateLimit WRITE setDownloadRateLimit NOTIFY rateLimitsChanged)
+    Q_PROPERTY(int uploadRate READ getUploadRate NOTIFY transferRatesChanged)
+    Q_PROPERTY(int downloadRate READ getDownloadRate NOTIFY transferRatesChanged)
 
     Q_INVOKABLE void addContact(const QVariantMap& args);
     Q_INVOKABLE void startService();
@@ -179,6 +186,37 @@ public:
     void registerConnection(const Contact::ptr_t& contact);
     void unregisterConnection(const QUuid& uuid);
 
+    // Bandwidth limits shared by all the contacts for this identity
+    TokenBucket::ptr_t getUploadBucket();
+    TokenBucket::ptr_t getDownloadBucket();
+
+    /*! Bandwidth limits for file-transfers for this identity
+     *
+     * Rates are in bytes per second. 0 means unlimited.
+     * Saved in the settings for this identity. Until they are set,
+     * the "identityUploadRateLimit" and "identityDownloadRateLimit"
+     * settings are used.
+     */
+    int getUploadRateLimit();
+    void setUploadRateLimit(const int rate);
+    int getDownloadRateLimit();
+    void setDownloadRateLimit(const int rate);
+
+    /*! Current file-transfer rates for all the contacts of this identity
+     *
+     * In bytes per second. Updated by the contacts while they
+     * transfer files.
+     */
+    int getUploadRate() const noexcept;
+    int getDownloadRate() const noexcept;
+    void updateTransferRates();
+
+    // Connect to the contact as soon as possible, if it's scheduled for connection
+    void expediteConnect(const QUuid& contact);
+
+    // The transport is back on-line. Retry the contacts we failed to connect to.
+    void retryFailedConnects();
+
 public slots:
     void onAddmeRequest(const PeerAddmeReq& req);
 
@@ -195,13 +233,16 @@ signals:
 
 private slots:
     void onProcessOnlineLater();
+    void onContactOnlineStatusChanged();
 
 private:
     void connectContacts();
-    static int getRandomConnectDelay();
+    bool tryConnectContact(const QUuid& uuid);
     void disconnectContacts();
     void forAllContacts(const std::function<void (const Contact::ptr_t&)>& fn );
     std::deque<QUuid> getAllContacts() const;
+    QString getRateLimitKey(const QString& direction) const;
+    void setRateLimit(TokenBucket& bucket, const QString& direction, const int rate);
 
     Contact::ptr_t contactFromHandle(const QByteArray& handle);
     Contact::ptr_t contactFromHash(const QByteArray& hash);
@@ -212,6 +253,11 @@ private:
     IdentityData data_;
     QDateTime created_;
     bool avatarUrlChanging_ = false;
+    TokenBucket::ptr_t uploadBucket_;
+    TokenBucket::ptr_t downloadBucket_;
+    int uploadRate_ = 0;
+    int downloadRate_ = 0;
+    std::unique_ptr<ReconnectScheduler> reconnect_;
 
     // Active Connections in any direction
     // Keeps connected Contacts in memory
@@ -47,6 +47,7 @@ public:
     QVariant data(const QModelIndex &index, int role) const override;
     QHash<int, QByteArray> roleNames() const override;
     void onOnline();
+    void onNetworkUp();
 
 signals:
     void currentIdentityChanged();
@@ -74,6 +74,13 @@ public:
     void sign(const crypto::DsCert& cert);
     bool validate(const crypto::DsCert& cert) const;
 
+    /*! The data covered by the signature, as one buffer.
+     *
+     * The buffer is re-used, so a caller that processes many
+     * messages only needs to allocate when it grows.
+     */
+    void getSignedData(QByteArray& buffer) const;
+
     /*! Add the new Message to the database. */
     void addToDb();
 
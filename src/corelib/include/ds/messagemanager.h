@@ -3,6 +3,7 @@
 
 #include <deque>
 #include <unordered_map>
+#include <vector>
 #include <QUuid>
 #include <QObject>
 
@@ -25,6 +26,16 @@ public:
     Message::ptr_t getMessage(const QByteArray& messageId, const Message::Direction direction);
     Message::ptr_t sendMessage(Conversation& conversation, MessageData data);
     Message::ptr_t receivedMessage(Conversation& conversation, MessageData data);
+
+    /*! Verify and store a backlog of messages from the same contact.
+     *
+     * The signatures are verified in parallel.
+     *
+     * \return One entry per message, in the same order. nullptr for
+     *      messages that failed validation.
+     */
+    std::vector<Message::ptr_t> receivedMessages(Conversation& conversation,
+                                                 std::vector<MessageData> data);
     void touch(const Message::ptr_t& message);
 
     void onMessageReceivedDateChanged(const Message::ptr_t& message);
@@ -38,6 +49,8 @@ signals:
     void messageStateChanged(const Message::ptr_t& message);
 
 private:
+    Message::ptr_t addReceived(Conversation& conversation, const Message::ptr_t& message);
+
     Registry<int, Message> registry_;
     LruCache<Message::ptr_t> lru_cache_{3};
 
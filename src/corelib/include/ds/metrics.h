@@ -0,0 +1,158 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <array>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <QElapsedTimer>
+#include <QString>
+
+namespace ds {
+namespace core {
+
+/*! Monotonic counter */
+class Counter {
+public:
+    void add(const quint64 value = 1) noexcept {
+        value_.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    quint64 get() const noexcept {
+        return value_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<quint64> value_{0};
+};
+
+/*! Value that can go up and down, like a queue depth */
+class Gauge {
+public:
+    void set(const qint64 value) noexcept {
+        value_.store(value, std::memory_order_relaxed);
+    }
+
+    void add(const qint64 value) noexcept {
+        value_.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    qint64 get() const noexcept {
+        return value_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<qint64> value_{0};
+};
+
+/*! Latency histogram
+ *
+ * Values are in microseconds, and are put in buckets with
+ * power of two boundaries. Percentiles are approximated
+ * to the upper boundary of the bucket.
+ */
+class Histogram {
+public:
+    static constexpr size_t num_buckets = 32;
+
+    void record(const quint64 usec) noexcept;
+
+    quint64 getCount() const noexcept {
+        return count_.load(std::memory_order_relaxed);
+    }
+
+    quint64 getSum() const noexcept {
+        return sum_.load(std::memory_order_relaxed);
+    }
+
+    quint64 getMax() const noexcept {
+        return max_.load(std::memory_order_relaxed);
+    }
+
+    // Approximate percentile (0 - 100) in microseconds
+    quint64 getPercentile(const double percentile) const noexcept;
+
+private:
+    std::array<std::atomic<quint64>, num_buckets> buckets_ = {};
+    std::atomic<quint64> count_{0};
+    std::atomic<quint64> sum_{0};
+    std::atomic<quint64> max_{0};
+};
+
+/*! Records the lifetime of the object in a histogram */
+class ScopedTimer {
+public:
+    ScopedTimer(Histogram& histogram)
+        : histogram_{histogram} {
+        timer_.start();
+    }
+
+    ~ScopedTimer() {
+        histogram_.record(static_cast<quint64>(timer_.nsecsElapsed() / 1000));
+    }
+
+private:
+    Histogram& histogram_;
+    QElapsedTimer timer_;
+};
+
+/*! Registry for run-time metrics
+ *
+ * Metrics are created on first use, and live until they
+ * are removed, so it's safe to keep references to them.
+ * Names are dot-separated, like "prot.frames.sent".
+ *
+ * Updating a metric is lock-free. Looking up a metric by
+ * name takes a lock, so frequently updated metrics should
+ * be looked up once and cached.
+ */
+class Metrics {
+public:
+    enum class Type {
+        COUNTER,
+        GAUGE,
+        HISTOGRAM
+    };
+
+    struct Sample {
+        QString name;
+        Type type = Type::COUNTER;
+        qint64 value = {}; // Counter / gauge value, or histogram count
+        quint64 sum = {};
+        quint64 max = {};
+        quint64 p50 = {};
+        quint64 p99 = {};
+    };
+
+    static Metrics& instance();
+
+    Counter& counter(const QString& name);
+    Gauge& gauge(const QString& name);
+    Histogram& histogram(const QString& name);
+
+    // Remove all metrics with names starting with prefix
+    void remove(const QString& prefix);
+
+    // Current value of all the metrics, sorted by name
+    std::vector<Sample> snapshot() const;
+
+    // Write a snapshot to path in json format. Throws on error.
+    void dump(const QString& path) const;
+
+    static const QString& getName(const Type type);
+
+private:
+    Metrics() = default;
+
+    mutable std::mutex mutex_;
+    std::map<QString, std::unique_ptr<Counter>> counters_;
+    std::map<QString, std::unique_ptr<Gauge>> gauges_;
+    std::map<QString, std::unique_ptr<Histogram>> histograms_;
+};
+
+}} // namespaces
+
+#endif // METRICS_H
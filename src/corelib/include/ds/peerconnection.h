@@ -10,6 +10,7 @@
 
 #include "ds/dscert.h"
 #include "message.h"
+#include "ds/ratelimiter.h"
 
 namespace ds{
 namespace core {
@@ -174,6 +175,21 @@ public:
 
     enum Direction { INCOMING, OUTGOING };
 
+    /*! Choose between two connections to the same peer, in opposite directions.
+     *
+     * Both peers make the same choice: The connection initiated by
+     * the peer with the smaller signing pubkey is kept.
+     *
+     * \param identity Our certificate
+     * \param contact The peer's certificate
+     * \return The direction of the connection to keep, as seen by us
+     */
+    static Direction preferredDirection(const crypto::DsCert& identity,
+                                        const crypto::DsCert& contact) {
+        return identity.getSigningPubKey().toByteArray() < contact.getSigningPubKey().toByteArray()
+                ? OUTGOING : INCOMING;
+    }
+
     virtual QUuid getConnectionId() const = 0;
     virtual void authorize(bool allow) = 0;
     virtual Direction getDirection() const noexcept = 0;
@@ -183,6 +199,9 @@ public:
     virtual uint64_t sendAck(const QString& what, const QString& status, const QString& data = {}) = 0;
     virtual uint64_t sendAck(const QString& what, const QString& status, const QVariantMap& params) = 0;
     virtual bool isConnected() const noexcept = 0;
+
+    // False if the output buffer is above its high watermark
+    virtual bool canSendMore() const noexcept = 0;
     virtual uint64_t sendMessage(const Message& message) = 0;
     virtual uint64_t sendAvatar(const QImage& avatar) = 0;
     virtual uint64_t offerFile(const File& file) = 0;
@@ -190,6 +209,12 @@ public:
     virtual uint64_t sendSome(File& file) = 0;
     virtual void disableNotifications() = 0;
 
+    // Throttle incoming file-data through this shaper
+    virtual void setDownloadShaper(BandwidthShaper::ptr_t shaper) = 0;
+
+    // Last measured round-trip time in milliseconds, or -1 if unknown
+    virtual int getRtt() const noexcept { return -1; }
+
 signals:
     void connectedToPeer(const std::shared_ptr<PeerConnection>& peer);
     void disconnectedFromPeer(const std::shared_ptr<PeerConnection>& peer);
@@ -199,6 +224,10 @@ signals:
     void receivedFileOffer(const PeerFileOffer& msg);
     void receivedAvatar(const PeerSetAvatarReq& avatar);
     void outputBufferEmptied();
+
+    // canSendMore() returned false, and the output queue has drained to the low watermark
+    void outputBelowLowWatermark();
+    void rttMeasured(const int msec);
 };
 
 }}
@@ -71,7 +71,10 @@ public:
     };
 
     enum class Transport {
-        TOR
+        TOR,
+
+        // Direct TCP connections, without Tor. For testing only.
+        LOOPBACK
     };
 
     enum class Direction {
@@ -118,6 +121,9 @@ signals:
     void serviceStarted(const QUuid& service, const bool newService);
     void serviceStopped(const QUuid& service);
 
+    /*! The service is reachable; the transport has published its address */
+    void servicePublished(const QUuid& service);
+
     void incomingPeer(const std::shared_ptr<PeerConnection>& peer);
 
 public slots:
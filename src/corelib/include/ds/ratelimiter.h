@@ -0,0 +1,100 @@
+#ifndef RATELIMITER_H
+#define RATELIMITER_H
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include <QtGlobal>
+
+namespace ds {
+namespace core {
+
+/*! Measures the current throughput in bytes per second */
+class RateMeter {
+public:
+    using clock_t = std::chrono::steady_clock;
+
+    void add(const quint64 bytes);
+
+    // Bytes per second, as measured over the last completed window
+    quint64 getRate() const;
+
+    // Total bytes seen by the meter
+    quint64 getTotal() const noexcept { return total_; }
+
+private:
+    void update(const clock_t::time_point& now) const;
+
+    mutable clock_t::time_point windowStart_ = clock_t::now();
+    mutable quint64 windowBytes_ = 0;
+    mutable quint64 rate_ = 0;
+    quint64 total_ = 0;
+};
+
+/*! Token bucket for bandwidth shaping
+ *
+ * The bucket is filled with \a rate bytes per second, up to \a burst bytes.
+ * Data that is sent or received is consumed from the bucket,
+ * and the bucket may go into debt. The caller is expected to wait
+ * for getDelay() before it sends or receives more data.
+ *
+ * A rate of 0 means unlimited. The bucket then only measures the rate.
+ */
+class TokenBucket {
+public:
+    using ptr_t = std::shared_ptr<TokenBucket>;
+    using clock_t = std::chrono::steady_clock;
+
+    TokenBucket(const quint64 rate = 0, const quint64 burst = 0);
+
+    void setRate(const quint64 rate, const quint64 burst = 0);
+    quint64 getLimit() const noexcept { return rate_; }
+    bool isUnlimited() const noexcept { return rate_ == 0; }
+
+    void consume(const quint64 bytes);
+
+    // How long to wait before the bucket allows more data
+    std::chrono::milliseconds getDelay() const;
+
+    const RateMeter& getMeter() const noexcept { return meter_; }
+
+    /*! Create a bucket from the settings
+     *
+     * \param key Settings key for the rate in bytes per second.
+     *      The burst is read from the same key with a "Burst" suffix.
+     * \param defaultKey Key to use if \a key is not set.
+     */
+    static ptr_t create(const QString& key, const QString& defaultKey = {});
+
+private:
+    void refill() const;
+
+    quint64 rate_ = 0;
+    quint64 burst_ = 0;
+    mutable double tokens_ = 0;
+    mutable clock_t::time_point lastRefill_ = clock_t::now();
+    RateMeter meter_;
+};
+
+/*! A chain of token buckets that are applied together.
+ *
+ * Typically the contacts own bucket, the identity's bucket and
+ * the global bucket.
+ */
+class BandwidthShaper {
+public:
+    using ptr_t = std::shared_ptr<BandwidthShaper>;
+
+    BandwidthShaper(std::vector<TokenBucket::ptr_t> buckets);
+
+    void consume(const quint64 bytes);
+    std::chrono::milliseconds getDelay() const;
+
+private:
+    std::vector<TokenBucket::ptr_t> buckets_;
+};
+
+}} // namespaces
+
+#endif // RATELIMITER_H
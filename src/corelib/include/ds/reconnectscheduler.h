@@ -0,0 +1,126 @@
+#ifndef RECONNECTSCHEDULER_H
+#define RECONNECTSCHEDULER_H
+
+#include <chrono>
+#include <functional>
+#include <map>
+
+#include <QObject>
+#include <QTimer>
+#include <QUuid>
+
+namespace ds {
+namespace core {
+
+/*! Schedules outbound connections to contacts
+ *
+ * Limits the number of connection attempts in progress, so that
+ * we don't flood Tor with circuit builds when an identity with
+ * many contacts goes online. Contacts with queued messages or
+ * files are connected first.
+ *
+ * Among contacts that are due, the ones with the lowest known
+ * round-trip time are connected first, as they are likely to
+ * release their slot quickly.
+ *
+ * Each contact gets a random delay before the first attempt, and
+ * an exponential backoff with jitter after failed attempts, to make
+ * the connection pattern harder to correlate on the network.
+ *
+ * The owner starts the actual connection in the connect functor,
+ * and reports the outcome with connected() or failed().
+ */
+class ReconnectScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    using clock_t = std::chrono::steady_clock;
+    using duration_t = std::chrono::milliseconds;
+
+    // Start connecting. Return false if the contact should not be connected now.
+    using connect_fn_t = std::function<bool (const QUuid& contact)>;
+
+    struct Config {
+        size_t maxConcurrent = 4;
+        duration_t startupSpread = std::chrono::seconds(60);
+        duration_t minDelay = std::chrono::seconds(3);
+        duration_t maxDelay = std::chrono::minutes(15);
+        duration_t connectTimeout = std::chrono::minutes(2);
+    };
+
+    ReconnectScheduler(const Config& config, connect_fn_t connectFn,
+                       QObject *parent = nullptr);
+    ~ReconnectScheduler() override;
+
+    // Config from the "maxConcurrentConnects", "connectStartupSpread",
+    // "reconnectMinDelay", "reconnectMaxDelay" and "connectTimeout" settings.
+    static Config getConfig();
+
+    /*! Schedule the first connection attempt to a contact
+     *
+     * Does nothing if the contact is already scheduled.
+     */
+    void schedule(const QUuid& contact, const bool priority = false);
+
+    // Schedule a new attempt after a lost connection
+    void reconnect(const QUuid& contact);
+
+    // Move the contact to the front of the queue
+    void prioritize(const QUuid& contact);
+
+    /*! Retry the contacts that are backing off after failed attempts.
+     *
+     * Used when the transport is back on-line, as the attempts probably
+     * failed because it was down. Resets their backoff.
+     */
+    void retryFailed();
+
+    // The connection to the contact is established
+    void connected(const QUuid& contact);
+
+    // The connection attempt failed. Schedules a new attempt with backoff.
+    void failed(const QUuid& contact);
+
+    // Last measured round-trip time to the contact
+    void setRtt(const QUuid& contact, const duration_t rtt);
+
+    // Forget the contact
+    void remove(const QUuid& contact);
+    void clear();
+
+    bool isScheduled(const QUuid& contact) const;
+    bool isConnecting(const QUuid& contact) const;
+    size_t getConnecting() const noexcept { return connecting_; }
+    size_t size() const noexcept { return entries_.size(); }
+
+    // Random delay before the next attempt, after <attempts> failed attempts
+    duration_t getBackoff(const unsigned attempts) const;
+
+private slots:
+    void process();
+
+private:
+    struct Entry {
+        clock_t::time_point due;
+        clock_t::time_point started;
+        unsigned attempts = 0;
+        bool priority = false;
+        bool connecting = false;
+    };
+
+    void setConnecting(Entry& entry, const bool connecting);
+    void erase(std::map<QUuid, Entry>::iterator it);
+    void startTimer();
+    duration_t getRandom(const duration_t min, const duration_t max) const;
+
+    const Config config_;
+    connect_fn_t connectFn_;
+    std::map<QUuid, Entry> entries_;
+    std::map<QUuid, duration_t> rtt_;
+    size_t connecting_ = 0;
+    QTimer timer_;
+};
+
+}} // namespaces
+
+#endif // RECONNECTSCHEDULER_H
@@ -0,0 +1,65 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <QObject>
+#include <QTimer>
+
+namespace ds {
+namespace core {
+
+/*! Hashed timer wheel for coarse deadlines
+ *
+ * Keeps any number of deadlines with a single QTimer. Adding and
+ * cancelling a deadline is O(1), and each tick only looks at the
+ * deadlines in one slot. Deadlines fire within one tick after
+ * they expire, which is fine for timeouts measured in seconds.
+ *
+ * The timer only runs while there are pending deadlines.
+ */
+class TimerWheel : public QObject
+{
+    Q_OBJECT
+public:
+    using ptr_t = std::shared_ptr<TimerWheel>;
+    using id_t = quint64;
+    using callback_t = std::function<void ()>;
+    using duration_t = std::chrono::milliseconds;
+
+    TimerWheel(const duration_t tick = std::chrono::seconds(1),
+               const size_t slots = 256);
+
+    // Call callback after timeout. Returns an id that can be used to cancel it.
+    id_t add(const duration_t timeout, callback_t callback);
+
+    // Returns true if the deadline was pending
+    bool cancel(const id_t id);
+
+    size_t size() const noexcept { return entries_.size(); }
+    duration_t getTick() const noexcept { return tick_; }
+
+private slots:
+    void onTick();
+
+private:
+    struct Entry {
+        callback_t callback;
+        size_t rounds = 0; // Full turns of the wheel before it expires
+    };
+
+    const duration_t tick_;
+    std::vector<std::vector<id_t>> slots_;
+    std::unordered_map<id_t, Entry> entries_;
+    size_t current_ = 0;
+    id_t nextId_ = 0;
+    QTimer timer_;
+};
+
+}} // namespaces
+
+#endif // TIMERWHEEL_H
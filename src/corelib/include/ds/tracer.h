@@ -0,0 +1,125 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QString>
+
+namespace ds {
+namespace core {
+
+/*! Span based tracing
+ *
+ * Records timestamped spans that can be exported in the
+ * Chrome trace-event format, and viewed in chrome://tracing
+ * or Perfetto.
+ *
+ * Tracing is disabled by default, and then costs one atomic
+ * load per span. When enabled, events are appended to a
+ * bounded buffer. Events that don't fit are dropped and counted.
+ *
+ * Async spans ("b"/"e" events) with the same category and id
+ * are shown on one track, so they can be used to follow one
+ * message from the sender to the receiver.
+ */
+class Tracer {
+public:
+    struct Event {
+        QString name;
+        QString category;
+        QString id; // Async spans
+        char phase = 'X';
+        qint64 ts = {}; // Microseconds since the tracer was created
+        qint64 dur = {};
+        quint64 tid = {};
+    };
+
+    static Tracer& instance();
+
+    bool isEnabled() const noexcept {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    void enable(const bool enable, const size_t maxEvents = 100000);
+
+    // Microseconds since the tracer was created
+    qint64 now() const noexcept {
+        return clock_.nsecsElapsed() / 1000;
+    }
+
+    // The id's are binary, like a message-id, and are exported in base64.
+
+    // Complete span, starting at ts
+    void complete(const QString& name, const QString& category,
+                  const QByteArray& id, const qint64 ts);
+
+    // Async spans. May begin and end in different functions or threads.
+    void begin(const QString& name, const QString& category, const QByteArray& id);
+    void end(const QString& name, const QString& category, const QByteArray& id);
+
+    // Instant event
+    void mark(const QString& name, const QString& category, const QByteArray& id);
+
+    std::vector<Event> events() const;
+    size_t getDropped() const noexcept;
+    void clear();
+
+    // Write the events to path in Chrome trace-event json format. Throws on error.
+    void write(const QString& path) const;
+
+private:
+    Tracer();
+    void add(const QString& name, const QString& category,
+             const QByteArray& id, const char phase,
+             const qint64 ts, const qint64 dur = 0);
+
+    std::atomic_bool enabled_{false};
+    QElapsedTimer clock_;
+    mutable std::mutex mutex_;
+    std::vector<Event> events_;
+    size_t maxEvents_ = 0;
+    size_t dropped_ = 0;
+};
+
+/*! Records the lifetime of the object as a complete span
+ *
+ * Nothing is recorded if tracing was disabled when the
+ * span was created.
+ */
+class TraceSpan {
+public:
+    TraceSpan(const char *name, const char *category, const QByteArray& id = {})
+        : enabled_{Tracer::instance().isEnabled()}
+    {
+        if (enabled_) {
+            name_ = name;
+            category_ = category;
+            id_ = id;
+            start_ = Tracer::instance().now();
+        }
+    }
+
+    ~TraceSpan() {
+        if (enabled_) {
+            Tracer::instance().complete(name_, category_, id_, start_);
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator = (const TraceSpan&) = delete;
+
+private:
+    const bool enabled_;
+    QString name_;
+    QString category_;
+    QByteArray id_;
+    qint64 start_ = {};
+};
+
+}} // namespaces
+
+#endif // TRACER_H
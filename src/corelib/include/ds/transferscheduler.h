@@ -0,0 +1,178 @@
+#ifndef TRANSFERSCHEDULER_H
+#define TRANSFERSCHEDULER_H
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+#include <QtGlobal>
+
+namespace ds {
+namespace core {
+
+/*! Deficit Round Robin scheduler for concurrent transfers
+ *
+ * Each active transfer is a flow. For every round, each flow gets
+ * a quantum added to its deficit, and may send blocks as long as
+ * the next block fits within the deficit. The quantum is weighted
+ * by the remaining bytes of the transfer, so that small files
+ * finish quickly even when a huge file is in flight, while
+ * the huge file still gets its fair share of the bandwidth.
+ */
+template <typename T>
+class TransferScheduler {
+public:
+    using ptr_t = std::shared_ptr<T>;
+
+    // Return the number of bytes remaining to be sent for the item
+    using remaining_fn_t = std::function<quint64 (const T&)>;
+
+    // Send one block. Return the number of bytes sent, or 0 if
+    // the output is blocked. That ends the round, and the next
+    // round continues with the same item and its remaining credit.
+    using send_fn_t = std::function<size_t (T&)>;
+
+    TransferScheduler(remaining_fn_t remaining, size_t blockSize = 1024 * 8)
+        : remaining_{std::move(remaining)}, blockSize_{blockSize} {}
+
+    bool insert(const ptr_t& item) {
+        if (deficits_.find(item) != deficits_.end()) {
+            return false;
+        }
+
+        deficits_[item] = 0;
+        order_.push_back(item);
+        return true;
+    }
+
+    void erase(const ptr_t& item) {
+        if (deficits_.erase(item)) {
+            if (order_.front() == item) {
+                resumeFront_ = false;
+            }
+            order_.erase(std::find(order_.begin(), order_.end(), item));
+        }
+    }
+
+    void clear() {
+        deficits_.clear();
+        order_.clear();
+        resumeFront_ = false;
+    }
+
+    bool empty() const noexcept {
+        return order_.empty();
+    }
+
+    size_t size() const noexcept {
+        return order_.size();
+    }
+
+    // Copy of the items, safe to use if the scheduler is modified
+    std::vector<ptr_t> items() const {
+        return {order_.begin(), order_.end()};
+    }
+
+    /*! Give each flow one round.
+     *
+     * The send functor may modify the scheduler (for example
+     * erase a completed transfer).
+     *
+     * If the output blocks, the round ends there, and the next
+     * round starts with the blocked flow, without giving it
+     * another quantum. That way the flows at the back get their
+     * turn even when the output only takes a few blocks at a time.
+     *
+     * \return Number of bytes sent in this round.
+     */
+    size_t runRound(const send_fn_t& send) {
+        size_t total = 0;
+        auto resume = resumeFront_;
+        resumeFront_ = false;
+
+        for(const auto& item : items()) {
+            const auto resuming = resume;
+            resume = false;
+
+            auto it = deficits_.find(item);
+            if (it == deficits_.end()) {
+                continue; // Removed during this round
+            }
+
+            if (!resuming) {
+                it->second += getQuantum(remaining_(*item));
+            }
+
+            while(true) {
+                it = deficits_.find(item);
+                if (it == deficits_.end()) {
+                    break;
+                }
+
+                const auto next = std::min<quint64>(remaining_(*item), blockSize_);
+                if ((next == 0) || (next > it->second)) {
+                    if (next == 0) {
+                        // Idle flows don't accumulate credit
+                        it->second = 0;
+                    }
+                    break;
+                }
+
+                const auto sent = send(*item);
+
+                it = deficits_.find(item);
+                if (it == deficits_.end()) {
+                    total += sent;
+                    break;
+                }
+
+                if (sent == 0) {
+                    // Keep the credit until the output drains
+                    resumeAt(item);
+                    return total;
+                }
+
+                it->second -= std::min<quint64>(sent, it->second);
+                total += sent;
+            }
+        }
+
+        return total;
+    }
+
+    // Smaller transfers get a larger quantum
+    quint64 getQuantum(const quint64 remaining) const noexcept {
+        if (remaining <= 64 * 1024) {
+            return blockSize_ * 8;
+        }
+
+        if (remaining <= 1024 * 1024) {
+            return blockSize_ * 4;
+        }
+
+        if (remaining <= 64 * 1024 * 1024) {
+            return blockSize_ * 2;
+        }
+
+        return blockSize_;
+    }
+
+private:
+    void resumeAt(const ptr_t& item) {
+        std::rotate(order_.begin(), std::find(order_.begin(), order_.end(), item), order_.end());
+        resumeFront_ = true;
+    }
+
+    remaining_fn_t remaining_;
+    const size_t blockSize_;
+    std::deque<ptr_t> order_;
+    std::map<ptr_t, quint64> deficits_;
+    bool resumeFront_ = false; // The first flow was blocked in the last round
+};
+
+}} // namespaces
+
+#endif // TRANSFERSCHEDULER_H
@@ -8,6 +8,7 @@
 #include <QImage>
 
 #include "ds/errors.h"
+#include "ds/database.h"
 
 namespace ds {
 namespace core {
@@ -25,7 +26,7 @@ void update(T *self, const char *name, const QVariant& value) {
     query.prepare(sql);
     query.bindValue(":id", self->getId());
     query.bindValue(":value", value);
-    if(!query.exec()) {
+    if(!Database::exec(query)) {
         throw Error(QStringLiteral("SQL query failed: %1").arg(
                         query.lastError().text()));
     }
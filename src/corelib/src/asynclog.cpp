@@ -0,0 +1,124 @@
+
+#include "ds/asynclog.h"
+#include "ds/metrics.h"
+
+using namespace std;
+
+namespace ds {
+namespace core {
+
+AsyncLogHandler::AsyncLogHandler(std::unique_ptr<logfault::Handler> handler,
+                                 const size_t maxQueued)
+    : logfault::Handler(handler->level_)
+    , handler_{move(handler)}
+    , maxQueued_{maxQueued}
+{
+    thread_ = thread([this] {
+        run();
+    });
+}
+
+AsyncLogHandler::~AsyncLogHandler()
+{
+    {
+        lock_guard<mutex> lock{mutex_};
+        done_ = true;
+        cv_.notify_one();
+    }
+
+    thread_.join();
+}
+
+void AsyncLogHandler::LogMessage(const logfault::Message &msg)
+{
+    // Reserve a slot before the node is visible to the writer,
+    // so that the counter never goes below zero.
+    if (queued_.fetch_add(1) >= maxQueued_) {
+        queued_.fetch_sub(1);
+        dropped_.fetch_add(1, memory_order_relaxed);
+        Metrics::instance().counter("log.dropped").add();
+        return;
+    }
+
+    push(new Node(msg));
+
+    if (sleeping_.load()) {
+        lock_guard<mutex> lock{mutex_};
+        cv_.notify_one();
+    }
+}
+
+void AsyncLogHandler::push(AsyncLogHandler::Node *node) noexcept
+{
+    node->next.store(nullptr, memory_order_relaxed);
+    auto prev = head_.exchange(node, memory_order_acq_rel);
+    prev->next.store(node, memory_order_release);
+}
+
+AsyncLogHandler::Node *AsyncLogHandler::pop() noexcept
+{
+    auto tail = tail_;
+    auto next = tail->next.load(memory_order_acquire);
+
+    if (tail == &stub_) {
+        if (!next) {
+            return nullptr;
+        }
+        tail_ = next;
+        tail = next;
+        next = next->next.load(memory_order_acquire);
+    }
+
+    if (next) {
+        tail_ = next;
+        return tail;
+    }
+
+    if (tail != head_.load(memory_order_acquire)) {
+        return nullptr; // A producer is in the middle of a push
+    }
+
+    push(&stub_);
+
+    next = tail->next.load(memory_order_acquire);
+    if (next) {
+        tail_ = next;
+        return tail;
+    }
+
+    return nullptr;
+}
+
+void AsyncLogHandler::run()
+{
+    while(true) {
+        while(auto node = pop()) {
+            queued_.fetch_sub(1);
+            try {
+                handler_->LogMessage(*node->message);
+            } catch(const std::exception&) {
+                ; // Nowhere to log this
+            }
+            delete node;
+        }
+
+        if (queued_.load()) {
+            // A message is reserved, but not linked in yet
+            this_thread::yield();
+            continue;
+        }
+
+        unique_lock<mutex> lock{mutex_};
+        if (done_) {
+            break;
+        }
+
+        sleeping_ = true;
+        cv_.wait(lock, [this] {
+            return done_ || (queued_.load() > 0);
+        });
+        sleeping_ = false;
+    }
+}
+
+}} // namespaces
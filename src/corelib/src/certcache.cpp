@@ -0,0 +1,117 @@
+
+#include "ds/certcache.h"
+#include "ds/metrics.h"
+
+#include "logfault/logfault.h"
+
+using namespace std;
+
+namespace ds {
+namespace core {
+
+namespace {
+
+struct CertCacheMetrics {
+    Counter& hits = Metrics::instance().counter("crypto.certcache.hits");
+    Counter& misses = Metrics::instance().counter("crypto.certcache.misses");
+    Counter& evictions = Metrics::instance().counter("crypto.certcache.evictions");
+    Gauge& size = Metrics::instance().gauge("crypto.certcache.size");
+};
+
+CertCacheMetrics& metrics()
+{
+    static CertCacheMetrics m;
+    return m;
+}
+
+} // anonymous namespace
+
+CertCache &CertCache::instance()
+{
+    static CertCache cache;
+    return cache;
+}
+
+CertCache::CertCache(const size_t capacity)
+    : capacity_{capacity}
+{
+}
+
+crypto::DsCert::ptr_t CertCache::getFromPubkey(const QByteArray &pubkey)
+{
+    {
+        lock_guard<mutex> lock{mutex_};
+        auto it = index_.find(pubkey);
+        if (it != index_.end()) {
+            lru_.splice(lru_.begin(), lru_, it->second);
+            metrics().hits.add();
+            return it->second->second;
+        }
+    }
+
+    metrics().misses.add();
+
+    // Don't hold the lock while we do the expensive part
+    return crypto::DsCert::createFromPubkey(pubkey);
+}
+
+void CertCache::add(const QByteArray &pubkey, const crypto::DsCert::ptr_t &cert)
+{
+    lock_guard<mutex> lock{mutex_};
+    if (capacity_ == 0) {
+        return;
+    }
+
+    // Another thread may have added it in the meantime
+    auto it = index_.find(pubkey);
+    if (it != index_.end()) {
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return;
+    }
+
+    lru_.emplace_front(pubkey, cert);
+    index_.emplace(pubkey, lru_.begin());
+    shrink();
+}
+
+void CertCache::setCapacity(const size_t capacity)
+{
+    lock_guard<mutex> lock{mutex_};
+    capacity_ = capacity;
+    shrink();
+
+    LFLOG_DEBUG << "The cert cache holds up to " << capacity << " certs.";
+}
+
+size_t CertCache::getCapacity() const
+{
+    lock_guard<mutex> lock{mutex_};
+    return capacity_;
+}
+
+size_t CertCache::size() const
+{
+    lock_guard<mutex> lock{mutex_};
+    return lru_.size();
+}
+
+void CertCache::clear()
+{
+    lock_guard<mutex> lock{mutex_};
+    index_.clear();
+    lru_.clear();
+    metrics().size.set(0);
+}
+
+void CertCache::shrink()
+{
+    while(lru_.size() > capacity_) {
+        index_.erase(lru_.back().first);
+        lru_.pop_back();
+        metrics().evictions.add();
+    }
+
+    metrics().size.set(static_cast<qint64>(lru_.size()));
+}
+
+}} // namespaces
@@ -1,6 +1,8 @@
 ﻿
 #include <memory>
 
+#include <QTimer>
+
 #include "ds/contact.h"
 #include "ds/dsengine.h"
 #include "ds/identity.h"
@@ -8,6 +10,9 @@
 #include "ds/update_helper.h"
 #include "ds/errors.h"
 #include "ds/conversation.h"
+#include "ds/metrics.h"
+#include "ds/tracer.h"
+#include "ds/database.h"
 
 #include "logfault/logfault.h"
 
@@ -15,6 +20,7 @@ namespace ds {
 namespace core {
 
 using namespace std;
+using namespace std::chrono;
 using namespace crypto;
 
 namespace  {
@@ -32,6 +38,13 @@ Contact::Contact(QObject &parent,
                  data_t data)
     : QObject{&parent}
     , id_{dbId}, online_{online}, data_{move(data)}
+    , transferringFileQueue_{[](const File& file) -> quint64 {
+        if ((file.getDirection() != File::OUTGOING)
+                || (file.getState() != File::FS_TRANSFERRING)) {
+            return 0;
+        }
+        return static_cast<quint64>(max<qlonglong>(0, file.getSize() - file.getBytesTransferred()));
+    }}
 {
     connect(this, &Contact::sendAddMeLater,
             this, &Contact::onSendAddMeLater,
@@ -45,6 +58,14 @@ Contact::Contact(QObject &parent,
             this, &Contact::onProcessOnlineLater,
             Qt::QueuedConnection);
 
+    connect(this, &Contact::processIncomingMessagesLater,
+            this, &Contact::onProcessIncomingMessagesLater,
+            Qt::QueuedConnection);
+
+    rateTimer_.setInterval(1000);
+    connect(&rateTimer_, &QTimer::timeout,
+            this, &Contact::updateTransferRates);
+
     LFLOG_TRACE << "Contact #" << getId() << " " << getName()
                 << " is being constructed.";
 
@@ -63,6 +84,8 @@ Contact::~Contact()
     } catch(const exception& ex) {
         LFLOG_ERROR << "Caught exception: " << ex.what();
     }
+
+    reportQueueDepths({});
 }
 
 void Contact::connectToContact()
@@ -227,6 +250,19 @@ void Contact::setLastSeen(const QDateTime &when)
     updateIf("last_seen", when, data_->lastSeen, this, &Contact::lastSeenChanged);
 }
 
+int Contact::getRtt() const noexcept
+{
+    return rtt_;
+}
+
+void Contact::onRttMeasured(const int msec)
+{
+    if (rtt_ != msec) {
+        rtt_ = msec;
+        emit rttChanged();
+    }
+}
+
 void Contact::touchLastSeen()
 {
     const auto when = QDateTime::fromTime_t((QDateTime::currentDateTimeUtc().toTime_t() / 60) * 60);
@@ -322,6 +358,11 @@ void Contact::setOnlineStatus(const Contact::OnlineStatus status)
         emit onlineStatusChanged();
 
         setOnline(onlineStatus_ == ONLINE);
+
+        if (onlineStatus_ != ONLINE) {
+            // Unknown until it is measured on the next connection
+            onRttMeasured(-1);
+        }
     }
 }
 
@@ -346,9 +387,13 @@ void Contact::queueMessage(const Message::ptr_t &message)
     loadMessageQueue();
 
     if (message->getDirection() == Message::OUTGOING) {
+        // Ends when the message is handed over to the peer
+        Tracer::instance().begin("message.queued", "message", message->getData().messageId);
         messageQueue_.push_back(message);
         message->setState(Message::MS_QUEUED);
         procesMessageQueue();
+        updateQueueMetrics();
+        expediteConnect();
     }
 }
 
@@ -359,6 +404,17 @@ void Contact::queueFile(const std::shared_ptr<File> &file)
     // Send offer or start transfer, depending on direction
     fileQueue_.push_back(file);
     processFilesQueue();
+    updateQueueMetrics();
+    expediteConnect();
+}
+
+void Contact::expediteConnect()
+{
+    if (!isOnline()) {
+        if (auto identity = getIdentity()) {
+            identity->expediteConnect(getUuid());
+        }
+    }
 }
 
 void Contact::sendAvatar(const QImage &avatar)
@@ -384,7 +440,7 @@ Contact::ptr_t Contact::load(QObject& parent, const QUuid &key)
                   "id, identity, uuid, name, nickname, cert, address, notes, contact_group, avatar, created, initiated_by, last_seen, state, addme_message, auto_connect, hash, peer_verified, manually_disconnected, download_path "
                   " from contact where uuid=:uuid");
     query.bindValue(":uuid", key);
-    if(!query.exec()) {
+    if(!Database::exec(query)) {
         throw Error(QStringLiteral("Failed to fetch contact: %1").arg(
                         query.lastError().text()));
     }
@@ -462,7 +518,7 @@ void Contact::addToDb()
     query.bindValue(":manually_disconnected", data_->manuallyDisconnected);
     query.bindValue(":download_path", data_->downloadPath);
 
-    if(!query.exec()) {
+    if(!Database::exec(query)) {
         throw Error(QStringLiteral("Failed to add Contact: %1").arg(
                         query.lastError().text()));
     }
@@ -479,7 +535,7 @@ void Contact::deleteFromDb() {
         QSqlQuery query;
         query.prepare("DELETE FROM contact WHERE id=:id");
         query.bindValue(":id", id_);
-        if(!query.exec()) {
+        if(!Database::exec(query)) {
             throw Error(QStringLiteral("SQL Failed to delete identity: %1").arg(
                             query.lastError().text()));
         }
@@ -537,15 +593,21 @@ void Contact::onConnectedToPeer(const std::shared_ptr<PeerConnection>& peer)
          *
          * - A new incoming connection replaces an existing incoming connection
          * - A new outgoing connection replaces an existing outgoing connection
-         * - If the existion connection is active, compare hashes and use the lesser one.
+         * - If the existing connection is active and in the other direction,
+         *   keep the one that the peer will also keep.
+         *
+         * Simultaneous connects are normally resolved by the protocol layer
+         * during the handshake. This handles the cases it leaves to us.
          */
 
         if (isOnline() && connection_ && (connection_->peer->getDirection() != peer->getDirection())) {
-            if (getCert()->getHash().toByteArray() < peer->getPeerCert()->getHash().toByteArray()) {
-                LFLOG_NOTICE << "Incmoing connection with id " << peer->getConnectionId().toString()
-                             << " has a 'larger' hash than my hash. "
-                             << "I will therefore prefer my current, active connection "
-                             << connection_->peer->getConnectionId().toString();
+            const auto preferred = PeerConnection::preferredDirection(
+                        *getIdentity()->getCert(), *getCert());
+            if (connection_->peer->getDirection() == preferred) {
+                LFLOG_NOTICE << "Connection with id " << peer->getConnectionId().toString()
+                             << " collides with my current, active connection "
+                             << connection_->peer->getConnectionId().toString()
+                             << ", which I prefer. Closing the new connection.";
                 peer->close();
                 return;
             }
@@ -557,6 +619,7 @@ void Contact::onConnectedToPeer(const std::shared_ptr<PeerConnection>& peer)
 
         prepareForNewConnection();
         connection_ = make_unique<Connection>(peer, *this);
+        connection_->peer->setDownloadShaper(getDownloadShaper());
     }
 
     if (connection_->peer->getDirection() == PeerConnection::INCOMING) {
@@ -583,6 +646,12 @@ void Contact::onConnectedToPeer(const std::shared_ptr<PeerConnection>& peer)
     connect(connection_->peer.get(), &PeerConnection::outputBufferEmptied,
             this, &Contact::onOutputBufferEmptied);
 
+    connect(connection_->peer.get(), &PeerConnection::outputBelowLowWatermark,
+            this, &Contact::onOutputBufferEmptied);
+
+    connect(connection_->peer.get(), &PeerConnection::rttMeasured,
+            this, &Contact::onRttMeasured);
+
     setOnlineStatus(ONLINE);
     touchLastSeen();
 }
@@ -607,6 +676,11 @@ void Contact::onDisconnectedFromPeer(const std::shared_ptr<PeerConnection>& peer
                 << " to Contact " << getName()
                 << " is disconnected.";
 
+    if (connection_ && (connection_->peer != peer)) {
+        // A connection we replaced, for example after a collision
+        return;
+    }
+
     connection_.reset();
     setOnlineStatus(DISCONNECTED);
     clearFileQueues();
@@ -729,12 +803,15 @@ void Contact::onReceivedAck(const PeerAck &ack)
                        << getIdentity()->getName()
                        << ". Ignoring the message.";
         }
-    }if (ack.what == "AddAvatar") {
+    } else if (ack.what == "SetAvatar") {
         sentAvatarPendingAck_ = false;
         if (ack.status == "Accepted") {
             LFLOG_TRACE << "Contact " << getName()
                         << " accepted the avatar sent from Identity "
                         << getIdentity()->getName();
+
+            // Don't send it again until it changes
+            setSentAvatar(true);
         } else {
             LFLOG_TRACE << "Contact " << getName()
                         << " rejected the avatar sent from Identity "
@@ -778,6 +855,7 @@ void Contact::onReceivedAck(const PeerAck &ack)
         }
 
         message->touchSentReceivedTime();
+        Tracer::instance().end("message.delivery", "message", messageId);
 
         if (ack.status == "Received") {
             message->setState(Message::MS_RECEIVED);
@@ -882,6 +960,9 @@ bool Contact::procesMessageQueue()
 
         // TODO: Check ready status on socket
         try {
+            const auto& messageId = messageQueue_.front()->getData().messageId;
+            Tracer::instance().end("message.queued", "message", messageId);
+            TraceSpan span{"Contact::procesMessageQueue", "message", messageId};
             connection_->peer->sendMessage(*messageQueue_.front());
             messageQueue_.front()->setState(Message::MS_SENT);
         } catch(const std::exception& ex) {
@@ -947,58 +1028,104 @@ bool Contact::processFilesQueue()
 
 bool Contact::processFileBlocks()
 {
-    for(auto& file : transferringFileQueue_) {
-        if (!isOnline()) {
-            break;
-        }
+    if (!isOnline() || transferringFileQueue_.empty()) {
+        return false;
+    }
 
-        if (file->getState() != File::FS_TRANSFERRING) {
-            transferringFileQueue_.erase(file);
-            return processFileBlocks(); // Try again
-        }
+    auto shaper = getUploadShaper();
+    auto delay = shaper->getDelay();
+    if (delay.count() > 0) {
+        scheduleShapingRetry(delay);
+        return false;
+    }
 
-        if (file->getDirection() != File::OUTGOING) {
-            continue;
+    // Give each active transfer a fair share of the connection, weighted
+    // so that small files are not starved by a large file.
+    const auto sent = transferringFileQueue_.runRound([this, &shaper](File& file) -> size_t {
+        if (!isOnline()
+                || !connection_->peer->canSendMore()
+                || (shaper->getDelay().count() > 0)) {
+            return 0;
         }
 
-        if (connection_->peer->sendSome(*file) > 0) {
-            return true;
+        const auto before = file.getBytesTransferred();
+        if (connection_->peer->sendSome(file) == 0) {
+            return 0;
         }
 
-        if (file->getState() == File::FS_TRANSFERRING) {
-            break; // We could not send, and the file is not complete or failed
-        }
+        const auto bytes = static_cast<size_t>(max<qlonglong>(1, file.getBytesTransferred() - before));
+        shaper->consume(bytes);
+        return bytes;
+    });
+
+    if (!sent && ((delay = shaper->getDelay()).count() > 0)) {
+        // We will not get another outputBufferEmptied() notification
+        scheduleShapingRetry(delay);
     }
 
-    return false;
+    return sent > 0;
 }
 
 void Contact::onReceivedMessage(const PeerMessage &msg)
 {
-    if (getState() != ACCEPTED) {
-        LFLOG_WARN << "Rejecting message on connection "
-                   << msg.peer->getConnectionId().toString()
-                   << ". Not in ACCEPTED state.";
+    TraceSpan span{"Contact::onReceivedMessage", "message", msg.data.messageId};
 
-        msg.peer->sendAck("Message", "Rejected", msg.data.messageId.toBase64());
-        msg.peer->close();
-        return;
+    // Messages that arrive together, like the backlog after a
+    // reconnect, are verified as one batch.
+    incomingMessages_.push_back(msg);
+    if (incomingMessages_.size() == 1) {
+        emit processIncomingMessagesLater();
     }
+}
 
-    auto conversation = getRequestedOrDefaultConversation(
-                msg.data.conversation, *msg.peer, "Message",
-                msg.data.messageId);
+void Contact::onProcessIncomingMessagesLater()
+{
+    auto pending = move(incomingMessages_);
+    incomingMessages_.clear();
+
+    // Consecutive messages to the same conversation are delivered together
+    Conversation *batchConversation = {};
+    vector<MessageData> batch;
+    const auto flush = [&] {
+        if (!batch.empty()) {
+            batchConversation->incomingMessages(this, move(batch));
+            batch.clear();
+        }
+    };
 
-    if (!conversation) {
-        return;
-    }
+    for(auto& msg : pending) {
+        if (getState() != ACCEPTED) {
+            LFLOG_WARN << "Rejecting message on connection "
+                       << msg.peer->getConnectionId().toString()
+                       << ". Not in ACCEPTED state.";
 
-    LFLOG_DEBUG << "Accepting incoming message with id: " << msg.data.messageId.toHex()
-                << " over connection " << msg.peer->getConnectionId().toString()
-                << " to " << getName()
-                << " for local delivery to conversation " << conversation->getName();
+            msg.peer->sendAck("Message", "Rejected", msg.data.messageId.toBase64());
+            msg.peer->close();
+            continue;
+        }
 
-    conversation->incomingMessage(this, msg.data);
+        auto conversation = getRequestedOrDefaultConversation(
+                    msg.data.conversation, *msg.peer, "Message",
+                    msg.data.messageId);
+
+        if (!conversation) {
+            continue;
+        }
+
+        LFLOG_DEBUG << "Accepting incoming message with id: " << msg.data.messageId.toHex()
+                    << " over connection " << msg.peer->getConnectionId().toString()
+                    << " to " << getName()
+                    << " for local delivery to conversation " << conversation->getName();
+
+        if (conversation != batchConversation) {
+            flush();
+            batchConversation = conversation;
+        }
+
+        batch.push_back(move(msg.data));
+    }
+
+    flush();
 }
 
 void Contact::onReceivedFileOffer(const PeerFileOffer &msg)
@@ -1034,6 +1161,12 @@ void Contact::onReceivedAvatar(const PeerSetAvatarReq &avatar)
 }
 
 void Contact::onOutputBufferEmptied()
+{
+    processQueues();
+    updateQueueMetrics();
+}
+
+void Contact::processQueues()
 {
     if (isOnline()) {
         if (procesMessageQueue()) {
@@ -1063,7 +1196,7 @@ void Contact::loadMessageQueue()
     query.prepare("SELECT m.id FROM message AS m LEFT JOIN conversation AS c ON m.conversation_id = c.id WHERE c.participants = :contact AND m.received_time IS NULL ORDER BY m.id");
     query.bindValue(":contact", getUuid().toString());
 
-    if(!query.exec()) {
+    if(!Database::exec(query)) {
         throw Error(QStringLiteral("Failed to query message-queue: %1").arg(
                         query.lastError().text()));
     }
@@ -1098,7 +1231,7 @@ void Contact::loadFileQueue()
     query.bindValue(":waiting", static_cast<int>(File::FS_WAITING));
     query.bindValue(":queued", static_cast<int>(File::FS_QUEUED));
 
-    if(!query.exec()) {
+    if(!Database::exec(query)) {
         throw Error(QStringLiteral("Failed to query file-queue: %1").arg(
                         query.lastError().text()));
     }
@@ -1125,7 +1258,11 @@ void Contact::queueTransfer(const std::shared_ptr<File> &file)
         return;
     }
 
-    if (transferringFileQueue_.insert(file).second) {
+    if (transferringFileQueue_.insert(file)) {
+        if (!rateTimer_.isActive()) {
+            rateTimer_.start();
+        }
+
         std::weak_ptr<File> weak = file;
         QMetaObject::Connection conn;
         connect(file.get(), &File::stateChanged,
@@ -1173,7 +1310,7 @@ void Contact::clearFileQueues()
     fileQueue_.clear();
 
     // transferringFileQueue_ may be modified by file state change events
-    auto tmpTransfers = transferringFileQueue_;
+    const auto tmpTransfers = transferringFileQueue_.items();
 
     for(auto& file : tmpTransfers) {
         if (file->getState() == File::FS_TRANSFERRING) {
@@ -1183,6 +1320,151 @@ void Contact::clearFileQueues()
 
     transferringFileQueue_.clear();
     loadedFileQueue_ = false; // No longer loaded
+    updateQueueMetrics();
+}
+
+void Contact::updateQueueMetrics()
+{
+    QueueDepths depths;
+    depths.messages = static_cast<qint64>(messageQueue_.size());
+    depths.unconfirmed = static_cast<qint64>(unconfirmedMessageQueue_.size());
+    depths.files = static_cast<qint64>(fileQueue_.size());
+    depths.transfers = static_cast<qint64>(transferringFileQueue_.size());
+    reportQueueDepths(depths);
+}
+
+// The gauges are the totals for all contacts, so we report the change.
+void Contact::reportQueueDepths(const QueueDepths &depths)
+{
+    static auto& messages = Metrics::instance().gauge("contact.queue.messages");
+    static auto& unconfirmed = Metrics::instance().gauge("contact.queue.unconfirmed");
+    static auto& files = Metrics::instance().gauge("contact.queue.files");
+    static auto& transfers = Metrics::instance().gauge("contact.queue.transfers");
+
+    messages.add(depths.messages - reportedQueueDepths_.messages);
+    unconfirmed.add(depths.unconfirmed - reportedQueueDepths_.unconfirmed);
+    files.add(depths.files - reportedQueueDepths_.files);
+    transfers.add(depths.transfers - reportedQueueDepths_.transfers);
+    reportedQueueDepths_ = depths;
+}
+
+TokenBucket::ptr_t Contact::getUploadBucket()
+{
+    if (!uploadBucket_) {
+        uploadBucket_ = TokenBucket::create(getRateLimitKey("upload"),
+                                            "contactUploadRateLimit");
+    }
+    return uploadBucket_;
+}
+
+TokenBucket::ptr_t Contact::getDownloadBucket()
+{
+    if (!downloadBucket_) {
+        downloadBucket_ = TokenBucket::create(getRateLimitKey("download"),
+                                              "contactDownloadRateLimit");
+    }
+    return downloadBucket_;
+}
+
+QString Contact::getRateLimitKey(const QString &direction) const
+{
+    return QStringLiteral("contacts/%1/%2RateLimit").arg(getUuid().toString(), direction);
+}
+
+void Contact::setRateLimit(TokenBucket &bucket, const QString &direction, const int rate)
+{
+    const auto limit = static_cast<quint64>(max(0, rate));
+    if (bucket.getLimit() != limit) {
+        DsEngine::instance().settings().setValue(getRateLimitKey(direction), limit);
+        bucket.setRate(limit);
+        emit rateLimitsChanged();
+    }
+}
+
+int Contact::getUploadRateLimit()
+{
+    return static_cast<int>(getUploadBucket()->getLimit());
+}
+
+void Contact::setUploadRateLimit(const int rate)
+{
+    setRateLimit(*getUploadBucket(), "upload", rate);
+}
+
+int Contact::getDownloadRateLimit()
+{
+    return static_cast<int>(getDownloadBucket()->getLimit());
+}
+
+void Contact::setDownloadRateLimit(const int rate)
+{
+    setRateLimit(*getDownloadBucket(), "download", rate);
+}
+
+BandwidthShaper::ptr_t Contact::getUploadShaper()
+{
+    if (!uploadShaper_) {
+        uploadShaper_ = make_shared<BandwidthShaper>(vector<TokenBucket::ptr_t>{
+            getUploadBucket(),
+            getIdentity()->getUploadBucket(),
+            DsEngine::instance().getUploadBucket()});
+    }
+
+    return uploadShaper_;
+}
+
+BandwidthShaper::ptr_t Contact::getDownloadShaper()
+{
+    if (!downloadShaper_) {
+        downloadShaper_ = make_shared<BandwidthShaper>(vector<TokenBucket::ptr_t>{
+            getDownloadBucket(),
+            getIdentity()->getDownloadBucket(),
+            DsEngine::instance().getDownloadBucket()});
+    }
+
+    return downloadShaper_;
+}
+
+void Contact::scheduleShapingRetry(const milliseconds &delay)
+{
+    if (shapingRetryPending_) {
+        return;
+    }
+
+    shapingRetryPending_ = true;
+    QTimer::singleShot(static_cast<int>(delay.count()), this, [this]() {
+        shapingRetryPending_ = false;
+        onOutputBufferEmptied();
+    });
+}
+
+int Contact::getUploadRate() const noexcept
+{
+    return uploadRate_;
+}
+
+int Contact::getDownloadRate() const noexcept
+{
+    return downloadRate_;
+}
+
+void Contact::updateTransferRates()
+{
+    const auto upload = static_cast<int>(getUploadBucket()->getMeter().getRate());
+    const auto download = static_cast<int>(getDownloadBucket()->getMeter().getRate());
+
+    if ((upload != uploadRate_) || (download != downloadRate_)) {
+        uploadRate_ = upload;
+        downloadRate_ = download;
+        emit transferRatesChanged();
+    }
+
+    getIdentity()->updateTransferRates();
+
+    // Keep going until the rates have dropped to zero
+    if (transferringFileQueue_.empty() && !upload && !download) {
+        rateTimer_.stop();
+    }
 }
 
 void Contact::prepareForNewConnection()
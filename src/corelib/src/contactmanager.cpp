@@ -38,7 +38,7 @@ Contact::ptr_t ContactManager::getContact(const int dbId)
     QSqlQuery query;
     query.prepare("SELECT uuid FROM contact WHERE id=:id");
     query.bindValue(":id", dbId);
-    query.exec();
+    Database::exec(query);
     if (query.next()) {
         return getContact(query.value(0).toUuid());
     }
@@ -4,6 +4,8 @@
 #include "ds/dsengine.h"
 #include "ds/crypto.h"
 #include "ds/identity.h"
+#include "ds/database.h"
+#include "ds/tracer.h"
 
 #include "logfault/logfault.h"
 
@@ -54,6 +56,10 @@ void Conversation::sendMessage(const QString &text)
                            data.conversation,
                            data.composedTime.toString().toUtf8()});
 
+    // Ends when the peer acknowledge the message
+    Tracer::instance().begin("message.delivery", "message", data.messageId);
+    TraceSpan span{"Conversation::sendMessage", "message", data.messageId};
+
     DsEngine::instance().getMessageManager()->sendMessage(*this, data);
     touchLastActivity();
 }
@@ -95,11 +101,35 @@ void Conversation::incomingMessage(Contact *contact, const MessageData &data)
     }
 
     // Send ack
+    TraceSpan span{"message.ack", "message", data.messageId};
     contact->sendAck("Message", "Received", data.messageId.toBase64());
 
     touchLastActivity();
 }
 
+void Conversation::incomingMessages(Contact *contact, std::vector<MessageData> data)
+{
+    if (data.size() == 1) {
+        incomingMessage(contact, data.front());
+        return;
+    }
+
+    vector<QByteArray> ids;
+    ids.reserve(data.size());
+    for(const auto& d : data) {
+        ids.push_back(d.messageId);
+    }
+
+    const auto messages = DsEngine::instance().getMessageManager()->receivedMessages(*this, move(data));
+
+    for(size_t i = 0; i < messages.size(); ++i) {
+        TraceSpan span{"message.ack", "message", ids[i]};
+        contact->sendAck("Message", messages[i] ? "Received" : "Rejected", ids[i].toBase64());
+    }
+
+    touchLastActivity();
+}
+
 void Conversation::incomingFileOffer(Contact *contact, const PeerFileOffer &offer)
 {
     Q_UNUSED(contact)
@@ -296,7 +326,7 @@ void Conversation::addToDb()
     query.bindValue(":unread", unread_);
     query.bindValue(":hash", hash_);
 
-    if(!query.exec()) {
+    if(!Database::exec(query)) {
         throw Error(QStringLiteral("Failed to save Conversation: %1").arg(
                         query.lastError().text()));
     }
@@ -315,7 +345,7 @@ void Conversation::deleteFromDb()
         QSqlQuery query;
         query.prepare("DELETE FROM conversation WHERE id=:id");
         query.bindValue(":id", id_);
-        if(!query.exec()) {
+        if(!Database::exec(query)) {
             throw Error(QStringLiteral("SQL Failed to delete conversation: %1").arg(
                             query.lastError().text()));
         }
@@ -384,7 +414,7 @@ Conversation::ptr_t Conversation::load(QObject &parent, const std::function<void
 
     prepare(query);
 
-    if(!query.exec()) {
+    if(!Database::exec(query)) {
         throw Error(QStringLiteral("Failed to fetch conversation: %1").arg(
                         query.lastError().text()));
     }
@@ -44,7 +44,7 @@ Conversation::ptr_t ConversationManager::getConversation(const int dbId)
     QSqlQuery query;
     query.prepare("SELECT uuid FROM conversation WHERE id=:id");
     query.bindValue(":id", dbId);
-    query.exec();
+    Database::exec(query);
     if (query.next()) {
         return getConversation(query.value(0).toUuid());
     }
@@ -58,7 +58,7 @@ Conversation::ptr_t ConversationManager::getConversation(Contact *participant)
     query.prepare("SELECT uuid FROM conversation WHERE participants=:uuid AND identity=:identity");
     query.bindValue(":uuid", participant->getUuid());
     query.bindValue(":identity", participant->getIdentityId());
-    query.exec();
+    Database::exec(query);
     if (query.next()) {
         return getConversation(query.value(0).toUuid());
     }
@@ -73,7 +73,7 @@ Conversation::ptr_t ConversationManager::getConversation(const QByteArray &hash,
     query.bindValue(":hash", hash);
     query.bindValue(":uuid", participant->getUuid());
     query.bindValue(":identity", participant->getIdentityId());
-    query.exec();
+    Database::exec(query);
     if (query.next()) {
         return getConversation(query.value(0).toUuid());
     }
@@ -0,0 +1,159 @@
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QMetaObject>
+#include <QPointer>
+
+#include "ds/cryptoexecutor.h"
+#include "ds/metrics.h"
+
+#include "logfault/logfault.h"
+
+using namespace std;
+
+namespace ds {
+namespace core {
+
+namespace {
+
+struct ExecutorMetrics {
+    Counter& jobs = Metrics::instance().counter("crypto.executor.jobs");
+    Gauge& queued = Metrics::instance().gauge("crypto.executor.queued");
+    Histogram& latency = Metrics::instance().histogram("crypto.executor.latency");
+};
+
+ExecutorMetrics& metrics()
+{
+    static ExecutorMetrics m;
+    return m;
+}
+
+// Returns the exception thrown by the job, if any
+exception_ptr runJob(const CryptoExecutor::fn_t& job)
+{
+    try {
+        job();
+    } catch(const std::exception& ex) {
+        LFLOG_WARN << "Caught exception from crypto job: " << ex.what();
+        return current_exception();
+    }
+
+    return {};
+}
+
+} // anonymous namespace
+
+CryptoExecutor &CryptoExecutor::instance()
+{
+    static CryptoExecutor executor;
+    return executor;
+}
+
+CryptoExecutor::~CryptoExecutor()
+{
+    stop();
+}
+
+void CryptoExecutor::setThreads(const size_t threads)
+{
+    if (threads == workers_.size()) {
+        return;
+    }
+
+    stop();
+
+    for(size_t i = 0; i < threads; ++i) {
+        auto worker = make_unique<Worker>();
+        auto& w = *worker;
+        w.thread = thread([&w] {
+            run(w);
+        });
+        workers_.push_back(move(worker));
+    }
+
+    LFLOG_DEBUG << "The crypto executor uses " << threads << " threads.";
+}
+
+void CryptoExecutor::post(const void *key, fn_t job, QObject *context, done_t done)
+{
+    if (workers_.empty()) {
+        done(runJob(job));
+        return;
+    }
+
+    metrics().jobs.add();
+    metrics().queued.add(1);
+
+    // Fibonacci hashing, as the low bits of a pointer are mostly zero
+    const auto hash = static_cast<quint64>(reinterpret_cast<quintptr>(key)) * 11400714819323198485ull;
+    auto& worker = *workers_[static_cast<size_t>(hash >> 32) % workers_.size()];
+
+    QPointer<QObject> target{context};
+    QElapsedTimer queued;
+    queued.start();
+
+    auto task = [job = move(job), done = move(done), target, queued]() mutable {
+        metrics().queued.add(-1);
+        metrics().latency.record(static_cast<quint64>(queued.nsecsElapsed() / 1000));
+
+        auto failure = runJob(job);
+
+        // The context may be deleted while we are on our way, so it's
+        // checked again on the main thread.
+        if (auto app = QCoreApplication::instance()) {
+            QMetaObject::invokeMethod(app, [target, done = move(done), failure = move(failure)] {
+                if (target) {
+                    done(failure);
+                }
+            }, Qt::QueuedConnection);
+        }
+    };
+
+    {
+        lock_guard<mutex> lock{worker.mutex};
+        worker.jobs.push_back(move(task));
+    }
+    worker.cv.notify_one();
+}
+
+void CryptoExecutor::stop()
+{
+    for(auto& worker : workers_) {
+        {
+            lock_guard<mutex> lock{worker->mutex};
+            worker->done = true;
+        }
+        worker->cv.notify_one();
+    }
+
+    for(auto& worker : workers_) {
+        worker->thread.join();
+    }
+
+    workers_.clear();
+}
+
+void CryptoExecutor::run(CryptoExecutor::Worker &worker)
+{
+    while(true) {
+        fn_t job;
+        {
+            unique_lock<mutex> lock{worker.mutex};
+            worker.cv.wait(lock, [&worker] {
+                return worker.done || !worker.jobs.empty();
+            });
+
+            // Finish the queued jobs before we quit
+            if (worker.jobs.empty()) {
+                return;
+            }
+
+            job = move(worker.jobs.front());
+            worker.jobs.pop_front();
+        }
+
+        job();
+    }
+}
+
+}} // namespaces
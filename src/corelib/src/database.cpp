@@ -3,6 +3,7 @@
 
 #include "ds/database.h"
 #include "ds/file.h"
+#include "ds/metrics.h"
 
 #include "logfault/logfault.h"
 
@@ -80,7 +81,7 @@ void Database::createDatabase()
         QSqlQuery query(db_);
         query.prepare("INSERT INTO ds (version) VALUES (:version)");
         query.bindValue(":version", currentVersion);
-        if(!query.exec()) {
+        if(!Database::exec(query)) {
             throw Error("Failed to initialize database");
         }
 
@@ -92,6 +93,19 @@ void Database::createDatabase()
     db_.commit();
 }
 
+bool Database::exec(QSqlQuery &query)
+{
+    static auto& queries = Metrics::instance().histogram("db.queryTime");
+    static auto& failures = Metrics::instance().counter("db.queryFailures");
+
+    ScopedTimer timer{queries};
+    const auto result = query.exec();
+    if (!result) {
+        failures.add();
+    }
+    return result;
+}
+
 void Database::exec(const char *sql)
 {
     QSqlQuery query(db_);
@@ -111,7 +125,7 @@ void Database::prepareData()
         query.bindValue(":transferring", static_cast<int>(File::FS_TRANSFERRING));
         query.bindValue(":queued", static_cast<int>(File::FS_TRANSFERRING));
         query.bindValue(":offered", static_cast<int>(File::FS_OFFERED));
-        query.exec();
+        Database::exec(query);
         if (query.lastError().type() != QSqlError::NoError) {
             throw Error(QStringLiteral("SQL query failed: %1").arg(query.lastError().text()));
         }
@@ -123,7 +137,7 @@ void Database::prepareData()
         query.bindValue(":queued", static_cast<int>(File::FS_QUEUED));
         query.bindValue(":in", static_cast<int>(File::INCOMING));
         query.bindValue(":transferring", static_cast<int>(File::FS_TRANSFERRING));
-        query.exec();
+        Database::exec(query);
         if (query.lastError().type() != QSqlError::NoError) {
             throw Error(QStringLiteral("SQL query failed: %1").arg(query.lastError().text()));
         }
@@ -15,6 +15,8 @@
 #include "ds/logutil.h"
 #include "ds/bytes.h"
 #include "ds/memoryview.h"
+#include "ds/tracer.h"
+#include "ds/asynclog.h"
 
 #include <QString>
 #include <QDebug>
@@ -52,6 +54,15 @@ DsEngine::DsEngine(std::unique_ptr<QSettings> settings)
 
 DsEngine::~DsEngine()
 {
+    const auto tracePath = settings_->value("tracePath").toString();
+    if (Tracer::instance().isEnabled() && !tracePath.isEmpty()) {
+        try {
+            Tracer::instance().write(tracePath);
+        } catch(const std::exception& ex) {
+            LFLOG_ERROR << "Failed to write trace: " << ex.what();
+        }
+    }
+
     assert(instance_ == this);
     instance_ = {};
 }
@@ -152,6 +163,22 @@ void DsEngine::whenOnline(const std::function<void ()>& fn)
     }
 }
 
+TokenBucket::ptr_t DsEngine::getUploadBucket()
+{
+    if (!uploadBucket_) {
+        uploadBucket_ = TokenBucket::create("uploadRateLimit");
+    }
+    return uploadBucket_;
+}
+
+TokenBucket::ptr_t DsEngine::getDownloadBucket()
+{
+    if (!downloadBucket_) {
+        downloadBucket_ = TokenBucket::create("downloadRateLimit");
+    }
+    return downloadBucket_;
+}
+
 QDateTime DsEngine::getSafeNow() noexcept
 {
     return getSafeTime(QDateTime::currentDateTime());
@@ -281,6 +308,10 @@ void DsEngine::start()
             &ds::core::ProtocolManager::serviceFailed,
             this, &DsEngine::onServiceFailed);
 
+    connect(tor_mgr_.get(),
+            &ds::core::ProtocolManager::servicePublished,
+            this, &DsEngine::servicePublished);
+
     connect(tor_mgr_.get(),
             &ds::core::ProtocolManager::incomingPeer,
             this, [this](const std::shared_ptr<PeerConnection>& peer) {
@@ -309,6 +340,10 @@ void DsEngine::onStateChanged(const ProtocolManager::State old, const ProtocolMa
         setState(State::RUNNING);
         break;
     case ProtocolManager::State::ONLINE:
+        // Back from a network outage
+        if (old == ProtocolManager::State::CONNECTED) {
+            identityManager_->onNetworkUp();
+        }
         break;
     case ProtocolManager::State::SHUTTINGDOWN:
         break;
@@ -409,12 +444,20 @@ void DsEngine::initialize()
 
     LogManager::Instance().ClearHandlers();
 
+    // Format and write log messages from a background thread
+    const bool logAsync = settings_->value("logAsync", true).toBool();
+    auto addLogHandler = [logAsync](unique_ptr<logfault::Handler> handler) {
+        if (logAsync) {
+            handler = make_unique<AsyncLogHandler>(move(handler));
+        }
+        LogManager::Instance().AddHandler(move(handler));
+    };
+
     if (isEnabled(LogSystem::STDOUT)) {
 
         const auto level = getLogLevel(LogSystem::STDOUT);
-        LogManager::Instance().AddHandler(
-                make_unique<StreamHandler>(
-                    clog, level));
+        addLogHandler(make_unique<StreamHandler>(
+                          clog, level));
 
         LFLOG_NOTICE << "Enabled logging to standard output at level "
                      << logfault::Handler::LevelName(level);
@@ -423,9 +466,8 @@ void DsEngine::initialize()
     if (isEnabled(LogSystem::LOGFILE)) {
         const auto level = getLogLevel(LogSystem::LOGFILE);
         auto logPath = settings_->value("logPath", "").toString().toUtf8().toStdString();
-        LogManager::Instance().AddHandler(
-                make_unique<StreamHandler>(
-                    logPath, level, true));
+        addLogHandler(make_unique<StreamHandler>(
+                          logPath, level, true));
 
         LFLOG_NOTICE << "Enabled logging to \""
                      << logPath
@@ -433,6 +475,12 @@ void DsEngine::initialize()
                      << logfault::Handler::LevelName(level);
     }
 
+    if (settings_->value("traceEnabled", false).toBool()) {
+        const auto maxEvents = settings_->value("traceMaxEvents", 100000).toUInt();
+        Tracer::instance().enable(true, maxEvents);
+        LFLOG_NOTICE << "Enabled tracing of up to " << maxEvents << " events";
+    }
+
     database_ = std::make_unique<Database>(*settings_);
 
     identityManager_ = new IdentityManager(*this);
@@ -518,25 +566,20 @@ QByteArray DsEngine::imageToBytes(const QImage &img)
 QByteArray DsEngine::getIdentityAsBase58(const DsCert::ptr_t &cert, const QByteArray &address)
 {
     // Format:
-    //  1 byte version (1)
+    //  1 byte version (1 for legacy onion addresses, 2 for v3)
     //  32 byte pubkey
-    //  10 bytes onion address
+    //  10 bytes legacy onion address, or the 32 byte pubkey of a v3 onion address
     //  2 bytes port
 
     // B58 tag: {11, 176}
 
-    QByteArray bytes;
-
-    bytes.append('\1'); // Version
-    bytes += cert->getSigningPubKey().toByteArray();
-
     // Parse the address
     std::string onion, port;
-    static const regex legacy_pattern{R"(^(onion:)?([a-z2-7]{16})\:(\d{3,5})$)"};
+    static const regex pattern{R"(^(onion:)?([a-z2-7]{16}|[a-z2-7]{56})\:(\d{3,5})$)"};
 
     std::smatch m;
     std::string str = address.toStdString();
-    if (std::regex_match(str, m, legacy_pattern)) {
+    if (std::regex_match(str, m, pattern)) {
         onion = m[2].str();
         port = m[3].str();
     } else {
@@ -544,13 +587,23 @@ QByteArray DsEngine::getIdentityAsBase58(const DsCert::ptr_t &cert, const QByteA
         return {};
     }
 
-    if (onion.size() == 16) {
-        // Legacy onion address
-        bytes += crypto::onion16decode({onion.c_str()});
-    } else {
-        // TODO: Implement
-        LFLOG_ERROR << "getIdentityAsBase58 NOT IMPLEMENTED for modern Tor addresses!";
-        return "Sorry, Not implemented";
+    const bool legacy = onion.size() == 16;
+
+    QByteArray bytes;
+    bytes.append(legacy ? '\1' : '\2'); // Version
+    bytes += cert->getSigningPubKey().toByteArray();
+
+    try {
+        if (legacy) {
+            bytes += crypto::onion16decode({onion.c_str()});
+        } else {
+            // The checksum and version can be re-created from the pubkey
+            bytes += crypto::onionV3ToPubkey({onion.c_str()});
+        }
+    } catch(const std::exception& ex) {
+        LFLOG_ERROR << "getIdentityAsBase58: Invalid address: " << address
+                    << ": " << ex.what();
+        return {};
     }
 
     appendValueToBytes(qToBigEndian(static_cast<uint16_t>(atoi(port.c_str()))), bytes);
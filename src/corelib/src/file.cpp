@@ -8,6 +8,7 @@
 #include "ds/crypto.h"
 #include "ds/file.h"
 #include "ds/hashtask.h"
+#include "ds/database.h"
 
 #include <sodium.h>
 
@@ -343,7 +344,7 @@ void File::addToDb()
     query.bindValue(":created_time", data_->createdTime);
     query.bindValue(":ack_time", data_->ackTime);
     query.bindValue(":bytes_transferred", data_->bytesTransferred);
-    if(!query.exec()) {
+    if(!Database::exec(query)) {
         throw Error(QStringLiteral("Failed to save File: %1").arg(
                         query.lastError().text()));
     }
@@ -361,7 +362,7 @@ void File::deleteFromDb()
         QSqlQuery query;
         query.prepare("DELETE FROM file WHERE id=:id");
         query.bindValue(":id", id_);
-        if(!query.exec()) {
+        if(!Database::exec(query)) {
             throw Error(QStringLiteral("SQL Failed to delete file: %1").arg(
                             query.lastError().text()));
         }
@@ -427,7 +428,7 @@ File::ptr_t File::load(QObject &parent, const std::function<void (QSqlQuery &)>
 
     prepare(query);
 
-    if(!query.exec()) {
+    if(!Database::exec(query)) {
         throw Error(QStringLiteral("Failed to fetch file: %1").arg(
                         query.lastError().text()));
     }
@@ -4,6 +4,7 @@
 #include <QStandardPaths>
 
 #include "include/ds/filemanager.h"
+#include "ds/database.h"
 
 #include "logfault/logfault.h"
 
@@ -37,7 +38,7 @@ File::ptr_t FileManager::getFile(const QByteArray &hash, Conversation &conversat
     query.prepare("SELECT id FROM file WHERE hash=:hash AND conversation_id=:cid");
     query.bindValue(":hash", hash);
     query.bindValue(":cid", conversation.getId());
-    query.exec();
+    Database::exec(query);
     if (query.next()) {
         return getFile(query.value(0).toInt());
     }
@@ -51,7 +52,7 @@ File::ptr_t FileManager::getFileFromId(const QByteArray &fileId, Conversation &c
     query.prepare("SELECT id FROM file WHERE file_id=:fid AND conversation_id=:cid");
     query.bindValue(":fid", fileId);
     query.bindValue(":cid", conversation.getId());
-    query.exec();
+    Database::exec(query);
 
     if (query.next()) {
         return getFile(query.value(0).toInt());
@@ -66,7 +67,7 @@ File::ptr_t FileManager::getFileFromId(const QByteArray &fileId, const File::Dir
     query.prepare("SELECT id FROM file WHERE file_id=:fid AND direction=:direction");
     query.bindValue(":fid", fileId);
     query.bindValue(":direction", static_cast<int>(direction));
-    query.exec();
+    Database::exec(query);
 
     if (query.next()) {
         return getFile(query.value(0).toInt());
@@ -81,7 +82,7 @@ File::ptr_t FileManager::getFileFromId(const QByteArray &fileId, const Contact &
     query.prepare("SELECT id FROM file WHERE file_id=:fid AND contact_id=:cid");
     query.bindValue(":fid", fileId);
     query.bindValue(":cid", contact.getId());
-    query.exec();
+    Database::exec(query);
 
     if (query.next()) {
         return getFile(query.value(0).toInt());
@@ -1,7 +1,10 @@
 
 #include <array>
 
+#include <QElapsedTimer>
+
 #include "ds/hashtask.h"
+#include "ds/metrics.h"
 
 #include "logfault/logfault.h"
 
@@ -14,7 +17,15 @@ HashTask::HashTask(QObject *owner, File::ptr_t file)
  : QObject{owner}, file_{move(file)} {}
 
 void HashTask::run() {
+    static auto& hashTime = Metrics::instance().histogram("file.hash.time");
+    static auto& hashedBytes = Metrics::instance().counter("file.hash.bytes");
+    static auto& hashRate = Metrics::instance().gauge("file.hash.rate");
+
     try {
+        QElapsedTimer timer;
+        timer.start();
+        quint64 bytes = 0;
+
         QFile file(getPath());
         if (!file.open(QIODevice::ReadOnly)) {
             emit hashed({}, "Failed to open file");
@@ -25,7 +36,7 @@ void HashTask::run() {
         crypto_hash_sha256_init(&state);
 
         std::array<uint8_t, 1024 * 8> buffer = {};
-        while(!file.isOpen()) {
+        while(file.isOpen()) {
             if (file_->getState() != File::FS_HASHING) {
                 LFLOG_WARN << "File #" << file_->getId()
                            << " changed state during hashing. Aborting!";
@@ -40,6 +51,7 @@ void HashTask::run() {
             if (bytes_read > 0) {
                 crypto_hash_sha256_update(&state, buffer.data(),
                                           static_cast<size_t>(bytes_read));
+                bytes += static_cast<quint64>(bytes_read);
             } else if (bytes_read == 0) {
                 file.close();
             } else {
@@ -52,6 +64,14 @@ void HashTask::run() {
         QByteArray out;
         out.resize(crypto_hash_sha256_BYTES);
         crypto_hash_sha256_final(&state, reinterpret_cast<uint8_t *>(out.data()));
+
+        const auto usec = static_cast<quint64>(timer.nsecsElapsed() / 1000);
+        hashTime.record(usec);
+        hashedBytes.add(bytes);
+        if (usec) {
+            hashRate.set(static_cast<qint64>(bytes * 1000000 / usec)); // bytes per second
+        }
+
         emit hashed(out, {});
     } catch(const std::exception& ex) {
         LFLOG_WARN << "Caught exception from task: " << ex.what();
@@ -1,4 +1,5 @@
-#include <random>
+#include <algorithm>
+#include <set>
 
 #include "ds/dsengine.h"
 #include "ds/identity.h"
@@ -6,6 +7,8 @@
 #include "ds/update_helper.h"
 #include "ds/dscert.h"
 #include "ds/base58.h"
+#include "ds/database.h"
+#include "ds/file.h"
 
 #include "logfault/logfault.h"
 
@@ -24,6 +27,11 @@ Identity::Identity(QObject& parent,
     : QObject{&parent}
     , id_{dbId}, online_{online}, data_{std::move(data)}, created_{move(created)}
 {
+    reconnect_ = make_unique<ReconnectScheduler>(
+                ReconnectScheduler::getConfig(),
+                [this](const QUuid& uuid) {
+        return tryConnectContact(uuid);
+    });
 
     connect(this, &Identity::processOnlineLater,
             this, &Identity::onProcessOnlineLater,
@@ -130,52 +138,132 @@ void Identity::onProcessOnlineLater()
 
 void Identity::connectContacts()
 {
+    // Contacts with queued messages or files are connected first
+    set<QString> pendingMessages;
+    set<int> pendingFiles;
+
     QSqlQuery query;
-    query.prepare("SELECT uuid FROM contact WHERE identity=:id AND auto_connect=1");
+    query.prepare("SELECT DISTINCT c.participants FROM message AS m LEFT JOIN conversation AS c ON m.conversation_id = c.id WHERE c.identity = :id AND m.received_time IS NULL");
+    query.bindValue(":id", getId());
+    if(!Database::exec(query)) {
+        throw Error(QStringLiteral("Failed to query message-queues: %1").arg(
+                        query.lastError().text()));
+    }
+
+    while (query.next()) {
+        pendingMessages.insert(query.value(0).toString());
+    }
+
+    query.prepare("SELECT DISTINCT contact_id FROM file WHERE identity_id=:id AND ((direction=:out AND state=:waiting) OR (direction=:in AND state=:queued))");
+    query.bindValue(":id", getId());
+    query.bindValue(":out", static_cast<int>(File::OUTGOING));
+    query.bindValue(":in", static_cast<int>(File::INCOMING));
+    query.bindValue(":waiting", static_cast<int>(File::FS_WAITING));
+    query.bindValue(":queued", static_cast<int>(File::FS_QUEUED));
+    if(!Database::exec(query)) {
+        throw Error(QStringLiteral("Failed to query file-queues: %1").arg(
+                        query.lastError().text()));
+    }
+
+    while (query.next()) {
+        pendingFiles.insert(query.value(0).toInt());
+    }
+
+    query.prepare("SELECT id, uuid FROM contact WHERE identity=:id AND auto_connect=1");
     query.bindValue(":id", getId());
-    if(!query.exec()) {
+    if(!Database::exec(query)) {
         throw Error(QStringLiteral("Failed to fetch contact from hash: %1").arg(
                         query.lastError().text()));
     }
 
+    // Connect to contacts with random delays to make it a tiny bit harder for
+    // NSA, German intelligence and GRU to deduce what's going on,
+    // based on based on the meta-date they collect from the transport
+    // layer on the network. The scheduler limits the number of
+    // concurrent connection attempts.
     while (query.next()) {
-        auto contact = DsEngine::instance().getContactManager()->getContact(query.value(0).toUuid());
+        const auto uuid = query.value(1).toUuid();
+        const bool priority = (pendingFiles.count(query.value(0).toInt()) > 0)
+                || (pendingMessages.count(uuid.toString()) > 0);
 
-        // Connect to contacts with random delays to make it a tiny bit harder for
-        // NSA, German intelligence and GRU to deduce what's going on,
-        // based on based on the meta-date they collect from the transport
-        // layer on the network.
-        const auto delay = getRandomConnectDelay();
+        reconnect_->schedule(uuid, priority);
+    }
+
+    LFLOG_DEBUG << "Identity " << getName()
+                << " has scheduled " << reconnect_->size()
+                << " contacts for connection.";
+}
+
+bool Identity::tryConnectContact(const QUuid &uuid)
+{
+    // Get the contact from the manager.
+    // This will fail if the contact was deleted while the connect was scheduled...
+    auto contact = DsEngine::instance().getContactManager()->getContact(uuid);
+    if (!contact) {
+        return false;
+    }
+
+    if (isOnline()
+          && contact->isAutoConnect()
+          && !contact->wasManuallyDisconnected()
+          && (contact->getOnlineStatus() == Contact::DISCONNECTED)
+          && ((contact->getState() == Contact::WAITING_FOR_ACCEPTANCE)
+           || (contact->getState() == Contact::ACCEPTED)
+           || (contact->getState() == Contact::PENDING))) {
 
         LFLOG_DEBUG << "Identity " << getName()
-                    << " will connect to Contact " << contact->getName()
-                    << " in " << (delay / 1000) << " seconds.";
-
-        auto uuid = contact->getUuid();
-        QTimer::singleShot(delay, this, [this, uuid]() {
-            // Get the contact again fromn the manager.
-            // This will fail if the contact was deleted while the timer was running...
-            if (auto contact = DsEngine::instance().getContactManager()->getContact(uuid)) {
-                if (isOnline()
-                      && contact->isAutoConnect()
-                      && !contact->wasManuallyDisconnected()
-                      && (contact->getOnlineStatus() == Contact::DISCONNECTED)
-                      && ((contact->getState() == Contact::WAITING_FOR_ACCEPTANCE)
-                       || (contact->getState() == Contact::ACCEPTED)
-                       || (contact->getState() == Contact::PENDING))) {
-                    contact->connectToContact();
-                }
-            }
-        });
+                    << " is connecting to Contact " << contact->getName();
+
+        connect(contact.get(), &Contact::onlineStatusChanged,
+                this, &Identity::onContactOnlineStatusChanged,
+                Qt::UniqueConnection);
+
+        contact->connectToContact();
+        return true;
     }
+
+    return false;
 }
 
-int Identity::getRandomConnectDelay()
+void Identity::onContactOnlineStatusChanged()
 {
-     static random_device rd;
-     static mt19937 gen{rd()}; //Standard mersenne_twister_engine seeded with rd()
-     static std::uniform_int_distribution<> dis(3000, 60000);
-     return dis(gen);
+    auto contact = qobject_cast<Contact *>(sender());
+    if (!contact) {
+        return;
+    }
+
+    const auto uuid = contact->getUuid();
+
+    switch(contact->getOnlineStatus()) {
+    case Contact::ONLINE:
+        reconnect_->connected(uuid);
+        break;
+    case Contact::DISCONNECTED:
+        [[fallthrough]];
+    case Contact::OFFLINE:
+        reconnect_->setRtt(uuid, chrono::milliseconds{contact->getRtt()});
+        if (reconnect_->isConnecting(uuid)) {
+            reconnect_->failed(uuid);
+        } else if (isOnline() && contact->isAutoConnect()) {
+            // Lost an established connection
+            reconnect_->reconnect(uuid);
+        }
+        break;
+    case Contact::CONNECTING:
+        break;
+    }
+}
+
+void Identity::expediteConnect(const QUuid &contact)
+{
+    reconnect_->prioritize(contact);
+}
+
+void Identity::retryFailedConnects()
+{
+    if (isOnline()) {
+        reconnect_->retryFailed();
+    }
 }
 
 void Identity::disconnectContacts()
@@ -219,7 +307,7 @@ std::deque<QUuid> Identity::getAllContacts() const
     QSqlQuery query;
     query.prepare("SELECT uuid FROM contact WHERE identity=:id");
     query.bindValue(":id", getId());
-    if(!query.exec()) {
+    if(!Database::exec(query)) {
         throw Error(QStringLiteral("Failed to fetch contact from hash: %1").arg(
                         query.lastError().text()));
     }
@@ -245,7 +333,7 @@ Contact::ptr_t Identity::contactFromHash(const QByteArray &hash)
     query.prepare("SELECT uuid FROM contact WHERE identity=:id AND hash=:hash");
     query.bindValue(":id", getId());
     query.bindValue(":hash", hash);
-    if(!query.exec()) {
+    if(!Database::exec(query)) {
         throw Error(QStringLiteral("Failed to fetch contact from hash: %1").arg(
                         query.lastError().text()));
     }
@@ -274,7 +362,7 @@ Conversation::ptr_t Identity::convesationFromHash(const QByteArray &hash)
     query.prepare("SELECT uuid FROM conversation WHERE identity=:id AND hash=:hash");
     query.bindValue(":id", getId());
     query.bindValue(":hash", hash);
-    if(!query.exec()) {
+    if(!Database::exec(query)) {
         throw Error(QStringLiteral("Failed to fetch conversation from hash: %1").arg(
                         query.lastError().text()));
     }
@@ -309,6 +397,81 @@ void Identity::unregisterConnection(const QUuid &uuid)
                 << " active connections ";
 }
 
+TokenBucket::ptr_t Identity::getUploadBucket()
+{
+    if (!uploadBucket_) {
+        uploadBucket_ = TokenBucket::create(getRateLimitKey("upload"),
+                                            "identityUploadRateLimit");
+    }
+    return uploadBucket_;
+}
+
+TokenBucket::ptr_t Identity::getDownloadBucket()
+{
+    if (!downloadBucket_) {
+        downloadBucket_ = TokenBucket::create(getRateLimitKey("download"),
+                                              "identityDownloadRateLimit");
+    }
+    return downloadBucket_;
+}
+
+int Identity::getUploadRateLimit()
+{
+    return static_cast<int>(getUploadBucket()->getLimit());
+}
+
+void Identity::setUploadRateLimit(const int rate)
+{
+    setRateLimit(*getUploadBucket(), "upload", rate);
+}
+
+int Identity::getDownloadRateLimit()
+{
+    return static_cast<int>(getDownloadBucket()->getLimit());
+}
+
+void Identity::setDownloadRateLimit(const int rate)
+{
+    setRateLimit(*getDownloadBucket(), "download", rate);
+}
+
+int Identity::getUploadRate() const noexcept
+{
+    return uploadRate_;
+}
+
+int Identity::getDownloadRate() const noexcept
+{
+    return downloadRate_;
+}
+
+void Identity::updateTransferRates()
+{
+    const auto upload = static_cast<int>(getUploadBucket()->getMeter().getRate());
+    const auto download = static_cast<int>(getDownloadBucket()->getMeter().getRate());
+
+    if ((upload != uploadRate_) || (download != downloadRate_)) {
+        uploadRate_ = upload;
+        downloadRate_ = download;
+        emit transferRatesChanged();
+    }
+}
+
+QString Identity::getRateLimitKey(const QString &direction) const
+{
+    return QStringLiteral("identities/%1/%2RateLimit").arg(getUuid().toString(), direction);
+}
+
+void Identity::setRateLimit(TokenBucket &bucket, const QString &direction, const int rate)
+{
+    const auto limit = static_cast<quint64>(max(0, rate));
+    if (bucket.getLimit() != limit) {
+        DsEngine::instance().settings().setValue(getRateLimitKey(direction), limit);
+        bucket.setRate(limit);
+        emit rateLimitsChanged();
+    }
+}
+
 int Identity::getId() const noexcept {
     return id_;
 }
@@ -391,6 +554,7 @@ void Identity::setOnline(const bool value) {
             emit processOnlineLater();
         } else {
             disconnectContacts();
+            reconnect_->clear();
         }
     }
 }
@@ -457,7 +621,7 @@ void Identity::addToDb() {
     query.bindValue(":created", created_);
     query.bindValue(":auto_connect", data_.autoConnect);
 
-    if(!query.exec()) {
+    if(!Database::exec(query)) {
         throw Error(QStringLiteral("Failed to add identity: %1").arg(
                         query.lastError().text()));
     }
@@ -475,7 +639,7 @@ void Identity::deleteFromDb() {
         QSqlQuery query;
         query.prepare("DELETE FROM identity WHERE id=:id");
         query.bindValue(":id", id_);
-        if(!query.exec()) {
+        if(!Database::exec(query)) {
             throw Error(QStringLiteral("SQL Failed to delete identity: %1").arg(
                             query.lastError().text()));
         }
@@ -3,6 +3,7 @@
 #include "ds/errors.h"
 #include "ds/dscert.h"
 #include "ds/dsengine.h"
+#include "ds/database.h"
 
 
 #include <QSqlQuery>
@@ -35,7 +36,7 @@ void IdentityManager::load()
                   "id, uuid, hash, name, cert, address, address_data, notes, avatar, created, auto_connect "
                   " FROM identity ");
 
-    if(!query.exec()) {
+    if(!Database::exec(query)) {
         throw Error(QStringLiteral("Failed to add identity: %1").arg(
                         query.lastError().text()));
     }
@@ -223,6 +224,13 @@ void IdentityManager::onOnline()
     }
 }
 
+void IdentityManager::onNetworkUp()
+{
+    for(auto identity : rows_) {
+        identity->retryFailedConnects();
+    }
+}
+
 Identity *IdentityManager::addIdentity(const IdentityData &data)
 {
     const QDateTime when = QDateTime::fromTime_t((QDateTime::currentDateTimeUtc().toTime_t() / 60) * 60);
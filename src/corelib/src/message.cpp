@@ -7,6 +7,7 @@
 #include "ds/errors.h"
 #include "ds/update_helper.h"
 #include "ds/dsengine.h"
+#include "ds/database.h"
 
 #include "logfault/logfault.h"
 
@@ -96,7 +97,7 @@ Conversation *Message::getConversation() const
     QSqlQuery query;
     query.prepare("SELECT uuid FROM conversation WHERE id=:id");
     query.bindValue(":id", getConversationId());
-    if(!query.exec()) {
+    if(!Database::exec(query)) {
         throw Error(QStringLiteral("Failed to fetch conversation from id: %1").arg(
                         query.lastError().text()));
     }
@@ -121,25 +122,40 @@ void Message::sign(const DsCert &cert)
     assert(!data_->messageId.isEmpty());
     assert(data_->composedTime.isValid());
 
-    data_->signature = cert.sign<QByteArray>({
-        data_->conversation,
-        data_->messageId,
-        data_->composedTime.toString(Qt::ISODate).toUtf8(),
-        data_->content.toUtf8(),
-        data_->sender,
-        QString::number(static_cast<int>(data_->encoding)).toUtf8()});
+    QByteArray buffer;
+    getSignedData(buffer);
+    data_->signature = cert.sign<QByteArray>({buffer});
 }
 
 bool Message::validate(const DsCert &cert) const
 {
-    return  cert.verify(data_->signature,
-        {data_->conversation,
-            data_->messageId,
-            data_->composedTime.toString(Qt::ISODate).toUtf8(),
-            data_->content.toUtf8(),
-            data_->sender,
-            QString::number(static_cast<int>(data_->encoding)).toUtf8()
-                        });
+    QByteArray buffer;
+    getSignedData(buffer);
+    return cert.verify(data_->signature, {buffer});
+}
+
+void Message::getSignedData(QByteArray &buffer) const
+{
+    // Same bytes as the parts we used to feed one by one to the signature
+    const auto date = data_->composedTime.toString(Qt::ISODate);
+    const auto encoding = static_cast<int>(data_->encoding);
+
+    buffer.resize(0);
+    buffer.reserve(data_->conversation.size()
+                   + data_->messageId.size()
+                   + date.size()
+                   + (data_->content.size() * 3)
+                   + data_->sender.size()
+                   + 12);
+
+    buffer.append(data_->conversation);
+    buffer.append(data_->messageId);
+    for(const auto ch : date) {
+        buffer.append(static_cast<char>(ch.unicode())); // ISO dates are ascii
+    }
+    buffer.append(data_->content.toUtf8());
+    buffer.append(data_->sender);
+    buffer.append(QByteArray::number(encoding));
 }
 
 void Message::addToDb()
@@ -167,7 +183,7 @@ void Message::addToDb()
     query.bindValue(":encoding", data_->encoding);
 
 
-    if(!query.exec()) {
+    if(!Database::exec(query)) {
         throw Error(QStringLiteral("Failed to add Message: %1").arg(
                         query.lastError().text()));
     }
@@ -184,7 +200,7 @@ void Message::deleteFromDb()
         QSqlQuery query;
         query.prepare("DELETE FROM message WHERE id=:id");
         query.bindValue(":id", id_);
-        if(!query.exec()) {
+        if(!Database::exec(query)) {
             throw Error(QStringLiteral("SQL Failed to delete message: %1").arg(
                             query.lastError().text()));
         }
@@ -202,7 +218,7 @@ Message::ptr_t Message::load(QObject &parent, int dbId)
     query.prepare("SELECT direction, state, conversation_id, conversation, message_id, composed_time, received_time, content, signature, sender, encoding FROM message where id=:id ");
     query.bindValue(":id", dbId);
 
-    if(!query.exec()) {
+    if(!Database::exec(query)) {
         throw Error(QStringLiteral("Failed to fetch Message: %1").arg(
                         query.lastError().text()));
     }
@@ -1,6 +1,9 @@
 #include "ds/messagemanager.h"
 #include "ds/dsengine.h"
 #include "ds/database.h"
+#include "ds/tracer.h"
+#include "ds/metrics.h"
+#include "ds/batchverifier.h"
 
 #include "logfault/logfault.h"
 
@@ -34,7 +37,7 @@ Message::ptr_t MessageManager::getMessage(const QByteArray &messageId,
     query.prepare("SELECT id FROM message WHERE conversation_id=:cid and message_id=:mid");
     query.bindValue(":cid", conversationId);
     query.bindValue(":mid", messageId);
-    if(!query.exec()) {
+    if(!Database::exec(query)) {
         throw Error(QStringLiteral("Failed to fetch Message from hash: %1").arg(
                         query.lastError().text()));
     }
@@ -52,7 +55,7 @@ Message::ptr_t MessageManager::getMessage(const QByteArray &messageId, const Mes
     query.prepare("SELECT id FROM message WHERE message_id=:mid and direction=:direction");
     query.bindValue(":mid", messageId);
     query.bindValue(":direction", static_cast<int>(direction));
-    if(!query.exec()) {
+    if(!Database::exec(query)) {
         throw Error(QStringLiteral("Failed to fetch Message from hash: %1").arg(
                         query.lastError().text()));
     }
@@ -71,8 +74,16 @@ Message::ptr_t MessageManager::sendMessage(Conversation &conversation, MessageDa
     assert(conversation.getIdentity());
 
     auto cert = conversation.getIdentity()->getCert();
-    message->sign(*cert);
-    message->addToDb();
+    {
+        TraceSpan span{"message.sign", "message", data.messageId};
+        message->sign(*cert);
+    }
+
+    {
+        TraceSpan span{"message.store", "message", data.messageId};
+        message->addToDb();
+    }
+
     registry_.add(message->getId(), message);
     touch(message);
 
@@ -92,20 +103,91 @@ Message::ptr_t MessageManager::receivedMessage(Conversation &conversation, Messa
     assert(conversation.getIdentity());
     assert(conversation.getFirstParticipant());
 
+    TraceSpan receiveSpan{"MessageManager::receivedMessage", "message", data.messageId};
+
     auto cert = conversation.getFirstParticipant()->getCert();
-    if (!message->validate(*cert)) {
+    bool valid = false;
+    {
+        TraceSpan span{"message.verify", "message", data.messageId};
+        valid = message->validate(*cert);
+    }
+
+    if (!valid) {
         LFLOG_WARN << "Incoming message from " << conversation.getFirstParticipant()->getName()
                    << " to " << conversation.getIdentity()->getName()
                    << " failed validation. Rejecting.";
         return {};
     }
 
+    return addReceived(conversation, message);
+}
+
+std::vector<Message::ptr_t> MessageManager::receivedMessages(Conversation &conversation,
+                                                             std::vector<MessageData> data)
+{
+    assert(conversation.getIdentity());
+    assert(conversation.getFirstParticipant());
+
+    TraceSpan receiveSpan{"MessageManager::receivedMessages", "message"};
+
+    auto cert = conversation.getFirstParticipant()->getCert();
+
+    vector<Message::ptr_t> messages;
+    vector<crypto::BatchVerifier::Item> items;
+    messages.reserve(data.size());
+    items.resize(data.size());
+
+    for(size_t i = 0; i < data.size(); ++i) {
+        messages.push_back(make_shared<Message>(*this, move(data[i]), Message::INCOMING,
+                                                conversation.getId()));
+        auto& item = items[i];
+        item.cert = cert.get();
+        item.signature = messages.back()->getData().signature;
+        messages.back()->getSignedData(item.data);
+    }
+
+    vector<bool> valid;
+    {
+        TraceSpan span{"message.verify.batch", "message"};
+        ScopedTimer timer{Metrics::instance().histogram("message.verify.batch")};
+        valid = crypto::BatchVerifier{}.verify(items);
+    }
+
+    Metrics::instance().counter("message.verify.batched").add(messages.size());
+
+    for(size_t i = 0; i < messages.size(); ++i) {
+        if (!valid[i]) {
+            LFLOG_WARN << "Incoming message from " << conversation.getFirstParticipant()->getName()
+                       << " to " << conversation.getIdentity()->getName()
+                       << " failed validation. Rejecting.";
+            messages[i].reset();
+            continue;
+        }
+
+        messages[i] = addReceived(conversation, messages[i]);
+    }
+
+    return messages;
+}
+
+Message::ptr_t MessageManager::addReceived(Conversation &conversation,
+                                           const Message::ptr_t &message)
+{
+    const auto& data = message->getData();
+
     // See if we already have received this message
-    if (auto existing = getMessage(data.messageId, conversation.getId())) {
-        return existing;
+    {
+        TraceSpan span{"message.dedup", "message", data.messageId};
+        if (auto existing = getMessage(data.messageId, conversation.getId())) {
+            return existing;
+        }
+    }
+
+    {
+        TraceSpan span{"message.store", "message", data.messageId};
+        message->addToDb();
     }
 
-    message->addToDb();
     registry_.add(message->getId(), message);
     touch(message);
 
@@ -0,0 +1,200 @@
+
+#include <algorithm>
+
+#include <QDateTime>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include "ds/metrics.h"
+#include "ds/errors.h"
+
+using namespace std;
+
+namespace ds {
+namespace core {
+
+namespace {
+
+template <typename T>
+T& getOrCreate(std::map<QString, std::unique_ptr<T>>& metrics, const QString& name)
+{
+    auto& ptr = metrics[name];
+    if (!ptr) {
+        ptr = make_unique<T>();
+    }
+    return *ptr;
+}
+
+template <typename T>
+void removeByPrefix(std::map<QString, std::unique_ptr<T>>& metrics, const QString& prefix)
+{
+    for(auto it = metrics.lower_bound(prefix); it != metrics.end();) {
+        if (!it->first.startsWith(prefix)) {
+            break;
+        }
+        it = metrics.erase(it);
+    }
+}
+
+} // anonymous namespace
+
+void Histogram::record(const quint64 usec) noexcept
+{
+    size_t bucket = 0;
+    for(auto v = usec; v && (bucket < (num_buckets - 1)); v >>= 1) {
+        ++bucket;
+    }
+
+    buckets_[bucket].fetch_add(1, memory_order_relaxed);
+    count_.fetch_add(1, memory_order_relaxed);
+    sum_.fetch_add(usec, memory_order_relaxed);
+
+    auto current = max_.load(memory_order_relaxed);
+    while((usec > current)
+          && !max_.compare_exchange_weak(current, usec, memory_order_relaxed))
+        ;
+}
+
+quint64 Histogram::getPercentile(const double percentile) const noexcept
+{
+    const auto count = getCount();
+    if (!count) {
+        return 0;
+    }
+
+    const auto wanted = max<quint64>(1, static_cast<quint64>(count * percentile / 100.0));
+    quint64 seen = 0;
+    for(size_t i = 0; i < num_buckets; ++i) {
+        seen += buckets_[i].load(memory_order_relaxed);
+        if (seen >= wanted) {
+            // Upper boundary of the bucket
+            return min<quint64>(i ? (quint64{1} << i) - 1 : 0, getMax());
+        }
+    }
+
+    return getMax();
+}
+
+Metrics &Metrics::instance()
+{
+    static Metrics metrics;
+    return metrics;
+}
+
+Counter &Metrics::counter(const QString &name)
+{
+    lock_guard<mutex> lock{mutex_};
+    return getOrCreate(counters_, name);
+}
+
+Gauge &Metrics::gauge(const QString &name)
+{
+    lock_guard<mutex> lock{mutex_};
+    return getOrCreate(gauges_, name);
+}
+
+Histogram &Metrics::histogram(const QString &name)
+{
+    lock_guard<mutex> lock{mutex_};
+    return getOrCreate(histograms_, name);
+}
+
+void Metrics::remove(const QString &prefix)
+{
+    lock_guard<mutex> lock{mutex_};
+    removeByPrefix(counters_, prefix);
+    removeByPrefix(gauges_, prefix);
+    removeByPrefix(histograms_, prefix);
+}
+
+std::vector<Metrics::Sample> Metrics::snapshot() const
+{
+    vector<Sample> samples;
+
+    {
+        lock_guard<mutex> lock{mutex_};
+        samples.reserve(counters_.size() + gauges_.size() + histograms_.size());
+
+        for(const auto& it : counters_) {
+            Sample s;
+            s.name = it.first;
+            s.type = Type::COUNTER;
+            s.value = static_cast<qint64>(it.second->get());
+            samples.push_back(move(s));
+        }
+
+        for(const auto& it : gauges_) {
+            Sample s;
+            s.name = it.first;
+            s.type = Type::GAUGE;
+            s.value = it.second->get();
+            samples.push_back(move(s));
+        }
+
+        for(const auto& it : histograms_) {
+            Sample s;
+            s.name = it.first;
+            s.type = Type::HISTOGRAM;
+            s.value = static_cast<qint64>(it.second->getCount());
+            s.sum = it.second->getSum();
+            s.max = it.second->getMax();
+            s.p50 = it.second->getPercentile(50);
+            s.p99 = it.second->getPercentile(99);
+            samples.push_back(move(s));
+        }
+    }
+
+    sort(samples.begin(), samples.end(), [](const Sample& left, const Sample& right) {
+        return left.name < right.name;
+    });
+
+    return samples;
+}
+
+void Metrics::dump(const QString &path) const
+{
+    QJsonArray metrics;
+    for(const auto& s : snapshot()) {
+        QJsonObject obj{
+            {"name", s.name},
+            {"type", getName(s.type)},
+            {"value", static_cast<double>(s.value)}
+        };
+
+        if (s.type == Type::HISTOGRAM) {
+            obj.insert("sumUsec", static_cast<double>(s.sum));
+            obj.insert("maxUsec", static_cast<double>(s.max));
+            obj.insert("p50Usec", static_cast<double>(s.p50));
+            obj.insert("p99Usec", static_cast<double>(s.p99));
+        }
+
+        metrics.append(obj);
+    }
+
+    QJsonObject json{
+        {"date", QDateTime::currentDateTimeUtc().toString(Qt::ISODate)},
+        {"metrics", metrics}
+    };
+
+    QFile file{path};
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        throw Error(QStringLiteral("Failed to open %1: %2").arg(path, file.errorString()));
+    }
+
+    file.write(QJsonDocument{json}.toJson());
+}
+
+const QString &Metrics::getName(const Metrics::Type type)
+{
+    static const array<QString, 3> names = {{
+        "counter",
+        "gauge",
+        "histogram"
+    }};
+
+    return names.at(static_cast<size_t>(type));
+}
+
+}} // namespaces
@@ -1,6 +1,8 @@
 #include <memory>
 
 #include "ds/torprotocolmanager.h"
+#include "ds/loopbackprotocolmanager.h"
+#include "logfault/logfault.h"
 
 using namespace std;
 
@@ -9,8 +11,22 @@ namespace ds {
 namespace core {
 
 
-ProtocolManager::ptr_t ProtocolManager::create(QSettings& settings, ProtocolManager::Transport)
+ProtocolManager::ptr_t ProtocolManager::create(QSettings& settings,
+                                               ProtocolManager::Transport transport)
 {
+    // Tor can be replaced with direct TCP connections for testing
+    if (settings.value("transport").toString() == "loopback") {
+        transport = Transport::LOOPBACK;
+    }
+
+    switch(transport) {
+    case Transport::LOOPBACK:
+        LFLOG_WARN << "Using the loopback transport. Connections are NOT anonymous!";
+        return make_shared<ds::prot::LoopbackProtocolManager>(settings);
+    case Transport::TOR:
+        break;
+    }
+
     return make_shared<ds::prot::TorProtocolManager>(settings);
 }
 
@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <cmath>
+
+#include "ds/ratelimiter.h"
+#include "ds/dsengine.h"
+
+#include "logfault/logfault.h"
+
+namespace ds {
+namespace core {
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+// The bucket must at least allow a few file-blocks in a burst
+constexpr quint64 min_burst = 1024 * 32;
+}
+
+void RateMeter::add(const quint64 bytes)
+{
+    update(clock_t::now());
+    windowBytes_ += bytes;
+    total_ += bytes;
+}
+
+quint64 RateMeter::getRate() const
+{
+    update(clock_t::now());
+    return rate_;
+}
+
+void RateMeter::update(const clock_t::time_point &now) const
+{
+    const auto elapsed = duration_cast<milliseconds>(now - windowStart_).count();
+    if (elapsed < 1000) {
+        return;
+    }
+
+    // If the window was idle for a long time, the rate will decline accordingly
+    rate_ = (windowBytes_ * 1000) / static_cast<quint64>(elapsed);
+    windowBytes_ = 0;
+    windowStart_ = now;
+}
+
+TokenBucket::TokenBucket(const quint64 rate, const quint64 burst)
+{
+    setRate(rate, burst);
+}
+
+void TokenBucket::setRate(const quint64 rate, const quint64 burst)
+{
+    rate_ = rate;
+    burst_ = max(burst ? burst : rate, min_burst);
+    tokens_ = static_cast<double>(burst_);
+    lastRefill_ = clock_t::now();
+}
+
+void TokenBucket::consume(const quint64 bytes)
+{
+    meter_.add(bytes);
+
+    if (isUnlimited()) {
+        return;
+    }
+
+    refill();
+    tokens_ -= static_cast<double>(bytes);
+}
+
+milliseconds TokenBucket::getDelay() const
+{
+    if (isUnlimited()) {
+        return {};
+    }
+
+    refill();
+
+    if (tokens_ >= 0) {
+        return {};
+    }
+
+    // Time until we are out of debt.
+    return milliseconds{static_cast<milliseconds::rep>(
+                    ceil((-tokens_ * 1000.0) / static_cast<double>(rate_)))};
+}
+
+TokenBucket::ptr_t TokenBucket::create(const QString &key, const QString &defaultKey)
+{
+    auto& settings = DsEngine::instance().settings();
+    const auto& useKey = (defaultKey.isEmpty() || settings.contains(key)) ? key : defaultKey;
+    const auto rate = settings.value(useKey, 0).toULongLong();
+    const auto burst = settings.value(useKey + "Burst", 0).toULongLong();
+
+    if (rate) {
+        LFLOG_DEBUG << "Bandwidth limit " << key << " is "
+                    << rate << " bytes/sec";
+    }
+
+    return make_shared<TokenBucket>(rate, burst);
+}
+
+void TokenBucket::refill() const
+{
+    const auto now = clock_t::now();
+    const auto elapsed = duration_cast<microseconds>(now - lastRefill_).count();
+    lastRefill_ = now;
+
+    tokens_ = min(static_cast<double>(burst_),
+                  tokens_ + (static_cast<double>(rate_) * static_cast<double>(elapsed)) / 1000000.0);
+}
+
+BandwidthShaper::BandwidthShaper(std::vector<TokenBucket::ptr_t> buckets)
+    : buckets_{move(buckets)}
+{
+}
+
+void BandwidthShaper::consume(const quint64 bytes)
+{
+    for(auto& bucket : buckets_) {
+        bucket->consume(bytes);
+    }
+}
+
+milliseconds BandwidthShaper::getDelay() const
+{
+    milliseconds delay = {};
+    for(const auto& bucket : buckets_) {
+        delay = max(delay, bucket->getDelay());
+    }
+    return delay;
+}
+
+}} // namespaces
@@ -0,0 +1,357 @@
+
+#include <algorithm>
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include "ds/reconnectscheduler.h"
+#include "ds/dsengine.h"
+#include "ds/metrics.h"
+
+#include "logfault/logfault.h"
+
+using namespace std;
+using namespace std::chrono;
+
+namespace ds {
+namespace core {
+
+namespace {
+
+struct ConnectMetrics {
+    Counter& attempts = Metrics::instance().counter("contact.connect.attempts");
+    Counter& failures = Metrics::instance().counter("contact.connect.failures");
+    Counter& timeouts = Metrics::instance().counter("contact.connect.timeouts");
+    Gauge& connecting = Metrics::instance().gauge("contact.connect.connecting");
+    Gauge& scheduled = Metrics::instance().gauge("contact.connect.scheduled");
+    Histogram& latency = Metrics::instance().histogram("contact.connect.time");
+};
+
+ConnectMetrics& metrics()
+{
+    static ConnectMetrics m;
+    return m;
+}
+
+} // anonymous namespace
+
+ReconnectScheduler::ReconnectScheduler(const Config &config,
+                                       connect_fn_t connectFn,
+                                       QObject *parent)
+    : QObject{parent}, config_{config}, connectFn_{move(connectFn)}
+{
+    timer_.setSingleShot(true);
+    connect(&timer_, &QTimer::timeout, this, &ReconnectScheduler::process);
+}
+
+ReconnectScheduler::~ReconnectScheduler()
+{
+    clear();
+}
+
+ReconnectScheduler::Config ReconnectScheduler::getConfig()
+{
+    auto& settings = DsEngine::instance().settings();
+    Config config;
+
+    config.maxConcurrent = static_cast<size_t>(max(1, settings.value(
+        "maxConcurrentConnects", static_cast<int>(config.maxConcurrent)).toInt()));
+    config.startupSpread = duration_t{settings.value(
+        "connectStartupSpread", static_cast<int>(config.startupSpread.count())).toInt()};
+    config.minDelay = duration_t{settings.value(
+        "reconnectMinDelay", static_cast<int>(config.minDelay.count())).toInt()};
+    config.maxDelay = duration_t{settings.value(
+        "reconnectMaxDelay", static_cast<int>(config.maxDelay.count())).toInt()};
+    config.connectTimeout = duration_t{settings.value(
+        "connectTimeout", static_cast<int>(config.connectTimeout.count())).toInt()};
+
+    return config;
+}
+
+void ReconnectScheduler::schedule(const QUuid &contact, const bool priority)
+{
+    if (entries_.find(contact) != entries_.end()) {
+        if (priority) {
+            prioritize(contact);
+        }
+        return;
+    }
+
+    const auto spread = priority
+            ? min(config_.minDelay, config_.startupSpread)
+            : config_.startupSpread;
+
+    Entry entry;
+    entry.due = clock_t::now() + getRandom(duration_t{0}, spread);
+    entry.priority = priority;
+    entries_.emplace(contact, entry);
+    metrics().scheduled.add(1);
+
+    startTimer();
+}
+
+void ReconnectScheduler::reconnect(const QUuid &contact)
+{
+    if (entries_.find(contact) != entries_.end()) {
+        return;
+    }
+
+    Entry entry;
+    entry.due = clock_t::now() + getBackoff(0);
+    entries_.emplace(contact, entry);
+    metrics().scheduled.add(1);
+
+    startTimer();
+}
+
+void ReconnectScheduler::prioritize(const QUuid &contact)
+{
+    auto it = entries_.find(contact);
+    if (it == entries_.end()) {
+        return;
+    }
+
+    auto& entry = it->second;
+    entry.priority = true;
+    if (!entry.connecting) {
+        entry.due = min(entry.due, clock_t::now() + getRandom(duration_t{0}, config_.minDelay));
+    }
+
+    startTimer();
+}
+
+void ReconnectScheduler::retryFailed()
+{
+    const auto now = clock_t::now();
+
+    for(auto& it : entries_) {
+        auto& entry = it.second;
+        if (!entry.connecting && entry.attempts) {
+            entry.attempts = 0;
+            entry.due = min(entry.due, now + getRandom(duration_t{0}, config_.minDelay));
+        }
+    }
+
+    startTimer();
+}
+
+void ReconnectScheduler::connected(const QUuid &contact)
+{
+    auto it = entries_.find(contact);
+    if (it == entries_.end()) {
+        return;
+    }
+
+    if (it->second.connecting) {
+        metrics().latency.record(static_cast<quint64>(
+            duration_cast<microseconds>(clock_t::now() - it->second.started).count()));
+    }
+
+    erase(it);
+    startTimer();
+}
+
+void ReconnectScheduler::failed(const QUuid &contact)
+{
+    auto it = entries_.find(contact);
+    if ((it == entries_.end()) || !it->second.connecting) {
+        return;
+    }
+
+    auto& entry = it->second;
+    metrics().failures.add();
+    setConnecting(entry, false);
+    const auto delay = getBackoff(++entry.attempts);
+    entry.due = clock_t::now() + delay;
+
+    LFLOG_DEBUG << "Connection attempt #" << entry.attempts
+                << " to contact " << contact.toString()
+                << " failed. Retrying in " << (delay.count() / 1000) << " seconds.";
+
+    startTimer();
+}
+
+void ReconnectScheduler::setRtt(const QUuid &contact, const duration_t rtt)
+{
+    if (rtt.count() >= 0) {
+        rtt_[contact] = rtt;
+    } else {
+        rtt_.erase(contact);
+    }
+}
+
+void ReconnectScheduler::remove(const QUuid &contact)
+{
+    auto it = entries_.find(contact);
+    if (it != entries_.end()) {
+        erase(it);
+        startTimer();
+    }
+}
+
+void ReconnectScheduler::clear()
+{
+    for(auto& it : entries_) {
+        setConnecting(it.second, false);
+    }
+
+    metrics().scheduled.add(-static_cast<qint64>(entries_.size()));
+    entries_.clear();
+    rtt_.clear();
+    timer_.stop();
+}
+
+bool ReconnectScheduler::isScheduled(const QUuid &contact) const
+{
+    return entries_.find(contact) != entries_.end();
+}
+
+bool ReconnectScheduler::isConnecting(const QUuid &contact) const
+{
+    auto it = entries_.find(contact);
+    return (it != entries_.end()) && it->second.connecting;
+}
+
+ReconnectScheduler::duration_t ReconnectScheduler::getBackoff(const unsigned attempts) const
+{
+    // Exponential backoff with "equal jitter"; somewhere between
+    // half and the full delay for this attempt.
+    const auto factor = qint64{1} << min(attempts, 20u);
+    const auto delay = min<qint64>(config_.minDelay.count() * factor, config_.maxDelay.count());
+    return getRandom(duration_t{delay / 2}, duration_t{delay});
+}
+
+void ReconnectScheduler::process()
+{
+    const auto now = clock_t::now();
+
+    // Release the slots held by attempts that take too long.
+    // Tor may keep trying to build a circuit for a very long time.
+    for(auto& it : entries_) {
+        auto& entry = it.second;
+        if (entry.connecting && (now >= (entry.started + config_.connectTimeout))) {
+            LFLOG_DEBUG << "Connection attempt to contact " << it.first.toString()
+                        << " timed out. Releasing the slot.";
+            metrics().timeouts.add();
+            setConnecting(entry, false);
+            entry.due = now + getBackoff(++entry.attempts);
+        }
+    }
+
+    // Contacts that are due, with priority first, then the fastest
+    // known round-trip time, then the longest waiting.
+    vector<tuple<bool, duration_t, clock_t::time_point, QUuid>> due;
+    for(const auto& it : entries_) {
+        if (!it.second.connecting && (it.second.due <= now)) {
+            const auto rtt = rtt_.find(it.first);
+            due.emplace_back(!it.second.priority,
+                             rtt == rtt_.end() ? duration_t::max() : rtt->second,
+                             it.second.due, it.first);
+        }
+    }
+
+    sort(due.begin(), due.end());
+
+    for(const auto& candidate : due) {
+        if (connecting_ >= config_.maxConcurrent) {
+            break;
+        }
+
+        const auto uuid = get<3>(candidate);
+
+        // The connect functor may have modified the entries
+        auto it = entries_.find(uuid);
+        if ((it == entries_.end()) || it->second.connecting) {
+            continue;
+        }
+
+        setConnecting(it->second, true);
+        it->second.started = now;
+        metrics().attempts.add();
+
+        bool started = false;
+        try {
+            started = connectFn_(uuid);
+        } catch(const std::exception& ex) {
+            LFLOG_WARN << "Failed to connect to contact " << uuid.toString()
+                       << ": " << ex.what();
+            failed(uuid);
+            continue;
+        }
+
+        if (!started) {
+            remove(uuid);
+        }
+    }
+
+    startTimer();
+}
+
+void ReconnectScheduler::setConnecting(ReconnectScheduler::Entry &entry, const bool connecting)
+{
+    if (entry.connecting != connecting) {
+        entry.connecting = connecting;
+        if (connecting) {
+            ++connecting_;
+            metrics().connecting.add(1);
+        } else {
+            --connecting_;
+            metrics().connecting.add(-1);
+        }
+    }
+}
+
+void ReconnectScheduler::erase(std::map<QUuid, Entry>::iterator it)
+{
+    setConnecting(it->second, false);
+    entries_.erase(it);
+    metrics().scheduled.add(-1);
+}
+
+void ReconnectScheduler::startTimer()
+{
+    const bool canStart = connecting_ < config_.maxConcurrent;
+    bool haveNext = false;
+    clock_t::time_point next;
+
+    for(const auto& it : entries_) {
+        const auto& entry = it.second;
+        clock_t::time_point when;
+        if (entry.connecting) {
+            when = entry.started + config_.connectTimeout;
+        } else if (canStart) {
+            when = entry.due;
+        } else {
+            continue;
+        }
+
+        if (!haveNext || (when < next)) {
+            next = when;
+            haveNext = true;
+        }
+    }
+
+    if (!haveNext) {
+        timer_.stop();
+        return;
+    }
+
+    const auto delay = max<qint64>(0, duration_cast<milliseconds>(next - clock_t::now()).count());
+    timer_.start(static_cast<int>(delay));
+}
+
+ReconnectScheduler::duration_t ReconnectScheduler::getRandom(const duration_t min,
+                                                             const duration_t max) const
+{
+    static random_device rd;
+    static mt19937 gen{rd()};
+
+    if (max <= min) {
+        return min;
+    }
+
+    uniform_int_distribution<qint64> dis(min.count(), max.count());
+    return duration_t{dis(gen)};
+}
+
+}} // namespaces
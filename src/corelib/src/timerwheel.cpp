@@ -0,0 +1,90 @@
+
+#include <algorithm>
+
+#include "ds/timerwheel.h"
+
+#include "logfault/logfault.h"
+
+using namespace std;
+
+namespace ds {
+namespace core {
+
+TimerWheel::TimerWheel(const duration_t tick, const size_t slots)
+    : tick_{max(tick, duration_t{1})}, slots_(max<size_t>(slots, 1))
+{
+    // Coarse timers may fire early, and we never want to expire a deadline early
+    timer_.setTimerType(Qt::PreciseTimer);
+    connect(&timer_, &QTimer::timeout, this, &TimerWheel::onTick);
+}
+
+TimerWheel::id_t TimerWheel::add(const duration_t timeout, callback_t callback)
+{
+    const auto numSlots = slots_.size();
+
+    // Round up, so we never fire before the deadline has expired
+    const auto ticks = max<size_t>(1, static_cast<size_t>(
+        (timeout.count() + tick_.count() - 1) / tick_.count()));
+
+    const auto id = ++nextId_;
+
+    // The next tick may be due at any moment, so count from the tick
+    // after that. The deadline may then fire up to one tick late, but never early.
+    Entry entry;
+    entry.callback = move(callback);
+    entry.rounds = ticks / numSlots;
+    entries_.emplace(id, move(entry));
+    slots_[(current_ + ticks + 1) % numSlots].push_back(id);
+
+    if (!timer_.isActive()) {
+        timer_.start(static_cast<int>(tick_.count()));
+    }
+
+    return id;
+}
+
+bool TimerWheel::cancel(const id_t id)
+{
+    // The id is left in its slot, and ignored when the slot is processed
+    return entries_.erase(id) > 0;
+}
+
+void TimerWheel::onTick()
+{
+    current_ = (current_ + 1) % slots_.size();
+
+    vector<id_t> ids;
+    swap(ids, slots_[current_]);
+
+    vector<callback_t> expired;
+    for(const auto id : ids) {
+        auto it = entries_.find(id);
+        if (it == entries_.end()) {
+            continue; // Cancelled
+        }
+
+        if (it->second.rounds) {
+            --it->second.rounds;
+            slots_[current_].push_back(id);
+            continue;
+        }
+
+        expired.push_back(move(it->second.callback));
+        entries_.erase(it);
+    }
+
+    // The callbacks may add or cancel deadlines
+    for(auto& callback : expired) {
+        try {
+            callback();
+        } catch(const std::exception& ex) {
+            LFLOG_ERROR << "Caught exception from deadline: " << ex.what();
+        }
+    }
+
+    if (entries_.empty()) {
+        timer_.stop();
+    }
+}
+
+}} // namespaces
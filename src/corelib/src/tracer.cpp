@@ -0,0 +1,158 @@
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QThread>
+
+#include "ds/tracer.h"
+#include "ds/errors.h"
+
+using namespace std;
+
+namespace ds {
+namespace core {
+
+Tracer::Tracer()
+{
+    clock_.start();
+}
+
+Tracer &Tracer::instance()
+{
+    static Tracer tracer;
+    return tracer;
+}
+
+void Tracer::enable(const bool enable, const size_t maxEvents)
+{
+    {
+        lock_guard<mutex> lock{mutex_};
+        maxEvents_ = maxEvents;
+        if (enable) {
+            events_.reserve(min<size_t>(maxEvents_, 4096));
+        }
+    }
+
+    enabled_ = enable;
+}
+
+void Tracer::complete(const QString &name, const QString &category,
+                      const QByteArray &id, const qint64 ts)
+{
+    add(name, category, id, 'X', ts, now() - ts);
+}
+
+void Tracer::begin(const QString &name, const QString &category, const QByteArray &id)
+{
+    if (isEnabled()) {
+        add(name, category, id, 'b', now());
+    }
+}
+
+void Tracer::end(const QString &name, const QString &category, const QByteArray &id)
+{
+    if (isEnabled()) {
+        add(name, category, id, 'e', now());
+    }
+}
+
+void Tracer::mark(const QString &name, const QString &category, const QByteArray &id)
+{
+    if (isEnabled()) {
+        add(name, category, id, 'i', now());
+    }
+}
+
+std::vector<Tracer::Event> Tracer::events() const
+{
+    lock_guard<mutex> lock{mutex_};
+    return events_;
+}
+
+size_t Tracer::getDropped() const noexcept
+{
+    lock_guard<mutex> lock{mutex_};
+    return dropped_;
+}
+
+void Tracer::clear()
+{
+    lock_guard<mutex> lock{mutex_};
+    events_.clear();
+    dropped_ = 0;
+}
+
+void Tracer::write(const QString &path) const
+{
+    const auto pid = QCoreApplication::applicationPid();
+
+    QJsonArray traceEvents;
+    for(const auto& e : events()) {
+        QJsonObject obj{
+            {"name", e.name},
+            {"cat", e.category},
+            {"ph", QString(QChar(e.phase))},
+            {"ts", static_cast<double>(e.ts)},
+            {"pid", static_cast<double>(pid)},
+            {"tid", static_cast<double>(e.tid)}
+        };
+
+        switch(e.phase) {
+        case 'X':
+            obj.insert("dur", static_cast<double>(e.dur));
+            if (!e.id.isEmpty()) {
+                obj.insert("args", QJsonObject{{"id", e.id}});
+            }
+            break;
+        case 'i':
+            obj.insert("s", "t");
+            if (!e.id.isEmpty()) {
+                obj.insert("args", QJsonObject{{"id", e.id}});
+            }
+            break;
+        default:
+            obj.insert("id", e.id);
+        }
+
+        traceEvents.append(obj);
+    }
+
+    QJsonObject json{
+        {"traceEvents", traceEvents},
+        {"displayTimeUnit", "ms"},
+        {"otherData", QJsonObject{{"droppedEvents", static_cast<double>(getDropped())}}}
+    };
+
+    QFile file{path};
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        throw Error(QStringLiteral("Failed to open %1: %2").arg(path, file.errorString()));
+    }
+
+    file.write(QJsonDocument{json}.toJson(QJsonDocument::Compact));
+}
+
+void Tracer::add(const QString &name, const QString &category,
+                 const QByteArray &id, const char phase,
+                 const qint64 ts, const qint64 dur)
+{
+    Event event;
+    event.name = name;
+    event.category = category;
+    event.id = QString::fromLatin1(id.toBase64());
+    event.phase = phase;
+    event.ts = ts;
+    event.dur = dur;
+    event.tid = static_cast<quint64>(reinterpret_cast<quintptr>(QThread::currentThreadId()));
+
+    lock_guard<mutex> lock{mutex_};
+    if (events_.size() >= maxEvents_) {
+        ++dropped_;
+        return;
+    }
+
+    events_.push_back(move(event));
+}
+
+}} // namespaces
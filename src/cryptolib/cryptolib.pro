@@ -35,7 +35,9 @@ SOURCES += \
     #src/rsacertimpl.cpp \
     src/certimpl.cpp \
     src/base58.cpp \
-    src/base32.cpp
+    src/base32.cpp \
+    src/batchverifier.cpp \
+    src/securearena.cpp
 
 HEADERS += \
     include/ds/crypto.h \
@@ -46,6 +48,8 @@ HEADERS += \
     include/ds/base58.h \
     include/ds/base32.h \
     include/ds/safememory.h \
-    include/ds/memoryview.h
+    include/ds/memoryview.h \
+    include/ds/batchverifier.h \
+    include/ds/securearena.h
 
 INCLUDEPATH += $$PWD/include
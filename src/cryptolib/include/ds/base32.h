@@ -1,14 +1,41 @@
 #ifndef BASE32_H
 #define BASE32_H
 
+#include <cstddef>
+#include <cstdint>
+
 #include <QByteArray>
 
 namespace ds {
 namespace crypto {
 
+/*! Base32 (RFC 4648, lower case, no padding) as used in onion addresses.
+ *
+ * The sizes must be multiples of 5 bytes / 8 characters. dst must
+ * have room for the output.
+ *
+ * \return false if src contains a character outside the alphabet
+ */
+bool base32decode(std::uint8_t *dst, const char *src, const size_t srclen) noexcept;
+void base32encode(char *dst, const std::uint8_t *src, const size_t srclen) noexcept;
+
+// Legacy (v2) onion addresses, 16 characters / 10 bytes
 QByteArray onion16decode(const QByteArray& src);
 QByteArray onion16encode(const QByteArray& src);
 
+// Tor v3 onion addresses, 56 characters / 35 bytes (pubkey, checksum, version)
+QByteArray onion56decode(const QByteArray& src);
+QByteArray onion56encode(const QByteArray& src);
+
+/*! The v3 onion address for a 32 byte ed25519 pubkey */
+QByteArray onionV3FromPubkey(const QByteArray& pubkey);
+
+/*! The pubkey in a v3 onion address
+ *
+ * Throws if the checksum or version is wrong.
+ */
+QByteArray onionV3ToPubkey(const QByteArray& address);
+
 }} // namespaces
 
 #endif // BASE32_H
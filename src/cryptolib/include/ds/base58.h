@@ -20,8 +20,11 @@
  */
 
 
-#include <string>
+#include <algorithm>
 #include <array>
+#include <cassert>
+#include <stdexcept>
+#include <string>
 #include <vector>
 #include <string.h>
 
@@ -34,44 +37,27 @@ namespace crypto {
 
 bool b58tobin_(void *bin, size_t *binszp, const std::string& b58);
 
+/*! Encode binsz bytes from data to b58
+ *
+ * \return The number of digits. If larger than b58sz,
+ *      the output was truncated.
+ */
+size_t b58enc_(char *b58, const size_t b58sz, const void *data, const size_t binsz);
+
+// Max number of base58 digits for binsz bytes
+constexpr size_t b58size(const size_t binsz) {
+    return binsz * 138 / 100 + 1;
+}
+
 template <typename T>
 bool b58enc_(T& b58, const void *data, size_t binsz)
 {
-    static constexpr char b58digits_ordered[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
-
-    const uint8_t *bin = reinterpret_cast<const unsigned char *>(data);;
-    int carry = 0;
-    size_t i = 0, j = 0, high = 0, zcount = 0;
-    size_t size = 0;
-
-    while (zcount < binsz && !bin[zcount])
-        ++zcount;
-
-    size = (binsz - zcount) * 138 / 100 + 1;
-    std::vector<uint8_t> buf(size);
-
-    for (i = zcount, high = size - 1; i < binsz; ++i, high = j)
-    {
-        for (carry = bin[i], j = size - 1; (j > high) || carry; --j)
-        {
-            carry += 256 * buf[j];
-            buf[j] = carry % 58;
-            carry /= 58;
-        }
-    }
-
-    for (j = 0; j < size && !buf[j]; ++j);
-
-    b58.resize(zcount + size - j);
-
-    if (zcount) {
-        for(size_t ix = 0; ix < zcount; ++ix) {
-            b58[static_cast<int>(ix)] = '1';
-        }
-    }
-    for (i = zcount; j < size; ++i, ++j)
-        b58[static_cast<int>(i)] = b58digits_ordered[buf[j]];
-    b58.resize(i);
+    // Encode directly into the output, and trim it to size
+    const auto size = b58size(binsz);
+    b58.resize(static_cast<decltype(b58.size())>(size));
+    const auto len = b58enc_(&*b58.begin(), size, data, binsz);
+    assert(len <= size);
+    b58.resize(static_cast<decltype(b58.size())>(len));
 
     return true;
 }
@@ -120,7 +106,8 @@ T b58tobin_check(const std::string& in, size_t bytes, std::initializer_list<uint
 
     auto full = b58tobin<T>(in, bytes + ver.size() + 4);
 
-    if (!b58check(full, in)) {
+    if ((static_cast<size_t>(full.size()) != bytes + ver.size() + 4)
+            || !b58check(full, in)) {
         return {};
     }
 
@@ -133,9 +120,8 @@ T b58tobin_check(const std::string& in, size_t bytes, std::initializer_list<uint
     }
 
     T bin;
-    for(; it != full.end() - 4; ++it) {
-        bin.push_back(*it);
-    }
+    bin.resize(static_cast<decltype(bin.size())>(bytes));
+    std::copy(it, full.cend() - 4, bin.begin());
 
     return bin;
 }
@@ -154,23 +140,27 @@ Tout b58enc(const T& in) {
 template <typename Tout=std::string, typename T>
 Tout b58check_enc(const T& data, std::initializer_list<uint8_t> ver)
 {
-    const auto bufsize = data.size() + ver.size() + 4;
-    std::vector<unsigned char> buf;
-    buf.reserve(bufsize);
-
-    for(auto const v : ver) {
-        buf.push_back(v);
+    const auto bufsize = ver.size() + static_cast<size_t>(data.size()) + 4;
+
+    // Keys and identities fit on the stack
+    std::array<unsigned char, 128> stack;
+    std::vector<unsigned char> heap;
+    unsigned char *buf = stack.data();
+    if (bufsize > stack.size()) {
+        heap.resize(bufsize);
+        buf = heap.data();
     }
 
-    for(const auto c : data) {
-        buf.push_back(c);
-    }
+    auto *p = std::copy(ver.begin(), ver.end(), buf);
+    p = std::copy(data.begin(), data.end(), p);
 
     std::array<unsigned char, crypto_hash_sha256_BYTES> hash;
-    crypto_hash_sha256(hash.data(), buf.data(), buf.size());
-    std::copy(hash.begin(), hash.begin() + 4, std::back_inserter(buf));
+    crypto_hash_sha256(hash.data(), buf, bufsize - 4);
+    std::copy(hash.begin(), hash.begin() + 4, p);
 
-    return b58enc<Tout>(buf);
+    Tout out;
+    b58enc_<Tout>(out, buf, bufsize);
+    return out;
 }
 
 
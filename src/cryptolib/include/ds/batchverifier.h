@@ -0,0 +1,52 @@
+#ifndef BATCHVERIFIER_H
+#define BATCHVERIFIER_H
+
+#include <vector>
+
+#include <QByteArray>
+
+#include "ds/dscert.h"
+
+namespace ds {
+namespace crypto {
+
+/*! Verifies many signatures at once.
+ *
+ * Used when a contact delivers a backlog of messages after a
+ * reconnect. The items are split in chunks that are verified in
+ * parallel on the global thread-pool, with one chunk verified on
+ * the calling thread. The call blocks until all the items are
+ * verified.
+ *
+ * The signatures are the same as created by DsCert::sign() over
+ * the parts that make up the data.
+ */
+class BatchVerifier
+{
+public:
+    struct Item {
+        const DsCert *cert = {};
+        QByteArray signature;
+        QByteArray data; // The signed data, as one buffer
+    };
+
+    // Batches smaller than this are verified on the calling thread
+    static constexpr size_t min_parallel = 16;
+
+    explicit BatchVerifier(const size_t maxThreads = 0);
+
+    /*! Verify the items.
+     *
+     * \return One result per item, in the same order.
+     */
+    std::vector<bool> verify(const std::vector<Item>& items) const;
+
+    static bool verify(const Item& item) noexcept;
+
+private:
+    size_t maxThreads_;
+};
+
+}} // namespaces
+
+#endif // BATCHVERIFIER_H
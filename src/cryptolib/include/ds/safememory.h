@@ -7,6 +7,8 @@
 #include <string.h>
 #include <sodium.h>
 
+#include "ds/securearena.h"
+
 namespace ds {
 namespace crypto {
 
@@ -18,6 +20,8 @@ namespace crypto {
  * data when the object is deleted.
  *
  * This class is designed for safety, not performance.
+ * The memory comes from the SecureArena, so that small
+ * buffers share locked pages.
  */
 template <typename T = char>
 class SafeMemory {
@@ -57,6 +61,7 @@ public:
 
     SafeMemory& operator = (SafeMemory&& v) {
         swap(v);
+        return *this;
     }
 
     bool operator == (const SafeMemory& v) const noexcept {
@@ -79,8 +84,8 @@ public:
     }
 
     void clear() noexcept {
-        if (!empty()) {
-            sodium_free(data_);
+        if (data_) {
+            SecureArena::instance().free(data_);
             data_ = nullptr;
             len_ = {};
         }
@@ -88,21 +93,15 @@ public:
 
     void resize(const size_t bytes) {
         if (bytes > len_) {
-            auto d = static_cast<T *>(sodium_malloc(sizeof(T) * bytes));
-            if (d == nullptr) {
-                throw std::bad_alloc();
-            }
+            auto d = static_cast<T *>(SecureArena::instance().allocate(sizeof(T) * bytes));
             if (len_) {
-                memcpy(d, data_, len_);
-                clear();
+                memcpy(d, data_, sizeof(T) * len_);
             }
+            // We may still hold memory after a resize(0)
+            clear();
             data_ = d;
-        } else {
-            const auto diff = bytes - len_;
-            const auto upper = len_ - diff;
-            if (diff) {
-                sodium_memzero(data_ + upper, diff);
-            }
+        } else if (bytes < len_) {
+            sodium_memzero(data_ + bytes, sizeof(T) * (len_ - bytes));
         }
         len_ = bytes;
     }
@@ -123,8 +122,8 @@ public:
         }
 
         auto start = len_;
-        resize(bytes);
-        memcpy(data_ + start, data, bytes);
+        resize(start + bytes);
+        memcpy(data_ + start, data, sizeof(T) * bytes);
     }
 
     template <typename Tc>
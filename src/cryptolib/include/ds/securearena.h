@@ -0,0 +1,99 @@
+#ifndef SECUREARENA_H
+#define SECUREARENA_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace ds {
+namespace crypto {
+
+/*! Locked memory for SafeMemory
+ *
+ * sodium_malloc() maps guard pages around each allocation and locks
+ * it in memory. That costs a handful of syscalls and at least one
+ * locked page for every key, and RLIMIT_MEMLOCK is small on most
+ * hosts, so with many certs the locking starts to fail.
+ *
+ * The arena gets a few large regions from sodium_malloc(), with guard
+ * pages and locking for the region as a whole, and splits them in
+ * fixed-size slots. Small allocations are served from the slots of the
+ * nearest size, and are zeroed when they are freed. Allocations larger
+ * than max_slot go directly to sodium_malloc().
+ *
+ * The tradeoff is that there are no guard pages between the slots
+ * in a region. Disable the arena to get the old behaviour back.
+ *
+ * Regions are kept for reuse when their slots are freed. trim()
+ * gives back the regions that are not in use.
+ *
+ * Thread-safe.
+ */
+class SecureArena
+{
+public:
+    static constexpr size_t min_slot = 16;
+    static constexpr size_t max_slot = 1024;
+    static constexpr size_t region_bytes = 64 * 1024;
+
+    struct Stats {
+        size_t regions = {};
+        size_t slotsInUse = {};
+        size_t largeInUse = {};
+        size_t lockedBytes = {};
+        size_t lockedPages = {};
+    };
+
+    static SecureArena& instance();
+
+    // Throws std::bad_alloc
+    void *allocate(const size_t bytes);
+
+    // Zeroes and frees memory returned by allocate()
+    void free(void *ptr) noexcept;
+
+    // Only affects new allocations
+    void setEnabled(const bool enabled);
+    bool isEnabled() const;
+
+    // Give back the regions that have no slots in use
+    void trim();
+
+    Stats getStats() const;
+
+    static size_t pageSize() noexcept;
+
+private:
+    static constexpr size_t num_classes = 7; // 16 .. 1024 bytes
+
+    struct Region {
+        std::uint8_t *base = {};
+        size_t slotSize = {};
+        size_t inUse = {};
+    };
+
+    using free_list_t = std::vector<std::uint8_t *>;
+
+    SecureArena() = default;
+    void addRegion(const size_t cls);
+    Region *findRegion(const void *ptr);
+    static size_t getClass(const size_t bytes) noexcept;
+
+    mutable std::mutex mutex_;
+    bool enabled_ = true;
+
+    // By base address
+    std::map<const std::uint8_t *, Region> regions_;
+    std::array<free_list_t, num_classes> free_;
+
+    // Allocations larger than max_slot, with their size
+    std::unordered_map<void *, size_t> large_;
+};
+
+}} // namespaces
+
+#endif // SECUREARENA_H
@@ -1,98 +1,171 @@
 
 #include <array>
-#include <vector>
 #include <cassert>
+#include <stdexcept>
+
 #include <QByteArray>
+#include <QCryptographicHash>
 
+#include "ds/base32.h"
 
 namespace ds {
 namespace crypto {
 
 using namespace std;
 
-QByteArray onion16decode(const QByteArray& src) {
-    //Refactored from eschalot.c
-    array<uint8_t, 16> tmp = {};
+namespace {
+
+constexpr char alphabet[] = "abcdefghijklmnopqrstuvwxyz234567";
+
+// Value of each character, or -1
+constexpr array<int8_t, 256> decode_map = {
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,26,27,28,29,30,31, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1, 0, 1, 2, 3, 4, 5, 6,  7, 8, 9,10,11,12,13,14,
+    15,16,17,18,19,20,21,22, 23,24,25,-1,-1,-1,-1,-1,
+    // The upper half is all -1
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+};
+
+constexpr size_t onion16_bytes = 10;
+constexpr size_t onion56_bytes = 35;
+constexpr int onion_pubkey_bytes = 32;
+constexpr uint8_t onion_version = 3;
+
+QByteArray decode(const QByteArray& src, const size_t bytes, const char *what)
+{
+    if (static_cast<size_t>(src.size()) != bytes / 5 * 8) {
+        throw runtime_error(string{what} + ": invalid source size");
+    }
 
-    if (src.size() != 16) {
-        throw runtime_error("onion16decode: source size must be 16");
+    array<uint8_t, onion56_bytes> buffer;
+    assert(bytes <= buffer.size());
+    if (!base32decode(buffer.data(), src.constData(), static_cast<size_t>(src.size()))) {
+        throw runtime_error(string{what} + ": invalid character");
     }
 
-    for (int i = 0; i < src.size(); i++) {
-        if (static_cast<uint8_t>(src.at(i)) >= 'a'
-                && static_cast<uint8_t>(src.at(i)) <= 'z') {
-            tmp.at(static_cast<size_t>(i)) = static_cast<unsigned char>((src.at(i)) - ('a'));
-        } else {
-            if (static_cast<uint8_t>(src.at(i)) >= '2'
-                    && static_cast<uint8_t>(src.at(i)) <= '7')
-                tmp.at(static_cast<size_t>(i)) = static_cast<unsigned char>(src.at(i)) - '1' + ('z' - 'a');
-            else {
-                /* Bad character detected.
-                 * This should not happen, but just in case
-                 * we will replace it with 'z' character. */
-                tmp.at(static_cast<size_t>(i)) = 26;
-            }
+    return {reinterpret_cast<const char *>(buffer.data()), static_cast<int>(bytes)};
+}
+
+QByteArray encode(const QByteArray& src, const size_t bytes, const char *what)
+{
+    if (static_cast<size_t>(src.size()) != bytes) {
+        throw runtime_error(string{what} + ": invalid source size");
+    }
+
+    QByteArray dst;
+    dst.resize(static_cast<int>(bytes / 5 * 8));
+    base32encode(dst.data(), reinterpret_cast<const uint8_t *>(src.constData()), bytes);
+    return dst;
+}
+
+QByteArray onionChecksum(const QByteArray& pubkey)
+{
+    // CHECKSUM = H(".onion checksum" | PUBKEY | VERSION)[:2], H is SHA3-256
+    QCryptographicHash hash{QCryptographicHash::Sha3_256};
+    hash.addData(".onion checksum");
+    hash.addData(pubkey);
+    hash.addData(QByteArray(1, static_cast<char>(onion_version)));
+    return hash.result().left(2);
+}
+
+} // anonymous namespace
+
+bool base32decode(uint8_t *dst, const char *src, const size_t srclen) noexcept
+{
+    assert((srclen % 8) == 0);
+
+    // 8 characters gives 40 bits, or 5 bytes
+    for(size_t i = 0; i + 8 <= srclen; i += 8) {
+        uint64_t block = 0;
+        int invalid = 0;
+        for(size_t j = 0; j < 8; ++j) {
+            const auto v = decode_map[static_cast<uint8_t>(src[i + j])];
+            invalid |= v;
+            block = (block << 5) | static_cast<uint8_t>(v & 31);
+        }
+
+        if (invalid < 0) {
+            return false;
+        }
+
+        for(int j = 4; j >= 0; --j) {
+            *dst++ = static_cast<uint8_t>(block >> (j * 8));
         }
     }
-    std::vector<uint8_t> dst;
-    //QByteArray dst;
-    dst.push_back(static_cast<uint8_t>(tmp.at( 0) << 3) | static_cast<uint8_t>(tmp.at(1) >> 2));
-    dst.push_back(static_cast<uint8_t>(tmp.at( 1) << 6) | static_cast<uint8_t>(tmp.at(2) << 1) | static_cast<uint8_t>(tmp.at(3) >> 4));
-    dst.push_back(static_cast<uint8_t>(tmp.at( 3) << 4) | static_cast<uint8_t>(tmp.at(4) >> 1));
-    dst.push_back(static_cast<uint8_t>(tmp.at( 4) << 7) | static_cast<uint8_t>(tmp.at(5) << 2) | (tmp.at(6) >> 3));
-    dst.push_back(static_cast<uint8_t>(tmp.at( 6) << 5) | static_cast<uint8_t>(tmp.at(7)));
-    dst.push_back(static_cast<uint8_t>(tmp.at( 8) << 3) | static_cast<uint8_t>(tmp.at(9) >> 2));
-    dst.push_back(static_cast<uint8_t>(tmp.at( 9) << 6) | static_cast<uint8_t>(tmp.at(10) << 1) | (tmp.at(11) >> 4));
-    dst.push_back(static_cast<uint8_t>(tmp.at(11) << 4) | static_cast<uint8_t>(tmp.at(12) >> 1));
-    dst.push_back(static_cast<uint8_t>(tmp.at(12) << 7) | static_cast<uint8_t>(tmp.at(13) << 2) | (tmp.at(14) >> 3));
-    dst.push_back(static_cast<uint8_t>(tmp.at(14) << 5) | static_cast<uint8_t>(tmp.at(15)));
-
-    return QByteArray{reinterpret_cast<const char *>(dst.data()), static_cast<int>(dst.size())};
+
+    return true;
 }
 
-/* Decode base32 16 character long 'src' into 10 byte long 'dst'. */
-/* TODO: Revisit and review, would like to shrink it down a bit.
- * However, it has to stay endian-safe and be fast. */
+void base32encode(char *dst, const uint8_t *src, const size_t srclen) noexcept
+{
+    assert((srclen % 5) == 0);
 
+    for(size_t i = 0; i + 5 <= srclen; i += 5) {
+        uint64_t block = 0;
+        for(size_t j = 0; j < 5; ++j) {
+            block = (block << 8) | src[i + j];
+        }
 
-QByteArray onion16encode(const QByteArray& src) {
-    //Refactored from eschalot.c
-    static const array<char, 32> alphabet = {
-        'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i',
-        'j', 'k', 'l', 'm', 'n', 'o', 'p', 'q', 'r',
-        's', 't', 'u', 'v', 'w', 'x', 'y', 'z', '2',
-        '3', '4', '5', '6', '7'
-    };
-
-    if (src.size() != 10) {
-        throw runtime_error("onion16encode: source size must be 10");
+        for(int j = 7; j >= 0; --j) {
+            *dst++ = alphabet[(block >> (j * 5)) & 31];
+        }
     }
+}
 
-    QByteArray dst;
-    dst.resize(16);
-
-    auto usrc = reinterpret_cast<const uint8_t *>(src.constData());
-
-    dst[ 0] = alphabet.at( (usrc[0] >> 3)			    );
-    dst[ 1] = alphabet.at(((usrc[0] << 2) | (usrc[1] >> 6))	& 31);
-    dst[ 2] = alphabet.at( (usrc[1] >> 1) 			& 31);
-    dst[ 3] = alphabet.at(((usrc[1] << 4) | (usrc[2] >> 4))	& 31);
-    dst[ 4] = alphabet.at(((usrc[2] << 1) | (usrc[3] >> 7))	& 31);
-    dst[ 5] = alphabet.at( (usrc[3] >> 2)			& 31);
-    dst[ 6] = alphabet.at(((usrc[3] << 3) | (usrc[4] >> 5))	& 31);
-    dst[ 7] = alphabet.at(  usrc[4]				& 31);
-
-    dst[ 8] = alphabet.at( (usrc[5] >> 3)			    );
-    dst[ 9] = alphabet.at(((usrc[5] << 2) | (usrc[6] >> 6))	& 31);
-    dst[10] = alphabet.at( (usrc[6] >> 1)			& 31);
-    dst[11] = alphabet.at(((usrc[6] << 4) | (usrc[7] >> 4))	& 31);
-    dst[12] = alphabet.at(((usrc[7] << 1) | (usrc[8] >> 7))	& 31);
-    dst[13] = alphabet.at( (usrc[8] >> 2)			& 31);
-    dst[14] = alphabet.at(((usrc[8] << 3) | (usrc[9] >> 5))	& 31);
-    dst[15] = alphabet.at(  usrc[9]				& 31);
+QByteArray onion16decode(const QByteArray& src) {
+    return decode(src, onion16_bytes, "onion16decode");
+}
 
-    return dst;
+QByteArray onion16encode(const QByteArray& src) {
+    return encode(src, onion16_bytes, "onion16encode");
+}
+
+QByteArray onion56decode(const QByteArray &src)
+{
+    return decode(src, onion56_bytes, "onion56decode");
+}
+
+QByteArray onion56encode(const QByteArray &src)
+{
+    return encode(src, onion56_bytes, "onion56encode");
 }
 
+QByteArray onionV3FromPubkey(const QByteArray &pubkey)
+{
+    if (pubkey.size() != onion_pubkey_bytes) {
+        throw runtime_error("onionV3FromPubkey: pubkey size must be 32");
+    }
+
+    return onion56encode(pubkey + onionChecksum(pubkey)
+                         + QByteArray(1, static_cast<char>(onion_version)));
+}
+
+QByteArray onionV3ToPubkey(const QByteArray &address)
+{
+    const auto bytes = onion56decode(address);
+    const auto pubkey = bytes.left(onion_pubkey_bytes);
+
+    if (static_cast<uint8_t>(bytes.at(bytes.size() - 1)) != onion_version) {
+        throw runtime_error("onionV3ToPubkey: unsupported version");
+    }
+
+    if (bytes.mid(onion_pubkey_bytes, 2) != onionChecksum(pubkey)) {
+        throw runtime_error("onionV3ToPubkey: invalid checksum");
+    }
+
+    return pubkey;
+}
 
 }} //namespaces
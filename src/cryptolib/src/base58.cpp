@@ -1,7 +1,8 @@
-#include <string>
+#include <algorithm>
 #include <array>
-#include <vector>
 #include <cstring>
+#include <string>
+#include <vector>
 
 #include <sodium.h>
 
@@ -23,7 +24,35 @@ constexpr std::array<int8_t, 256> b58digits_map = {
     47,48,49,50,51,52,53,54, 55,56,57,-1,-1,-1,-1,-1,
 };
 
-//static constexpr char b58digits_ordered[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+constexpr char b58digits_ordered[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+
+// Five base58 digits fit in 32 bits, so we work on groups of them
+constexpr uint32_t b58_group = 58u * 58u * 58u * 58u * 58u;
+constexpr std::array<uint32_t, 6> b58_pow = {1, 58, 58 * 58, 58 * 58 * 58,
+                                             58 * 58 * 58 * 58, b58_group};
+
+// Large enough for the keys and handles we use, without heap allocations
+constexpr size_t stack_words = 64;
+
+// Work-buffer on the stack, or on the heap for unusually large data
+class Words {
+public:
+    explicit Words(const size_t size) {
+        if (size > buffer_.size()) {
+            heap_.resize(size);
+            data_ = heap_.data();
+        } else {
+            std::fill(buffer_.begin(), buffer_.begin() + static_cast<long>(size), 0u);
+        }
+    }
+
+    uint32_t& operator[](const size_t ix) noexcept { return data_[ix]; }
+
+private:
+    std::array<uint32_t, stack_words> buffer_;
+    std::vector<uint32_t> heap_;
+    uint32_t *data_ = buffer_.data();
+};
 
 } // anonymous namespace
 
@@ -31,14 +60,11 @@ bool b58tobin_(void *bin, size_t *binszp, const std::string& b58) {
     size_t binsz = *binszp;
     const auto *b58u = reinterpret_cast<const unsigned char *>(b58.c_str());
     auto *binu = reinterpret_cast<unsigned char *>(bin);
-    size_t outisz = (binsz + 3) / 4;
-    //uint32_t outi[outisz];
-    std::vector<uint32_t> outi(outisz);
-    uint64_t t = 0;
-    uint32_t c = 0;
+    const size_t outisz = (binsz + 3) / 4;
+    Words outi{outisz};
     size_t i = 0, j = 0;
-    uint8_t bytesleft = binsz % 4;
-    uint32_t zeromask = bytesleft ? (0xffffffff << (bytesleft * 8)) : 0;
+    const uint8_t bytesleft = binsz % 4;
+    const uint32_t zeromask = bytesleft ? (0xffffffff << (bytesleft * 8)) : 0;
     unsigned zerocount = 0;
     const auto b58sz = b58.size();
 
@@ -46,25 +72,34 @@ bool b58tobin_(void *bin, size_t *binszp, const std::string& b58) {
     for (i = 0; i < b58sz && b58u[i] == '1'; ++i)
         ++zerocount;
 
-    for ( ; i < b58sz; ++i)
+    while (i < b58sz)
     {
-        if (b58u[i] & 0x80)
-            // High-bit set on invalid digit
-            return false;
-        if (b58digits_map.at(b58u[i]) == -1)
-            // Invalid base58 digit
-            return false;
-        c = static_cast<unsigned>(b58digits_map.at(b58u[i]));
+        // Collect up to five digits, and add them to the number in one pass
+        uint64_t c = 0;
+        size_t digits = 0;
+        for (; digits < 5 && i < b58sz; ++digits, ++i)
+        {
+            if (b58u[i] & 0x80)
+                // High-bit set on invalid digit
+                return false;
+            const auto value = b58digits_map[b58u[i]];
+            if (value == -1)
+                // Invalid base58 digit
+                return false;
+            c = c * 58 + static_cast<uint64_t>(value);
+        }
+
+        const uint64_t mul = b58_pow[digits];
         for (j = outisz; j--; )
         {
-            t = (static_cast<uint64_t>(outi[j])) * 58 + c;
-            c = (t & 0x3f00000000) >> 32;
-            outi[j] = t & 0xffffffff;
+            const uint64_t t = static_cast<uint64_t>(outi[j]) * mul + c;
+            c = t >> 32;
+            outi[j] = static_cast<uint32_t>(t);
         }
         if (c)
             // Output number too big (carry to the next int32)
             return false;
-        if (outi[0] & zeromask)
+        if (outisz && (outi[0] & zeromask))
             // Output number too big (last int32 filled too far)
             return false;
     }
@@ -106,4 +141,74 @@ bool b58tobin_(void *bin, size_t *binszp, const std::string& b58) {
     return true;
 }
 
+size_t b58enc_(char *b58, const size_t b58sz, const void *data, const size_t binsz)
+{
+    const auto *bin = reinterpret_cast<const uint8_t *>(data);
+    size_t zcount = 0;
+
+    while (zcount < binsz && !bin[zcount])
+        ++zcount;
+
+    // The number in groups of five base58 digits, least significant first
+    const size_t bytes = binsz - zcount;
+    Words limbs{(bytes * 138 / 100 + 1) / 5 + 1};
+    size_t used = 0;
+
+    // Add the input 32 bits at the time, with the odd bytes first
+    for (size_t i = zcount; i < binsz;)
+    {
+        const size_t chunk = (i == zcount && (bytes % 4)) ? (bytes % 4) : 4;
+        uint64_t carry = 0;
+        for (size_t k = 0; k < chunk; ++k, ++i)
+            carry = (carry << 8) | bin[i];
+
+        const uint64_t mul = uint64_t{1} << (chunk * 8);
+        for (size_t j = 0; j < used; ++j)
+        {
+            const uint64_t t = static_cast<uint64_t>(limbs[j]) * mul + carry;
+            limbs[j] = static_cast<uint32_t>(t % b58_group);
+            carry = t / b58_group;
+        }
+        while (carry)
+        {
+            limbs[used++] = static_cast<uint32_t>(carry % b58_group);
+            carry /= b58_group;
+        }
+    }
+
+    // Expand the groups to digits, most significant first
+    std::array<char, 5> group;
+    size_t len = 0;
+    const auto put = [&](const char ch) {
+        if (len < b58sz) {
+            b58[len] = ch;
+        }
+        ++len;
+    };
+
+    for (size_t i = 0; i < zcount; ++i)
+        put('1');
+
+    for (size_t j = used; j--; )
+    {
+        auto limb = limbs[j];
+        for (size_t k = group.size(); k--; )
+        {
+            group[k] = b58digits_ordered[limb % 58];
+            limb /= 58;
+        }
+
+        // No leading zeros in the most significant group
+        size_t first = 0;
+        if (j == used - 1) {
+            while (group[first] == '1')
+                ++first;
+        }
+        for (; first < group.size(); ++first)
+            put(group[first]);
+    }
+
+    return len;
+}
+
 }} // namespaces
@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+
+#include "ds/batchverifier.h"
+
+namespace ds {
+namespace crypto {
+
+using namespace std;
+
+namespace {
+
+using items_t = std::vector<BatchVerifier::Item>;
+
+// vector<bool> is packed, so each chunk writes to its own bytes
+using results_t = std::vector<char>;
+
+struct Chunk {
+    size_t begin = {};
+    size_t end = {};
+};
+
+void verifyChunk(const items_t& items, results_t& results, const Chunk& chunk)
+{
+    for(auto i = chunk.begin; i < chunk.end; ++i) {
+        results[i] = BatchVerifier::verify(items[i]);
+    }
+}
+
+// Counts down the chunks running in the pool
+struct Latch {
+    void add() {
+        lock_guard<mutex> lock{mutex_};
+        ++pending_;
+    }
+
+    void done() {
+        lock_guard<mutex> lock{mutex_};
+        if (--pending_ == 0) {
+            cv_.notify_one();
+        }
+    }
+
+    void wait() {
+        unique_lock<mutex> lock{mutex_};
+        cv_.wait(lock, [this] { return pending_ == 0; });
+    }
+
+private:
+    size_t pending_ = {};
+    mutex mutex_;
+    condition_variable cv_;
+};
+
+class VerifyTask : public QRunnable {
+public:
+    VerifyTask(const items_t& items, results_t& results,
+               const Chunk chunk, Latch& latch)
+        : items_{items}, results_{results}, chunk_{chunk}, latch_{latch}
+    {
+        setAutoDelete(true);
+    }
+
+    void run() override {
+        verifyChunk(items_, results_, chunk_);
+        latch_.done();
+    }
+
+private:
+    const items_t& items_;
+    results_t& results_;
+    const Chunk chunk_;
+    Latch& latch_;
+};
+
+} // anonymous namespace
+
+BatchVerifier::BatchVerifier(const size_t maxThreads)
+    : maxThreads_{maxThreads
+                  ? maxThreads
+                  : static_cast<size_t>(max(1, QThread::idealThreadCount()))}
+{
+}
+
+vector<bool> BatchVerifier::verify(const vector<Item>& items) const
+{
+    results_t results(items.size());
+
+    const auto chunks = (items.size() < min_parallel)
+            ? size_t{1}
+            : min(maxThreads_, items.size() / (min_parallel / 2));
+    const auto chunkSize = (items.size() + chunks - 1) / max<size_t>(1, chunks);
+
+    Latch latch;
+    Chunk mine{0, min(chunkSize, items.size())};
+
+    for(auto begin = mine.end; begin < items.size(); begin += chunkSize) {
+        const Chunk chunk{begin, min(begin + chunkSize, items.size())};
+
+        latch.add();
+        auto task = new VerifyTask(items, results, chunk, latch);
+
+        // If the pool is busy, don't wait for it
+        if (!QThreadPool::globalInstance()->tryStart(task)) {
+            delete task;
+            verifyChunk(items, results, chunk);
+            latch.done();
+        }
+    }
+
+    verifyChunk(items, results, mine);
+    latch.wait();
+
+    return {results.begin(), results.end()};
+}
+
+bool BatchVerifier::verify(const BatchVerifier::Item &item) noexcept
+{
+    if (!item.cert || (item.signature.size() != crypto_sign_BYTES)) {
+        return false;
+    }
+
+    try {
+        return item.cert->verify(item.signature, {item.data});
+    } catch(const std::exception&) {
+        return false;
+    }
+}
+
+}} // namespaces
@@ -0,0 +1,205 @@
+
+#include <algorithm>
+#include <cassert>
+#include <new>
+
+#include <sodium.h>
+
+#ifndef _WIN32
+#   include <unistd.h>
+#endif
+
+#include "ds/securearena.h"
+
+namespace ds {
+namespace crypto {
+
+using namespace std;
+
+namespace {
+
+// The canary sodium_malloc() puts in front of the data
+constexpr size_t canary_bytes = 16;
+
+size_t roundUp(const size_t bytes, const size_t to) noexcept
+{
+    return ((bytes + to - 1) / to) * to;
+}
+
+} // anonymous namespace
+
+SecureArena &SecureArena::instance()
+{
+    // Never destroyed. Static objects that own SafeMemory may be
+    // destroyed after us, and they still need to free their memory.
+    static auto *arena = new SecureArena;
+    return *arena;
+}
+
+void *SecureArena::allocate(const size_t bytes)
+{
+    lock_guard<mutex> lock{mutex_};
+
+    if (!enabled_ || (bytes > max_slot)) {
+        auto ptr = sodium_malloc(bytes);
+        if (ptr == nullptr) {
+            throw bad_alloc();
+        }
+        large_.emplace(ptr, bytes);
+        return ptr;
+    }
+
+    const auto cls = getClass(bytes);
+    auto& list = free_[cls];
+    if (list.empty()) {
+        addRegion(cls);
+    }
+
+    auto ptr = list.back();
+    list.pop_back();
+
+    auto region = findRegion(ptr);
+    assert(region);
+    ++region->inUse;
+
+    return ptr;
+}
+
+void SecureArena::free(void *ptr) noexcept
+{
+    if (ptr == nullptr) {
+        return;
+    }
+
+    lock_guard<mutex> lock{mutex_};
+
+    auto it = large_.find(ptr);
+    if (it != large_.end()) {
+        large_.erase(it);
+        sodium_free(ptr); // Zeroes the memory
+        return;
+    }
+
+    auto region = findRegion(ptr);
+    assert(region);
+    if (!region) {
+        return;
+    }
+
+    sodium_memzero(ptr, region->slotSize);
+    --region->inUse;
+    free_[getClass(region->slotSize)].push_back(static_cast<uint8_t *>(ptr));
+}
+
+void SecureArena::setEnabled(const bool enabled)
+{
+    lock_guard<mutex> lock{mutex_};
+    enabled_ = enabled;
+}
+
+bool SecureArena::isEnabled() const
+{
+    lock_guard<mutex> lock{mutex_};
+    return enabled_;
+}
+
+void SecureArena::trim()
+{
+    lock_guard<mutex> lock{mutex_};
+
+    for(auto it = regions_.begin(); it != regions_.end();) {
+        auto& region = it->second;
+        if (region.inUse) {
+            ++it;
+            continue;
+        }
+
+        auto& list = free_[getClass(region.slotSize)];
+        const auto end = region.base + region_bytes;
+        list.erase(remove_if(list.begin(), list.end(), [&](const uint8_t *slot) {
+            return (slot >= region.base) && (slot < end);
+        }), list.end());
+
+        sodium_free(region.base);
+        it = regions_.erase(it);
+    }
+}
+
+SecureArena::Stats SecureArena::getStats() const
+{
+    lock_guard<mutex> lock{mutex_};
+
+    Stats stats;
+    stats.regions = regions_.size();
+    stats.largeInUse = large_.size();
+
+    for(const auto& it : regions_) {
+        stats.slotsInUse += it.second.inUse;
+    }
+
+    // sodium_malloc() locks whole pages
+    const auto page = pageSize();
+    stats.lockedBytes = regions_.size() * roundUp(region_bytes + canary_bytes, page);
+    for(const auto& it : large_) {
+        stats.lockedBytes += roundUp(it.second + canary_bytes, page);
+    }
+    stats.lockedPages = stats.lockedBytes / page;
+
+    return stats;
+}
+
+size_t SecureArena::pageSize() noexcept
+{
+#ifdef _WIN32
+    return 4096;
+#else
+    static const auto size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return size;
+#endif
+}
+
+void SecureArena::addRegion(const size_t cls)
+{
+    const auto slotSize = min_slot << cls;
+    auto base = static_cast<uint8_t *>(sodium_malloc(region_bytes));
+    if (base == nullptr) {
+        throw bad_alloc();
+    }
+
+    sodium_memzero(base, region_bytes);
+    regions_.emplace(base, Region{base, slotSize, 0});
+
+    // Hand out the slots from the start of the region
+    auto& list = free_[cls];
+    for(auto offset = region_bytes; offset >= slotSize; offset -= slotSize) {
+        list.push_back(base + offset - slotSize);
+    }
+}
+
+SecureArena::Region *SecureArena::findRegion(const void *ptr)
+{
+    const auto p = static_cast<const uint8_t *>(ptr);
+    auto it = regions_.upper_bound(p);
+    if (it == regions_.begin()) {
+        return {};
+    }
+
+    --it;
+    if (p >= it->first + region_bytes) {
+        return {};
+    }
+
+    return &it->second;
+}
+
+size_t SecureArena::getClass(const size_t bytes) noexcept
+{
+    assert(bytes <= max_slot);
+    size_t cls = 0;
+    for(auto size = min_slot; size < bytes; size <<= 1) {
+        ++cls;
+    }
+    return cls;
+}
+
+}} // namespaces
@@ -1,7 +1,7 @@
 #ifndef LOGMODEL_H
 #define LOGMODEL_H
 
-#include <deque>
+#include <vector>
 
 #include <QSettings>
 #include <QAbstractListModel>
@@ -28,11 +28,8 @@ class LogModel : public QAbstractListModel
     Q_OBJECT
 
     struct Item {
-        Item(QString t, logfault::LogLevel ll)
-            : text{std::move(t)}, level{ll} {}
-
         QString text;
-        logfault::LogLevel level;
+        logfault::LogLevel level = logfault::LogLevel::DISABLED;
     };
 public:
     LogModel(QSettings& settings);
@@ -45,8 +42,15 @@ public slots:
     void log(QString text, logfault::LogLevel level);
 
 private:
+    const Item& at(const size_t row) const;
+
     QSettings& settings_;
-    std::deque<std::unique_ptr<Item>> log_items_;
+
+    // Ring-buffer with the latest log messages. When it is full,
+    // the oldest item is overwritten.
+    std::vector<Item> log_items_;
+    size_t first_ = 0;
+    size_t count_ = 0;
 };
 
 
@@ -15,6 +15,7 @@
 #include "ds/conversationsmodel.h"
 #include "ds/messagesmodel.h"
 #include "ds/filesmodel.h"
+#include "ds/metricsmodel.h"
 
 #ifndef PROGRAM_VERSION
     #define PROGRAM_VERSION "develop"
@@ -56,6 +57,7 @@ public:
     Q_INVOKABLE ConversationsModel *conversationsModel();
     Q_INVOKABLE MessagesModel *messagesModel();
     Q_INVOKABLE FilesModel *filesModel();
+    Q_INVOKABLE MetricsModel *metricsModel();
     Q_INVOKABLE void textToClipboard(const QString& text);
     Q_INVOKABLE QVariantMap getIdenityFromClipboard() const;
     Q_INVOKABLE static QString urlToPath(const QString& url);
@@ -103,6 +105,7 @@ private:
     std::unique_ptr<ConversationsModel> conversationsModel_;
     std::unique_ptr<MessagesModel> messagesModel_;
     std::unique_ptr<FilesModel> filesModel_;
+    std::unique_ptr<MetricsModel> metricsModel_;
     int page_ = 3; // Home
     std::unique_ptr<QImage> tmpImage_;
 };
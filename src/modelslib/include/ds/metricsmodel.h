@@ -0,0 +1,70 @@
+#ifndef METRICSMODEL_H
+#define METRICSMODEL_H
+
+#include <vector>
+
+#include <QSettings>
+#include <QAbstractListModel>
+#include <QTimer>
+
+#include "ds/metrics.h"
+
+namespace ds {
+namespace models {
+
+/*! Exposes the run-time metrics to QML
+ *
+ * The model polls the metrics registry, so it does not
+ * add any overhead to the code that updates the metrics.
+ */
+class MetricsModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+    enum Roles {
+        H_NAME = Qt::UserRole,
+        H_TYPE,
+        H_VALUE,
+        H_DETAILS
+    };
+
+public:
+    MetricsModel(QSettings& settings);
+
+    /*! Write the current metrics to a file in json format.
+     *
+     * \param path File to write to. If empty, the "metricsDumpPath"
+     *      setting is used.
+     * \return The path that was written, or an empty string on error.
+     */
+    Q_INVOKABLE QString dump(const QString& path = {});
+
+    /*! Write the recorded trace-spans to a file in Chrome trace-event format.
+     *
+     * Tracing is enabled with the "traceEnabled" setting.
+     *
+     * \param path File to write to. If empty, the "tracePath"
+     *      setting is used.
+     * \return The path that was written, or an empty string on error.
+     */
+    Q_INVOKABLE QString dumpTrace(const QString& path = {});
+
+    // QAbstractItemModel interface
+    QVariant data(const QModelIndex &index, int role) const override;
+    int rowCount(const QModelIndex &parent) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+public slots:
+    void refresh();
+
+private:
+    static QString getDetails(const core::Metrics::Sample& sample);
+
+    QSettings& settings_;
+    QTimer timer_;
+    std::vector<core::Metrics::Sample> samples_;
+};
+
+}} // namespaces
+
+#endif // METRICSMODEL_H
@@ -28,7 +28,8 @@ SOURCES += \
     src/notificationsmodel.cpp \
     src/messagesmodel.cpp \
     src/filesmodel.cpp \
-    src/imageprovider.cpp
+    src/imageprovider.cpp \
+    src/metricsmodel.cpp
 
 HEADERS += \
     include/ds/contactsmodel.h \
@@ -40,7 +41,8 @@ HEADERS += \
     include/ds/notificationsmodel.h \
     include/ds/messagesmodel.h \
     include/ds/filesmodel.h \
-    include/ds/imageprovider.h
+    include/ds/imageprovider.h \
+    include/ds/metricsmodel.h
 
 INCLUDEPATH += \
     $$PWD/include \
@@ -7,6 +7,7 @@
 #include "ds/base58.h"
 #include "ds/strategy.h"
 #include "ds/manager.h"
+#include "ds/database.h"
 
 #include <QBuffer>
 #include <QDateTime>
@@ -142,7 +143,7 @@ void ContactsModel::queryRows(rows_t &rows)
     query.prepare("SELECT uuid FROM contact WHERE identity=:identity ORDER BY LOWER(NAME)");
     query.bindValue(":identity", identity_->getId());
 
-    if(!query.exec()) {
+    if(!Database::exec(query)) {
         throw Error(QStringLiteral("Failed to query contacts: %1").arg(
                         query.lastError().text()));
     }
@@ -3,6 +3,7 @@
 #include "ds/errors.h"
 #include "ds/model_util.h"
 #include "ds/strategy.h"
+#include "ds/database.h"
 
 #include <QBuffer>
 #include <QDateTime>
@@ -227,7 +228,7 @@ void ConversationsModel::queryRows(ConversationsModel::rows_t &rows)
     query.prepare("SELECT uuid FROM conversation WHERE identity=:identity ORDER BY updated DESC");
     query.bindValue(":identity", identity_->getId());
 
-    if(!query.exec()) {
+    if(!Database::exec(query)) {
         throw Error(QStringLiteral("Failed to add Conversation: %1").arg(
                         query.lastError().text()));
     }
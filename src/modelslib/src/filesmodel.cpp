@@ -9,6 +9,7 @@
 #include "ds/errors.h"
 #include "ds/manager.h"
 #include "ds/filesmodel.h"
+#include "ds/database.h"
 
 #include "logfault/logfault.h"
 
@@ -171,7 +172,7 @@ void FilesModel::queryRows(FilesModel::rows_t &rows)
                     : currentContact_ ? currentContact_->getId()
                     : currentIdentity_->getId());
 
-    if(!query.exec()) {
+    if(!Database::exec(query)) {
         throw Error(QStringLiteral("Failed to query files: %1").arg(
                         query.lastError().text()));
     }
@@ -1,9 +1,11 @@
 
+#include <algorithm>
 #include <memory>
 #include <QDateTime>
 
 #include "ds/logutil.h"
 #include "ds/logmodel.h"
+#include "ds/asynclog.h"
 
 using namespace  std;
 
@@ -12,23 +14,38 @@ namespace models {
 
 LogModel::LogModel(QSettings &settings)
     : settings_{settings}
+    , log_items_(static_cast<size_t>(std::max(1, settings.value("logModelSize", 100).toInt())))
 {
+    static const int registered = [] {
+        return qRegisterMetaType<logfault::LogLevel>("logfault::LogLevel");
+    }();
+    Q_UNUSED(registered);
+
     if (core::isEnabled(core::LogSystem::APPLICATION)) {
         auto handler = make_unique<LogModelHandler>(core::getLogLevel(core::LogSystem::APPLICATION));
-        connect(handler.get(), &LogModelHandler::message, this, &LogModel::log);
-        logfault::LogManager::Instance().AddHandler(move(handler));
+
+        // The handler may be called from the log writer thread, so the
+        // messages are queued to the model's thread.
+        connect(handler.get(), &LogModelHandler::message, this, &LogModel::log,
+                Qt::QueuedConnection);
+
+        if (settings_.value("logAsync", true).toBool()) {
+            logfault::LogManager::Instance().AddHandler(
+                        make_unique<core::AsyncLogHandler>(move(handler)));
+        } else {
+            logfault::LogManager::Instance().AddHandler(move(handler));
+        }
     }
 }
 
 QVariant LogModel::data(const QModelIndex &index, int role) const
 {
-    if (index.row() >= static_cast<int>(log_items_.size())) {
+    if (!index.isValid() || (index.row() >= static_cast<int>(count_))) {
         return {};
     }
 
     if (role == Qt::DisplayRole) {
-        const auto& li = log_items_[static_cast<size_t>(index.row())];
-        return li->text;
+        return at(static_cast<size_t>(index.row())).text;
     }
 
     return {};
@@ -36,25 +53,34 @@ QVariant LogModel::data(const QModelIndex &index, int role) const
 
 int LogModel::rowCount(const QModelIndex &/*parent*/) const
 {
-    return static_cast<int>(log_items_.size());
+    return static_cast<int>(count_);
 }
 
 void LogModel::log(QString text, logfault::LogLevel level)
 {
-    auto item = make_unique<Item>(text, level);
+    const auto capacity = log_items_.size();
 
-    if (log_items_.size() > 100) {
+    if (count_ == capacity) {
         beginRemoveRows({}, 0, 0);
-        log_items_.erase(log_items_.begin());
+        first_ = (first_ + 1) % capacity;
+        --count_;
         endRemoveRows();
     }
 
-    const auto row = static_cast<int>(log_items_.size());
+    const auto row = static_cast<int>(count_);
     beginInsertRows({}, row, row);
-    log_items_.push_back(move(item));
+    auto& item = log_items_[(first_ + count_) % capacity];
+    item.text = move(text);
+    item.level = level;
+    ++count_;
     endInsertRows();
 }
 
+const LogModel::Item &LogModel::at(const size_t row) const
+{
+    return log_items_[(first_ + row) % log_items_.size()];
+}
+
 void LogModelHandler::LogMessage(const logfault::Message &msg)
 {
     std::ostringstream out;
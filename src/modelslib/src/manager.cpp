@@ -52,6 +52,11 @@ FilesModel *Manager::filesModel()
     return filesModel_.get();
 }
 
+MetricsModel *Manager::metricsModel()
+{
+    return metricsModel_.get();
+}
+
 void Manager::textToClipboard(const QString& text)
 {
     auto cb = QGuiApplication::clipboard();
@@ -60,37 +65,50 @@ void Manager::textToClipboard(const QString& text)
 
 QVariantMap Manager::getIdenityFromClipboard() const
 {
-    // name : base58 for version, pubkey and legacy tor service and port
-    static const regex legacy_onion_pattern(R"(^(.+)\:([123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz]{69})$)");
+    // name : base58 for version, pubkey and tor service and port
+    static const regex onion_pattern(R"(^(.+)\:([123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz]{69,100})$)");
     std::smatch match;
 
     QVariantMap values;
 
     const auto text =  QGuiApplication::clipboard()->text().toStdString();
-    if (!text.empty() && regex_match(text, match, legacy_onion_pattern)) {
+    if (!text.empty() && regex_match(text, match, onion_pattern)) {
         if (match.size() == 3) {
             const auto nick = match[1].str();
             const auto blob = match[2].str();
-            values["nickName"] = nick.c_str();
 
-            // See IdentitiesModel::getIdentityAsBase58 for data-format
+            // See DsEngine::getIdentityAsBase58 for data-format
+
+            // 10 bytes legacy onion address, or 32 bytes v3 onion pubkey
+            auto const legacy_len = 1 + 32 + 10 + 2;
+            auto const v3_len = 1 + 32 + 32 + 2;
+            auto data = b58tobin_check<QByteArray>(blob, legacy_len,  {11, 176});
+            if (data.isEmpty()) {
+                data = b58tobin_check<QByteArray>(blob, v3_len,  {11, 176});
+            }
 
-            // 16 bytes onion address
-            auto const assumed_len = 1 + 32 + 10 + 2;
-            auto data = b58tobin_check<QByteArray>(blob, assumed_len,  {11, 176});
-            assert(data.size() == assumed_len);
-            if (data.at(0) != 1) { // Version
+            if (data.isEmpty()) {
+                LFLOG_NOTICE << "Invalid identity payload";
+                return {};
+            }
+
+            QByteArray address;
+            const auto version = static_cast<int>(data.at(0));
+            if (version == 1 && data.size() == legacy_len) {
+                address = onion16encode(data.mid(33, 10));
+            } else if (version == 2 && data.size() == v3_len) {
+                address = onionV3FromPubkey(data.mid(33, 32));
+            } else {
                 LFLOG_NOTICE << "Unsupported version of identity payload: v="
-                             << static_cast<int>(data.at(0));
+                             << version;
                 return {};
             }
 
             const auto pubkey = data.mid(1, 32);
-            const auto host = data.mid(33, 10);
-            const auto port = data.mid(43,2);
-            const auto address = onion16encode(host);
+            const auto port = data.right(2);
             const auto portVal = bytesToValue<uint16_t>(port);
 
+            values["nickName"] = nick.c_str();
             values["address"] = QString("onion:") + address
                     + ":" + QString::number(qFromBigEndian(portVal));
 
@@ -183,6 +201,7 @@ Manager::Manager()
     conversationsModel_ = make_unique<ConversationsModel>(*this);
     messagesModel_ = make_unique<MessagesModel>(*this);
     filesModel_ = make_unique<FilesModel>(*this);
+    metricsModel_ = make_unique<MetricsModel>(engine_->settings());
 
     instance_ = this;
 }
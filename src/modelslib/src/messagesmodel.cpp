@@ -2,6 +2,7 @@
 #include "ds/messagesmodel.h"
 #include "ds/dsengine.h"
 #include "ds/dscert.h"
+#include "ds/database.h"
 
 #include <QSqlQuery>
 #include <QSqlError>
@@ -219,7 +220,7 @@ void MessagesModel::queryRows(MessagesModel::rows_t &rows)
         "ORDER BY created ");
     query.bindValue(":cid", conversation_->getId());
 
-    if(!query.exec()) {
+    if(!Database::exec(query)) {
         throw Error(QStringLiteral("Failed to add Conversation: %1").arg(
                         query.lastError().text()));
     }
@@ -258,7 +259,7 @@ std::shared_ptr<MessageContent> MessagesModel::loadData(const int id) const
     query.prepare("SELECT state, direction, composed_time, received_time, content FROM message where id=:id ");
     query.bindValue(":id", id);
 
-    if(!query.exec()) {
+    if(!Database::exec(query)) {
         throw Error(QStringLiteral("Failed to fetch Message: %1").arg(
                         query.lastError().text()));
     }
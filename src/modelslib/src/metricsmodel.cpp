@@ -0,0 +1,137 @@
+
+#include <QDir>
+#include <QStandardPaths>
+
+#include "ds/metricsmodel.h"
+#include "ds/tracer.h"
+#include "logfault/logfault.h"
+
+using namespace std;
+using namespace ds::core;
+
+namespace ds {
+namespace models {
+
+MetricsModel::MetricsModel(QSettings &settings)
+    : settings_{settings}
+{
+    connect(&timer_, &QTimer::timeout, this, &MetricsModel::refresh);
+    timer_.start(settings_.value("metricsRefreshInterval", 1000).toInt());
+    refresh();
+}
+
+QString MetricsModel::dump(const QString &path)
+{
+    auto target = path;
+    if (target.isEmpty()) {
+        target = settings_.value("metricsDumpPath",
+                                 QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)
+                                 + QDir::separator() + "metrics.json").toString();
+    }
+
+    try {
+        Metrics::instance().dump(target);
+    } catch(const std::exception& ex) {
+        LFLOG_ERROR << "Failed to dump metrics: " << ex.what();
+        return {};
+    }
+
+    LFLOG_NOTICE << "Dumped metrics to " << target;
+    return target;
+}
+
+QString MetricsModel::dumpTrace(const QString &path)
+{
+    auto target = path;
+    if (target.isEmpty()) {
+        target = settings_.value("tracePath",
+                                 QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)
+                                 + QDir::separator() + "trace.json").toString();
+    }
+
+    try {
+        Tracer::instance().write(target);
+    } catch(const std::exception& ex) {
+        LFLOG_ERROR << "Failed to dump trace: " << ex.what();
+        return {};
+    }
+
+    LFLOG_NOTICE << "Dumped trace to " << target;
+    return target;
+}
+
+QVariant MetricsModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || (index.row() >= static_cast<int>(samples_.size()))) {
+        return {};
+    }
+
+    const auto& sample = samples_.at(static_cast<size_t>(index.row()));
+
+    switch(role) {
+    case Qt::DisplayRole:
+    case H_NAME:
+        return sample.name;
+    case H_TYPE:
+        return Metrics::getName(sample.type);
+    case H_VALUE:
+        return sample.value;
+    case H_DETAILS:
+        return getDetails(sample);
+    }
+
+    return {};
+}
+
+int MetricsModel::rowCount(const QModelIndex &/*parent*/) const
+{
+    return static_cast<int>(samples_.size());
+}
+
+QHash<int, QByteArray> MetricsModel::roleNames() const
+{
+    static const QHash<int, QByteArray> names = {
+        {H_NAME, "name"},
+        {H_TYPE, "type"},
+        {H_VALUE, "value"},
+        {H_DETAILS, "details"}
+    };
+
+    return names;
+}
+
+void MetricsModel::refresh()
+{
+    auto samples = Metrics::instance().snapshot();
+
+    const bool sameRows = (samples.size() == samples_.size())
+            && equal(samples.begin(), samples.end(), samples_.begin(),
+                     [](const Metrics::Sample& left, const Metrics::Sample& right) {
+        return left.name == right.name;
+    });
+
+    if (!sameRows) {
+        beginResetModel();
+        samples_ = move(samples);
+        endResetModel();
+        return;
+    }
+
+    samples_ = move(samples);
+    if (!samples_.empty()) {
+        emit dataChanged(index(0), index(static_cast<int>(samples_.size()) - 1),
+                         {H_VALUE, H_DETAILS});
+    }
+}
+
+QString MetricsModel::getDetails(const Metrics::Sample &sample)
+{
+    if (sample.type != Metrics::Type::HISTOGRAM) {
+        return QString::number(sample.value);
+    }
+
+    return QStringLiteral("n=%1 p50=%2us p99=%3us max=%4us")
+            .arg(sample.value).arg(sample.p50).arg(sample.p99).arg(sample.max);
+}
+
+}} // namespaces
@@ -1,5 +1,6 @@
 #include "include/ds/notificationsmodel.h"
 #include "ds/crypto.h"
+#include "ds/database.h"
 
 
 #include <QDateTime>
@@ -33,7 +34,7 @@ void NotificationsModel::deleteRow(const int row)
         QSqlQuery query;
         query.prepare("DELETE FROM notification WHERE id=:id");
         query.bindValue(":id", id);
-        query.exec();
+        Database::exec(query);
         refresh();
     }
 }
@@ -43,7 +44,7 @@ bool NotificationsModel::isHashPresent(const QByteArray &hash) const
     QSqlQuery query;
     query.prepare("SELECT count(0) FROM notification WHERE hash=:hash");
     query.bindValue(":hash", hash);
-    query.exec();
+    Database::exec(query);
     return query.next() && (query.value(0).toInt() > 0);
 }
 
@@ -142,7 +143,7 @@ void NotificationsModel::addNotification(Identity *identity, const core::PeerAdd
     query.bindValue(":data", core::DsEngine::toJson(data));
     query.bindValue(":hash", hash);
 
-    query.exec();
+    Database::exec(query);
     refresh();
 }
 
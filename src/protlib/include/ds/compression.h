@@ -0,0 +1,39 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <QByteArray>
+#include <QString>
+
+namespace ds {
+namespace prot {
+
+/*! Compression of payloads before they are encrypted.
+ *
+ * We use zlib (via qCompress), as it is available wherever Qt is.
+ * The compressed data starts with the 4 bytes uncompressed length
+ * (big endian), followed by the zlib stream.
+ */
+class Compression {
+public:
+    // Name used when we negotiate compression with a peer
+    static const QString name;
+
+    // Payloads smaller than this are not worth compressing
+    static constexpr size_t minBytes = 128;
+
+    static QByteArray compress(const void *data, const size_t bytes, const int level = -1);
+
+    /*! Throws std::runtime_error if the data is invalid, or expands to more than maxBytes.
+     *
+     * We never inflate more than the length in the header, so a
+     * false header can't make us allocate more than maxBytes.
+     */
+    static QByteArray decompress(const void *data, const size_t bytes, const size_t maxBytes);
+
+    // False for file-types that are known to be compressed already
+    static bool isCompressible(const QString& fileName);
+};
+
+}} // namespaces
+
+#endif // COMPRESSION_H
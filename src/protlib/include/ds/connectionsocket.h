@@ -2,6 +2,7 @@
 #define CONNECTIONSOCKET_H
 
 #include <memory>
+#include <deque>
 
 #include <QTcpSocket>
 #include <QUuid>
@@ -29,13 +30,42 @@ public:
     template <typename T>
     void write(const T& data) {
         const char *p = reinterpret_cast<const char *>(data.data());
-        const qint64 bytes = data.size();
-        outData.append(p, bytes);
+        const auto bytes = static_cast<int>(data.size());
+        if (bytes == 0) {
+            return;
+        }
+        outQueue_.emplace_back(p, bytes);
+        addOutBytes(bytes);
+        if (isAboveHighWatermark()) {
+            reachedHighWatermark_ = true;
+        }
+        checkOutputLimit();
         sendMore();
     }
 
+    /*! Set the limits for the output queue.
+     *
+     * Producers should stop writing when the queue is above the
+     * high watermark, and resume when belowLowWatermark() is emitted.
+     */
+    void setWatermarks(const size_t low, const size_t high);
+
+    // Bytes queued for output, not yet handed over to the socket
+    size_t getOutputBufferSize() const noexcept { return outBytes_; }
+    bool isAboveHighWatermark() const noexcept { return outBytes_ >= highWatermark_; }
+    bool isBelowLowWatermark() const noexcept { return outBytes_ <= lowWatermark_; }
+
     void wantBytes(size_t bytesRequested);
 
+    /*! Stop reading from the socket
+     *
+     * Data stays in the kernel, and QTcpSocket's bounded read
+     * buffer, so the TCP flow-control slows down the sender.
+     */
+    void pauseReading();
+    void resumeReading();
+    bool isReadingPaused() const noexcept { return readingPaused_; }
+
     void connectToDefaultHost();
     const QByteArray& getDefaultHost() const noexcept { return host_; }
     quint16 getDefaultPort() const noexcept { return port_; }
@@ -47,6 +77,10 @@ signals:
     void haveBytes(const data_t& data);
     void outputBufferEmptied();
 
+    // The output queue went above the high watermark, and has now drained
+    // to the low watermark.
+    void belowLowWatermark();
+
 private slots:
     void onConnected();
     void onDisconnected();
@@ -54,13 +88,36 @@ private slots:
 
 private:
     void processInput();
+    void readInput();
     void sendMore();
+    void checkOutputLimit();
+    void addOutBytes(const qint64 bytes);
+    void updateInBytes();
 
     QUuid uuid;
-    QByteArray outData;
+
+    // Queued output buffers. We never compact the data, just
+    // keep track of how much of the first buffer that is sent.
+    std::deque<QByteArray> outQueue_;
+    int outOffset_ = 0;
+    size_t outBytes_ = 0;
+    size_t lowWatermark_ = 1024 * 64;
+    size_t highWatermark_ = 1024 * 256;
+    bool reachedHighWatermark_ = false;
+
+    // Hard limit. If a producer ignores the watermarks, we close the connection
+    size_t maxOutDataSize = 1024 * 1024 * 4;
+
+    // How much we allow in QTcpSocket's own buffer at any time
+    qint64 maxSocketBufferSize = 1024 * 64;
     QByteArray inData;
+    int reportedInBytes_ = 0; // inData size, as reported to the metrics
     size_t bytesWanted_ = {};
     size_t maxInDataSize = 1024 * 265;
+    bool readingPaused_ = false;
+
+    // How much QTcpSocket may read from the kernel while we are not reading
+    constexpr static qint64 maxReadBufferSize = 1024 * 64;
     const QByteArray host_;
     const quint16 port_;
 };
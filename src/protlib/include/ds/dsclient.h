@@ -2,6 +2,7 @@
 #define DSCLIENT_H
 
 #include "ds/peer.h"
+#include "ds/sessiontickets.h"
 
 namespace ds {
 namespace prot {
@@ -17,7 +18,9 @@ public:
 
     enum class State {
         CONNECTED,
+        SAYING_HELLO,
         GET_OLLEH,
+        VERIFYING_OLLEH,
         ENCRYPTED_STREAM
     };
 
@@ -29,15 +32,26 @@ private slots:
 
 
 private:
+    struct OllehResult;
+
     void sayHello();
+    void onHelloReady(const ConnectionSocket *connection, const QByteArray& ciphertext);
     void getHelloReply(const data_t& data);
+    void onOllehVerified(const OllehResult& result);
+    void onError(const ConnectionSocket *connection, const std::exception_ptr& failure);
+    void retryWithHello();
+    void reconnect();
     void startConnectRetryTimer();
     void initConnections();
+    bool onConnectionLost() override;
 
     State state_ = State::CONNECTED;
     size_t maxReconnects_ = 20;
     size_t numReconnects_ = {};
     size_t reconnectDelayMilliseconds_ = 20000;
+    bool offeredAesGcm_ = false;
+    SessionTickets::secret_t resumeSecret_; // Set while we resume with a ticket
+    bool ticketRejected_ = false; // Use a full Hello from now on
 
     // PeerConnection interface
 public:
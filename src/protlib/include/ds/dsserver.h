@@ -1,7 +1,10 @@
 #ifndef DSSERVER_H
 #define DSSERVER_H
 
+#include <functional>
+
 #include "ds/peer.h"
+#include "ds/sessiontickets.h"
 
 
 namespace ds {
@@ -13,14 +16,27 @@ class DsServer : public Peer
 public:
     enum class State {
         CONNECTED,
+        VERIFYING_HELLO,
         WAITING_FOR_AUTHORIZATION,
+        SENDING_OLLEH,
         ENCRYPTED_STREAM,
         FAILED,
-        UNAUTHORIZED
+        UNAUTHORIZED,
+        COLLISION
     };
 
+    // Return true if the incoming connection should be dropped
+    using collision_fn_t = std::function<bool (const DsServer& server)>;
+
     DsServer(ConnectionSocket::ptr_t connection, core::ConnectData connectionData);
 
+    /*! Check for a collision with our own connections to the same peer.
+     *
+     * Called when the peer has proven its identity in the Hello
+     * message, before the secure stream is set up.
+     */
+    void setCollisionHandler(collision_fn_t fn) { collisionHandler_ = std::move(fn); }
+
 public slots:
     virtual void authorize(bool authorize) override;
 
@@ -28,9 +44,17 @@ private slots:
     void advance(const data_t& data);
 
 private:
+    struct HelloResult;
+
     void getHello(const data_t& data);
+    void onHelloVerified(const HelloResult& result);
+    void onOllehReady(const QByteArray& ciphertext);
+    void onError(const std::exception& ex);
 
     State state_ = State::CONNECTED;
+    collision_fn_t collisionHandler_;
+    bool useAesGcm_ = false; // Selected from the client's Hello
+    SessionTickets::secret_t resumeSecret_; // From the client's ticket, if it resumed
 
     // PeerConnection interface
 public:
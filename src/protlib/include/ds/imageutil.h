@@ -3,13 +3,36 @@
 
 #include <QImage>
 #include <QJsonObject>
+#include <QSize>
 
 namespace ds {
 namespace prot {
 
+// Legacy avatar format, with the raw r, g, b channels in base64
 QJsonObject toJson(const QImage& image);
 QImage toQimage(const QJsonObject& object);
 
+struct EncodedImage {
+    QByteArray data; // PNG
+    QByteArray hash; // sha256 of data
+};
+
+/*! Encode an image as PNG
+ *
+ * The most recent images are cached (by QImage::cacheKey()), so
+ * sending the same avatar to many contacts only encodes it once.
+ */
+EncodedImage toPng(const QImage& image);
+
+/*! Decode a PNG image
+ *
+ * The image header is checked before the image is decoded, and
+ * images larger than maxSize are rejected.
+ *
+ * Throws ds::core::Error on failure.
+ */
+QImage fromPng(const QByteArray& data, const QSize& maxSize);
+
 }} // namespaces
 
 #endif // IMAGEUTIL_H
@@ -0,0 +1,41 @@
+#ifndef LOOPBACKPROTOCOLMANAGER_H
+#define LOOPBACKPROTOCOLMANAGER_H
+
+#include "ds/serviceprotocolmanager.h"
+
+namespace ds {
+namespace prot {
+
+/*! Protocol manager using direct TCP connections.
+ *
+ * Uses the same DS protocol as the Tor transport, but without
+ * Tor. Services listen on a normal TCP port, and we connect
+ * directly to the peer without any proxy.
+ *
+ * This is intended for testing and benchmarking. It provides
+ * no anonymity at all.
+ *
+ * Addresses are in the format "direct:host:port".
+ */
+class LoopbackProtocolManager : public ServiceProtocolManager
+{
+public:
+    LoopbackProtocolManager(QSettings& settings);
+
+public slots:
+    void start() override;
+    void stop() override;
+    void createTransportHandle(const core::TransportHandleReq &) override;
+    void startService(const QUuid& service,
+                      const crypto::DsCert::ptr_t& cert,
+                      const QVariantMap& data) override;
+    void stopService(const QUuid& service) override;
+    core::PeerConnection::ptr_t connectTo(core::ConnectData cd) override;
+
+protected:
+    QByteArray getHost() const;
+};
+
+}} // namespaces
+
+#endif // LOOPBACKPROTOCOLMANAGER_H
@@ -0,0 +1,132 @@
+#ifndef MULTIPLEXER_H
+#define MULTIPLEXER_H
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QPointer>
+
+#include "ds/peer.h"
+
+namespace ds {
+namespace prot {
+
+class TorServiceInterface;
+
+/*! A logical connection between one of our identities and a contact,
+ * carried by an established connection to the same host.
+ *
+ * The session has its own control channel and binary channels,
+ * mapped to the channels of the transport with the session id in
+ * the high byte. Everything above the framing (messages, acks,
+ * avatars, file-transfers) works as on a normal connection.
+ *
+ * The session ends when the transport is closed.
+ */
+class MuxSession : public Peer
+{
+    Q_OBJECT
+public:
+    using ptr_t = std::shared_ptr<MuxSession>;
+    static constexpr size_t nonce_bytes = 32;
+
+    // For outgoing sessions, an empty nonce is replaced by a random nonce
+    MuxSession(Peer::ptr_t transport, core::ConnectData connectionData,
+               const Direction direction, const quint32 sessionId,
+               QByteArray nonce = {});
+    ~MuxSession() override;
+
+    // Ask the peer to open the session. Outgoing sessions only.
+    void open();
+
+    // The peer accepted the session
+    void onAccepted(const QByteArray& signature);
+
+    // The peer closed or rejected the session
+    void onRemoteClose();
+
+    quint32 getSessionId() const noexcept { return sessionId_; }
+    const Peer::ptr_t& getTransport() const noexcept { return transport_; }
+
+public slots:
+    void authorize(bool authorize) override;
+
+public:
+    using Peer::send;
+    uint64_t send(const void *data, const size_t bytes, const quint32 channel,
+                  const bool final = false, const bool compress = false) override;
+    bool isSession() const noexcept override { return true; }
+    int getRtt() const noexcept override;
+    void close() override;
+    Direction getDirection() const noexcept override {
+        return direction_;
+    }
+
+private:
+    void sendClose();
+    void established();
+
+    Peer::ptr_t transport_;
+    const Direction direction_;
+    const quint32 sessionId_;
+    QByteArray nonce_;
+    bool closed_ = false;
+};
+
+/*! Carries sessions for several identities over shared connections
+ *
+ * Optional. Each identity normally has its own hidden service and
+ * connections, so that the identities can't be linked to each other
+ * on the network or by the contacts. Services that enable multiplexing
+ * announce their identities to all the peers they connect to, and
+ * let other identities on the same host use their connections.
+ * This saves circuits and handshakes, at the cost of revealing to
+ * the peers that the identities belong to the same user.
+ *
+ * Both the identity that owns the connection and the identity that
+ * opens a session over it must have multiplexing enabled.
+ */
+class Multiplexer
+{
+public:
+    static Multiplexer& instance();
+
+    // Accept sessions to and from the identity of the service
+    void addService(TorServiceInterface& service, const crypto::DsCert& cert);
+    void removeService(TorServiceInterface& service, const crypto::DsCert& cert);
+
+    /*! Pubkeys to announce to a peer, base64 encoded
+     *
+     * Empty if the identity owning the connection doesn't use multiplexing.
+     */
+    QJsonArray getIdentities(const crypto::DsCert& identity) const;
+
+    // A connection where the peer announced identities it accepts sessions for
+    void addTransport(const Peer::ptr_t& transport);
+
+    /*! Open a session to a contact over an existing connection
+     *
+     * \return The session, or nullptr if there is no usable connection.
+     */
+    MuxSession::ptr_t openSession(const core::ConnectData& cd);
+
+    // Handle MuxOpen, MuxAccept and MuxClose messages on a transport
+    void onControl(Peer& transport, const QJsonObject& json);
+
+private:
+    Multiplexer() = default;
+
+    void onOpen(Peer& transport, const quint32 sessionId, const QJsonObject& json);
+    TorServiceInterface *getService(const QByteArray& pubkey) const;
+    static MuxSession::ptr_t getSession(Peer& transport, const quint32 sessionId);
+
+    std::map<QByteArray /* signing pubkey */, QPointer<TorServiceInterface>> services_;
+    std::vector<std::weak_ptr<Peer>> transports_;
+};
+
+}} // namespaces
+
+#endif // MULTIPLEXER_H
@@ -3,11 +3,18 @@
 
 #include <array>
 #include <cassert>
+#include <chrono>
+#include <set>
+
+#include <QJsonObject>
 
 #include "ds/protocolmanager.h"
 #include "ds/connectionsocket.h"
 #include "ds/peerconnection.h"
 #include "ds/file.h"
+#include "ds/metrics.h"
+#include "ds/timerwheel.h"
+#include "ds/streamcipher.h"
 
 namespace ds {
 namespace prot {
@@ -20,8 +27,24 @@ public:
     using ptr_t = std::shared_ptr<Peer>;
     using mview_t = crypto::MemoryView<uint8_t>;
     using data_t = crypto::MemoryView<uint8_t>;
-    using stream_state_t = crypto_secretstream_xchacha20poly1305_state;
-    static constexpr size_t crypt_bytes = crypto_secretstream_xchacha20poly1305_ABYTES;
+    using stream_state_t = StreamCipher;
+    static constexpr size_t crypt_bytes = StreamCipher::abytes;
+
+    // The low nibble of the version byte in Hello and Olleh is the version of
+    // the structure. In the Hello, the aes_gcm flag tells that the client can
+    // use AES-256-GCM. In the Olleh, it tells that the server selected it.
+    static constexpr uint8_t handshake_version = 1;
+    static constexpr uint8_t handshake_version_mask = 0x0f;
+    static constexpr uint8_t handshake_aes_gcm = 0x10;
+
+    // Reserved binary channel for avatar images
+    static constexpr quint32 avatar_channel = 0xffffffff;
+
+    // Multiplexed sessions use the high byte of the channel as session id.
+    // Session 0 is the connection itself, and 0xff is reserved for avatar_channel.
+    static constexpr int session_shift = 24;
+    static constexpr quint32 session_channel_mask = 0x00ffffff;
+    static constexpr quint32 max_session_id = 0xfe;
     enum class InState {
         DISABLED,
         CHUNK_SIZE,
@@ -76,6 +99,24 @@ public:
         mview_t signature;
     };
 
+    // Phases of a connection, with their own deadlines
+    enum class Phase {
+        CONNECTING, // Covered by the client's connect retries
+        HANDSHAKE, // Until Hello / Olleh is exchanged
+        AUTHORIZATION, // Until the owner of the service accepts the peer
+        ESTABLISHED, // Closed if idle for too long
+        CLOSED
+    };
+
+    struct Timeouts {
+        std::chrono::milliseconds handshake = std::chrono::seconds(30);
+        std::chrono::milliseconds authorization = std::chrono::seconds(60);
+        std::chrono::milliseconds idle = {}; // 0 disables the idle timeout
+        std::chrono::milliseconds keepalive = std::chrono::seconds(60); // 0 disables keepalives
+        std::chrono::milliseconds maxKeepalive = std::chrono::minutes(10); // Interval for idle peers
+        std::chrono::milliseconds pong = std::chrono::seconds(60); // Wait for the Pong
+    };
+
     class Channel {
     public:
         using ptr_t = std::shared_ptr<Channel>;
@@ -88,9 +129,11 @@ public:
         virtual uint64_t onOutgoing(Peer& peer) = 0;
     };
 
+    // If connectionId is null, the id of the connection socket is used
     Peer(ConnectionSocket::ptr_t connection,
-         core::ConnectData connectionData);
-    ~Peer() override = default;
+         core::ConnectData connectionData,
+         const QUuid& connectionId = {});
+    ~Peer() override;
 
     ConnectionSocket& getConnection() {
         if (!connection_) {
@@ -118,7 +161,100 @@ public slots:
     uint64_t send(const QJsonDocument& json);
 
     // Final is true for the last block of a file-transfer to indicate EOF.
-    uint64_t send(const void *data, const size_t bytes, const quint32 channel, const bool final = false);
+    // If compress is true, the payload is compressed if that makes it smaller.
+    virtual uint64_t send(const void *data, const size_t bytes, const quint32 channel,
+                          const bool final = false, const bool compress = false);
+
+    // True if both we and the peer have agreed to use compression
+    bool useCompression() const noexcept;
+
+    // Our compression setting. Must be set before the encrypted stream is enabled.
+    void enableCompression(const bool enable) noexcept {
+        compressionEnabled_ = enable;
+    }
+
+    // Offer / accept AES-256-GCM if the CPU supports it. Must be set before the handshake.
+    void enableAesGcm(const bool enable) noexcept {
+        aesGcmEnabled_ = enable;
+    }
+
+    // Ask for / issue session tickets, so that reconnects skip the public key operations
+    void enableResumption(const bool enable) noexcept {
+        resumptionEnabled_ = enable;
+    }
+
+    // True if the handshake was resumed with a session ticket
+    bool isResumed() const noexcept { return resumed_; }
+
+    // The cipher suite for the encrypted stream
+    StreamCipher::Suite getCipherSuite() const noexcept {
+        return stateOut.getSuite();
+    }
+
+    // Receive data on a binary channel that is not a file-transfer
+    void addInChannel(const quint32 id, Channel::ptr_t channel);
+
+    // Timeouts from the "handshakeTimeout", "authorizationTimeout", "idleTimeout",
+    // "keepaliveInterval", "keepaliveMaxInterval" and "keepaliveTimeout"
+    // settings (milliseconds).
+    static Timeouts getTimeouts(const QSettings& settings);
+
+    /*! Enforce timeouts for the connection.
+     *
+     * Peers that don't progress through the handshake in time, or are
+     * idle for too long, are closed. The deadline for the current phase
+     * is armed immediately.
+     *
+     * Established connections to peers that support it are probed with
+     * encrypted Ping / Pong messages on the control channel. The interval
+     * doubles while the connection is idle, up to Timeouts::maxKeepalive.
+     * Peers that don't answer in time are closed.
+     */
+    void setDeadlines(core::TimerWheel::ptr_t wheel, const Timeouts& timeouts);
+
+    Phase getPhase() const noexcept { return phase_; }
+
+    // When the current phase was entered
+    std::chrono::steady_clock::time_point getPhaseEntered() const noexcept {
+        return phaseEntered_;
+    }
+
+    // Last measured round-trip time in milliseconds, or -1 if unknown
+    int getRtt() const noexcept override { return rtt_; }
+
+    // True for a logical session carried by another connection
+    virtual bool isSession() const noexcept { return false; }
+
+    /*! A value that is unique for this connection, and only known by the two peers.
+     *
+     * Derived from the stream keys and headers of both directions. Signatures
+     * over it can't be replayed on another connection.
+     *
+     * \return The value, or an empty array until the handshake has set up
+     *      both streams.
+     */
+    QByteArray getChannelBinding() const;
+
+    // Signing pubkeys of the identities the peer accepts sessions for
+    const std::set<QByteArray>& getMuxIdentities() const noexcept {
+        return peerMuxIdentities_;
+    }
+
+    /*! Reserve an id for a new session on this connection.
+     *
+     * The side that initiated the connection uses odd numbers, the
+     * other side even numbers, so that both can open sessions.
+     *
+     * \return The id, or 0 if all the ids are in use.
+     */
+    quint32 allocateSessionId();
+
+    // True if the id is in the range the peer allocates from
+    bool isRemoteSessionId(const quint32 id) const noexcept;
+
+    void attachSession(const quint32 id, const std::shared_ptr<Peer>& session);
+    void detachSession(const quint32 id, const Peer *session);
+    std::shared_ptr<Peer> getSession(const quint32 id) const;
 
 signals:
     void incomingPeer(const std::shared_ptr<PeerConnection>& peer);
@@ -132,12 +268,20 @@ protected:
     void onReceivedData(const quint32 channel, const quint64 id,
                         const mview_t& data, const bool final);
     void onReceivedJson(const quint64 id, const mview_t& data);
+    void onReceivedAvatarData(const mview_t& data, const bool final);
+    void onReceivedSessionData(const quint32 channel, const quint64 id,
+                               const mview_t& data, const bool final);
     void enableEncryptedStream();
+    void sendFeatures();
+    void sendSessionTicket();
+    void onSessionTicket(const QJsonObject& json);
     void wantChunkSize();
     void wantChunkData(const size_t bytes);
     void processStream(const data_t& data);
     void prepareEncryption(stream_state_t& state, mview_t& header, mview_t& key);
     void prepareDecryption(stream_state_t& state, const mview_t& header, const mview_t& key);
+    bool canUseAesGcm() const noexcept;
+    void setCipherSuite(const StreamCipher::Suite suite);
     void decrypt(mview_t& data, const mview_t& ciphertext, bool& final);
     QByteArray safePayload(const mview_t& data);
     quint32 createChannel(const core::File& file);
@@ -145,16 +289,84 @@ protected:
     uint64_t startSend(core::File& file);
     void useConnection(ConnectionSocket *cc);
 
+    // Called when the connection is lost. Return true to handle it without notifying.
+    virtual bool onConnectionLost() { return false; }
+
+    void enterPhase(const Phase phase);
+    void armDeadline(const std::chrono::milliseconds& timeout);
+    void onDeadline(const Phase phase);
+    void startKeepalive();
+    void stopKeepalive();
+    void armKeepalive(const std::chrono::milliseconds& timeout);
+    void onKeepalive();
+    void onPong(const quint64 seq);
+
     InState inState_ = InState::DISABLED;
     ConnectionSocket::ptr_t connection_;
     core::ConnectData connectionData_;
-    stream_state_t stateIn = {};
-    stream_state_t stateOut = {};
+    stream_state_t stateIn;
+    stream_state_t stateOut;
+    QByteArray streamInHash_; // Hash of the header and key, for getChannelBinding()
+    QByteArray streamOutHash_;
+    bool aesGcmEnabled_ = false; // Our setting
+    bool resumptionEnabled_ = false; // Our setting
+    bool resumed_ = false;
     quint64 request_id_ = {}; // Counter for outgoing requests
     quint32 nextInchannel_ = 1;
     std::map<quint32, Channel::ptr_t> outChannels_;
     std::map<quint32, Channel::ptr_t> inChannels_;
     bool notificationsDisabled_ = false;
+    core::BandwidthShaper::ptr_t downloadShaper_;
+    bool compressionEnabled_ = false; // Our setting
+    bool peerSupportsCompression_ = false; // Announced by the peer
+    std::set<QByteArray> compressedOffers_; // Incoming file-id's, offered with compression
+    std::set<quint32> compressedOutChannels_; // Outgoing channels, accepted with compression
+    bool peerSupportsPngAvatar_ = false; // Announced by the peer
+    bool peerSupportsPing_ = false; // Announced by the peer
+    std::set<QByteArray> peerMuxIdentities_; // Announced by the peer
+
+    // Multiplexed sessions carried by this connection
+    std::map<quint32, std::weak_ptr<Peer>> sessions_;
+    quint32 lastSessionId_ = {};
+
+    // Avatar in transfer over avatar_channel
+    struct IncomingAvatar {
+        quint64 requestId = {};
+        int size = {};
+        QByteArray hash;
+        QByteArray data;
+    };
+    std::unique_ptr<IncomingAvatar> incomingAvatar_;
+
+    // Metrics for this connection. Removed from the registry with the peer.
+    struct Counters {
+        explicit Counters(const QString& prefix);
+
+        core::Counter& framesSent;
+        core::Counter& bytesSent;
+        core::Counter& framesReceived;
+        core::Counter& bytesReceived;
+    };
+
+    const QString metricsPrefix_;
+    Counters counters_;
+
+    // Deadline for the current phase
+    core::TimerWheel::ptr_t deadlines_;
+    Timeouts timeouts_;
+    Phase phase_ = Phase::CONNECTING;
+    std::chrono::steady_clock::time_point phaseEntered_ = std::chrono::steady_clock::now();
+    core::TimerWheel::id_t deadlineId_ = {};
+    std::chrono::steady_clock::time_point lastActivity_ = std::chrono::steady_clock::now();
+
+    // Keepalive probing. Keepalive messages don't count as activity.
+    core::TimerWheel::id_t keepaliveId_ = {};
+    std::chrono::milliseconds keepaliveInterval_ = {};
+    quint64 pingSeq_ = {};
+    quint64 outstandingPing_ = {}; // 0 if we don't wait for a Pong
+    std::chrono::steady_clock::time_point pingSent_;
+    std::chrono::steady_clock::time_point lastPong_;
+    int rtt_ = -1;
 
     // PeerConnection interface
 public:
@@ -166,12 +378,14 @@ public:
     uint64_t sendAck(const QString& what, const QString& status, const QString& data) override;
     uint64_t sendAck(const QString& what, const QString& status, const QVariantMap& params) override;
     bool isConnected() const noexcept override;
+    bool canSendMore() const noexcept override;
     uint64_t sendMessage(const core::Message &message) override;
     uint64_t sendAvatar(const QImage& avatar) override;
     uint64_t offerFile(const core::File& file) override;
     uint64_t startTransfer(core::File& file) override;
     uint64_t sendSome(core::File& file) override;
     void disableNotifications() override;
+    void setDownloadShaper(core::BandwidthShaper::ptr_t shaper) override;
 };
 
 }} // namespaces
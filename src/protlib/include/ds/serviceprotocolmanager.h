@@ -0,0 +1,49 @@
+#ifndef SERVICEPROTOCOLMANAGER_H
+#define SERVICEPROTOCOLMANAGER_H
+
+#include <map>
+
+#include "ds/protocolmanager.h"
+#include "ds/torserviceinterface.h"
+
+namespace ds {
+namespace prot {
+
+/*! Common code for the protocol managers that run DS services
+ *
+ * The transports (Tor and loopback) differ in how services are
+ * created and how we connect to peers. Everything else is shared
+ * here, so that they don't drift apart.
+ */
+class ServiceProtocolManager : public ds::core::ProtocolManager
+{
+public:
+    explicit ServiceProtocolManager(QSettings& settings);
+
+public slots:
+    uint64_t sendAddme(const core::AddmeReq& req) override;
+    uint64_t sendAck(const core::AckMsg& ack) override;
+
+public:
+    State getState() const override;
+    QByteArray getPeerHandle(const QUuid &service, const QUuid &connectionId) override;
+    TorServiceInterface& getService(const QUuid& service);
+    static const QByteArray& getName(const State state);
+
+protected:
+    void setState(State state);
+
+    // Apply the settings for the process-wide crypto and session caches
+    void applySettings();
+
+    // Apply the settings for the protocol to a new service
+    void configureService(TorServiceInterface& service) const;
+
+    QSettings& settings_;
+    State state_ = State::OFFLINE;
+    std::map<QUuid, TorServiceInterface::ptr_t> services_;
+};
+
+}} // namespaces
+
+#endif // SERVICEPROTOCOLMANAGER_H
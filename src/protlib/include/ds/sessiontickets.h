@@ -0,0 +1,153 @@
+#ifndef SESSIONTICKETS_H
+#define SESSIONTICKETS_H
+
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+
+#include <QByteArray>
+
+#include <sodium.h>
+
+#include "ds/memoryview.h"
+#include "ds/safememory.h"
+
+namespace ds {
+namespace prot {
+
+/*! Session tickets, to resume the handshake with a returning contact.
+ *
+ * After a handshake, the server gives the client a ticket and a fresh
+ * secret over the encrypted stream. The ticket is the client's pubkey,
+ * the secret and the expiry time, encrypted with a key that only the
+ * server knows. When the client reconnects, it sends the ticket, and
+ * its stream key and header encrypted with the secret, instead of the
+ * Hello. The server replies with its stream key and header encrypted
+ * with the same secret. That replaces the sealed boxes and the
+ * signatures in the full handshake with symmetric crypto.
+ *
+ * The resume message and the reply are padded to the same size as the
+ * Hello and Olleh, so they look the same on the wire.
+ *
+ * The ticket keys are random, kept in memory only, and rotated every
+ * lifetime. The key used for a ticket is derived from the ticket key
+ * and the pubkey of the identity that issued it. Each ticket can be
+ * used once.
+ *
+ * The client keeps its tickets in memory, indexed by the pubkeys of
+ * the identities at both ends.
+ *
+ * Thread-safe. The server opens the resume message on the crypto
+ * executor.
+ */
+class SessionTickets
+{
+public:
+    using mview_t = crypto::MemoryView<uint8_t>;
+    using secret_t = crypto::SafeMemory<uint8_t>;
+    using clock_t = std::chrono::system_clock;
+
+    static constexpr size_t secret_bytes = crypto_secretbox_KEYBYTES;
+    static constexpr size_t pubkey_bytes = crypto_sign_PUBLICKEYBYTES;
+    static constexpr size_t ticket_bytes = crypto_secretbox_NONCEBYTES
+            + pubkey_bytes + secret_bytes + 4 /* expires */
+            + crypto_secretbox_MACBYTES;
+    static constexpr int default_lifetime_seconds = 3600;
+
+    // Tickets kept by the client
+    static constexpr size_t max_tickets = 1024;
+
+    // What the client gets, and uses to resume
+    struct Ticket {
+        QByteArray ticket;
+        secret_t secret;
+        clock_t::time_point expires;
+    };
+
+    // What the server gets from a valid resume message
+    struct Resumed {
+        QByteArray clientPubkey;
+        secret_t secret;
+    };
+
+    static SessionTickets& instance();
+
+    SessionTickets();
+
+    void setLifetime(const std::chrono::seconds lifetime);
+    std::chrono::seconds getLifetime() const;
+
+    /*! Issue a ticket to a client that has completed the handshake.
+     *
+     * \param serverPubkey Signing pubkey of our identity
+     * \param clientPubkey Signing pubkey of the client
+     */
+    Ticket issue(const QByteArray& serverPubkey, const QByteArray& clientPubkey);
+
+    /*! Open a resume message from a client.
+     *
+     * \return false if the message is not a valid, unused ticket for
+     *      our identity. The caller should then try it as a Hello.
+     */
+    bool openResume(const QByteArray& serverPubkey, const QByteArray& message,
+                    mview_t& version, mview_t& key, mview_t& header,
+                    Resumed& resumed);
+
+    // Server's reply to a resume message, padded to bytes
+    static QByteArray sealReply(const secret_t& secret, const size_t bytes,
+                                const mview_t& version, const mview_t& key,
+                                const mview_t& header);
+
+    // Keep a ticket we got from a server
+    void store(const QByteArray& ourPubkey, const QByteArray& serverPubkey,
+               Ticket ticket);
+
+    /*! Get the ticket for a server, if we have one that has not expired.
+     *
+     * The ticket is removed, as it can only be used once.
+     */
+    bool take(const QByteArray& ourPubkey, const QByteArray& serverPubkey,
+              Ticket& ticket);
+
+    // Client's resume message, padded to bytes
+    static QByteArray sealResume(const Ticket& ticket, const size_t bytes,
+                                 const mview_t& version, const mview_t& key,
+                                 const mview_t& header);
+
+    // Open the server's reply to our resume message
+    static bool openReply(const secret_t& secret, const mview_t& message,
+                          mview_t& version, mview_t& key, mview_t& header);
+
+    size_t size() const;
+
+    // Forget all tickets and rotate the keys
+    void clear();
+
+private:
+    using key_t = secret_t;
+
+    void rotate(const clock_t::time_point now);
+    key_t deriveKey(const key_t& ticketKey, const QByteArray& serverPubkey) const;
+    void pruneUsed(const clock_t::time_point now);
+    static QByteArray makeIndex(const QByteArray& ourPubkey,
+                                const QByteArray& serverPubkey);
+
+    mutable std::mutex mutex_;
+    std::chrono::seconds lifetime_{default_lifetime_seconds};
+
+    // Server
+    key_t currentKey_;
+    key_t previousKey_;
+    clock_t::time_point rotated_;
+    std::set<QByteArray> used_; // Nonces of the tickets used
+    std::deque<std::pair<clock_t::time_point, QByteArray>> usedExpires_;
+
+    // Client
+    std::map<QByteArray, Ticket> tickets_;
+};
+
+}} // namespaces
+
+#endif // SESSIONTICKETS_H
@@ -0,0 +1,92 @@
+#ifndef STREAMCIPHER_H
+#define STREAMCIPHER_H
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include <sodium.h>
+
+namespace ds {
+namespace prot {
+
+/*! Stream encryption for one direction of a connection.
+ *
+ * The default suite is libsodium's secretstream (XChaCha20-Poly1305).
+ * On hosts with AES-NI, the peers may agree on AES-256-GCM instead,
+ * which is much faster for bulk data like file transfers.
+ *
+ * Both suites use the same key and header from the handshake, and the
+ * same overhead per message, so the framing does not change. For
+ * AES-256-GCM, the header gives the initial nonce, which is incremented
+ * for each message, and the tag is encrypted as the first byte of the
+ * plaintext.
+ *
+ * The state is prepared for both suites when the stream is initialized,
+ * as the client commits its key in the Hello, before it knows what the
+ * server selects. setSuite() picks one and wipes the other.
+ */
+class StreamCipher
+{
+public:
+    enum class Suite {
+        XCHACHA20POLY1305,
+        AES256GCM
+    };
+
+    static constexpr size_t key_bytes = crypto_secretstream_xchacha20poly1305_KEYBYTES;
+    static constexpr size_t header_bytes = crypto_secretstream_xchacha20poly1305_HEADERBYTES;
+    static constexpr size_t abytes = crypto_secretstream_xchacha20poly1305_ABYTES;
+
+    static constexpr unsigned char tag_message = crypto_secretstream_xchacha20poly1305_TAG_MESSAGE;
+    static constexpr unsigned char tag_push = crypto_secretstream_xchacha20poly1305_TAG_PUSH;
+    static constexpr unsigned char tag_final = crypto_secretstream_xchacha20poly1305_TAG_FINAL;
+
+    StreamCipher();
+    ~StreamCipher();
+
+    StreamCipher(const StreamCipher&) = delete;
+    StreamCipher& operator = (const StreamCipher&) = delete;
+
+    // True if the CPU has hardware support for AES-256-GCM
+    static bool isAesGcmAvailable() noexcept;
+
+    static const char *getName(const Suite suite) noexcept;
+
+    // Generate a new key and header, and prepare for encryption
+    void initPush(unsigned char *header, unsigned char *key);
+
+    // Prepare for decryption with the key and header from the peer
+    void initPull(const unsigned char *header, const unsigned char *key);
+
+    // Select the suite agreed with the peer. Throws if it's not available.
+    void setSuite(const Suite suite);
+    Suite getSuite() const noexcept { return suite_; }
+
+    // ciphertext must have room for bytes + abytes
+    void push(unsigned char *ciphertext, const unsigned char *data,
+              const size_t bytes, const unsigned char tag);
+
+    // data must have room for bytes - abytes. Returns false if the data is invalid.
+    bool pull(unsigned char *data, unsigned char& tag,
+              const unsigned char *ciphertext, const size_t bytes);
+
+private:
+    using aes_state_t = crypto_aead_aes256gcm_state;
+
+    struct AesDeleter {
+        void operator()(aes_state_t *state) const noexcept;
+    };
+
+    void prepareAes(const unsigned char *header, const unsigned char *key);
+
+    Suite suite_ = Suite::XCHACHA20POLY1305;
+    crypto_secretstream_xchacha20poly1305_state xchacha_ = {};
+    std::unique_ptr<aes_state_t, AesDeleter> aes_;
+    std::array<unsigned char, crypto_aead_aes256gcm_NPUBBYTES> nonce_ = {};
+    std::vector<unsigned char> scratch_;
+};
+
+}} // namespaces
+
+#endif // STREAMCIPHER_H
@@ -1,14 +1,13 @@
 #ifndef TORPROTOCOLMANAGER_H
 #define TORPROTOCOLMANAGER_H
 
-#include "ds/protocolmanager.h"
+#include "ds/serviceprotocolmanager.h"
 #include "ds/tormgr.h"
-#include "ds/torserviceinterface.h"
 
 namespace ds {
 namespace prot {
 
-class TorProtocolManager : public ds::core::ProtocolManager
+class TorProtocolManager : public ServiceProtocolManager
 {
 public:
     TorProtocolManager(QSettings& settings);
@@ -26,29 +25,11 @@ public slots:
 private slots:
     void onServiceCreated(const ds::tor::ServiceProperties& service);
 
-public:
-    State getState() const override;
-    static const QByteArray& getName(const State state);
-
 protected:
-    void setState(State state);
     ds::tor::TorConfig getConfig() const;
-    TorServiceInterface& getService(const QUuid& service);
 
     std::unique_ptr<::ds::tor::TorMgr> tor_;
-    QSettings& settings_;
-    State state_ = State::OFFLINE;
-
-    std::map<QUuid, TorServiceInterface::ptr_t> services_;
-
-    // ProtocolManager interface
-public slots:
-    uint64_t sendAddme(const core::AddmeReq& req) override;
-    uint64_t sendAck(const core::AckMsg& ack) override;
-
-    // ProtocolManager interface
-public:
-    QByteArray getPeerHandle(const QUuid &service, const QUuid &connectionId) override;
+    QNetworkProxy proxy_;
 };
 
 }} // namespaces
@@ -5,6 +5,7 @@
 
 #include <QObject>
 #include <QTcpSocket>
+#include <QNetworkProxy>
 #include <QUuid>
 
 #include "ds/protocolmanager.h"
@@ -50,8 +51,10 @@ public:
 
     /*! Start a service.
      * Any existing service will be terminated.
+     *
+     * \param port Port to listen to. If 0, a random port is used.
      */
-    StartServiceResult startService();
+    StartServiceResult startService(const uint16_t port = 0);
 
     /*! Stop the service if it is running */
     StopServiceResult stopService();
@@ -75,6 +78,56 @@ public:
     const QString& getAddress() const noexcept { return address_; }
     Peer::ptr_t getPeer(const QUuid& uuid) const;
 
+    /*! Proxy used for outgoing connections.
+     *
+     * Defaults to the Tor SOCKS proxy. Use QNetworkProxy::NoProxy
+     * for direct connections.
+     */
+    void setProxy(const QNetworkProxy& proxy) { proxy_ = proxy; }
+
+    /*! Set the host-address to listen to. Defaults to localhost. */
+    void setListenAddress(const QHostAddress& address) { listenAddress_ = address; }
+
+    /*! Offer compression to new peers */
+    void setCompression(const bool enable) noexcept { compression_ = enable; }
+
+    /*! Offer AES-256-GCM to new peers, if the CPU supports it */
+    void setAesGcm(const bool enable) noexcept { aesGcm_ = enable; }
+
+    /*! Use session tickets to resume the handshake with returning peers */
+    void setResumption(const bool enable) noexcept { resumption_ = enable; }
+
+    /*! Timeouts for the handshake, authorization and idle phases of new peers */
+    void setTimeouts(const Peer::Timeouts& timeouts) noexcept { timeouts_ = timeouts; }
+
+    /*! Give up a connection attempt after this many failed circuits to the host.
+     *
+     * Tor keeps trying for a long time, while the reconnect scheduler
+     * can do better with a fresh attempt after a backoff. 0 disables.
+     */
+    void setMaxCircuitFailures(const unsigned failures) noexcept { maxCircuitFailures_ = failures; }
+
+    /*! Tor reported a failed circuit to a hidden service.
+     *
+     * \param host Onion address, with ".onion"
+     */
+    void onRendezvousFailed(const QByteArray& host);
+
+    /*! Share connections with other identities that enable multiplexing.
+     *
+     * See Multiplexer. Takes effect while the service is running.
+     */
+    void setMultiplexing(const bool enable);
+
+    /*! Accept a session from a contact over a connection owned by another identity.
+     *
+     * Called by the Multiplexer when the peer has proven that it holds
+     * the contact's key. The session must be authorized like an incoming
+     * connection.
+     */
+    void acceptSession(const Peer::ptr_t& transport, const quint32 sessionId,
+                       crypto::DsCert::ptr_t contactsCert, const QByteArray& nonce);
+
 signals:
     void serviceStarted(const StartServiceResult& ssr);
     void serviceStopped(const StopServiceResult& ssr);
@@ -89,12 +142,27 @@ private slots:
 
 private:
     static QNetworkProxy& getTorProxy();
+    void addPeer(const Peer::ptr_t& peer);
+    bool resolveCollision(const Peer& incoming);
+
+    // One timer wheel for the deadlines of all the peers, shared by all the services
+    static core::TimerWheel::ptr_t getDeadlines();
 
     crypto::DsCert::ptr_t cert_;
     std::shared_ptr<TorSocketListener> server_;
     std::map<QUuid, Peer::ptr_t> peers_;
     const QString address_;
     const QUuid identityId_;
+    QNetworkProxy proxy_;
+    QHostAddress listenAddress_ = QHostAddress::LocalHost;
+    bool compression_ = true;
+    bool aesGcm_ = false;
+    bool resumption_ = true;
+    bool multiplexing_ = false;
+    unsigned maxCircuitFailures_ = 3;
+    std::map<QUuid, unsigned> circuitFailures_;
+    Peer::Timeouts timeouts_;
+    core::TimerWheel::ptr_t deadlines_ = getDeadlines();
 };
 
 }} //namespaces
@@ -38,7 +38,13 @@ SOURCES += \
     src/torsocketlistener.cpp \
     src/peer.cpp \
     src/dsserver.cpp \
-     src/imageutil.cpp
+     src/imageutil.cpp \
+    src/compression.cpp \
+    src/loopbackprotocolmanager.cpp \
+    src/serviceprotocolmanager.cpp \
+    src/multiplexer.cpp \
+    src/sessiontickets.cpp \
+    src/streamcipher.cpp
 
 HEADERS += \
     include/ds/torprotocolmanager.h \
@@ -48,7 +54,13 @@ HEADERS += \
     include/ds/torsocketlistener.h \
     include/ds/peer.h \
     include/ds/dsserver.h \
-    include/ds/imageutil.h
+    include/ds/imageutil.h \
+    include/ds/compression.h \
+    include/ds/loopbackprotocolmanager.h \
+    include/ds/serviceprotocolmanager.h \
+    include/ds/multiplexer.h \
+    include/ds/sessiontickets.h \
+    include/ds/streamcipher.h
 
 
 INCLUDEPATH += $$PWD/include \
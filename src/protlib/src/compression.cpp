@@ -0,0 +1,82 @@
+#include <set>
+#include <stdexcept>
+
+#include <QFileInfo>
+#include <QtEndian>
+
+#include <zlib.h>
+
+#include "ds/compression.h"
+
+#include "logfault/logfault.h"
+
+namespace ds {
+namespace prot {
+
+using namespace std;
+
+const QString Compression::name = "zlib";
+
+QByteArray Compression::compress(const void *data, const size_t bytes, const int level)
+{
+    return qCompress(reinterpret_cast<const uchar *>(data), static_cast<int>(bytes), level);
+}
+
+QByteArray Compression::decompress(const void *data, const size_t bytes, const size_t maxBytes)
+{
+    if (bytes < 4) {
+        throw runtime_error("Compressed payload is too short");
+    }
+
+    // Don't let a peer make us allocate huge buffers
+    const auto expected = qFromBigEndian<quint32>(data);
+    if (expected > maxBytes) {
+        LFLOG_WARN << "Compressed payload claims to expand to "
+                   << expected << " bytes. Max is " << maxBytes;
+        throw runtime_error("Compressed payload is too large");
+    }
+
+    if (expected == 0) {
+        return {};
+    }
+
+    // The header is only a claim. We inflate into a buffer of that size,
+    // and reject the payload if the stream does not end exactly there.
+    QByteArray rval(static_cast<int>(expected), 0);
+
+    z_stream zs = {};
+    if (inflateInit(&zs) != Z_OK) {
+        throw runtime_error("Failed to initialize zlib");
+    }
+
+    zs.next_in = const_cast<Bytef *>(reinterpret_cast<const Bytef *>(data) + 4);
+    zs.avail_in = static_cast<uInt>(bytes - 4);
+    zs.next_out = reinterpret_cast<Bytef *>(rval.data());
+    zs.avail_out = static_cast<uInt>(expected);
+
+    const auto result = inflate(&zs, Z_FINISH);
+    const auto inflated = zs.total_out;
+    inflateEnd(&zs);
+
+    if ((result != Z_STREAM_END) || (inflated != expected)) {
+        LFLOG_WARN << "Compressed payload does not expand to the "
+                   << expected << " bytes it claims";
+        throw runtime_error("Failed to decompress payload");
+    }
+
+    return rval;
+}
+
+bool Compression::isCompressible(const QString &fileName)
+{
+    static const set<QString> compressed = {
+        "7z", "apk", "avi", "bz2", "docx", "epub", "flac", "gif", "gz", "heic",
+        "jar", "jpeg", "jpg", "lz", "lz4", "lzma", "m4a", "mkv", "mov", "mp3",
+        "mp4", "odt", "ods", "ogg", "opus", "png", "rar", "tbz", "tgz", "txz",
+        "webm", "webp", "xlsx", "xz", "zip", "zst"
+    };
+
+    return compressed.find(QFileInfo{fileName}.suffix().toLower()) == compressed.end();
+}
+
+}} // namespaces
@@ -1,5 +1,8 @@
 
+#include <algorithm>
+
 #include "include/ds/connectionsocket.h"
+#include "ds/metrics.h"
 #include "logfault/logfault.h"
 
 using namespace std;
@@ -7,11 +10,29 @@ using namespace std;
 namespace ds {
 namespace prot {
 
+namespace {
+
+struct SocketMetrics {
+    core::Gauge& sockets = core::Metrics::instance().gauge("prot.socket.count");
+    core::Gauge& outQueue = core::Metrics::instance().gauge("prot.socket.outQueueBytes");
+    core::Gauge& inBuffer = core::Metrics::instance().gauge("prot.socket.inBufferBytes");
+    core::Counter& bytesRead = core::Metrics::instance().counter("prot.socket.bytesRead");
+    core::Counter& bytesWritten = core::Metrics::instance().counter("prot.socket.bytesWritten");
+    core::Counter& overflows = core::Metrics::instance().counter("prot.socket.overflows");
+};
+
+SocketMetrics& metrics() {
+    static SocketMetrics metrics;
+    return metrics;
+}
+
+} // anonymous namespace
+
 ConnectionSocket::ConnectionSocket(QByteArray host,
                                    quint16 port, const QUuid &uuid)
     : host_{move(host)}, port_{port}
 {
-    setReadBufferSize(1024 * 64);
+    setReadBufferSize(maxReadBufferSize);
 
     if (uuid.isNull()) {
         this->uuid = QUuid::createUuid();
@@ -29,8 +50,9 @@ ConnectionSocket::ConnectionSocket(QByteArray host,
             this, SLOT(onSocketFailed(SocketError)));
 
     connect(this, &ConnectionSocket::readyRead, this, [this]() {
-        inData += readAll();
-        processInput();
+        if (!readingPaused_) {
+            readInput();
+        }
     });
 
     connect(this, &ConnectionSocket::bytesWritten,
@@ -38,18 +60,24 @@ ConnectionSocket::ConnectionSocket(QByteArray host,
 
         Q_UNUSED(bytes)
 
-        if (outData.isEmpty()) {
+        if (outQueue_.empty()) {
             emit outputBufferEmptied();
         } else {
             sendMore();
         }
     });
 
+    metrics().sockets.add(1);
+
     LFLOG_TRACE << "Socket is constructed: " << uuid.toString();
 }
 
 ConnectionSocket::~ConnectionSocket()
 {
+    metrics().sockets.add(-1);
+    metrics().outQueue.add(-static_cast<qint64>(outBytes_));
+    metrics().inBuffer.add(-reportedInBytes_);
+
     LFLOG_TRACE << "Socket is destructed: " << uuid.toString();
 }
 
@@ -59,6 +87,31 @@ void ConnectionSocket::wantBytes(size_t bytesRequested)
     processInput();
 }
 
+void ConnectionSocket::pauseReading()
+{
+    readingPaused_ = true;
+}
+
+void ConnectionSocket::resumeReading()
+{
+    if (readingPaused_) {
+        readingPaused_ = false;
+
+        // We will not get another readyRead() for data that is already buffered
+        if (bytesAvailable() > 0) {
+            readInput();
+        }
+    }
+}
+
+void ConnectionSocket::setWatermarks(const size_t low, const size_t high)
+{
+    assert(low <= high);
+    lowWatermark_ = low;
+    highWatermark_ = high;
+    maxOutDataSize = std::max(maxOutDataSize, highWatermark_ * 4);
+}
+
 void ConnectionSocket::connectToDefaultHost()
 {
     connectToHost(host_, port_);
@@ -88,6 +141,14 @@ void ConnectionSocket::onSocketFailed(SocketError socketError)
     emit socketFailed(uuid, socketError);
 }
 
+void ConnectionSocket::readInput()
+{
+    const auto data = readAll();
+    metrics().bytesRead.add(static_cast<quint64>(data.size()));
+    inData += data;
+    processInput();
+}
+
 void ConnectionSocket::processInput()
 {
     if (bytesWanted_ && (static_cast<size_t>(inData.size()) >= bytesWanted_)) {
@@ -104,9 +165,12 @@ void ConnectionSocket::processInput()
 
         // We may be called recursively, so InData must be updated before we emit
         bytesWanted_ = 0;
+        updateInBytes();
         emit haveBytes(my_data);
     }
 
+    updateInBytes();
+
     // This should never happen, but just in case...
     if (static_cast<size_t>(inData.size()) > maxInDataSize) {
         LFLOG_ERROR << "To much data ("
@@ -118,18 +182,54 @@ void ConnectionSocket::processInput()
 
 void ConnectionSocket::sendMore()
 {
-    if (outData.isEmpty()) {
-        return;
-    }
+    // Only keep a limited amount of data in the sockets own buffer,
+    // so that the watermarks reflect what is actually pending.
+    while(!outQueue_.empty() && (bytesToWrite() < maxSocketBufferSize)) {
+        const auto& front = outQueue_.front();
+        const auto chunk = min<qint64>(front.size() - outOffset_,
+                                       maxSocketBufferSize - bytesToWrite());
+        const auto written = QTcpSocket::write(front.constData() + outOffset_, chunk);
+        if (written <= 0) {
+            break;
+        }
 
-    auto written = QTcpSocket::write(outData);
-    if (written > 0) {
-        if (written == outData.size()) {
-            outData.clear();
-        } else {
-            outData.remove(0, static_cast<int>(written));
+        outOffset_ += static_cast<int>(written);
+        addOutBytes(-written);
+        metrics().bytesWritten.add(static_cast<quint64>(written));
+
+        if (outOffset_ == front.size()) {
+            outQueue_.pop_front();
+            outOffset_ = 0;
         }
     }
+
+    if (reachedHighWatermark_ && isBelowLowWatermark()) {
+        reachedHighWatermark_ = false;
+        emit belowLowWatermark();
+    }
+}
+
+void ConnectionSocket::checkOutputLimit()
+{
+    if (outBytes_ > maxOutDataSize) {
+        metrics().overflows.add();
+        LFLOG_ERROR << "To much data ("
+                   << outBytes_
+                   << ") in outgoing buffer on " << getUuid().toString();
+        close();
+    }
+}
+
+void ConnectionSocket::addOutBytes(const qint64 bytes)
+{
+    outBytes_ = static_cast<size_t>(static_cast<qint64>(outBytes_) + bytes);
+    metrics().outQueue.add(bytes);
+}
+
+void ConnectionSocket::updateInBytes()
+{
+    metrics().inBuffer.add(inData.size() - reportedInBytes_);
+    reportedInBytes_ = inData.size();
 }
 
 }}
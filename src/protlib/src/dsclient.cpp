@@ -5,6 +5,7 @@
 #include <vector>
 #include <sodium.h>
 #include "include/ds/dsclient.h"
+#include "ds/cryptoexecutor.h"
 #include "logfault/logfault.h"
 
 namespace ds {
@@ -29,7 +30,9 @@ void DsClient::advance()
                         << ". Starting DS protocol.";
             sayHello();
             break;
+        case State::SAYING_HELLO:
         case State::GET_OLLEH:
+        case State::VERIFYING_OLLEH:
         case State::ENCRYPTED_STREAM:
             break;
     }
@@ -47,9 +50,17 @@ void DsClient::advance(const Peer::data_t &data)
         case State::GET_OLLEH:
             getHelloReply(data);
             break;
+        case State::SAYING_HELLO:
+        case State::VERIFYING_OLLEH:
+            break;
     }
 }
 
+struct DsClient::OllehResult {
+    Olleh olleh;
+    QString error;
+};
+
 /* Create an initial message to the server
  *
  * This message will initialize stream-based out-bound encryption
@@ -61,75 +72,249 @@ void DsClient::sayHello()
         return;
     }
 
-    Hello hello;
-    hello.version.at(0) = '\1'; // Version of the hello structure
+    auto hello = make_shared<Hello>();
+    offeredAesGcm_ = canUseAesGcm();
+    hello->version.at(0) = handshake_version // Version of the hello structure
+            | (offeredAesGcm_ ? handshake_aes_gcm : 0);
 
-    prepareEncryption(stateOut, hello.header, hello.key);
+    prepareEncryption(stateOut, hello->header, hello->key);
+
+    // Resume with a session ticket if we have one. That saves the public key operations.
+    resumeSecret_.clear();
+    resumed_ = false;
+    SessionTickets::Ticket ticket;
+    if (resumptionEnabled_ && !ticketRejected_ && SessionTickets::instance().take(
+                connectionData_.identitysCert->getSigningPubKey().toByteArray(),
+                connectionData_.contactsCert->getSigningPubKey().toByteArray(),
+                ticket)) {
+        LFLOG_DEBUG << "Resuming the session with a ticket on "
+                    << connection_->getUuid().toString();
+        state_ = State::SAYING_HELLO;
+        const auto ciphertext = SessionTickets::sealResume(
+                    ticket, Hello::bytes + crypto_box_SEALBYTES,
+                    hello->version, hello->key, hello->header);
+        resumeSecret_ = move(ticket.secret);
+        onHelloReady(connection_.get(), ciphertext);
+        return;
+    }
 
     // Copy our pubkey
     {
         const auto& our_pubkey = connectionData_.identitysCert->getSigningPubKey();
-        assert(hello.pubkey.size() == our_pubkey.size());
-        copy(our_pubkey.cbegin(), our_pubkey.cend(), hello.pubkey.begin());
+        assert(hello->pubkey.size() == our_pubkey.size());
+        copy(our_pubkey.cbegin(), our_pubkey.cend(), hello->pubkey.begin());
     }
 
-    // Sign the payload, so the server know we have the private key for our announced pubkey.
-    connectionData_.identitysCert->sign(
-                hello.signature,
-                {hello.version, hello.key, hello.header, hello.pubkey});
+    state_ = State::SAYING_HELLO;
+    auto ciphertext = make_shared<QByteArray>(
+                static_cast<int>(Hello::bytes + crypto_box_SEALBYTES), '\0');
+
+    core::CryptoExecutor::instance().post(this,
+                [hello, ciphertext,
+                 identitysCert = connectionData_.identitysCert,
+                 contactsCert = connectionData_.contactsCert] {
 
-    // Encrypt the payload with the receipients public encryption key
-    array<uint8_t, hello.buffer.size() + crypto_box_SEALBYTES> ciphertext = {};
-    connectionData_.contactsCert->encrypt(ciphertext, hello.buffer);
+        // Sign the payload, so the server know we have the private key for our announced pubkey.
+        identitysCert->sign(hello->signature,
+                            {hello->version, hello->key, hello->header, hello->pubkey});
+
+        // Encrypt the payload with the receipients public encryption key
+        contactsCert->encrypt(*ciphertext, hello->buffer);
+    }, this, [this, connection = connection_.get(), ciphertext](const exception_ptr& failure) {
+        if (failure) {
+            onError(connection, failure);
+            return;
+        }
+        onHelloReady(connection, *ciphertext);
+    });
+}
+
+void DsClient::onHelloReady(const ConnectionSocket *connection, const QByteArray& ciphertext)
+{
+    if ((state_ != State::SAYING_HELLO) || (inState_ == InState::CLOSING)
+            || (connection != connection_.get())) {
+        return;
+    }
 
     // Send the message to the server.
     connection_->write(ciphertext);
     state_ = State::GET_OLLEH;
+    enterPhase(Phase::HANDSHAKE);
     connection_->wantBytes(Olleh::bytes + crypto_box_SEALBYTES);
     LFLOG_DEBUG << "Said hello to " << connection_->getUuid().toString();
 }
 
 void DsClient::getHelloReply(const Peer::data_t &data)
 {
-    Olleh olleh;
-    assert(olleh.buffer.size() == (data.size() - crypto_box_SEALBYTES));
+    auto result = make_shared<OllehResult>();
+    state_ = State::VERIFYING_OLLEH;
 
-    if (!connectionData_.identitysCert->decrypt(olleh.buffer, data)) {
-        LFLOG_ERROR << "Failed to decrypt Hello reply payload from " << connection_->getUuid().toString();
-        connection_->close();
+    if (!resumeSecret_.empty()) {
+        auto& olleh = result->olleh;
+        if (!SessionTickets::openReply(resumeSecret_, data,
+                                       olleh.version, olleh.key, olleh.header)) {
+            LFLOG_WARN << "Failed to open the reply to our session ticket from "
+                       << connection_->getUuid().toString();
+            retryWithHello();
+            return;
+        }
+
+        if ((olleh.version.at(0) & handshake_version_mask) != handshake_version) {
+            result->error = QStringLiteral("Unsupported Olleh version %1")
+                    .arg(static_cast<unsigned int>(olleh.version.at(0)));
+        }
+
+        resumeSecret_.clear();
+        resumed_ = result->error.isEmpty();
+        onOllehVerified(*result);
         return;
     }
 
-    // Check version
-    if (olleh.version.at(0) != 1) {
-        LFLOG_ERROR << "Unsupported Olleh version "
-                    << static_cast<unsigned int>(olleh.version.at(0))
-                    << " from " << connection_->getUuid().toString();
-        connection_->close();
+    // The view is only valid until we return
+    QByteArray ciphertext{reinterpret_cast<const char *>(data.cdata()),
+                          static_cast<int>(data.size())};
+
+    core::CryptoExecutor::instance().post(this,
+                [result, ciphertext,
+                 identitysCert = connectionData_.identitysCert,
+                 contactsCert = connectionData_.contactsCert] {
+
+        auto& olleh = result->olleh;
+        assert(olleh.buffer.size() == (static_cast<size_t>(ciphertext.size()) - crypto_box_SEALBYTES));
+
+        if (!identitysCert->decrypt(olleh.buffer, ciphertext)) {
+            result->error = "Failed to decrypt Hello reply payload";
+            return;
+        }
+
+        // Check version. The upper bits are flags.
+        if ((olleh.version.at(0) & handshake_version_mask) != handshake_version) {
+            result->error = QStringLiteral("Unsupported Olleh version %1")
+                    .arg(static_cast<unsigned int>(olleh.version.at(0)));
+            return;
+        }
+
+        // Validate the signature
+        if (!contactsCert->verify(
+                    olleh.signature,
+                    {olleh.version, olleh.key, olleh.header})) {
+            result->error = "Signature in Olleh message was forged";
+            return;
+        }
+    }, this, [this, connection = connection_.get(), result](const exception_ptr& failure) {
+        if (failure) {
+            onError(connection, failure);
+            return;
+        }
+        onOllehVerified(*result);
+    });
+}
+
+void DsClient::onOllehVerified(const OllehResult& result)
+{
+    if ((state_ != State::VERIFYING_OLLEH) || (inState_ == InState::CLOSING)) {
         return;
     }
 
-    // Validate the signature
-    if (!connectionData_.contactsCert->verify(
-                olleh.signature,
-                {olleh.version, olleh.key, olleh.header})) {
-        LFLOG_ERROR << "Signature in Olleh message was forged from "
-            << connection_->getUuid().toString();
+    if (!result.error.isEmpty()) {
+        LFLOG_ERROR << result.error << " from " << connection_->getUuid().toString();
         connection_->close();
         return;
     }
 
     // At this point, any further outbound data must be encrypted
+    const auto& olleh = result.olleh;
+    const bool aesGcm = olleh.version.at(0) & handshake_aes_gcm;
+    if (aesGcm && !offeredAesGcm_) {
+        LFLOG_ERROR << "The server selected a cipher suite we did not offer on "
+                    << connection_->getUuid().toString();
+        connection_->close();
+        return;
+    }
+
     prepareDecryption(stateIn, olleh.header, olleh.key);
+    setCipherSuite(aesGcm ? StreamCipher::Suite::AES256GCM
+                          : StreamCipher::Suite::XCHACHA20POLY1305);
     state_ = State::ENCRYPTED_STREAM;
     LFLOG_DEBUG << "The data-stream to " << connection_->getUuid().toString()
                 << " is fully switched to stream-encryption.";
 
+    enterPhase(Phase::ESTABLISHED);
     enableEncryptedStream();
 
     emit connectedToPeer(shared_from_this());
 }
 
+void DsClient::onError(const ConnectionSocket *connection, const exception_ptr& failure)
+{
+    // The connection may have been replaced by a reconnect
+    if ((connection != connection_.get()) || (inState_ == InState::CLOSING)) {
+        return;
+    }
+
+    try {
+        rethrow_exception(failure);
+    } catch(const std::exception& ex) {
+        LFLOG_ERROR << "The handshake failed on "
+                    << connection_->getUuid().toString()
+                    << ": " << ex.what();
+    }
+
+    connection_->close();
+}
+
+bool DsClient::onConnectionLost()
+{
+    // A server that can't open our ticket (it was restarted, or the ticket
+    // expired) can't tell us without revealing that this was a resume.
+    // It just drops the connection.
+    if ((state_ != State::GET_OLLEH) || resumeSecret_.empty()
+            || (inState_ == InState::CLOSING)) {
+        return false;
+    }
+
+    LFLOG_DEBUG << "The server dropped the connection after our session ticket on "
+                << connection_->getUuid().toString();
+    retryWithHello();
+    return true;
+}
+
+void DsClient::retryWithHello()
+{
+    LFLOG_DEBUG << "Retrying with a full Hello on connection "
+                << getConnectionId().toString();
+
+    ticketRejected_ = true;
+    resumeSecret_.clear();
+    state_ = State::CONNECTED;
+
+    // Don't replace the connection while it is emitting signals
+    QTimer::singleShot(0, this, [this]() {
+        if ((state_ != State::CONNECTED) || (inState_ == InState::CLOSING)) {
+            return;
+        }
+
+        connection_->disconnect(this);
+        connection_->close();
+        reconnect();
+    });
+}
+
+void DsClient::reconnect()
+{
+    auto connection = make_shared<ConnectionSocket>(
+                connection_->getDefaultHost(),
+                connection_->getDefaultPort(),
+                getConnectionId());
+
+    connection->setProxy(connection_->proxy());
+    connection_ = move(connection);
+    useConnection(connection_.get());
+    initConnections();
+    startConnectRetryTimer();
+    connection_->connectToDefaultHost();
+}
+
 void DsClient::startConnectRetryTimer()
 {
     if (++numReconnects_ > maxReconnects_) {
@@ -138,22 +323,11 @@ void DsClient::startConnectRetryTimer()
         return;
     }
     QTimer::singleShot(reconnectDelayMilliseconds_, this, [this]() {
-        if (!notificationsDisabled_
+        if (!notificationsDisabled_ && (inState_ != InState::CLOSING)
                 && ((connection_->state() == QAbstractSocket::ConnectingState)
                  || (connection_->state() == QAbstractSocket::UnconnectedState))) {
             LFLOG_DEBUG << "Retrying connect on connection " << getConnectionId().toString();
-
-            auto connection = make_shared<ConnectionSocket>(
-                        connection_->getDefaultHost(),
-                        connection_->getDefaultPort(),
-                        getConnectionId());
-
-            connection->setProxy(connection_->proxy());
-            connection_ = move(connection);
-            useConnection(connection_.get());
-            initConnections();
-            startConnectRetryTimer();
-            connection_->connectToDefaultHost();
+            reconnect();
         } else {
             if (connection_) {
                 LFLOG_TRACE << "Not reconnecting " << getConnectionId().toString()
@@ -1,4 +1,6 @@
 #include "include/ds/dsserver.h"
+#include "ds/certcache.h"
+#include "ds/cryptoexecutor.h"
 
 #include "logfault/logfault.h"
 
@@ -24,9 +26,18 @@ DsServer::DsServer(ds::prot::ConnectionSocket::ptr_t
     // Get exactely the hello payload.
     connection_->wantBytes(Hello::bytes + crypto_box_SEALBYTES);
 
-    // TODO: Set up a timer so we time out if things don't progress
+    // Time out if the peer don't send a valid Hello in time.
+    // The deadline is armed when the service calls setDeadlines().
+    enterPhase(Phase::HANDSHAKE);
 }
 
+struct DsServer::HelloResult {
+    Hello hello;
+    crypto::DsCert::ptr_t clientCert;
+    SessionTickets::Resumed resumed;
+    QString error;
+};
+
 void DsServer::authorize(bool authorize)
 {
     if (!authorize) {
@@ -40,29 +51,65 @@ void DsServer::authorize(bool authorize)
     LFLOG_DEBUG << "Connection " << connection_->getUuid().toString()
                 << " is authorized to proceed. Setting up secure streams.";
 
-    Olleh olleh;
-    olleh.version.at(0) = '\1';
-    prepareEncryption(stateOut, olleh.header, olleh.key);
+    auto olleh = make_shared<Olleh>();
+    olleh->version.at(0) = handshake_version | (useAesGcm_ ? handshake_aes_gcm : 0);
+    prepareEncryption(stateOut, olleh->header, olleh->key);
+    setCipherSuite(useAesGcm_ ? StreamCipher::Suite::AES256GCM
+                              : StreamCipher::Suite::XCHACHA20POLY1305);
+    state_ = State::SENDING_OLLEH;
 
-    // Sign the payload
-    connectionData_.identitysCert->sign(
-                olleh.signature,
-                {olleh.version, olleh.key, olleh.header});
+    if (!resumeSecret_.empty()) {
+        // The secret from the ticket authenticates the reply. No public key operations.
+        const auto ciphertext = SessionTickets::sealReply(
+                    resumeSecret_, Olleh::bytes + crypto_box_SEALBYTES,
+                    olleh->version, olleh->key, olleh->header);
+        resumeSecret_.clear();
+        onOllehReady(ciphertext);
+        return;
+    }
 
-    array<uint8_t, olleh.buffer.size() + crypto_box_SEALBYTES> ciphertext = {};
-    connectionData_.contactsCert->encrypt(ciphertext, olleh.buffer);
+    auto ciphertext = make_shared<QByteArray>(
+                static_cast<int>(Olleh::bytes + crypto_box_SEALBYTES), '\0');
 
-    // Send the message to the server.
+    core::CryptoExecutor::instance().post(this,
+                [olleh, ciphertext,
+                 identitysCert = connectionData_.identitysCert,
+                 contactsCert = connectionData_.contactsCert] {
+
+        // Sign the payload
+        identitysCert->sign(olleh->signature,
+                            {olleh->version, olleh->key, olleh->header});
+
+        contactsCert->encrypt(*ciphertext, olleh->buffer);
+    }, this, [this, ciphertext](const exception_ptr& failure) {
+        try {
+            if (failure) {
+                rethrow_exception(failure);
+            }
+            onOllehReady(*ciphertext);
+        } catch(const std::exception& ex) {
+            onError(ex);
+        }
+    });
+}
+
+void DsServer::onOllehReady(const QByteArray& ciphertext)
+{
+    if ((state_ != State::SENDING_OLLEH) || (inState_ == InState::CLOSING)) {
+        return;
+    }
+
+    // Send the message to the client.
     connection_->write(ciphertext);
     state_ = State::ENCRYPTED_STREAM;
 
     LFLOG_DEBUG << "The data-stream to " << connection_->getUuid().toString()
                 << " is fully switched to stream-encryption.";
+    enterPhase(Phase::ESTABLISHED);
     enableEncryptedStream();
     emit connectedToPeer(shared_from_this());
 }
 
-
 void DsServer::advance(const data_t& data)
 {
     try {
@@ -73,62 +120,138 @@ void DsServer::advance(const data_t& data)
             case State::CONNECTED:
                 getHello(data);
                 break;
+            case State::VERIFYING_HELLO:
             case State::WAITING_FOR_AUTHORIZATION:
+            case State::SENDING_OLLEH:
             case State::FAILED:
             case State::UNAUTHORIZED:
+            case State::COLLISION:
                 return;
         }
     } catch(const std::exception& ex) {
-        LFLOG_ERROR << "Caught exception while advancing IO on "
-                    << connection_->getUuid().toString()
-                    << ": " << ex.what();
-
-        state_ = State::FAILED;
-        connection_->close();
+        onError(ex);
     }
 }
 
+void DsServer::onError(const std::exception &ex)
+{
+    LFLOG_ERROR << "Caught exception while advancing IO on "
+                << connection_->getUuid().toString()
+                << ": " << ex.what();
+
+    state_ = State::FAILED;
+    connection_->close();
+}
+
 void DsServer::getHello(const data_t& data)
 {
+    // Decrypting and validating the Hello are the expensive parts of
+    // the handshake. Further IO is stalled until we are done, as we
+    // have not asked the connection for more bytes.
+    auto result = make_shared<HelloResult>();
+    state_ = State::VERIFYING_HELLO;
 
-    // Data is encrypted with our pubkey. Decrypt it.
-    Hello hello;
-    assert(hello.buffer.size() == data.size() - crypto_box_SEALBYTES);
+    // The view is only valid until we return
+    QByteArray ciphertext{reinterpret_cast<const char *>(data.cdata()),
+                          static_cast<int>(data.size())};
 
-    if (!connectionData_.identitysCert->decrypt(hello.buffer, data)) {
-        LFLOG_ERROR << "Failed to decrypt hello payload from " << connection_->getUuid().toString();
-        connection_->close();
+    core::CryptoExecutor::instance().post(this,
+                [result, ciphertext, identitysCert = connectionData_.identitysCert] {
+
+        auto& hello = result->hello;
+        assert(hello.buffer.size() == static_cast<size_t>(ciphertext.size()) - crypto_box_SEALBYTES);
+
+        // A returning client may resume with a session ticket instead of the Hello
+        const bool resumed = SessionTickets::instance().openResume(
+                    identitysCert->getSigningPubKey().toByteArray(), ciphertext,
+                    hello.version, hello.key, hello.header, result->resumed);
+
+        // Data is encrypted with our pubkey. Decrypt it.
+        if (!resumed && !identitysCert->decrypt(hello.buffer, ciphertext)) {
+            result->error = "Failed to decrypt hello payload";
+            return;
+        }
+
+        // Check version. The upper bits are flags.
+        if ((hello.version.at(0) & handshake_version_mask) != handshake_version) {
+            result->error = QStringLiteral("Unsupported Hello version %1")
+                    .arg(static_cast<unsigned int>(hello.version.at(0)));
+            return;
+        }
+
+        // The ticket proves who the client is
+        auto& certs = core::CertCache::instance();
+        if (resumed) {
+            result->clientCert = certs.getFromPubkey(result->resumed.clientPubkey);
+            certs.add(result->resumed.clientPubkey, result->clientCert);
+            return;
+        }
+
+        // Validate the signature. Contacts reconnect often, so their certs are cached,
+        // but only when the signature proves that the client holds the key.
+        const auto pubkey = hello.pubkey.toByteArray();
+        auto clientCert = certs.getFromPubkey(pubkey);
+        if (!clientCert->verify(
+                    hello.signature,
+                    {hello.version, hello.key, hello.header, hello.pubkey})) {
+            result->error = "Signature in Hello message was forged";
+            return;
+        }
+
+        certs.add(pubkey, clientCert);
+        result->clientCert = move(clientCert);
+    }, this, [this, result](const exception_ptr& failure) {
+        try {
+            if (failure) {
+                rethrow_exception(failure);
+            }
+            onHelloVerified(*result);
+        } catch(const std::exception& ex) {
+            onError(ex);
+        }
+    });
+}
+
+void DsServer::onHelloVerified(const HelloResult& result)
+{
+    if ((state_ != State::VERIFYING_HELLO) || (inState_ == InState::CLOSING)) {
         return;
     }
-    
-    // Check version
-    if (hello.version.at(0) != 1) {
-        LFLOG_ERROR << "Unsupported Hello version "
-                    << static_cast<unsigned int>(hello.version.at(0))
-                    << " from " << connection_->getUuid().toString();
+
+    if (!result.error.isEmpty()) {
+        LFLOG_ERROR << result.error << " from " << connection_->getUuid().toString();
+        state_ = State::FAILED;
         connection_->close();
         return;
     }
 
-    // Validate the signature
-    auto client_cert = crypto::DsCert::createFromPubkey(hello.pubkey.toByteArray());
-    if (!client_cert->verify(
-                hello.signature,
-                {hello.version, hello.key, hello.header, hello.pubkey})) {
-        LFLOG_ERROR << "Signature in Hello message was forged from "
-            << connection_->getUuid().toString();
-        connection_->close();
+    const auto& hello = result.hello;
+    const auto& client_cert = result.clientCert;
+    connectionData_.contactsCert = client_cert;
+
+    // Resolve simultaneous connects before we spend any more work on this one
+    if (collisionHandler_ && collisionHandler_(*this)) {
+        LFLOG_DEBUG << "Connection " << connection_->getUuid().toString()
+                    << " from " << client_cert->getB58PubKey()
+                    << " collides with our own connection to the peer. Closing.";
+        state_ = State::COLLISION;
+        close();
         return;
     }
 
-    connectionData_.contactsCert = crypto::DsCert::createFromPubkey(hello.pubkey.toByteArray());
-
     // At this point, any further inbound data is assumed to be encrypted
     prepareDecryption(stateIn, hello.header, hello.key);
 
+    // Use AES-256-GCM if both we and the client have hardware support for it
+    useAesGcm_ = (hello.version.at(0) & handshake_aes_gcm) && canUseAesGcm();
+
+    resumeSecret_ = result.resumed.secret;
+    resumed_ = !resumeSecret_.empty();
+
     // Stall further IO until we get authorization to proceed
     connection_->wantBytes(0);
     state_ = State::WAITING_FOR_AUTHORIZATION;
+    enterPhase(Phase::AUTHORIZATION);
 
     LFLOG_DEBUG << "We are ready to proceed with connection from "
                 << client_cert->getB58PubKey()
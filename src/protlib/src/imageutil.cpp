@@ -1,4 +1,10 @@
 
+#include <deque>
+
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QImageReader>
+
 #include "ds/errors.h"
 #include "include/ds/imageutil.h"
 
@@ -7,6 +13,7 @@
 namespace ds {
 namespace prot {
 
+using namespace std;
 using namespace core;
 
 QJsonObject toJson(const QImage &image)
@@ -19,14 +26,16 @@ QJsonObject toJson(const QImage &image)
         };
     }
 
-    const auto bytes = image.width() * image.height();
+    const auto rgb = image.convertToFormat(QImage::Format_RGB32);
+    const auto bytes = rgb.width() * rgb.height();
 
     QByteArray r(bytes, 0), g(bytes, 0), b(bytes, 0);
 
     int ix = 0;
-    for(int y = 0; y < image.height(); ++y) {
-        for(int x = 0; x < image.width(); ++x, ++ix) {
-            const auto pixel = image.pixel(x, y);
+    for(int y = 0; y < rgb.height(); ++y) {
+        const auto line = reinterpret_cast<const QRgb *>(rgb.constScanLine(y));
+        for(int x = 0; x < rgb.width(); ++x, ++ix) {
+            const auto pixel = line[x];
 
             r[ix] = static_cast<char>(static_cast<uint8_t>(qRed(pixel)));
             g[ix] = static_cast<char>(static_cast<uint8_t>(qGreen(pixel)));
@@ -35,8 +44,8 @@ QJsonObject toJson(const QImage &image)
     }
 
     return QJsonObject {
-        {"height", image.height()},
-        {"width", image.width()},
+        {"height", rgb.height()},
+        {"width", rgb.width()},
         { "r", QString{r.toBase64()}},
         { "g", QString{g.toBase64()}},
         { "b", QString{b.toBase64()}},
@@ -73,16 +82,74 @@ QImage toQimage(const QJsonObject &object)
 
     int ix = 0;
     for(int y = 0; y < height; ++y) {
+        auto line = reinterpret_cast<QRgb *>(img.scanLine(y));
         for (int x = 0; x < width; ++x, ++ix) {
 
             const auto r = static_cast<uint8_t>(rd[ix]);
             const auto g = static_cast<uint8_t>(gd[ix]);
             const auto b = static_cast<uint8_t>(bd[ix]);
 
-            img.setPixel(x, y, qRgb(r, g, b));
+            line[x] = qRgb(r, g, b);
         }
     }
     return img;
 }
 
+EncodedImage toPng(const QImage &image)
+{
+    static deque<pair<qint64, EncodedImage>> cache;
+    static const size_t cache_size = 4;
+
+    const auto key = image.cacheKey();
+    for(const auto& it : cache) {
+        if (it.first == key) {
+            return it.second;
+        }
+    }
+
+    EncodedImage encoded;
+    QBuffer buffer(&encoded.data);
+    buffer.open(QIODevice::WriteOnly);
+    if (!image.save(&buffer, "PNG")) {
+        throw Error("Failed to encode image as PNG");
+    }
+
+    encoded.hash = QCryptographicHash::hash(encoded.data, QCryptographicHash::Sha256);
+
+    cache.emplace_front(key, encoded);
+    if (cache.size() > cache_size) {
+        cache.pop_back();
+    }
+
+    return encoded;
+}
+
+QImage fromPng(const QByteArray &data, const QSize &maxSize)
+{
+    QBuffer buffer;
+    buffer.setData(data);
+    buffer.open(QIODevice::ReadOnly);
+
+    // Only allow the png decoder.
+    QImageReader reader{&buffer, "png"};
+    reader.setDecideFormatFromContent(false);
+
+    const auto size = reader.size();
+    if (!size.isValid()
+            || (size.width() > maxSize.width())
+            || (size.height() > maxSize.height())) {
+        LFLOG_WARN << "Invalid image size: height=" << size.height()
+                   << ", width=" << size.width();
+        throw Error("Invalid image size");
+    }
+
+    QImage img;
+    if (!reader.read(&img)) {
+        LFLOG_WARN << "Failed to decode png image: " << reader.errorString();
+        throw Error("Failed to decode image");
+    }
+
+    return img;
+}
+
 }} // namespaces
@@ -0,0 +1,128 @@
+
+#include <QTcpServer>
+
+#include "ds/loopbackprotocolmanager.h"
+#include "logfault/logfault.h"
+
+using namespace std;
+using namespace ds::core;
+
+namespace ds {
+namespace prot {
+
+LoopbackProtocolManager::LoopbackProtocolManager(QSettings &settings)
+    : ServiceProtocolManager{settings}
+{
+}
+
+QByteArray LoopbackProtocolManager::getHost() const
+{
+    return settings_.value(QStringLiteral("loopbackHost"),
+                           QStringLiteral("127.0.0.1")).toString().toUtf8();
+}
+
+void LoopbackProtocolManager::start()
+{
+    applySettings();
+
+    // There is no transport to wait for.
+    setState(State::CONNECTING);
+    setState(State::CONNECTED);
+    setState(State::ONLINE);
+}
+
+void LoopbackProtocolManager::stop()
+{
+    setState(State::SHUTTINGDOWN);
+
+    for(auto& it : services_) {
+        it.second->stopService();
+    }
+    services_.clear();
+
+    setState(State::OFFLINE);
+}
+
+void LoopbackProtocolManager::createTransportHandle(const TransportHandleReq &req)
+{
+    // Let the OS assign a free port for the service
+    QTcpServer probe;
+    if (!probe.listen(QHostAddress(QString{getHost()}))) {
+        LFLOG_ERROR << "Failed to allocate a port for " << req.uuid.toString()
+                    << ": " << probe.errorString();
+        emit transportHandleError({req.identityName, req.uuid, probe.errorString()});
+        return;
+    }
+    const auto port = probe.serverPort();
+    probe.close();
+
+    TransportHandle th;
+    th.identityName = req.identityName;
+    th.uuid = req.uuid;
+    th.handle = getHost() + ':' + QByteArray::number(port);
+
+    th.data["type"] = QByteArray("Direct TCP");
+    th.data["host"] = getHost();
+    th.data["port"] = port;
+    th.data["address"] = QString("direct:") + th.handle;
+
+    emit transportHandleReady(th);
+}
+
+void LoopbackProtocolManager::startService(const QUuid& serviceId,
+                                           const crypto::DsCert::ptr_t& cert,
+                                           const QVariantMap& data)
+{
+    auto it = services_.find(serviceId);
+    if (it != services_.end()) {
+        it->second->stopService();
+        services_.erase(it);
+    }
+
+    auto service = make_shared<TorServiceInterface>(cert, data["address"].toByteArray(), serviceId);
+    service->setProxy(QNetworkProxy{QNetworkProxy::NoProxy});
+    service->setListenAddress(QHostAddress(data["host"].toString()));
+    configureService(*service);
+
+    try {
+        service->startService(static_cast<uint16_t>(data["port"].toUInt()));
+    } catch(const std::exception& ex) {
+        emit serviceFailed(serviceId, ex.what());
+        return;
+    }
+
+    connect(service.get(), &TorServiceInterface::incomingPeer,
+            this, [this] (const std::shared_ptr<PeerConnection>& peer) {
+        emit incomingPeer(peer);
+    });
+
+    services_[serviceId] = service;
+
+    emit serviceStarted(serviceId, false);
+}
+
+void LoopbackProtocolManager::stopService(const QUuid& uuid)
+{
+    auto it = services_.find(uuid);
+    if (it != services_.end()) {
+        it->second->stopService();
+        services_.erase(it);
+        emit serviceStopped(uuid);
+    }
+}
+
+core::PeerConnection::ptr_t LoopbackProtocolManager::connectTo(core::ConnectData cd)
+{
+    // address may be "direct:hostname:port" or "hostname:port"
+    auto parts = cd.address.split(':');
+    if (parts.size() < 2 || parts.size() > 3) {
+        throw runtime_error("Expected: [direct:]address:port");
+    }
+
+    const auto port = static_cast<uint16_t>(parts.at(parts.size() -1).toUInt());
+    const auto host = parts.at(parts.size() - 2);
+    auto service = cd.service;
+    return getService(service).connectToService(host, port, move(cd));
+}
+
+}} // namespaces
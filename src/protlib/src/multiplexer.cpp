@@ -0,0 +1,394 @@
+
+#include <algorithm>
+#include <sodium.h>
+
+#include <QJsonDocument>
+
+#include "ds/certcache.h"
+#include "ds/multiplexer.h"
+#include "ds/torserviceinterface.h"
+#include "ds/metrics.h"
+
+#include "logfault/logfault.h"
+
+namespace ds {
+namespace prot {
+
+using namespace std;
+
+namespace {
+
+struct MuxMetrics {
+    core::Counter& opened = core::Metrics::instance().counter("prot.mux.opened");
+    core::Counter& accepted = core::Metrics::instance().counter("prot.mux.accepted");
+    core::Counter& rejected = core::Metrics::instance().counter("prot.mux.rejected");
+};
+
+MuxMetrics& metrics() {
+    static MuxMetrics metrics;
+    return metrics;
+}
+
+QJsonDocument toControl(const char *type, const quint32 sessionId) {
+    return QJsonDocument{QJsonObject{
+        {"type", type},
+        {"session", QString::number(sessionId)}
+    }};
+}
+
+QByteArray pubkeyOf(const crypto::DsCert& cert) {
+    return cert.getSigningPubKey().toByteArray();
+}
+
+} // anonymous namespace
+
+MuxSession::MuxSession(Peer::ptr_t transport, core::ConnectData connectionData,
+                       const PeerConnection::Direction direction,
+                       const quint32 sessionId, QByteArray nonce)
+    : Peer{transport->getConnectionPtr(), move(connectionData), QUuid::createUuid()}
+    , transport_{move(transport)}, direction_{direction}, sessionId_{sessionId}
+    , nonce_{move(nonce)}
+{
+    enableCompression(transport_->useCompression());
+
+    if (direction_ == OUTGOING) {
+        if (nonce_.isEmpty()) {
+            nonce_.resize(nonce_bytes);
+            randombytes_buf(nonce_.data(), nonce_bytes);
+        }
+    } else {
+        // Time out if the owner don't authorize the session in time
+        enterPhase(Phase::AUTHORIZATION);
+    }
+}
+
+MuxSession::~MuxSession()
+{
+    transport_->detachSession(sessionId_, this);
+}
+
+void MuxSession::open()
+{
+    assert(direction_ == OUTGOING);
+
+    const auto to = pubkeyOf(*connectionData_.contactsCert);
+    const auto signature = connectionData_.identitysCert->sign<QByteArray>({
+        QByteArray{"MuxOpen"}, QByteArray::number(sessionId_), to, nonce_,
+        transport_->getChannelBinding()});
+
+    LFLOG_DEBUG << "Opening session #" << sessionId_
+                << " with id " << getConnectionId().toString()
+                << " over connection " << transport_->getConnectionId().toString();
+
+    enterPhase(Phase::HANDSHAKE);
+    transport_->send(QJsonDocument{QJsonObject{
+        {"type", "MuxOpen"},
+        {"session", QString::number(sessionId_)},
+        {"from", QString{pubkeyOf(*connectionData_.identitysCert).toBase64()}},
+        {"to", QString{to.toBase64()}},
+        {"nonce", QString{nonce_.toBase64()}},
+        {"signature", QString{signature.toBase64()}}
+    }});
+}
+
+void MuxSession::onAccepted(const QByteArray &signature)
+{
+    if ((direction_ != OUTGOING) || (getPhase() != Phase::HANDSHAKE)) {
+        return;
+    }
+
+    // The peer proves that it holds the key for the identity we wanted
+    if ((signature.size() != crypto_sign_BYTES)
+            || !connectionData_.contactsCert->verify(signature, {
+                QByteArray{"MuxAccept"}, QByteArray::number(sessionId_),
+                pubkeyOf(*connectionData_.identitysCert), nonce_,
+                transport_->getChannelBinding()})) {
+        LFLOG_WARN << "Invalid signature in MuxAccept for session "
+                   << getConnectionId().toString()
+                   << " over connection " << transport_->getConnectionId().toString();
+        close();
+        return;
+    }
+
+    established();
+}
+
+void MuxSession::onRemoteClose()
+{
+    if (closed_) {
+        return;
+    }
+
+    LFLOG_DEBUG << "Session " << getConnectionId().toString()
+                << " was closed by the peer.";
+
+    closed_ = true;
+    transport_->detachSession(sessionId_, this);
+    Peer::close();
+}
+
+void MuxSession::authorize(bool authorize)
+{
+    if ((direction_ != INCOMING) || (getPhase() != Phase::AUTHORIZATION)) {
+        return;
+    }
+
+    if (!authorize) {
+        LFLOG_DEBUG << "Session " << getConnectionId().toString()
+                    << " was not authorized to proceed. Closing.";
+        metrics().rejected.add();
+        close();
+        return;
+    }
+
+    const auto signature = connectionData_.identitysCert->sign<QByteArray>({
+        QByteArray{"MuxAccept"}, QByteArray::number(sessionId_),
+        pubkeyOf(*connectionData_.contactsCert), nonce_,
+        transport_->getChannelBinding()});
+
+    transport_->send(QJsonDocument{QJsonObject{
+        {"type", "MuxAccept"},
+        {"session", QString::number(sessionId_)},
+        {"signature", QString{signature.toBase64()}}
+    }});
+
+    metrics().accepted.add();
+    established();
+}
+
+uint64_t MuxSession::send(const void *data, const size_t bytes,
+                          const quint32 channel, const bool final,
+                          const bool compress)
+{
+    if (closed_) {
+        throw runtime_error("Session is closed");
+    }
+
+    quint32 subChannel = channel;
+    if (channel == avatar_channel) {
+        subChannel = session_channel_mask;
+    } else if (channel >= session_channel_mask) {
+        throw runtime_error("Channel is out of range for a session");
+    }
+
+    return transport_->send(data, bytes,
+                            (sessionId_ << session_shift) | subChannel,
+                            final, compress);
+}
+
+int MuxSession::getRtt() const noexcept
+{
+    return transport_->getRtt();
+}
+
+void MuxSession::close()
+{
+    if (closed_) {
+        return;
+    }
+
+    closed_ = true;
+    sendClose();
+    transport_->detachSession(sessionId_, this);
+    Peer::close();
+}
+
+void MuxSession::sendClose()
+{
+    if (!transport_->isConnected()) {
+        return;
+    }
+
+    try {
+        transport_->send(toControl("MuxClose", sessionId_));
+    } catch(const std::exception& ex) {
+        LFLOG_DEBUG << "Failed to send MuxClose for session "
+                    << getConnectionId().toString() << ": " << ex.what();
+    }
+}
+
+void MuxSession::established()
+{
+    LFLOG_DEBUG << "Session " << getConnectionId().toString()
+                << " is established over connection "
+                << transport_->getConnectionId().toString();
+
+    enterPhase(Phase::ESTABLISHED);
+    sendFeatures();
+    emit connectedToPeer(shared_from_this());
+}
+
+Multiplexer &Multiplexer::instance()
+{
+    static Multiplexer multiplexer;
+    return multiplexer;
+}
+
+void Multiplexer::addService(TorServiceInterface &service, const crypto::DsCert &cert)
+{
+    services_[pubkeyOf(cert)] = &service;
+}
+
+void Multiplexer::removeService(TorServiceInterface &service, const crypto::DsCert &cert)
+{
+    auto it = services_.find(pubkeyOf(cert));
+    if ((it != services_.end()) && (it->second == &service)) {
+        services_.erase(it);
+    }
+}
+
+QJsonArray Multiplexer::getIdentities(const crypto::DsCert &identity) const
+{
+    QJsonArray identities;
+    if (!getService(pubkeyOf(identity))) {
+        return identities;
+    }
+
+    for(const auto& it : services_) {
+        if (it.second) {
+            identities.append(QString{it.first.toBase64()});
+        }
+    }
+
+    return identities;
+}
+
+void Multiplexer::addTransport(const Peer::ptr_t &transport)
+{
+    transports_.erase(remove_if(transports_.begin(), transports_.end(),
+                                [&transport](const weak_ptr<Peer>& w) {
+        auto t = w.lock();
+        return !t || (t == transport);
+    }), transports_.end());
+
+    transports_.push_back(transport);
+}
+
+MuxSession::ptr_t Multiplexer::openSession(const core::ConnectData &cd)
+{
+    if (!getService(pubkeyOf(*cd.identitysCert))) {
+        return {};
+    }
+
+    const auto contact = pubkeyOf(*cd.contactsCert);
+    for(const auto& w : transports_) {
+        auto transport = w.lock();
+        if (!transport
+                || !transport->isConnected()
+                || (transport->getPhase() != Peer::Phase::ESTABLISHED)
+                || !transport->getMuxIdentities().count(contact)
+                || !getService(pubkeyOf(*transport->getConnectData().identitysCert))) {
+            continue;
+        }
+
+        const auto sessionId = transport->allocateSessionId();
+        if (!sessionId) {
+            continue;
+        }
+
+        auto session = make_shared<MuxSession>(transport, cd, core::PeerConnection::OUTGOING,
+                                               sessionId);
+        transport->attachSession(sessionId, session);
+        session->open();
+        metrics().opened.add();
+        return session;
+    }
+
+    return {};
+}
+
+void Multiplexer::onControl(Peer &transport, const QJsonObject &json)
+{
+    const auto type = json.value("type").toString();
+    const auto sessionId = json.value("session").toString().toUInt();
+
+    if (type == "MuxOpen") {
+        onOpen(transport, sessionId, json);
+    } else if (type == "MuxAccept") {
+        if (auto session = getSession(transport, sessionId)) {
+            session->onAccepted(QByteArray::fromBase64(json.value("signature").toString().toUtf8()));
+        }
+    } else if (type == "MuxClose") {
+        if (auto session = getSession(transport, sessionId)) {
+            session->onRemoteClose();
+        }
+    }
+}
+
+void Multiplexer::onOpen(Peer &transport, const quint32 sessionId, const QJsonObject &json)
+{
+    const auto reject = [&transport, sessionId](const char *why) {
+        LFLOG_DEBUG << "Rejecting session #" << sessionId
+                    << " on connection " << transport.getConnectionId().toString()
+                    << ": " << why;
+        metrics().rejected.add();
+        transport.send(toControl("MuxClose", sessionId));
+    };
+
+    if (!transport.isRemoteSessionId(sessionId) || transport.getSession(sessionId)) {
+        reject("Invalid session id");
+        return;
+    }
+
+    if (!getService(pubkeyOf(*transport.getConnectData().identitysCert))) {
+        reject("Multiplexing is disabled");
+        return;
+    }
+
+    const auto from = QByteArray::fromBase64(json.value("from").toString().toUtf8());
+    const auto to = QByteArray::fromBase64(json.value("to").toString().toUtf8());
+    const auto nonce = QByteArray::fromBase64(json.value("nonce").toString().toUtf8());
+    const auto signature = QByteArray::fromBase64(json.value("signature").toString().toUtf8());
+
+    if ((from.size() != crypto_sign_PUBLICKEYBYTES)
+            || (to.size() != crypto_sign_PUBLICKEYBYTES)
+            || (nonce.size() != static_cast<int>(MuxSession::nonce_bytes))
+            || (signature.size() != crypto_sign_BYTES)) {
+        reject("Malformed request");
+        return;
+    }
+
+    auto service = getService(to);
+    if (!service) {
+        reject("Unknown identity");
+        return;
+    }
+
+    // Signatures from another connection can't be replayed here
+    const auto binding = transport.getChannelBinding();
+    if (binding.isEmpty()) {
+        reject("The connection is not established");
+        return;
+    }
+
+    // The peer proves that it holds the key for the identity it claims
+    auto contactsCert = core::CertCache::instance().getFromPubkey(from);
+    if (!contactsCert->verify(signature, {QByteArray{"MuxOpen"},
+                                          QByteArray::number(sessionId), to, nonce,
+                                          binding})) {
+        reject("Invalid signature");
+        return;
+    }
+
+    core::CertCache::instance().add(from, contactsCert);
+
+    service->acceptSession(static_pointer_cast<Peer>(transport.shared_from_this()),
+                           sessionId, move(contactsCert), nonce);
+}
+
+TorServiceInterface *Multiplexer::getService(const QByteArray &pubkey) const
+{
+    auto it = services_.find(pubkey);
+    if (it != services_.end()) {
+        return it->second.data();
+    }
+
+    return nullptr;
+}
+
+MuxSession::ptr_t Multiplexer::getSession(Peer &transport, const quint32 sessionId)
+{
+    return dynamic_pointer_cast<MuxSession>(transport.getSession(sessionId));
+}
+
+}} // namespaces
@@ -4,9 +4,12 @@
 #include <cassert>
 #include <sodium.h>
 
+#include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QtEndian>
+#include <QTimer>
+#include <QCryptographicHash>
 
 #include "ds/peer.h"
 #include "ds/message.h"
@@ -15,6 +18,11 @@
 #include "ds/dsengine.h"
 #include "ds/imageutil.h"
 #include "ds/bytes.h"
+#include "ds/crypto.h"
+#include "ds/compression.h"
+#include "ds/tracer.h"
+#include "ds/multiplexer.h"
+#include "ds/sessiontickets.h"
 
 #include "logfault/logfault.h"
 
@@ -26,6 +34,10 @@ using namespace core;
 
 namespace  {
 const std::vector<QString> encoding_names = {"us-ascii", "utf-8"};
+constexpr size_t max_uncompressed_payload = 1024 * 256;
+constexpr int max_avatar_bytes = 1024 * 128;
+constexpr int avatar_chunk_size = 1024 * 8;
+const QSize max_avatar_size{128, 128};
 const std::map<QString, Message::Encoding>  encoding_lookup = {
     {"us-ascii", Message::US_ACSII},
     {"utf-8", Message::UTF8}        
@@ -87,9 +99,10 @@ private:
 
 class OutgoingFileChannel : public Peer::Channel {
 public:
-    OutgoingFileChannel(const core::File::ptr_t& file)
+    OutgoingFileChannel(const core::File::ptr_t& file, const bool compress)
         : io_{file->getPath()}
         , file_{file}
+        , compress_{compress}
     {
         assert(file->getDirection() == File::OUTGOING);
         if (!io_.open(QIODevice::ReadOnly | QIODevice::ExistingOnly)) {
@@ -102,7 +115,8 @@ public:
 
         LFLOG_DEBUG << "Opened file #" << file->getId()
                     << " with path \"" << file->getPath()
-                    << " for READ for outgoing transfer";
+                    << " for READ for outgoing transfer"
+                    << (compress_ ? " with compression" : "");
     }
 
     // Channel interface
@@ -130,7 +144,7 @@ public:
 
         auto rval = peer.send(buffer_.data(),
                   static_cast<size_t>(bytesRead),
-                  file_->getChannel(), finished);
+                  file_->getChannel(), finished, compress_);
 
         file_->addBytesTransferred(static_cast<size_t>(bytesRead));
 
@@ -144,6 +158,7 @@ public:
 private:
     QFile io_;
     File::ptr_t file_;
+    const bool compress_;
     std::array<char, 1024 * 8> buffer_ = {};
 };
 
@@ -156,12 +171,46 @@ Message::Encoding toEncoding(const QString& name) {
     return it->second;
 }
 
+// Totals for all the peers
+struct ProtMetrics {
+    Counter& framesSent = Metrics::instance().counter("prot.frames.sent");
+    Counter& bytesSent = Metrics::instance().counter("prot.bytes.sent");
+    Counter& compressedFrames = Metrics::instance().counter("prot.frames.compressed");
+    Counter& framesReceived = Metrics::instance().counter("prot.frames.received");
+    Counter& bytesReceived = Metrics::instance().counter("prot.bytes.received");
+    Counter& decryptFailures = Metrics::instance().counter("prot.decrypt.failures");
+    Counter& aesGcmStreams = Metrics::instance().counter("prot.cipher.aesgcm");
+    Histogram& processFrame = Metrics::instance().histogram("prot.frames.processTime");
+    Counter& reapedHandshake = Metrics::instance().counter("prot.reaped.handshake");
+    Counter& reapedAuthorization = Metrics::instance().counter("prot.reaped.authorization");
+    Counter& reapedIdle = Metrics::instance().counter("prot.reaped.idle");
+    Counter& pings = Metrics::instance().counter("prot.keepalive.pings");
+    Counter& keepaliveTimeouts = Metrics::instance().counter("prot.keepalive.timeouts");
+    Histogram& rtt = Metrics::instance().histogram("prot.keepalive.rtt");
+};
+
+ProtMetrics& metrics() {
+    static ProtMetrics metrics;
+    return metrics;
+}
+
 } // anonymous namespace
 
+Peer::Counters::Counters(const QString &prefix)
+    : framesSent{core::Metrics::instance().counter(prefix + "framesSent")}
+    , bytesSent{core::Metrics::instance().counter(prefix + "bytesSent")}
+    , framesReceived{core::Metrics::instance().counter(prefix + "framesReceived")}
+    , bytesReceived{core::Metrics::instance().counter(prefix + "bytesReceived")}
+{
+}
+
 Peer::Peer(ConnectionSocket::ptr_t connection,
-           core::ConnectData connectionData)
+           core::ConnectData connectionData,
+           const QUuid& connectionId)
     : connection_{move(connection)}, connectionData_{move(connectionData)}
-    , uuid_{connection_->getUuid()}
+    , metricsPrefix_{"peer." + (connectionId.isNull() ? connection_->getUuid() : connectionId).toString() + "."}
+    , counters_{metricsPrefix_}
+    , uuid_{connectionId.isNull() ? connection_->getUuid() : connectionId}
 {
     useConnection(connection.get());
     connect(this, &Peer::closeLater,
@@ -182,6 +231,19 @@ Peer::Peer(ConnectionSocket::ptr_t connection,
     }, Qt::QueuedConnection);
 }
 
+Peer::~Peer()
+{
+    if (deadlines_ && deadlineId_) {
+        deadlines_->cancel(deadlineId_);
+    }
+
+    if (deadlines_ && keepaliveId_) {
+        deadlines_->cancel(keepaliveId_);
+    }
+
+    Metrics::instance().remove(metricsPrefix_);
+}
+
 uint64_t Peer::send(const QJsonDocument &json)
 {
     if (!connection_->isOpen()) {
@@ -195,17 +257,21 @@ uint64_t Peer::send(const QJsonDocument &json)
                 << ": "
                 << jsonData;
 
+    // Never compressed. Channel 0 carries data the other side can influence,
+    // like message texts and names, in the same stream as secrets. Compressing
+    // it before encryption would leak information through the length
+    // of the chunks (like the CRIME attack on TLS).
     return send(jsonData.constData(),
                 static_cast<size_t>(jsonData.size()),
-                /* channel */ 0);
+                /* channel */ 0, false, false);
 }
 
-uint64_t Peer::send(const void *data, const size_t bytes,
-                    const quint32 ch, const bool eof )
+uint64_t Peer::send(const void *data, size_t bytes,
+                    const quint32 ch, const bool eof, const bool compress)
 {
     const unsigned char tag = eof
-            ? crypto_secretstream_xchacha20poly1305_TAG_PUSH
-            : crypto_secretstream_xchacha20poly1305_TAG_MESSAGE;
+            ? StreamCipher::tag_push
+            : StreamCipher::tag_message;
 
     if (!connection_->isOpen()) {
         throw runtime_error("Connection is closed");
@@ -213,10 +279,23 @@ uint64_t Peer::send(const void *data, const size_t bytes,
 
     // Data format:
     // Two bytes length | one byte version | four bytes channel | 8 bytes id | data
+    //
+    // Version 1 is plain data, version 2 is data compressed with zlib.
 
     // The length is encrypted individually to allow the peer to read it before
     // fetching the payload.
 
+    QByteArray compressed;
+    char frameVersion = '\1';
+    if (compress && (bytes >= Compression::minBytes)) {
+        compressed = Compression::compress(data, bytes);
+        if (static_cast<size_t>(compressed.size()) < bytes) {
+            data = compressed.constData();
+            bytes = static_cast<size_t>(compressed.size());
+            frameVersion = '\2';
+        }
+    }
+
     const size_t len = 1 + 4 + 8 + static_cast<size_t>(bytes);
     vector<uint8_t> payload_len(2),
             buffer(len),
@@ -237,7 +316,7 @@ uint64_t Peer::send(const void *data, const size_t bytes,
 
     valueToBytes(qToBigEndian(static_cast<quint16>(len)), payload_len);
 
-    version.at(0) = '\1';
+    version.at(0) = static_cast<uint8_t>(frameVersion);
 
     valueToBytes(qToBigEndian(static_cast<quint32>(ch)), channel);
     valueToBytes(qToBigEndian(static_cast<quint64>(++request_id_)), id);
@@ -246,14 +325,8 @@ uint64_t Peer::send(const void *data, const size_t bytes,
     memcpy(payload.data(), data, payload.size());
 
     // encrypt length
-    if (crypto_secretstream_xchacha20poly1305_push(&stateOut,
-                                               cipherlen.data(),
-                                               nullptr,
-                                               payload_len.data(),
-                                               payload_len.size(),
-                                               nullptr, 0, 0) != 0) {
-        throw runtime_error("Stream encryption failed");
-    }
+    stateOut.push(cipherlen.data(), payload_len.data(), payload_len.size(),
+                  StreamCipher::tag_message);
 
     connection_->write(cipherlen);
 
@@ -264,25 +337,38 @@ uint64_t Peer::send(const void *data, const size_t bytes,
                 << " to connection "<< connection_->getUuid().toString();
 
     // Encrypt the payload
-    if (crypto_secretstream_xchacha20poly1305_push(&stateOut,
-                                               ciphertext.data(),
-                                               nullptr,
-                                               buffer.data(),
-                                               buffer.size(),
-                                               nullptr, 0, tag) != 0) {
-        throw runtime_error("Stream encryption failed");
-    }
+    stateOut.push(ciphertext.data(), buffer.data(), buffer.size(), tag);
 
     connection_->write(ciphertext);
+
+    const auto wireBytes = static_cast<quint64>(cipherlen.size() + ciphertext.size());
+    metrics().framesSent.add();
+    metrics().bytesSent.add(wireBytes);
+    counters_.framesSent.add();
+    counters_.bytesSent.add(wireBytes);
+    if (frameVersion == '\2') {
+        metrics().compressedFrames.add();
+    }
+
     return request_id_;
 }
 
 void Peer::onReceivedData(const quint32 channel, const quint64 id,
                           const Peer::mview_t& data, const bool final)
 {
+    const auto sessionId = channel >> session_shift;
+
     if (channel == 0) {
         onReceivedJson(channel, data);
+    } else if (sessionId && (sessionId <= max_session_id)) {
+        lastActivity_ = chrono::steady_clock::now();
+        onReceivedSessionData(channel, id, data, final);
+    } else if (channel == avatar_channel) {
+        lastActivity_ = chrono::steady_clock::now();
+        onReceivedAvatarData(data, final);
     } else {
+        lastActivity_ = chrono::steady_clock::now();
+
         auto it = inChannels_.find(channel);
         if (it == inChannels_.end()) {
             LFLOG_WARN << "Data to unknown channel #" << channel
@@ -326,6 +412,19 @@ void Peer::onReceivedJson(const quint64 id, const Peer::mview_t& data)
 
     const auto type = json.object().value("type");
 
+    if (type == "Ping") {
+        send(QJsonDocument{QJsonObject{
+            {"type", "Pong"},
+            {"id", json.object().value("id")}
+        }});
+        return;
+    } else if (type == "Pong") {
+        onPong(json.object().value("id").toString().toULongLong());
+        return;
+    }
+
+    lastActivity_ = chrono::steady_clock::now();
+
     if (type == "AddMe") {
         PeerAddmeReq req{shared_from_this(), getConnectionId(), id,
                     json.object().value("nick").toString(),
@@ -351,6 +450,12 @@ void Peer::onReceivedJson(const quint64 id, const Peer::mview_t& data)
                     json.object().value("status").toString().toUtf8(),
                     params};
 
+        if (ack.what == "IncomingFile" && ack.status == "Proceed"
+                && useCompression()
+                && (params.value("compression").toString() == Compression::name)) {
+            compressedOutChannels_.insert(static_cast<quint32>(params.value("channel").toInt()));
+        }
+
         LFLOG_TRACE << "Emitting Ack";
         emit receivedAck(ack);
     } else if (type == "Message") {
@@ -363,6 +468,9 @@ void Peer::onReceivedJson(const quint64 id, const Peer::mview_t& data)
                     toEncoding(json.object().value("encoding").toString()),
                     QByteArray::fromBase64(json.object().value("signature").toString().toUtf8())};
 
+        // The Contact queues the message, and verifies and delivers it in a
+        // batch later in the event loop. The span only covers the hand-over.
+        core::TraceSpan span{"Peer::receivedMessage", "message", msg.data.messageId};
         LFLOG_TRACE << "Emitting PeerMessage";
         emit receivedMessage(msg);
     } else if (type == "IncomingFile") {
@@ -375,9 +483,60 @@ void Peer::onReceivedJson(const quint64 id, const Peer::mview_t& data)
                     json.object().value("file-type").toString(),
                     QByteArray::fromBase64(json.object().value("sha256").toString().toUtf8())};
 
+        if (useCompression()
+                && (json.object().value("compression").toString() == Compression::name)) {
+            compressedOffers_.insert(msg.fileId);
+        }
+
         LFLOG_TRACE << "Emitting PeerFileOffer";
         emit receivedFileOffer(msg);
+    } else if (type == "Features") {
+        peerSupportsCompression_ = (json.object().value("compression").toString() == Compression::name);
+        peerSupportsPngAvatar_ = (json.object().value("avatar").toString() == "png");
+        peerSupportsPing_ = (json.object().value("ping").toString() == "1");
+        startKeepalive();
+
+        peerMuxIdentities_.clear();
+        for(const auto& pubkey : json.object().value("mux").toArray()) {
+            peerMuxIdentities_.insert(QByteArray::fromBase64(pubkey.toString().toUtf8()));
+        }
+
+        if (!peerMuxIdentities_.empty() && !isSession()) {
+            Multiplexer::instance().addTransport(static_pointer_cast<Peer>(shared_from_this()));
+        }
+
+        if (json.object().value("resume").toString() == "1") {
+            sendSessionTicket();
+        }
+
+        LFLOG_DEBUG << "Compression is " << (useCompression() ? "enabled" : "disabled")
+                    << " on connection " << getConnectionId().toString();
+    } else if ((type == "MuxOpen") || (type == "MuxAccept") || (type == "MuxClose")) {
+        if (isSession()) {
+            throw Error("Nested sessions are not supported");
+        }
+        Multiplexer::instance().onControl(*this, json.object());
+    } else if (type == "SessionTicket") {
+        onSessionTicket(json.object());
     } else if (type == "SetAvatar") {
+        if (json.object().value("format").toString() == "png") {
+            // The image follows as binary data on the avatar channel
+            auto avatar = make_unique<IncomingAvatar>();
+            avatar->requestId = id;
+            avatar->size = json.object().value("size").toString().toInt();
+            avatar->hash = QByteArray::fromBase64(json.object().value("hash").toString().toUtf8());
+
+            if ((avatar->size <= 0) || (avatar->size > max_avatar_bytes)) {
+                LFLOG_WARN << "Invalid avatar size " << avatar->size
+                           << " from peer at connection " << getConnectionId().toString();
+                throw Error("Invalid avatar size");
+            }
+
+            avatar->data.reserve(avatar->size);
+            incomingAvatar_ = move(avatar);
+            return;
+        }
+
         PeerSetAvatarReq avatar{shared_from_this(), getConnectionId(), id,
                     toQimage(json.object())};
 
@@ -389,9 +548,75 @@ void Peer::onReceivedJson(const quint64 id, const Peer::mview_t& data)
     }
 }
 
+void Peer::onReceivedAvatarData(const Peer::mview_t &data, const bool final)
+{
+    if (!incomingAvatar_) {
+        LFLOG_WARN << "Unexpected avatar data from peer at connection "
+                   << getConnectionId().toString();
+        throw Error("Unexpected avatar data");
+    }
+
+    if ((incomingAvatar_->data.size() + static_cast<int>(data.size())) > incomingAvatar_->size) {
+        throw Error("Too much avatar data");
+    }
+
+    incomingAvatar_->data.append(reinterpret_cast<const char *>(data.cdata()),
+                                 static_cast<int>(data.size()));
+
+    if (!final) {
+        return;
+    }
+
+    auto avatar = move(incomingAvatar_);
+
+    if ((avatar->data.size() != avatar->size)
+            || (QCryptographicHash::hash(avatar->data, QCryptographicHash::Sha256) != avatar->hash)) {
+        throw Error("Invalid avatar data");
+    }
+
+    if (notificationsDisabled_) {
+        return;
+    }
+
+    PeerSetAvatarReq req{shared_from_this(), getConnectionId(), avatar->requestId,
+                fromPng(avatar->data, max_avatar_size)};
+
+    LFLOG_TRACE << "Emitting PeerSetAvatarReq";
+    emit receivedAvatar(req);
+}
+
+void Peer::onReceivedSessionData(const quint32 channel, const quint64 id,
+                                 const Peer::mview_t &data, const bool final)
+{
+    const auto sessionId = channel >> session_shift;
+    auto session = getSession(sessionId);
+    if (!session) {
+        // Data may still be underway when a session is closed
+        LFLOG_DEBUG << "Data to unknown session #" << sessionId
+                    << " on connection " << getConnectionId().toString();
+        return;
+    }
+
+    auto subChannel = channel & session_channel_mask;
+    if (subChannel == session_channel_mask) {
+        subChannel = avatar_channel;
+    }
+
+    try {
+        session->onReceivedData(subChannel, id, data, final);
+    } catch (const std::exception& ex) {
+        LFLOG_ERROR << "Caught exception while processing incoming data for session "
+                    << session->getConnectionId().toString()
+                    << " on connection " << getConnectionId().toString()
+                    << " :" << ex.what();
+        session->close();
+    }
+}
+
 void Peer::onCloseLater()
 {
-    if (connection_->isOpen()) {
+    // Sessions share the connection with their transport
+    if (!isSession() && connection_->isOpen()) {
         connection_->close();
     }
 
@@ -408,6 +633,100 @@ void Peer::enableEncryptedStream()
 
     assert(inState_ == InState::DISABLED);
     wantChunkSize();
+    sendFeatures();
+}
+
+// Tell the peer about optional protocol features we support.
+// Older peers will just ignore this message.
+void Peer::sendFeatures()
+{
+    QJsonObject features{
+        {"type", "Features"},
+        {"avatar", "png"},
+        {"ping", "1"}
+    };
+
+    if (compressionEnabled_) {
+        features.insert("compression", Compression::name);
+    }
+
+    // Ask the server for a ticket for our next connection
+    if (resumptionEnabled_ && !isSession() && (getDirection() == OUTGOING)) {
+        features.insert("resume", "1");
+    }
+
+    if (!isSession()) {
+        const auto mux = Multiplexer::instance().getIdentities(*connectionData_.identitysCert);
+        if (!mux.isEmpty()) {
+            features.insert("mux", mux);
+        }
+    }
+
+    send(QJsonDocument{features});
+}
+
+// Give the client a ticket, so that it can resume the next handshake
+void Peer::sendSessionTicket()
+{
+    if (!resumptionEnabled_ || isSession() || (getDirection() != INCOMING)) {
+        return;
+    }
+
+    auto& tickets = SessionTickets::instance();
+    const auto ticket = tickets.issue(
+                connectionData_.identitysCert->getSigningPubKey().toByteArray(),
+                connectionData_.contactsCert->getSigningPubKey().toByteArray());
+
+    send(QJsonDocument{QJsonObject{
+        {"type", "SessionTicket"},
+        {"ticket", QString{ticket.ticket.toBase64()}},
+        {"secret", QString{ticket.secret.toByteArray().toBase64()}},
+        {"lifetime", QString::number(tickets.getLifetime().count())}
+    }});
+}
+
+void Peer::onSessionTicket(const QJsonObject& json)
+{
+    if (!resumptionEnabled_ || isSession() || (getDirection() != OUTGOING)) {
+        return;
+    }
+
+    SessionTickets::Ticket ticket;
+    ticket.ticket = QByteArray::fromBase64(json.value("ticket").toString().toUtf8());
+    ticket.secret = crypto::SafeMemory<uint8_t>{
+            QByteArray::fromBase64(json.value("secret").toString().toUtf8())};
+    const auto lifetime = json.value("lifetime").toString().toLongLong();
+
+    // Leave some margin for the time the ticket was on its way
+    ticket.expires = SessionTickets::clock_t::now()
+            + chrono::seconds{lifetime - min<qint64>(lifetime / 10, 60)};
+
+    if ((ticket.ticket.size() != static_cast<int>(SessionTickets::ticket_bytes))
+            || (ticket.secret.size() != SessionTickets::secret_bytes)
+            || (lifetime <= 0)) {
+        LFLOG_WARN << "Ignoring an invalid session ticket on connection "
+                   << getConnectionId().toString();
+        return;
+    }
+
+    SessionTickets::instance().store(
+                connectionData_.identitysCert->getSigningPubKey().toByteArray(),
+                connectionData_.contactsCert->getSigningPubKey().toByteArray(),
+                move(ticket));
+}
+
+bool Peer::useCompression() const noexcept
+{
+    return compressionEnabled_ && peerSupportsCompression_;
+}
+
+void Peer::addInChannel(const quint32 id, Channel::ptr_t channel)
+{
+    if ((id == 0) || (id == avatar_channel)) {
+        throw runtime_error("Reserved channel id");
+    }
+
+    inChannels_[id] = move(channel);
 }
 
 void Peer::wantChunkSize()
@@ -439,6 +758,9 @@ void Peer::processStream(const Peer::data_t &ciphertext)
         return;
     }
 
+    metrics().bytesReceived.add(ciphertext.size());
+    counters_.bytesReceived.add(ciphertext.size());
+
     bool final = {};
     if (inState_ == InState::CHUNK_SIZE) {
         array<uint8_t, 2> bytes = {};
@@ -448,6 +770,10 @@ void Peer::processStream(const Peer::data_t &ciphertext)
     } else if (inState_ == InState::CHUNK_DATA){
 
         static const QByteArray binary = {"[binary]"};
+        ScopedTimer timer{metrics().processFrame};
+        metrics().framesReceived.add();
+        counters_.framesReceived.add();
+
             assert(ciphertext.size() >= crypt_bytes + 5);
         std::vector<uint8_t> buffer(ciphertext.size() - crypt_bytes);
         mview_t buffer_view{buffer};
@@ -473,7 +799,13 @@ void Peer::processStream(const Peer::data_t &ciphertext)
 
         decrypt(buffer_view, ciphertext, final);
 
-        if (version.at(0) != '\1') {
+        QByteArray uncompressed;
+        if (version.at(0) == '\2') {
+            uncompressed = Compression::decompress(payload.cdata(), payload.size(),
+                                                   max_uncompressed_payload);
+            payload.assign(reinterpret_cast<uint8_t *>(uncompressed.data()),
+                           static_cast<size_t>(uncompressed.size()));
+        } else if (version.at(0) != '\1') {
             LFLOG_WARN << "Unknown chunk version" << static_cast<unsigned int>(version.at(0));
             throw runtime_error("Unknown chunk version");
         }
@@ -499,6 +831,21 @@ void Peer::processStream(const Peer::data_t &ciphertext)
             return;
         }
 
+        if (channel_id && downloadShaper_) {
+            // Stop reading from the socket until the bucket allows more data.
+            // The TCP flow-control will then slow down the sender.
+            downloadShaper_->consume(payload.size());
+            const auto delay = downloadShaper_->getDelay();
+            if (delay.count() > 0) {
+                connection_->pauseReading();
+                QTimer::singleShot(static_cast<int>(delay.count()), this, [this]() {
+                    connection_->resumeReading();
+                    wantChunkSize();
+                });
+                return;
+            }
+        }
+
         wantChunkSize();
     } else {
         throw runtime_error("Unexpected InState");
@@ -509,41 +856,72 @@ void Peer::prepareEncryption(Peer::stream_state_t &state,
                              mview_t& header,
                              Peer::mview_t &key)
 {
-    crypto_secretstream_xchacha20poly1305_keygen(key.data());
-
-    if (crypto_secretstream_xchacha20poly1305_init_push(&state, header.data(), key.cdata()) != 0) {
-        throw runtime_error("Failed to initialize encryption");
-    }
-
+    assert(key.size() == StreamCipher::key_bytes);
+    assert(header.size() == StreamCipher::header_bytes);
+    state.initPush(header.data(), key.data());
+    crypto::createHash(streamOutHash_, {header, key});
 }
 
 void Peer::prepareDecryption(Peer::stream_state_t &state,
                              const mview_t &header,
                              const Peer::mview_t &key)
 {
-    if (crypto_secretstream_xchacha20poly1305_init_pull(&state, header.cdata(), key.cdata()) != 0) {
+    assert(key.size() == StreamCipher::key_bytes);
+    assert(header.size() == StreamCipher::header_bytes);
+    try {
+        state.initPull(header.cdata(), key.cdata());
+    } catch(const std::exception&) {
         LFLOG_WARN << "Invalid decryption key / header from: " << connection_->getUuid().toString();
-        throw runtime_error("Failed to initialize decryption");
+        throw;
+    }
+    crypto::createHash(streamInHash_, {header, key});
+}
+
+QByteArray Peer::getChannelBinding() const
+{
+    if (streamInHash_.isEmpty() || streamOutHash_.isEmpty()) {
+        return {};
+    }
+
+    // Both peers must hash the client's stream first
+    const auto outgoing = getDirection() == OUTGOING;
+    QByteArray binding;
+    crypto::createHash(binding, {QByteArray{"ds-channel-binding"},
+                                 outgoing ? streamOutHash_ : streamInHash_,
+                                 outgoing ? streamInHash_ : streamOutHash_});
+    return binding;
+}
+
+bool Peer::canUseAesGcm() const noexcept
+{
+    return aesGcmEnabled_ && StreamCipher::isAesGcmAvailable();
+}
+
+void Peer::setCipherSuite(const StreamCipher::Suite suite)
+{
+    stateIn.setSuite(suite);
+    stateOut.setSuite(suite);
+
+    if (suite == StreamCipher::Suite::AES256GCM) {
+        metrics().aesGcmStreams.add();
     }
+
+    LFLOG_DEBUG << "Using " << StreamCipher::getName(suite)
+                << " for the stream on connection " << getConnectionId().toString();
 }
 
 void Peer::decrypt(Peer::mview_t &data, const Peer::mview_t &ciphertext,  bool& final)
 {
     assert((data.size() + crypt_bytes) == ciphertext.size());
     unsigned char tag = {};
-    if (crypto_secretstream_xchacha20poly1305_pull(&stateIn,
-                                                   data.data(),
-                                                   nullptr,
-                                                   &tag,
-                                                   ciphertext.cdata(),
-                                                   ciphertext.size(),
-                                                   nullptr, 0) != 0) {
+    if (!stateIn.pull(data.data(), tag, ciphertext.cdata(), ciphertext.size())) {
+        metrics().decryptFailures.add();
         throw runtime_error("Decryption of stream failed");
     }
 
-    final = (tag == crypto_secretstream_xchacha20poly1305_TAG_PUSH);
+    final = (tag == StreamCipher::tag_push);
 
-    if (!final && (tag == crypto_secretstream_xchacha20poly1305_TAG_FINAL)) {
+    if (!final && (tag == StreamCipher::tag_final)) {
 
         // NOTE: Currently we dont use this feature, so this is not supposed to happen.
 
@@ -556,13 +934,14 @@ void Peer::decrypt(Peer::mview_t &data, const Peer::mview_t &ciphertext,  bool&
 
 QByteArray Peer::safePayload(const Peer::mview_t &data)
 {
-    const auto json_text = data.toByteArray();
-    QJsonDocument json = QJsonDocument::fromJson(json_text);
-    if (!json.isNull()) {
-        return json_text;
+    // Only called for trace-logging. Don't parse the json again,
+    // just make sure we don't dump binary data into the log.
+    if (data.empty() || (data.at(0) != '{')) {
+        return "*** NOT Json ***";
     }
 
-    return "*** NOT Json ***";
+    return QByteArray{reinterpret_cast<const char *>(data.cdata()),
+                      static_cast<int>(data.size())};
 }
 
 quint32 Peer::createChannel(const File &file)
@@ -580,7 +959,8 @@ quint32 Peer::createChannel(const File &file)
         channelId = file.getChannel();
         assert(channelId > 0);
         assert(outChannels_.find(channelId) == outChannels_.end());
-        ch = make_shared<OutgoingFileChannel>(filePtr);
+        const bool compress = compressedOutChannels_.erase(channelId) > 0;
+        ch = make_shared<OutgoingFileChannel>(filePtr, compress);
         outChannels_[channelId] = ch;
     }
 
@@ -611,12 +991,16 @@ uint64_t Peer::startReceive(File &file)
                 << " with channel #"
                 << channelId;
 
-    const auto params = QVariantMap {
+    auto params = QVariantMap {
             {"rest", QString::number(0)},
             {"data", QString{file.getFileId().toBase64()}},
             {"channel", channelId}
     };
 
+    if (compressedOffers_.erase(file.getFileId())) {
+        params.insert("compression", Compression::name);
+    }
+
     LFLOG_DEBUG << "Requesting File : " << file.getId()
                 << " with channel #" << channelId
                 << " over connection " << getConnectionId().toString();
@@ -652,7 +1036,7 @@ void Peer::useConnection(ConnectionSocket *cc)
         LFLOG_DEBUG << "Peer " << getConnectionId().toString()
                     << " is disconnected";
 
-        if (!notificationsDisabled_) {
+        if (!notificationsDisabled_ && !onConnectionLost()) {
             emit disconnectedFromPeer(shared_from_this());
         }
     });
@@ -664,6 +1048,14 @@ void Peer::useConnection(ConnectionSocket *cc)
             emit outputBufferEmptied();
         }
     }, Qt::QueuedConnection);
+
+    connect(connection_.get(), &ConnectionSocket::belowLowWatermark,
+            this, [this]() {
+
+        if (!notificationsDisabled_) {
+            emit outputBelowLowWatermark();
+        }
+    }, Qt::QueuedConnection);
 }
 
 QUuid Peer::getConnectionId() const
@@ -679,9 +1071,283 @@ crypto::DsCert::ptr_t Peer::getPeerCert() const noexcept
 void Peer::close()
 {
    inState_ = InState::CLOSING;
+   enterPhase(Phase::CLOSED);
    emit closeLater();
 }
 
+Peer::Timeouts Peer::getTimeouts(const QSettings &settings)
+{
+    Timeouts timeouts;
+    timeouts.handshake = chrono::milliseconds{settings.value(
+        "handshakeTimeout", static_cast<int>(timeouts.handshake.count())).toInt()};
+    timeouts.authorization = chrono::milliseconds{settings.value(
+        "authorizationTimeout", static_cast<int>(timeouts.authorization.count())).toInt()};
+    timeouts.idle = chrono::milliseconds{settings.value(
+        "idleTimeout", static_cast<int>(timeouts.idle.count())).toInt()};
+    timeouts.keepalive = chrono::milliseconds{settings.value(
+        "keepaliveInterval", static_cast<int>(timeouts.keepalive.count())).toInt()};
+    timeouts.maxKeepalive = chrono::milliseconds{settings.value(
+        "keepaliveMaxInterval", static_cast<int>(timeouts.maxKeepalive.count())).toInt()};
+    timeouts.pong = chrono::milliseconds{settings.value(
+        "keepaliveTimeout", static_cast<int>(timeouts.pong.count())).toInt()};
+    return timeouts;
+}
+
+void Peer::setDeadlines(core::TimerWheel::ptr_t wheel, const Peer::Timeouts &timeouts)
+{
+    if (deadlines_ && deadlineId_) {
+        deadlines_->cancel(deadlineId_);
+        deadlineId_ = {};
+    }
+
+    stopKeepalive();
+    deadlines_ = move(wheel);
+    timeouts_ = timeouts;
+    enterPhase(phase_);
+}
+
+void Peer::enterPhase(const Peer::Phase phase)
+{
+    if (phase_ != phase) {
+        phase_ = phase;
+        phaseEntered_ = chrono::steady_clock::now();
+    }
+
+    if (!deadlines_) {
+        return; // Not armed yet
+    }
+
+    if (deadlineId_) {
+        deadlines_->cancel(deadlineId_);
+        deadlineId_ = {};
+    }
+
+    switch(phase) {
+    case Phase::HANDSHAKE:
+        armDeadline(timeouts_.handshake);
+        break;
+    case Phase::AUTHORIZATION:
+        armDeadline(timeouts_.authorization);
+        break;
+    case Phase::ESTABLISHED:
+        lastActivity_ = chrono::steady_clock::now();
+        armDeadline(timeouts_.idle);
+        startKeepalive();
+        break;
+    case Phase::CLOSED:
+        stopKeepalive();
+        break;
+    case Phase::CONNECTING:
+        break;
+    }
+}
+
+void Peer::armDeadline(const chrono::milliseconds &timeout)
+{
+    if (timeout.count() <= 0) {
+        return; // Disabled
+    }
+
+    const auto phase = phase_;
+    weak_ptr<PeerConnection> weak = shared_from_this();
+    deadlineId_ = deadlines_->add(timeout, [weak, phase] {
+        if (auto peer = weak.lock()) {
+            static_cast<Peer&>(*peer).onDeadline(phase);
+        }
+    });
+}
+
+void Peer::onDeadline(const Peer::Phase phase)
+{
+    deadlineId_ = {};
+
+    if (phase != phase_) {
+        return;
+    }
+
+    switch(phase) {
+    case Phase::HANDSHAKE:
+        LFLOG_DEBUG << "Connection " << getConnectionId().toString()
+                    << " did not complete the handshake in time. Closing.";
+        metrics().reapedHandshake.add();
+        break;
+    case Phase::AUTHORIZATION:
+        LFLOG_DEBUG << "Connection " << getConnectionId().toString()
+                    << " was not authorized in time. Closing.";
+        metrics().reapedAuthorization.add();
+        break;
+    case Phase::ESTABLISHED: {
+        const auto idle = chrono::duration_cast<chrono::milliseconds>(
+                    chrono::steady_clock::now() - lastActivity_);
+        if (idle < timeouts_.idle) {
+            // There was activity since the deadline was armed
+            armDeadline(timeouts_.idle - idle);
+            return;
+        }
+
+        LFLOG_DEBUG << "Connection " << getConnectionId().toString()
+                    << " has been idle for " << (idle.count() / 1000)
+                    << " seconds. Closing.";
+        metrics().reapedIdle.add();
+    } break;
+    case Phase::CONNECTING:
+    case Phase::CLOSED:
+        return;
+    }
+
+    close();
+}
+
+void Peer::startKeepalive()
+{
+    // The keepalives for the transport also cover its sessions
+    if (!deadlines_ || keepaliveId_ || !peerSupportsPing_ || isSession()
+            || (phase_ != Phase::ESTABLISHED)
+            || (timeouts_.keepalive.count() <= 0)) {
+        return;
+    }
+
+    keepaliveInterval_ = timeouts_.keepalive;
+    lastPong_ = chrono::steady_clock::now();
+    armKeepalive(keepaliveInterval_);
+}
+
+void Peer::stopKeepalive()
+{
+    if (deadlines_ && keepaliveId_) {
+        deadlines_->cancel(keepaliveId_);
+    }
+
+    keepaliveId_ = {};
+    outstandingPing_ = {};
+}
+
+void Peer::armKeepalive(const chrono::milliseconds &timeout)
+{
+    weak_ptr<PeerConnection> weak = shared_from_this();
+    keepaliveId_ = deadlines_->add(timeout, [weak] {
+        if (auto peer = weak.lock()) {
+            static_cast<Peer&>(*peer).onKeepalive();
+        }
+    });
+}
+
+void Peer::onKeepalive()
+{
+    keepaliveId_ = {};
+
+    if (phase_ != Phase::ESTABLISHED) {
+        return;
+    }
+
+    if (outstandingPing_) {
+        LFLOG_DEBUG << "Connection " << getConnectionId().toString()
+                    << " did not answer the keepalive in time. Closing.";
+        metrics().keepaliveTimeouts.add();
+        close();
+        return;
+    }
+
+    outstandingPing_ = ++pingSeq_;
+    pingSent_ = chrono::steady_clock::now();
+    metrics().pings.add();
+
+    send(QJsonDocument{QJsonObject{
+        {"type", "Ping"},
+        {"id", QString::number(outstandingPing_)}
+    }});
+
+    armKeepalive(timeouts_.pong);
+}
+
+void Peer::onPong(const quint64 seq)
+{
+    if (!outstandingPing_ || (seq != outstandingPing_)) {
+        LFLOG_TRACE << "Ignoring unexpected Pong on connection "
+                    << getConnectionId().toString();
+        return;
+    }
+
+    const auto now = chrono::steady_clock::now();
+    const auto rtt = chrono::duration_cast<chrono::microseconds>(now - pingSent_);
+    outstandingPing_ = {};
+    metrics().rtt.record(static_cast<quint64>(rtt.count()));
+
+    if (keepaliveId_) {
+        deadlines_->cancel(keepaliveId_);
+        keepaliveId_ = {};
+    }
+
+    // Probe active connections often, and back off while they are idle.
+    if (lastActivity_ > lastPong_) {
+        keepaliveInterval_ = timeouts_.keepalive;
+    } else {
+        keepaliveInterval_ = min(keepaliveInterval_ * 2,
+                                 max(timeouts_.maxKeepalive, timeouts_.keepalive));
+    }
+
+    lastPong_ = now;
+    armKeepalive(keepaliveInterval_);
+
+    rtt_ = static_cast<int>(rtt.count() / 1000);
+    LFLOG_TRACE << "Round-trip time on connection " << getConnectionId().toString()
+                << " is " << rtt_ << " ms. Next keepalive in "
+                << (keepaliveInterval_.count() / 1000) << " seconds.";
+
+    if (!notificationsDisabled_) {
+        emit rttMeasured(rtt_);
+    }
+}
+
+quint32 Peer::allocateSessionId()
+{
+    const quint32 parity = getDirection() == OUTGOING ? 1 : 0;
+
+    // Round-robin, so that an id is not re-used while data for
+    // a closed session may still be underway.
+    for(quint32 i = 0; i < max_session_id; ++i) {
+        lastSessionId_ = (lastSessionId_ % max_session_id) + 1;
+        if (((lastSessionId_ & 1) == parity) && !getSession(lastSessionId_)) {
+            return lastSessionId_;
+        }
+    }
+
+    return 0;
+}
+
+bool Peer::isRemoteSessionId(const quint32 id) const noexcept
+{
+    const quint32 parity = getDirection() == OUTGOING ? 0 : 1;
+    return (id > 0) && (id <= max_session_id) && ((id & 1) == parity);
+}
+
+void Peer::attachSession(const quint32 id, const std::shared_ptr<Peer> &session)
+{
+    assert(id > 0 && id <= max_session_id);
+    sessions_[id] = session;
+}
+
+void Peer::detachSession(const quint32 id, const Peer *session)
+{
+    auto it = sessions_.find(id);
+    if (it != sessions_.end()) {
+        auto current = it->second.lock();
+        if (!current || (current.get() == session)) {
+            sessions_.erase(it);
+        }
+    }
+}
+
+std::shared_ptr<Peer> Peer::getSession(const quint32 id) const
+{
+    auto it = sessions_.find(id);
+    if (it != sessions_.end()) {
+        return it->second.lock();
+    }
+
+    return {};
+}
+
 QUuid Peer::getIdentityId() const noexcept
 {
     return connectionData_.service;
@@ -720,8 +1386,15 @@ bool Peer::isConnected() const noexcept
     return connection_ && connection_->isOpen();
 };
 
+bool Peer::canSendMore() const noexcept
+{
+    return connection_ && !connection_->isAboveHighWatermark();
+}
+
 uint64_t Peer::sendMessage(const core::Message &message)
 {
+    core::TraceSpan span{"Peer::sendMessage", "message", message.getData().messageId};
+
     auto json = QJsonDocument{
         QJsonObject{
             {"type", "Message"},
@@ -743,6 +1416,34 @@ uint64_t Peer::sendMessage(const core::Message &message)
 
 uint64_t Peer::sendAvatar(const QImage &avatar)
 {
+    if (!avatar.isNull() && peerSupportsPngAvatar_) {
+        const auto png = toPng(avatar);
+        if (png.data.size() <= max_avatar_bytes) {
+            auto json = QJsonDocument{
+                QJsonObject{
+                    {"type", "SetAvatar"},
+                    {"format", "png"},
+                    {"size", QString::number(png.data.size())},
+                    {"hash", QString{png.hash.toBase64()}}
+                }
+            };
+
+            LFLOG_DEBUG << "Sending Avatar as png over connection " << getConnectionId().toString();
+
+            const auto rval = send(json);
+            for(int offset = 0; offset < png.data.size(); offset += avatar_chunk_size) {
+                const auto bytes = min(avatar_chunk_size, png.data.size() - offset);
+                send(png.data.constData() + offset, static_cast<size_t>(bytes), avatar_channel,
+                     (offset + bytes) == png.data.size());
+            }
+
+            return rval;
+        }
+
+        LFLOG_WARN << "The avatar is too large (" << png.data.size()
+                   << " bytes) to send as png. Sending it in the old format.";
+    }
+
     auto obj = toJson(avatar);
     obj.insert("type", "SetAvatar");
     auto json = QJsonDocument{
@@ -756,19 +1457,23 @@ uint64_t Peer::sendAvatar(const QImage &avatar)
 
 uint64_t Peer::offerFile(const File &file)
 {
-    auto json = QJsonDocument{
-        QJsonObject{
-            {"type", "IncomingFile"},
-            {"sha256", QString{file.getHash().toBase64()}},
-            {"name", file.getName()},
-            {"size", QString::number(file.getSize())},
-            {"file-type", "binary"},
-            {"rest", QString::number(0)},
-            {"file-id", QString{file.getFileId().toBase64()}},
-            {"conversation", QString{file.getConversation()->getHash().toBase64()}},
-        }
+    auto offer = QJsonObject{
+        {"type", "IncomingFile"},
+        {"sha256", QString{file.getHash().toBase64()}},
+        {"name", file.getName()},
+        {"size", QString::number(file.getSize())},
+        {"file-type", "binary"},
+        {"rest", QString::number(0)},
+        {"file-id", QString{file.getFileId().toBase64()}},
+        {"conversation", QString{file.getConversation()->getHash().toBase64()}},
     };
 
+    if (useCompression() && Compression::isCompressible(file.getName())) {
+        offer.insert("compression", Compression::name);
+    }
+
+    auto json = QJsonDocument{move(offer)};
+
     LFLOG_DEBUG << "Sending File Offer for file: " << file.getId()
                 << " over connection " << getConnectionId().toString();
 
@@ -810,6 +1515,11 @@ void Peer::disableNotifications()
     notificationsDisabled_ = true;
 }
 
+void Peer::setDownloadShaper(core::BandwidthShaper::ptr_t shaper)
+{
+    downloadShaper_ = move(shaper);
+}
+
 
 }} // namespace
 
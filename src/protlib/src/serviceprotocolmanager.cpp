@@ -0,0 +1,140 @@
+#include <array>
+
+#include <QJsonObject>
+#include <QJsonDocument>
+
+#include "ds/serviceprotocolmanager.h"
+#include "ds/certcache.h"
+#include "ds/sessiontickets.h"
+#include "ds/cryptoexecutor.h"
+#include "logfault/logfault.h"
+
+using namespace std;
+using namespace ds::core;
+
+namespace ds {
+namespace prot {
+
+ServiceProtocolManager::ServiceProtocolManager(QSettings &settings)
+    : settings_{settings}
+{
+}
+
+ProtocolManager::State ServiceProtocolManager::getState() const
+{
+    return state_;
+}
+
+const QByteArray& ServiceProtocolManager::getName(const ProtocolManager::State state)
+{
+    static const std::array<QByteArray, 5> names = {{
+       "OFFLINE",
+       "CONNECTING",
+       "CONNECTED",
+       "ONLINE",
+       "SHUTTINGDOWN"
+   }};
+
+   return names.at(static_cast<size_t>(state));
+}
+
+void ServiceProtocolManager::setState(ProtocolManager::State state)
+{
+    const auto old = state_;
+    state_ = state;
+    if (old != state_) {
+
+        LFLOG_DEBUG << "ProtocolManager changing state from " << getName(old)
+                 << " to " << getName(state);
+
+        emit stateChanged(old, state_);
+
+        switch(state) {
+        case ProtocolManager::State::OFFLINE:
+            emit offline();
+            break;
+        case ProtocolManager::State::CONNECTING:
+            emit connecting();
+            break;
+        case ProtocolManager::State::CONNECTED:
+            emit connected();
+            break;
+        case ProtocolManager::State::ONLINE:
+            emit online();
+            break;
+        case ProtocolManager::State::SHUTTINGDOWN:
+            emit shutdown();
+            break;
+        }
+    }
+}
+
+void ServiceProtocolManager::applySettings()
+{
+    // Off-thread handshakes. 0 (the default) does the crypto on the main thread.
+    core::CryptoExecutor::instance().setThreads(static_cast<size_t>(
+        max(0, settings_.value("cryptoThreads", 0).toInt())));
+
+    core::CertCache::instance().setCapacity(static_cast<size_t>(
+        max(0, settings_.value("certCacheSize",
+                               static_cast<int>(core::CertCache::default_capacity)).toInt())));
+
+    SessionTickets::instance().setLifetime(chrono::seconds{
+        settings_.value("sessionTicketLifetime", SessionTickets::default_lifetime_seconds).toInt()});
+}
+
+void ServiceProtocolManager::configureService(TorServiceInterface &service) const
+{
+    service.setCompression(settings_.value("compression", true).toBool());
+    service.setAesGcm(settings_.value("aesGcm", false).toBool());
+    service.setResumption(settings_.value("sessionTickets", true).toBool());
+    service.setTimeouts(Peer::getTimeouts(settings_));
+    service.setMultiplexing(settings_.value("multiplexIdentities", false).toBool());
+}
+
+TorServiceInterface& ServiceProtocolManager::getService(const QUuid& service)
+{
+    auto it = services_.find(service);
+    if (it == services_.end()) {
+        const auto name = service.toByteArray().toStdString();
+        throw runtime_error("No such service"s + name);
+    }
+
+    return *it->second;
+}
+
+uint64_t ServiceProtocolManager::sendAddme(const AddmeReq& req)
+{
+    auto json = QJsonDocument{
+        QJsonObject{
+            {"type", "AddMe"},
+            {"nick", req.nickName},
+            {"address", getService(req.service).getAddress()},
+            {"message", req.message}
+        }
+    };
+
+    if (auto peer = getService(req.service).getPeer(req.connection)) {
+        return peer->send(json);
+    }
+
+    throw runtime_error("Failed to access peer while sending addme");
+}
+
+uint64_t ServiceProtocolManager::sendAck(const AckMsg &ack)
+{
+    if (auto peer = getService(ack.service).getPeer(ack.connection)) {
+        return peer->sendAck(ack.what, ack.status, ack.data);
+    }
+
+    throw runtime_error("Failed to access peer while sending ack");
+}
+
+QByteArray ServiceProtocolManager::getPeerHandle(const QUuid &service,
+                                                 const QUuid &connectionId)
+{
+    const auto& cd = getService(service).getPeer(connectionId)->getConnectData();
+    return cd.contactsCert->getB58PubKey();
+}
+
+}} // namespaces
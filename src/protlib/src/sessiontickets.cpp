@@ -0,0 +1,387 @@
+#include <array>
+#include <cassert>
+
+#include <QtEndian>
+
+#include "ds/sessiontickets.h"
+#include "ds/metrics.h"
+
+#include "logfault/logfault.h"
+
+namespace ds {
+namespace prot {
+
+using namespace std;
+
+namespace {
+
+using nonce_t = array<uint8_t, crypto_secretbox_NONCEBYTES>;
+
+constexpr size_t ticket_plain_bytes = SessionTickets::pubkey_bytes
+        + SessionTickets::secret_bytes + 4;
+
+// The secret is only used for one resume, so fixed nonces are fine
+nonce_t directionNonce(const uint8_t direction)
+{
+    nonce_t nonce = {};
+    nonce[0] = direction;
+    return nonce;
+}
+
+constexpr uint8_t client_to_server = 0;
+constexpr uint8_t server_to_client = 1;
+
+struct TicketMetrics {
+    core::Counter& issued = core::Metrics::instance().counter("prot.tickets.issued");
+    core::Counter& resumed = core::Metrics::instance().counter("prot.tickets.resumed");
+    core::Counter& rejected = core::Metrics::instance().counter("prot.tickets.rejected");
+    core::Gauge& stored = core::Metrics::instance().gauge("prot.tickets.stored");
+};
+
+TicketMetrics& metrics()
+{
+    static TicketMetrics m;
+    return m;
+}
+
+size_t bodySize(const SessionTickets::mview_t& version,
+                const SessionTickets::mview_t& key,
+                const SessionTickets::mview_t& header)
+{
+    return version.size() + key.size() + header.size();
+}
+
+// Encrypt version, key and header into out, and pad out with random bytes
+void sealBody(QByteArray& out, const size_t offset,
+              const SessionTickets::secret_t& secret, const uint8_t direction,
+              const SessionTickets::mview_t& version,
+              const SessionTickets::mview_t& key,
+              const SessionTickets::mview_t& header)
+{
+    const auto plainBytes = bodySize(version, key, header);
+    assert(static_cast<size_t>(out.size()) >= offset + plainBytes + crypto_secretbox_MACBYTES);
+
+    SessionTickets::secret_t plain{plainBytes};
+    auto p = plain.data();
+    p = copy(version.cbegin(), version.cend(), p);
+    p = copy(key.cbegin(), key.cend(), p);
+    copy(header.cbegin(), header.cend(), p);
+
+    const auto nonce = directionNonce(direction);
+    auto dst = reinterpret_cast<uint8_t *>(out.data()) + offset;
+    crypto_secretbox_easy(dst, plain.cdata(), plain.size(), nonce.data(), secret.cdata());
+
+    const auto used = offset + plainBytes + crypto_secretbox_MACBYTES;
+    randombytes_buf(out.data() + used, static_cast<size_t>(out.size()) - used);
+}
+
+bool openBody(const uint8_t *data, const size_t bytes,
+              const SessionTickets::secret_t& secret, const uint8_t direction,
+              SessionTickets::mview_t& version, SessionTickets::mview_t& key,
+              SessionTickets::mview_t& header)
+{
+    const auto plainBytes = bodySize(version, key, header);
+    if (bytes < plainBytes + crypto_secretbox_MACBYTES) {
+        return false;
+    }
+
+    SessionTickets::secret_t plain{plainBytes};
+    const auto nonce = directionNonce(direction);
+    if (crypto_secretbox_open_easy(plain.data(), data, plainBytes + crypto_secretbox_MACBYTES,
+                                   nonce.data(), secret.cdata()) != 0) {
+        return false;
+    }
+
+    auto p = plain.cdata();
+    copy(p, p + version.size(), version.begin());
+    p += version.size();
+    copy(p, p + key.size(), key.begin());
+    p += key.size();
+    copy(p, p + header.size(), header.begin());
+    return true;
+}
+
+quint32 toSeconds(const SessionTickets::clock_t::time_point when)
+{
+    return static_cast<quint32>(
+                chrono::duration_cast<chrono::seconds>(when.time_since_epoch()).count());
+}
+
+} // anonymous namespace
+
+constexpr int SessionTickets::default_lifetime_seconds;
+
+SessionTickets &SessionTickets::instance()
+{
+    static SessionTickets tickets;
+    return tickets;
+}
+
+SessionTickets::SessionTickets()
+{
+    rotate(clock_t::now());
+}
+
+void SessionTickets::setLifetime(const chrono::seconds lifetime)
+{
+    lock_guard<mutex> lock{mutex_};
+    lifetime_ = max(lifetime, chrono::seconds{1});
+}
+
+chrono::seconds SessionTickets::getLifetime() const
+{
+    lock_guard<mutex> lock{mutex_};
+    return lifetime_;
+}
+
+SessionTickets::Ticket SessionTickets::issue(const QByteArray &serverPubkey,
+                                             const QByteArray &clientPubkey)
+{
+    if (clientPubkey.size() != static_cast<int>(pubkey_bytes)) {
+        throw runtime_error("Invalid pubkey for session ticket");
+    }
+
+    Ticket ticket;
+    ticket.secret.resize(secret_bytes);
+    crypto_secretbox_keygen(ticket.secret.data());
+
+    secret_t plain{ticket_plain_bytes};
+    auto p = copy(clientPubkey.cbegin(), clientPubkey.cend(), plain.data());
+    p = copy(ticket.secret.cbegin(), ticket.secret.cend(), p);
+
+    nonce_t nonce;
+    randombytes_buf(nonce.data(), nonce.size());
+
+    ticket.ticket.resize(static_cast<int>(ticket_bytes));
+    auto dst = reinterpret_cast<uint8_t *>(ticket.ticket.data());
+    copy(nonce.cbegin(), nonce.cend(), dst);
+
+    {
+        lock_guard<mutex> lock{mutex_};
+        const auto now = clock_t::now();
+        rotate(now);
+        ticket.expires = now + lifetime_;
+        qToBigEndian(toSeconds(ticket.expires), p);
+
+        const auto key = deriveKey(currentKey_, serverPubkey);
+        crypto_secretbox_easy(dst + nonce.size(), plain.cdata(), plain.size(),
+                              nonce.data(), key.cdata());
+    }
+
+    metrics().issued.add();
+    return ticket;
+}
+
+bool SessionTickets::openResume(const QByteArray &serverPubkey,
+                                const QByteArray &message,
+                                mview_t &version, mview_t &key,
+                                mview_t &header, Resumed &resumed)
+{
+    if (static_cast<size_t>(message.size()) < ticket_bytes) {
+        return false;
+    }
+
+    const auto data = reinterpret_cast<const uint8_t *>(message.constData());
+    const QByteArray nonce{message.constData(), static_cast<int>(crypto_secretbox_NONCEBYTES)};
+    secret_t plain{ticket_plain_bytes};
+
+    lock_guard<mutex> lock{mutex_};
+    const auto now = clock_t::now();
+    rotate(now);
+
+    bool opened = false;
+    for(const auto *ticketKey : {&currentKey_, &previousKey_}) {
+        if (ticketKey->empty()) {
+            continue;
+        }
+
+        const auto boxKey = deriveKey(*ticketKey, serverPubkey);
+        if (crypto_secretbox_open_easy(plain.data(), data + crypto_secretbox_NONCEBYTES,
+                                       ticket_bytes - crypto_secretbox_NONCEBYTES,
+                                       data, boxKey.cdata()) == 0) {
+            opened = true;
+            break;
+        }
+    }
+
+    // Most likely a Hello
+    if (!opened) {
+        return false;
+    }
+
+    const auto expires = qFromBigEndian<quint32>(plain.cdata() + pubkey_bytes + secret_bytes);
+    if (expires <= toSeconds(now)) {
+        LFLOG_DEBUG << "Rejecting an expired session ticket";
+        metrics().rejected.add();
+        return false;
+    }
+
+    pruneUsed(now);
+    if (used_.count(nonce)) {
+        LFLOG_WARN << "Rejecting a session ticket that was already used";
+        metrics().rejected.add();
+        return false;
+    }
+
+    secret_t secret{plain.cdata() + pubkey_bytes, secret_bytes};
+    if (!openBody(data + ticket_bytes, static_cast<size_t>(message.size()) - ticket_bytes,
+                  secret, client_to_server, version, key, header)) {
+        LFLOG_WARN << "Rejecting a resume message with a valid ticket but invalid body";
+        metrics().rejected.add();
+        return false;
+    }
+
+    used_.insert(nonce);
+    usedExpires_.emplace_back(clock_t::time_point{chrono::seconds{expires}}, nonce);
+
+    resumed.clientPubkey = QByteArray{reinterpret_cast<const char *>(plain.cdata()),
+                                      static_cast<int>(pubkey_bytes)};
+    resumed.secret = move(secret);
+    metrics().resumed.add();
+    return true;
+}
+
+QByteArray SessionTickets::sealReply(const secret_t &secret, const size_t bytes,
+                                     const mview_t &version, const mview_t &key,
+                                     const mview_t &header)
+{
+    QByteArray reply(static_cast<int>(bytes), '\0');
+    sealBody(reply, 0, secret, server_to_client, version, key, header);
+    return reply;
+}
+
+void SessionTickets::store(const QByteArray &ourPubkey,
+                           const QByteArray &serverPubkey, Ticket ticket)
+{
+    if (ticket.ticket.size() != static_cast<int>(ticket_bytes)
+            || ticket.secret.size() != secret_bytes) {
+        throw runtime_error("Invalid session ticket");
+    }
+
+    lock_guard<mutex> lock{mutex_};
+
+    // Make room by dropping expired tickets, then any ticket
+    if (tickets_.size() >= max_tickets) {
+        const auto now = clock_t::now();
+        for(auto it = tickets_.begin(); it != tickets_.end();) {
+            if (it->second.expires <= now) {
+                it = tickets_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        if (tickets_.size() >= max_tickets) {
+            tickets_.erase(tickets_.begin());
+        }
+    }
+
+    tickets_[makeIndex(ourPubkey, serverPubkey)] = move(ticket);
+    metrics().stored.set(static_cast<qint64>(tickets_.size()));
+}
+
+bool SessionTickets::take(const QByteArray &ourPubkey,
+                          const QByteArray &serverPubkey, Ticket &ticket)
+{
+    lock_guard<mutex> lock{mutex_};
+    auto it = tickets_.find(makeIndex(ourPubkey, serverPubkey));
+    if (it == tickets_.end()) {
+        return false;
+    }
+
+    const bool valid = it->second.expires > clock_t::now();
+    if (valid) {
+        ticket = move(it->second);
+    }
+
+    tickets_.erase(it);
+    metrics().stored.set(static_cast<qint64>(tickets_.size()));
+    return valid;
+}
+
+QByteArray SessionTickets::sealResume(const Ticket &ticket, const size_t bytes,
+                                      const mview_t &version, const mview_t &key,
+                                      const mview_t &header)
+{
+    assert(ticket.ticket.size() == static_cast<int>(ticket_bytes));
+
+    QByteArray message(static_cast<int>(bytes), '\0');
+    copy(ticket.ticket.cbegin(), ticket.ticket.cend(), message.begin());
+    sealBody(message, ticket_bytes, ticket.secret, client_to_server, version, key, header);
+    return message;
+}
+
+bool SessionTickets::openReply(const secret_t &secret, const mview_t &message,
+                               mview_t &version, mview_t &key, mview_t &header)
+{
+    return openBody(message.cdata(), message.size(), secret, server_to_client,
+                    version, key, header);
+}
+
+size_t SessionTickets::size() const
+{
+    lock_guard<mutex> lock{mutex_};
+    return tickets_.size();
+}
+
+void SessionTickets::clear()
+{
+    lock_guard<mutex> lock{mutex_};
+    tickets_.clear();
+    used_.clear();
+    usedExpires_.clear();
+    currentKey_.clear();
+    previousKey_.clear();
+    rotate(clock_t::now());
+    metrics().stored.set(0);
+}
+
+// Must be called with the mutex locked
+void SessionTickets::rotate(const clock_t::time_point now)
+{
+    const auto age = now - rotated_;
+    if (!currentKey_.empty() && (age < lifetime_)) {
+        return;
+    }
+
+    // A ticket is valid for one lifetime, so it's never issued
+    // with a key that is older than the previous one.
+    if (!currentKey_.empty() && (age < (lifetime_ * 2))) {
+        previousKey_ = move(currentKey_);
+    } else {
+        previousKey_.clear();
+    }
+
+    currentKey_.clear();
+    currentKey_.resize(crypto_secretbox_KEYBYTES);
+    crypto_secretbox_keygen(currentKey_.data());
+    rotated_ = now;
+}
+
+SessionTickets::key_t SessionTickets::deriveKey(const key_t &ticketKey,
+                                                const QByteArray &serverPubkey) const
+{
+    key_t key{crypto_secretbox_KEYBYTES};
+    crypto_generichash(key.data(), key.size(),
+                       reinterpret_cast<const uint8_t *>(serverPubkey.constData()),
+                       static_cast<size_t>(serverPubkey.size()),
+                       ticketKey.cdata(), ticketKey.size());
+    return key;
+}
+
+// Must be called with the mutex locked
+void SessionTickets::pruneUsed(const clock_t::time_point now)
+{
+    while(!usedExpires_.empty() && (usedExpires_.front().first <= now)) {
+        used_.erase(usedExpires_.front().second);
+        usedExpires_.pop_front();
+    }
+}
+
+QByteArray SessionTickets::makeIndex(const QByteArray &ourPubkey,
+                                     const QByteArray &serverPubkey)
+{
+    return ourPubkey + serverPubkey;
+}
+
+}} // namespaces
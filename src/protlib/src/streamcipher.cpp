@@ -0,0 +1,168 @@
+#include <cassert>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#include "ds/streamcipher.h"
+
+namespace ds {
+namespace prot {
+
+using namespace std;
+
+static_assert(StreamCipher::abytes == 1 + crypto_aead_aes256gcm_ABYTES,
+              "Both suites must have the same overhead");
+static_assert(StreamCipher::key_bytes == crypto_aead_aes256gcm_KEYBYTES,
+              "Both suites must use the same key size");
+static_assert(StreamCipher::header_bytes >= crypto_aead_aes256gcm_NPUBBYTES,
+              "The header must hold the nonce");
+
+StreamCipher::StreamCipher() = default;
+
+StreamCipher::~StreamCipher()
+{
+    sodium_memzero(&xchacha_, sizeof(xchacha_));
+    sodium_memzero(nonce_.data(), nonce_.size());
+    if (!scratch_.empty()) {
+        sodium_memzero(scratch_.data(), scratch_.size());
+    }
+}
+
+bool StreamCipher::isAesGcmAvailable() noexcept
+{
+    return crypto_aead_aes256gcm_is_available() == 1;
+}
+
+const char *StreamCipher::getName(const StreamCipher::Suite suite) noexcept
+{
+    switch(suite) {
+        case Suite::XCHACHA20POLY1305:
+            return "xchacha20poly1305";
+        case Suite::AES256GCM:
+            return "aes256gcm";
+    }
+    return "unknown";
+}
+
+void StreamCipher::initPush(unsigned char *header, unsigned char *key)
+{
+    crypto_secretstream_xchacha20poly1305_keygen(key);
+
+    if (crypto_secretstream_xchacha20poly1305_init_push(&xchacha_, header, key) != 0) {
+        throw runtime_error("Failed to initialize encryption");
+    }
+
+    prepareAes(header, key);
+}
+
+void StreamCipher::initPull(const unsigned char *header, const unsigned char *key)
+{
+    if (crypto_secretstream_xchacha20poly1305_init_pull(&xchacha_, header, key) != 0) {
+        throw runtime_error("Failed to initialize decryption");
+    }
+
+    prepareAes(header, key);
+}
+
+void StreamCipher::setSuite(const StreamCipher::Suite suite)
+{
+    if (suite == Suite::AES256GCM) {
+        if (!aes_) {
+            throw runtime_error("AES-256-GCM is not available");
+        }
+        sodium_memzero(&xchacha_, sizeof(xchacha_));
+    } else {
+        aes_.reset();
+    }
+
+    suite_ = suite;
+}
+
+void StreamCipher::push(unsigned char *ciphertext, const unsigned char *data,
+                        const size_t bytes, const unsigned char tag)
+{
+    if (suite_ == Suite::XCHACHA20POLY1305) {
+        if (crypto_secretstream_xchacha20poly1305_push(&xchacha_, ciphertext, nullptr,
+                                                       data, bytes,
+                                                       nullptr, 0, tag) != 0) {
+            throw runtime_error("Stream encryption failed");
+        }
+        return;
+    }
+
+    assert(aes_);
+
+    // The tag is encrypted along with the data
+    scratch_.resize(1 + bytes);
+    scratch_[0] = tag;
+    if (bytes) {
+        memcpy(scratch_.data() + 1, data, bytes);
+    }
+
+    if (crypto_aead_aes256gcm_encrypt_afternm(ciphertext, nullptr,
+                                              scratch_.data(), scratch_.size(),
+                                              nullptr, 0, nullptr,
+                                              nonce_.data(), aes_.get()) != 0) {
+        throw runtime_error("Stream encryption failed");
+    }
+
+    sodium_increment(nonce_.data(), nonce_.size());
+}
+
+bool StreamCipher::pull(unsigned char *data, unsigned char &tag,
+                        const unsigned char *ciphertext, const size_t bytes)
+{
+    if (bytes < abytes) {
+        return false;
+    }
+
+    if (suite_ == Suite::XCHACHA20POLY1305) {
+        return crypto_secretstream_xchacha20poly1305_pull(&xchacha_, data, nullptr, &tag,
+                                                          ciphertext, bytes,
+                                                          nullptr, 0) == 0;
+    }
+
+    assert(aes_);
+
+    scratch_.resize(bytes - crypto_aead_aes256gcm_ABYTES);
+    if (crypto_aead_aes256gcm_decrypt_afternm(scratch_.data(), nullptr, nullptr,
+                                              ciphertext, bytes,
+                                              nullptr, 0,
+                                              nonce_.data(), aes_.get()) != 0) {
+        return false;
+    }
+
+    sodium_increment(nonce_.data(), nonce_.size());
+
+    tag = scratch_[0];
+    if (scratch_.size() > 1) {
+        memcpy(data, scratch_.data() + 1, scratch_.size() - 1);
+    }
+
+    return true;
+}
+
+void StreamCipher::prepareAes(const unsigned char *header, const unsigned char *key)
+{
+    aes_.reset();
+    if (!isAesGcmAvailable()) {
+        return;
+    }
+
+    // The state must be 16 byte aligned. sodium_malloc() aligns it, as the size is a multiple of 16.
+    static_assert((sizeof(aes_state_t) % 16) == 0, "Unexpected size of the AES state");
+    aes_.reset(static_cast<aes_state_t *>(sodium_malloc(sizeof(aes_state_t))));
+    if (!aes_) {
+        throw bad_alloc();
+    }
+
+    crypto_aead_aes256gcm_beforenm(aes_.get(), key);
+    memcpy(nonce_.data(), header, nonce_.size());
+}
+
+void StreamCipher::AesDeleter::operator()(StreamCipher::aes_state_t *state) const noexcept
+{
+    sodium_free(state);
+}
+
+}} // namespaces
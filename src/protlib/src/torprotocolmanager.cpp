@@ -1,12 +1,12 @@
 
 #include <cassert>
-#include <array>
 
-#include <QJsonObject>
-#include <QJsonDocument>
+#include <QDir>
+#include <QStandardPaths>
 
 #include "ds/torprotocolmanager.h"
 #include "ds/errors.h"
+#include "ds/metrics.h"
 #include "logfault/logfault.h"
 
 using namespace std;
@@ -18,9 +18,12 @@ namespace prot {
 
 
 TorProtocolManager::TorProtocolManager(QSettings &settings)
-    : settings_{settings}
+    : ServiceProtocolManager{settings}
 {
-    tor_ = make_unique<TorMgr>(getConfig());
+    const auto config = getConfig();
+    tor_ = make_unique<TorMgr>(config);
+    proxy_ = QNetworkProxy{QNetworkProxy::Socks5Proxy,
+                           config.socks_host.toString(), config.socks_port};
 
     connect(tor_.get(), &TorMgr::serviceCreated, this, &TorProtocolManager::onServiceCreated);
 
@@ -53,55 +56,59 @@ TorProtocolManager::TorProtocolManager(QSettings &settings)
     connect(tor_.get(), &TorMgr::stopped, this, [this](){
         setState(State::OFFLINE);
     });
-}
 
-TorProtocolManager::State TorProtocolManager::getState() const
-{
-    return state_;
-}
+    // Tor is still running, but can't reach the network
+    connect(tor_.get(), &TorMgr::networkChanged, this, [this](const bool up) {
+        if (!up && (state_ == State::ONLINE)) {
+            setState(State::CONNECTED);
+        } else if (up && (state_ == State::CONNECTED)) {
+            auto ctl = tor_->getController();
+            if (ctl && (ctl->getCtlState() == TorController::CtlState::ONLINE)) {
+                setState(State::ONLINE);
+            }
+        }
+    });
 
-const QByteArray& TorProtocolManager::getName(const ProtocolManager::State state)
-{
-    static const std::array<QByteArray, 5> names = {{
-       "OFFLINE",
-       "CONNECTING",
-       "CONNECTED",
-       "ONLINE",
-       "SHUTTINGDOWN"
-   }};
-
-   return names.at(static_cast<size_t>(state));
-}
+    connect(tor_.get(), &TorMgr::startFailed, this, [this](const QString& reason) {
+        LFLOG_ERROR << "Failed to start tor: " << reason;
+        setState(State::OFFLINE);
+    });
 
-void TorProtocolManager::setState(ProtocolManager::State state)
-{
-    const auto old = state_;
-    state_ = state;
-    if (old != state_) {
-
-        LFLOG_DEBUG << "TorProtocolManager changing state from " << getName(old)
-                 << " to " << getName(state);
-
-        emit stateChanged(old, state_);
-
-        switch(state) {
-        case ProtocolManager::State::OFFLINE:
-            emit offline();
-            break;
-        case ProtocolManager::State::CONNECTING:
-            emit connecting();
-            break;
-        case ProtocolManager::State::CONNECTED:
-            emit connected();
-            break;
-        case ProtocolManager::State::ONLINE:
-            emit online();
-            break;
-        case ProtocolManager::State::SHUTTINGDOWN:
-            emit shutdown();
-            break;
+    connect(tor_.get(), &TorMgr::startupComplete, this, [](const TorMgr::StartupTimings& timings) {
+        auto& metrics = core::Metrics::instance();
+        metrics.gauge("tor.startup.process").set(timings.process);
+        metrics.gauge("tor.startup.connected").set(timings.connected);
+        metrics.gauge("tor.startup.authenticated").set(timings.authenticated);
+        metrics.gauge("tor.startup.online").set(timings.online);
+    });
+
+    connect(tor_.get(), &TorMgr::socksPortReady, this, [this](const QHostAddress& host,
+            const quint16 port) {
+        // A SOCKS port in the settings is used as is, like a proxy in front of tor
+        if (settings_.contains(QStringLiteral("torSocksPort"))) {
+            LFLOG_DEBUG << "Tor listens on SOCKS port " << host.toString() << ":" << port
+                        << ", but we use " << proxy_.hostName() << ":" << proxy_.port()
+                        << " from the settings";
+            return;
         }
-    }
+
+        proxy_.setHostName(host.toString());
+        proxy_.setPort(port);
+        for(auto& it : services_) {
+            it.second->setProxy(proxy_);
+        }
+    });
+
+    connect(tor_.get(), &TorMgr::servicePublished, this, [this](const QUuid& service) {
+        emit servicePublished(service);
+    });
+
+    connect(tor_.get(), &TorMgr::rendezvousFailed, this, [this](const QByteArray& host,
+            const QByteArray& /*reason*/) {
+        for(auto& it : services_) {
+            it.second->onRendezvousFailed(host);
+        }
+    });
 }
 
 TorConfig TorProtocolManager::getConfig() const
@@ -133,6 +140,28 @@ TorConfig TorProtocolManager::getConfig() const
          config.app_host = QHostAddress::LocalHost;
      }
 
+     config.socks_host = QHostAddress(
+                 settings_.value(QStringLiteral("torSocksHost"),
+                                 config.socks_host.toString()).toString());
+     if (config.socks_host.isNull()) {
+         config.socks_host = QHostAddress::LocalHost;
+     }
+     config.socks_port = static_cast<uint16_t>(
+                 settings_.value(QStringLiteral("torSocksPort"),
+                                 config.socks_port).toUInt());
+
+     // "system" uses a running tor. "private" starts our own.
+     if (settings_.value(QStringLiteral("torMode"), "system").toString() == "private") {
+         config.mode = TorConfig::Mode::PRIVATE;
+     }
+     config.tor_binary = settings_.value(
+                 QStringLiteral("torBinary"),
+                 config.tor_binary).toString();
+     config.data_dir = settings_.value(
+                 QStringLiteral("torDataDir"),
+                 QDir{QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)}
+                    .filePath("tor")).toString();
+
      auto amode = settings_.value("torCtlAuthMode", -1).toInt();
      switch(amode) {
         case 1:
@@ -148,55 +177,15 @@ TorConfig TorProtocolManager::getConfig() const
      return config;
 }
 
-TorServiceInterface& TorProtocolManager::getService(const QUuid& service)
-{
-    auto it = services_.find(service);
-    if (it == services_.end()) {
-        const auto name = service.toByteArray().toStdString();
-        throw runtime_error("No such service"s + name);
-    }
-
-    return *it->second;
-}
-
-uint64_t TorProtocolManager::sendAddme(const AddmeReq& req)
-{
-    auto json = QJsonDocument{
-        QJsonObject{
-            {"type", "AddMe"},
-            {"nick", req.nickName},
-            {"address", getService(req.service).getAddress()},
-            {"message", req.message}
-        }
-    };
-
-    if (auto peer = getService(req.service).getPeer(req.connection)) {
-        return peer->send(json);
-    }
-
-    throw runtime_error("Failed to access peer while sending addme");
-}
-
-uint64_t TorProtocolManager::sendAck(const AckMsg &ack)
+void TorProtocolManager::start()
 {
+    applySettings();
 
-    if (auto peer = getService(ack.service).getPeer(ack.connection)) {
-        return peer->sendAck(ack.what, ack.status, ack.data);
-    }
-
-    throw runtime_error("Failed to access peer while sending addme");
-}
+    const auto config = getConfig();
+    proxy_ = QNetworkProxy{QNetworkProxy::Socks5Proxy,
+                           config.socks_host.toString(), config.socks_port};
 
-QByteArray TorProtocolManager::getPeerHandle(const QUuid &service,
-                                             const QUuid &connectionId)
-{
-    const auto& cd = getService(service).getPeer(connectionId)->getConnectData();
-    return cd.contactsCert->getB58PubKey();
-}
-
-void TorProtocolManager::start()
-{
-    tor_->updateConfig(getConfig());
+    tor_->updateConfig(config);
     tor_->start();
     setState(State::CONNECTING);
 }
@@ -224,6 +213,10 @@ void TorProtocolManager::startService(const QUuid& serviceId,
     sp.service_id = data["service_id"].toByteArray();
 
     auto service = make_shared<TorServiceInterface>(cert, data["address"].toByteArray(), serviceId);
+    configureService(*service);
+    service->setProxy(proxy_);
+    service->setMaxCircuitFailures(static_cast<unsigned>(
+        max(0, settings_.value("torMaxCircuitFailures", 3).toInt())));
 
     // Add listening port
     auto properties = service->startService();
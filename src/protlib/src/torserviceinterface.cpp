@@ -1,9 +1,14 @@
 
+#include <vector>
+
 #include <QNetworkProxy>
+#include <QPointer>
 
 #include "ds/torserviceinterface.h"
 #include "ds/dsserver.h"
 #include "ds/dsclient.h"
+#include "ds/multiplexer.h"
+#include "ds/metrics.h"
 #include "logfault/logfault.h"
 
 namespace ds {
@@ -15,11 +20,12 @@ TorServiceInterface::TorServiceInterface(crypto::DsCert::ptr_t cert,
                                          const QByteArray& address,
                                          const QUuid& identityId)
     : cert_{move(cert)}, address_{address}, identityId_{identityId}
+    , proxy_{getTorProxy()}
 {
 }
 
 
-StartServiceResult TorServiceInterface::startService()
+StartServiceResult TorServiceInterface::startService(const uint16_t port)
 {
     StartServiceResult r;
 
@@ -30,13 +36,17 @@ StartServiceResult TorServiceInterface::startService()
         onNewIncomingConnection(connection);
     });
 
-    if (!server_->listen(QHostAddress::LocalHost)) {
+    if (!server_->listen(listenAddress_, port)) {
         LFLOG_ERROR << "Failed to start listener: "
                     << server_->errorString();
         throw runtime_error("Failed to start listener");
     }
     r.port = server_->serverPort();
 
+    if (multiplexing_) {
+        Multiplexer::instance().addService(*this, *cert_);
+    }
+
     LFLOG_NOTICE << "Started listening to " << server_->serverAddress()
                  << ":" << server_->serverPort();
 
@@ -48,6 +58,8 @@ StartServiceResult TorServiceInterface::startService()
 StopServiceResult TorServiceInterface::stopService()
 {
     StopServiceResult r;
+    Multiplexer::instance().removeService(*this, *cert_);
+
     if (server_) {
         if (server_->isListening()) {
 
@@ -68,6 +80,22 @@ core::PeerConnection::ptr_t
 TorServiceInterface::connectToService(const QByteArray &host, const uint16_t port,
                                       core::ConnectData cd)
 {
+    if (multiplexing_) {
+        if (auto session = Multiplexer::instance().openSession(cd)) {
+            LFLOG_DEBUG << "Connecting to " << host << ":" << port
+                        << " over an existing connection with session-id "
+                        << session->getConnectionId().toString();
+
+            connect(session.get(), &core::PeerConnection::disconnectedFromPeer,
+                    this, [this](const std::shared_ptr<core::PeerConnection>& peer) {
+                peers_.erase(peer->getConnectionId());
+            }, Qt::QueuedConnection);
+
+            addPeer(session);
+            return move(session);
+        }
+    }
+
     auto connection = make_shared<ConnectionSocket>(host, port);
 
     LFLOG_DEBUG << "Connecting to "
@@ -75,16 +103,20 @@ TorServiceInterface::connectToService(const QByteArray &host, const uint16_t por
                 << " with connection-id " << connection->getUuid().toString();
 
     auto client = make_shared<DsClient>(connection, move(cd));
+    client->enableCompression(compression_);
+    client->enableAesGcm(aesGcm_);
+    client->enableResumption(resumption_);
 
     connect(client.get(), &core::PeerConnection::disconnectedFromPeer,
             this, [this](const std::shared_ptr<core::PeerConnection>& peer) {
         peers_.erase(peer->getConnectionId());
+        circuitFailures_.erase(peer->getConnectionId());
     }, Qt::QueuedConnection);
 
-    connection->setProxy(getTorProxy());
+    connection->setProxy(proxy_);
     connection->connectToDefaultHost();
 
-    peers_[connection->getUuid()] = client;
+    addPeer(client);
 
     return move(client);
 }
@@ -96,6 +128,43 @@ void TorServiceInterface::close(const QUuid &uuid)
     }
 }
 
+void TorServiceInterface::onRendezvousFailed(const QByteArray &host)
+{
+    if (!maxCircuitFailures_) {
+        return;
+    }
+
+    // Only attempts that are still waiting for Tor to connect
+    vector<Peer::ptr_t> failed;
+    for(const auto& it : peers_) {
+        const auto& peer = it.second;
+        if ((peer->getDirection() != core::PeerConnection::OUTGOING)
+                || peer->isSession()) {
+            continue;
+        }
+
+        const auto& socket = peer->getConnection();
+        if ((socket.getDefaultHost() != host)
+                || (socket.state() == QAbstractSocket::ConnectedState)) {
+            continue;
+        }
+
+        if (++circuitFailures_[it.first] >= maxCircuitFailures_) {
+            failed.push_back(peer);
+        }
+    }
+
+    for(const auto& peer : failed) {
+        LFLOG_DEBUG << "Giving up connection " << peer->getConnectionId().toString()
+                    << " to " << host << " after " << circuitFailures_[peer->getConnectionId()]
+                    << " failed circuits";
+
+        core::Metrics::instance().counter("prot.rendezvous.giveups").add();
+        circuitFailures_.erase(peer->getConnectionId());
+        peer->close();
+    }
+}
+
 ConnectionSocket &TorServiceInterface::getSocket(const QUuid &uuid)
 {
     if (auto peer = getPeer(uuid)) {
@@ -115,13 +184,152 @@ void TorServiceInterface::onNewIncomingConnection(
     cd.identitysCert = cert_;
     cd.service = identityId_;
     auto server = make_shared<DsServer>(connection, move(cd));
+    server->enableCompression(compression_);
+    server->enableAesGcm(aesGcm_);
+    server->enableResumption(resumption_);
+    QPointer<TorServiceInterface> self{this};
+    server->setCollisionHandler([self](const DsServer& incoming) {
+        return self && self->resolveCollision(incoming);
+    });
 
     connect(server.get(), &Peer::incomingPeer,
             this, [this](const std::shared_ptr<core::PeerConnection>& peer) {
         emit incomingPeer(peer);
     });
 
-    peers_[connection->getUuid()] = server;
+    // Forget the peer when the socket is closed, even if the peer has
+    // disabled its notifications. Else, half-open connections from
+    // scanners would accumulate here.
+    const auto uuid = connection->getUuid();
+    connect(connection.get(), &ConnectionSocket::disconnected,
+            this, [this, uuid]() {
+        peers_.erase(uuid);
+    }, Qt::QueuedConnection);
+
+    addPeer(server);
+}
+
+void TorServiceInterface::setMultiplexing(const bool enable)
+{
+    multiplexing_ = enable;
+    if (enable && server_ && server_->isListening()) {
+        Multiplexer::instance().addService(*this, *cert_);
+    } else if (!enable) {
+        Multiplexer::instance().removeService(*this, *cert_);
+    }
+}
+
+void TorServiceInterface::acceptSession(const Peer::ptr_t &transport,
+                                        const quint32 sessionId,
+                                        crypto::DsCert::ptr_t contactsCert,
+                                        const QByteArray &nonce)
+{
+    core::ConnectData cd;
+    cd.identitysCert = cert_;
+    cd.contactsCert = move(contactsCert);
+    cd.service = identityId_;
+
+    auto session = make_shared<MuxSession>(transport, move(cd),
+                                           core::PeerConnection::INCOMING,
+                                           sessionId, nonce);
+    session->enableCompression(compression_);
+    transport->attachSession(sessionId, session);
+
+    LFLOG_DEBUG << "Incoming session #" << sessionId
+                << " with id " << session->getConnectionId().toString()
+                << " over connection " << transport->getConnectionId().toString();
+
+    connect(session.get(), &core::PeerConnection::disconnectedFromPeer,
+            this, [this](const std::shared_ptr<core::PeerConnection>& peer) {
+        peers_.erase(peer->getConnectionId());
+    }, Qt::QueuedConnection);
+
+    addPeer(session);
+    emit incomingPeer(session);
+}
+
+void TorServiceInterface::addPeer(const Peer::ptr_t &peer)
+{
+    peers_[peer->getConnectionId()] = peer;
+    peer->setDeadlines(deadlines_, timeouts_);
+}
+
+/* Both peers connected to each other at about the same time.
+ *
+ * Both sides see the other's Hello, and use the same rule to pick the
+ * connection to keep, so the losing connection is dropped before any
+ * stream-encryption is set up for it, and before the owner is involved.
+ *
+ * Returns true if the incoming connection loses.
+ */
+bool TorServiceInterface::resolveCollision(const Peer& incoming)
+{
+    const auto contact = incoming.getPeerCert();
+    const auto pubkey = contact->getSigningPubKey().toByteArray();
+    const bool keepOutgoing = core::PeerConnection::preferredDirection(*cert_, *contact)
+            == core::PeerConnection::OUTGOING;
+    const auto now = chrono::steady_clock::now();
+
+    bool dropIncoming = false;
+    vector<Peer::ptr_t> losers;
+    for(const auto& it : peers_) {
+        const auto& peer = it.second;
+        if ((peer->getDirection() != core::PeerConnection::OUTGOING)
+                || (peer->getPeerCert()->getSigningPubKey().toByteArray() != pubkey)) {
+            continue;
+        }
+
+        switch(peer->getPhase()) {
+        case Peer::Phase::CONNECTING:
+            // We have not sent Hello yet, so the peer doesn't know about it.
+            losers.push_back(peer);
+            break;
+        case Peer::Phase::HANDSHAKE:
+            if (keepOutgoing) {
+                dropIncoming = true;
+            } else {
+                losers.push_back(peer);
+            }
+            break;
+        case Peer::Phase::ESTABLISHED:
+            // The peer may still be waiting for our Hello on the incoming
+            // connection. Older connections may be stale, and are left
+            // to the contact to resolve.
+            if (keepOutgoing && ((now - peer->getPhaseEntered()) < timeouts_.handshake)) {
+                dropIncoming = true;
+            }
+            break;
+        case Peer::Phase::AUTHORIZATION:
+        case Peer::Phase::CLOSED:
+            break;
+        }
+    }
+
+    if (dropIncoming) {
+        core::Metrics::instance().counter("prot.collisions.incoming").add();
+        return true;
+    }
+
+    for(const auto& peer : losers) {
+        LFLOG_DEBUG << "Closing outgoing connection " << peer->getConnectionId().toString()
+                    << " in favor of incoming connection " << incoming.getConnectionId().toString()
+                    << " from the same peer.";
+        core::Metrics::instance().counter("prot.collisions.outgoing").add();
+        peer->close();
+    }
+
+    return false;
+}
+
+core::TimerWheel::ptr_t TorServiceInterface::getDeadlines()
+{
+    static weak_ptr<core::TimerWheel> shared;
+    auto wheel = shared.lock();
+    if (!wheel) {
+        wheel = make_shared<core::TimerWheel>();
+        shared = wheel;
+    }
+    return wheel;
 }
 
 void TorServiceInterface::autorizeConnection(const QUuid &connection, const bool allow)
@@ -136,8 +344,7 @@ void TorServiceInterface::autorizeConnection(const QUuid &connection, const bool
 
 QNetworkProxy &TorServiceInterface::getTorProxy()
 {
-    // TODO: Get the actual host/port used by our tor server,
-    //       preferably from the control connection.
+    // Default. TorProtocolManager sets the port tor reports.
     static QNetworkProxy proxy{QNetworkProxy::Socks5Proxy,
                 "127.0.0.1", 9050};
 
@@ -98,13 +98,14 @@ Page {
 
                     GridLayout {
                         rowSpacing: 0
-                        rows: 5
+                        rows: 6
                         flow: GridLayout.TopToBottom
                         Label { font.pointSize: 9; text: qsTr("Nick")}
                         Label { font.pointSize: 9; text: qsTr("Last seen")}
                         Label { font.pointSize: 9; text: qsTr("Handle")}
                         Label { font.pointSize: 9; text: qsTr("Address")}
                         Label { font.pointSize: 9; text: qsTr("Status")}
+                        Label { font.pointSize: 9; text: qsTr("Latency")}
 
                         Text {
                             font.pointSize: 9;
@@ -168,6 +169,12 @@ Page {
                                       : ""
                             }
                         }
+
+                        Text {
+                            font.pointSize: 9;
+                            color: "skyblue"
+                            text: cco && cco.rtt >= 0 ? qsTr("%1 ms").arg(cco.rtt) : qsTr("Unknown")
+                        }
                     }
                 }
             }
@@ -82,6 +82,29 @@ Dialog {
             }
         }
 
+        RowLayout {
+            spacing: 4
+            visible: contact !== null
+
+            Label { font.pointSize: 9; text: qsTr("KB/s up")}
+            SpinBox {
+                id: uploadLimit
+                minimumValue: 0
+                maximumValue: 1024 * 1024
+                value: contact ? Math.round(contact.uploadRateLimit / 1024) : 0
+            }
+
+            Label { font.pointSize: 9; text: qsTr("down")}
+            SpinBox {
+                id: downloadLimit
+                minimumValue: 0
+                maximumValue: 1024 * 1024
+                value: contact ? Math.round(contact.downloadRateLimit / 1024) : 0
+            }
+
+            Label { font.pointSize: 9; text: qsTr("(0 = unlimited)")}
+        }
+
         Label { font.pointSize: 9; text: qsTr("Notes")}
 
         TextArea {
@@ -101,6 +124,14 @@ Dialog {
             contact.addMeMessage = addmeMessage.text
             contact.autoConnect = autoConnect.checked
             contact.notes = notes.text
+
+            // Only save the limits if they were changed
+            if (uploadLimit.value !== Math.round(contact.uploadRateLimit / 1024)) {
+                contact.uploadRateLimit = uploadLimit.value * 1024
+            }
+            if (downloadLimit.value !== Math.round(contact.downloadRateLimit / 1024)) {
+                contact.downloadRateLimit = downloadLimit.value * 1024
+            }
         } else {
             const args = {
                 "identity" : identity.id,
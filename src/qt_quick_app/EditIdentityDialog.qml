@@ -110,6 +110,29 @@ Dialog {
             }
         }
 
+        RowLayout {
+            spacing: 4
+            visible: identity !== null
+
+            Label { font.pointSize: 9; text: qsTr("KB/s up")}
+            SpinBox {
+                id: uploadLimit
+                minimumValue: 0
+                maximumValue: 1024 * 1024
+                value: identity ? Math.round(identity.uploadRateLimit / 1024) : 0
+            }
+
+            Label { font.pointSize: 9; text: qsTr("down")}
+            SpinBox {
+                id: downloadLimit
+                minimumValue: 0
+                maximumValue: 1024 * 1024
+                value: identity ? Math.round(identity.downloadRateLimit / 1024) : 0
+            }
+
+            Label { font.pointSize: 9; text: qsTr("(0 = unlimited)")}
+        }
+
         Label { font.pointSize: 9; text: qsTr("Notes")}
 
         TextArea {
@@ -132,6 +155,14 @@ Dialog {
             identity.notes = value.notes
             identity.autoConnect = value.autoConnect
             identity.avatar = value.avatar
+
+            // Only save the limits if they were changed
+            if (uploadLimit.value !== Math.round(identity.uploadRateLimit / 1024)) {
+                identity.uploadRateLimit = uploadLimit.value * 1024
+            }
+            if (downloadLimit.value !== Math.round(identity.downloadRateLimit / 1024)) {
+                identity.downloadRateLimit = downloadLimit.value * 1024
+            }
         } else {
             // Add a new identity
             identities.createIdentity(value)
@@ -110,6 +110,10 @@ int main(int argc, char *argv[])
                                                    "FilesModel",
                                                    "Cannot create FilesModel in QML");
 
+    qmlRegisterUncreatableType<ds::models::MetricsModel>("com.jgaa.darkspeak", 1, 0,
+                                                   "MetricsModel",
+                                                   "MetricsModel is a global sigeleton.");
+
 
     qmlRegisterType<ds::core::QmlIdentityReq>("com.jgaa.darkspeak", 1, 0, "QmlIdentityReq");
 
@@ -123,6 +127,7 @@ int main(int argc, char *argv[])
     engine.rootContext()->setContextProperty("conversations", manager->conversationsModel());
     engine.rootContext()->setContextProperty("messages", manager->messagesModel());
     engine.rootContext()->setContextProperty("files", manager->filesModel());
+    engine.rootContext()->setContextProperty("metrics", manager->metricsModel());
 
     ImageProvider tmpProvider{"temp", [&manager](const QString& id) {
             Q_UNUSED(id)
@@ -28,6 +28,15 @@ struct TorConfig {
     uint16_t service_to_port = 29999;
     QHostAddress app_host = QHostAddress::LocalHost;
     //uint16_t app_port = 29998;
+
+    // SOCKS proxy. Replaced by the port tor reports on the control connection.
+    QHostAddress socks_host = QHostAddress::LocalHost;
+    uint16_t socks_port = 9050;
+
+    // PRIVATE mode
+    QString tor_binary = "tor";
+    QString data_dir; // DataDirectory. Keeps the consensus and guards between runs.
+    int start_timeout_ms = 30000; // Until tor listens on the control port
 };
 
 }} // namespaces
@@ -4,8 +4,11 @@
 #include <memory>
 #include <random>
 
+#include <QSet>
+
 #include "ds/torconfig.h"
 #include "ds/torctlsocket.h"
+#include "ds/torevents.h"
 #include "ds/serviceproperties.h"
 
 namespace ds {
@@ -80,6 +83,13 @@ public:
 
     }
 
+    // False if Tor reports that it can't build circuits, or the network is down
+    bool isNetworkUp() const noexcept { return network_up_; }
+
+    // Get the first TCP listener from a "GETINFO net/listeners/socks" reply
+    static bool parseSocksListener(const TorCtlReply& reply, QHostAddress& host,
+                                   quint16& port);
+
 signals:
     void torStateUpdate(TorState state, int progress, const QString& summary);
     void stateUpdate(CtlState state);
@@ -96,6 +106,23 @@ signals:
     // Emitted when the tor service has been shut down.
     void stopped();
 
+    // Typed events from Tor, that we subscribe to when we are authenticated.
+    void statusClient(const StatusClientEvent& event);
+    void hsDescriptor(const HsDescEvent& event);
+    void circuit(const CircEvent& event);
+
+    // Tor lost or regained its ability to build circuits
+    void networkChanged(const bool up);
+
+    // The first descriptor for a service was uploaded to a HSDir
+    void servicePublished(const QUuid& service);
+
+    // A circuit to a hidden service we connect to failed
+    void rendezvousFailed(const QByteArray& host, const QByteArray& reason);
+
+    // The SOCKS port Tor listens to, as reported on the control connection
+    void socksPortReady(const QHostAddress& host, const quint16 port);
+
 public slots:
     void start(); // Connect to Tor server
     void stop(); // Disconnect from Tor server
@@ -143,12 +170,21 @@ protected:
     void DoAuthentcate(const TorCtlReply& reply);
     void Authenticate(const QByteArray& data);
     void OnAuthReply(const TorCtlReply& reply);
+    void Subscribe();
+    void QuerySocksPort();
+    void OnBootstrap(const int progress, const QString& summary);
+    void OnStatusClient(const StatusClientEvent& event);
+    void OnHsDesc(const HsDescEvent& event);
+    void OnCirc(const CircEvent& event);
+    void setNetwork(const bool up);
     QByteArray GetCookie(const QString& path);
     QByteArray ComputeHmac(const QByteArray& key, const QByteArray& serverNonce);
 
 private:
     CtlState ctl_state_ = CtlState::DISCONNECTED;
     TorState tor_state_ = TorState::UNKNOWN;
+    int tor_progress_ = -1;
+    bool network_up_ = true;
     std::unique_ptr<TorCtlSocket> ctl_;
     TorConfig config_;
     QByteArray client_nonce_;
@@ -157,6 +193,7 @@ private:
     static const QByteArray tor_safe_clientkey_;
     std::mt19937 rnd_eng_;
     QMap<QUuid, QByteArray> service_map_;
+    QSet<QUuid> published_;
 };
 
 }} // namespaces
@@ -4,7 +4,6 @@
 #include <functional>
 #include <deque>
 //#include <map>
-#include <locale>
 #include <string.h>
 #include <algorithm>
 #include <QQueue>
@@ -14,18 +13,6 @@
 namespace ds {
 namespace tor {
 
-template<typename T>
-QString toKey(const T& key) {
-    QString rval;
-
-    std::locale loc;
-    for(const auto ch : key) {
-        rval += std::toupper(ch);
-    }
-
-    return rval;
-}
-
 struct TorCtlReply {
     std::deque<std::string> lines;
     int status = {};
@@ -45,6 +32,10 @@ struct TorCtlReply {
     // Try to parse a line into a key/value map. Return false if this is not a key/value set
     bool parse(const std::string& data, map_t& kv) const;
 
+    // Same, for a part of a line
+    static bool parse(std::string::const_iterator it,
+                      const std::string::const_iterator end, map_t& kv);
+
     // Unescape escaped (double quoted) section(s) of a string
     static std::string unescape(const std::string& escaped);
 
@@ -106,9 +97,12 @@ private:
     QQueue<handler_t> pending_;
     constexpr static size_t max_buffer_len_ = 1024 * 5;
     constexpr static size_t max_reply_lines_ = 32;
-    constexpr static int max_data_in_one_reply_line_ = 1024 * 16;
+
+    // Replies like GETINFO ns/all are several megabytes
+    constexpr static size_t max_data_bytes_ = 1024 * 1024 * 16;
     TorCtlReply current_reply_;
     State state_ = State::READY;
+    size_t data_lines_ = {};
 };
 
 }} // namespaces
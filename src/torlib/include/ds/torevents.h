@@ -0,0 +1,93 @@
+#ifndef TOREVENTS_H
+#define TOREVENTS_H
+
+#include <QByteArray>
+#include <QList>
+#include <QMap>
+
+#include "ds/torctlsocket.h"
+
+namespace ds {
+namespace tor {
+
+/*! An asynchronous event from Tor (650 reply), split into arguments
+ *
+ * "650 HS_DESC UPLOADED abc UNKNOWN $FP~nick REASON=X" gives the name
+ * "HS_DESC", the positional arguments "UPLOADED", "abc", "UNKNOWN" and
+ * "$FP~nick", and REASON=X. Quoted values are unescaped.
+ */
+struct TorEvent {
+    using kv_t = QMap<QByteArray, QByteArray>;
+
+    QByteArray name;
+    QList<QByteArray> args;
+    kv_t kv;
+
+    // Parse the first line of the event. Throws TorCtlReply::ParseError.
+    static TorEvent parse(const TorCtlReply& reply);
+
+    QByteArray arg(const int index) const { return args.value(index); }
+    QByteArray value(const QByteArray& key) const { return kv.value(key); }
+};
+
+/*! STATUS_CLIENT
+ *
+ * The actions we care about are BOOTSTRAP, CIRCUIT_ESTABLISHED
+ * and CIRCUIT_NOT_ESTABLISHED.
+ */
+struct StatusClientEvent {
+    StatusClientEvent() = default;
+    explicit StatusClientEvent(const TorEvent& ev);
+
+    QByteArray severity; // NOTICE, WARN or ERR
+    QByteArray action;
+    TorEvent::kv_t kv;
+};
+
+/*! NETWORK_LIVENESS (UP or DOWN) */
+struct NetworkLivenessEvent {
+    NetworkLivenessEvent() = default;
+    explicit NetworkLivenessEvent(const TorEvent& ev);
+
+    bool up = false;
+};
+
+/*! HS_DESC
+ *
+ * Reports the uploads of our own descriptors, and the fetches
+ * of the descriptors of the services we connect to.
+ */
+struct HsDescEvent {
+    HsDescEvent() = default;
+    explicit HsDescEvent(const TorEvent& ev);
+
+    QByteArray action; // REQUESTED, UPLOAD, RECEIVED, UPLOADED, IGNORE, FAILED, CREATED
+    QByteArray address; // Onion address, without ".onion"
+    QByteArray authType;
+    QByteArray hsDir;
+    QByteArray reason;
+};
+
+/*! CIRC */
+struct CircEvent {
+    CircEvent() = default;
+    explicit CircEvent(const TorEvent& ev);
+
+    QByteArray id;
+    QByteArray status; // LAUNCHED, BUILT, GUARD_WAIT, EXTENDED, FAILED or CLOSED
+    QByteArray purpose;
+    QByteArray hsState;
+    QByteArray rendQuery; // Onion address, without ".onion"
+    QByteArray reason;
+
+    // A failed circuit to a hidden service we connect to
+    bool isFailedClientCircuit() const;
+};
+
+}} // namespaces
+
+Q_DECLARE_METATYPE(ds::tor::StatusClientEvent)
+Q_DECLARE_METATYPE(ds::tor::HsDescEvent)
+Q_DECLARE_METATYPE(ds::tor::CircEvent)
+
+#endif // TOREVENTS_H
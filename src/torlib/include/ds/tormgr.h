@@ -3,10 +3,12 @@
 
 #include <memory>
 
+#include <QElapsedTimer>
 #include <QObject>
 
 #include "ds/torconfig.h"
 #include "ds/torcontroller.h"
+#include "ds/torprocess.h"
 
 namespace ds {
 namespace tor {
@@ -25,9 +27,18 @@ public:
         explicit OfflineError(const QString& what) : std::runtime_error(what.toStdString()) {}
     };
 
+    /*! Milliseconds from start() until each phase was reached. -1 if not reached. */
+    struct StartupTimings {
+        qint64 process = -1; // Our own tor listens on the control port (PRIVATE mode)
+        qint64 connected = -1; // Connected to the control port
+        qint64 authenticated = -1;
+        qint64 online = -1; // Tor has bootstrapped
+    };
+
     explicit TorMgr(const TorConfig& config);
 
     TorController *getController();
+    const StartupTimings& getStartupTimings() const noexcept { return timings_; }
 
 signals:
     // Connected to the Tor control channel
@@ -51,6 +62,16 @@ signals:
     void serviceStopped(const QUuid& service);
     void torStateUpdate(TorController::TorState state, int progress, const QString& summary);
     void stateUpdate(TorController::CtlState state);
+    void networkChanged(const bool up);
+    void socksPortReady(const QHostAddress& host, const quint16 port);
+
+    // Tor is online. All the timings are set, except process in SYSTEM mode.
+    void startupComplete(const StartupTimings& timings);
+
+    // We failed to start our own tor
+    void startFailed(const QString& reason);
+    void servicePublished(const QUuid& service);
+    void rendezvousFailed(const QByteArray& host, const QByteArray& reason);
 
 public slots:
     /*! Start / connect to the Tor service */
@@ -105,9 +126,14 @@ private slots:
 
 private:
     void startUseSystemInstance();
+    void startPrivateInstance();
+    qint64 elapsed() const { return startTimer_.elapsed(); }
 
     TorConfig config_;
     std::shared_ptr<TorController> ctl_;
+    std::unique_ptr<TorProcess> process_;
+    QElapsedTimer startTimer_;
+    StartupTimings timings_;
 };
 
 }} // namespaces
@@ -0,0 +1,96 @@
+#ifndef TORPROCESS_H
+#define TORPROCESS_H
+
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include <QObject>
+#include <QProcess>
+#include <QTimer>
+
+#include "ds/torconfig.h"
+
+namespace ds {
+namespace tor {
+
+/*! Runs our own instance of the tor server
+ *
+ * Used in TorConfig::Mode::PRIVATE. Tor gets a private DataDirectory,
+ * where it keeps the consensus, descriptors and guards between runs,
+ * so only the first start has to download everything.
+ *
+ * Tor picks free control and SOCKS ports, and writes the control
+ * port to a file in the DataDirectory, which we poll until it shows
+ * up. The SOCKS port is then queried over the control connection.
+ *
+ * Tor exits if our process dies, and when the control connection
+ * closes after the controller has sent TAKEOWNERSHIP.
+ *
+ * Settings that are not on the command line can be put in a "torrc"
+ * file in the DataDirectory.
+ */
+class TorProcess : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct StartError : public std::runtime_error
+    {
+        explicit StartError(const char *what) : std::runtime_error(what) {}
+        explicit StartError(const QString& what) : std::runtime_error(what.toStdString()) {}
+    };
+
+    explicit TorProcess(const TorConfig& config);
+    ~TorProcess() override;
+
+    /*! Start tor
+     *
+     * \exception StartError if the DataDirectory can not be created.
+     *
+     * Signals:
+     *  - controlPortReady when tor accepts control connections
+     *  - failed if tor did not start, or exited before it was ready
+     */
+    void start();
+
+    // Ask tor to exit. Kills it if it takes too long.
+    void stop();
+
+    bool isRunning() const;
+
+    QStringList getArguments() const;
+    QString getControlPortFile() const;
+
+    // Milliseconds since start()
+    qint64 getElapsed() const { return elapsed_.isValid() ? elapsed_.elapsed() : -1; }
+
+    // Parse the ControlPortWriteToFile format, "PORT=127.0.0.1:9151" or "PORT=[::1]:9151"
+    static bool parseControlPort(const QByteArray& data, QHostAddress& host,
+                                 quint16& port);
+
+signals:
+    void controlPortReady(const QHostAddress& host, const quint16 port);
+    void failed(const QString& reason);
+    void stopped();
+
+private slots:
+    void checkControlPortFile();
+    void onReadyRead();
+    void onFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    void onError(QProcess::ProcessError error);
+
+private:
+    void fail(const QString& reason);
+
+    TorConfig config_;
+    QProcess process_;
+    QTimer poll_;
+    QElapsedTimer elapsed_;
+    bool ready_ = false;
+    bool failed_ = false;
+    constexpr static int poll_interval_ms_ = 25;
+    constexpr static int kill_timeout_ms_ = 5000;
+};
+
+}} // namespaces
+
+#endif // TORPROCESS_H
@@ -1,6 +1,7 @@
 
 #include <QFile>
 #include <QFileInfo>
+#include <algorithm>
 #include <cassert>
 
 #include "include/ds/torcontroller.h"
@@ -25,6 +26,9 @@ TorController::TorController(const TorConfig &config)
         registered = true;
         qRegisterMetaType<ds::tor::ServiceProperties>("ServiceProperties");
         qRegisterMetaType<ds::tor::ServiceProperties>("::ds::tor::ServiceProperties");
+        qRegisterMetaType<ds::tor::StatusClientEvent>("StatusClientEvent");
+        qRegisterMetaType<ds::tor::HsDescEvent>("HsDescEvent");
+        qRegisterMetaType<ds::tor::CircEvent>("CircEvent");
     }
 }
 
@@ -84,6 +88,7 @@ void TorController::createService(const QUuid& serviceId)
             assert(!service.uuid.isNull());
 
             service_map_[service.uuid ] = service.service_id;
+            published_.remove(service.uuid);
 
             LFLOG_DEBUG << "Created Tor hidden service: " << service.service_id
                      << " with id " << service.uuid.toString();
@@ -115,6 +120,7 @@ void TorController::startService(const ServiceProperties &sp)
                 .toLocal8Bit();
 
     service_map_[sp.uuid] = sp.service_id;
+    published_.remove(sp.uuid);
     const auto uuid = sp.uuid;
     const auto service_id = sp.service_id;
 
@@ -148,6 +154,8 @@ void TorController::stopService(const QUuid& service)
             LFLOG_DEBUG << "Stopped Tor hidden service: " << service_id
                      << " with id " << service.toString();
 
+            published_.remove(service);
+
             emit serviceStopped(service);
         } else {
             auto msg = std::to_string(reply.status) + ' ' + reply.lines.front();
@@ -190,12 +198,97 @@ void TorController::clear()
     LFLOG_DEBUG << "Torctl connection was closed";
     setState(CtlState::STOPPED);
     setState(TorState::UNKNOWN);
+    published_.clear();
+    network_up_ = true;
     emit stopped();
 }
 
 void TorController::torEvent(const TorCtlReply &reply)
 {
     LFLOG_DEBUG << "Received tor event: " << reply.lines.front().c_str();
+
+    try {
+        const auto event = TorEvent::parse(reply);
+
+        if (event.name == "STATUS_CLIENT") {
+            OnStatusClient(StatusClientEvent{event});
+        } else if (event.name == "NETWORK_LIVENESS") {
+            setNetwork(NetworkLivenessEvent{event}.up);
+        } else if (event.name == "HS_DESC") {
+            OnHsDesc(HsDescEvent{event});
+        } else if (event.name == "CIRC") {
+            OnCirc(CircEvent{event});
+        }
+    } catch(const TorCtlReply::ParseError& ex) {
+        LFLOG_WARN << "Failed to parse tor event: " << ex.what();
+    }
+}
+
+void TorController::OnStatusClient(const StatusClientEvent &event)
+{
+    emit statusClient(event);
+
+    if (event.action == "BOOTSTRAP") {
+        OnBootstrap(event.kv.value("PROGRESS").toInt(),
+                    QString::fromUtf8(event.kv.value("SUMMARY")));
+    } else if (event.action == "CIRCUIT_ESTABLISHED") {
+        setNetwork(true);
+    } else if (event.action == "CIRCUIT_NOT_ESTABLISHED") {
+        setNetwork(false);
+    }
+}
+
+void TorController::OnHsDesc(const HsDescEvent &event)
+{
+    emit hsDescriptor(event);
+
+    // Tor uploads each descriptor to several HSDirs. The first one
+    // makes the service reachable.
+    if (event.action == "UPLOADED") {
+        const auto service = service_map_.key(event.address);
+        if (!service.isNull() && !published_.contains(service)) {
+            published_.insert(service);
+
+            LFLOG_DEBUG << "Published the descriptor for Tor hidden service: "
+                        << event.address << " with id " << service.toString();
+
+            emit servicePublished(service);
+        }
+    }
+}
+
+void TorController::OnCirc(const CircEvent &event)
+{
+    emit circuit(event);
+
+    if (event.isFailedClientCircuit()) {
+        LFLOG_DEBUG << "Circuit " << event.id << " to " << event.rendQuery
+                    << ".onion failed: " << event.reason;
+
+        emit rendezvousFailed(event.rendQuery + ".onion", event.reason);
+    }
+}
+
+void TorController::OnBootstrap(const int progress, const QString &summary)
+{
+    setState(progress == 100 ? TorState::READY : TorState::INITIALIZING,
+             progress, summary);
+
+    if ((progress == 100) && (ctl_state_ == CtlState::CONNECTED)) {
+        setState(CtlState::ONLINE);
+        emit ready();
+    }
+}
+
+void TorController::setNetwork(const bool up)
+{
+    if (network_up_ != up) {
+        network_up_ = up;
+
+        LFLOG_NOTICE << "Tor reports that the network is " << (up ? "up" : "down");
+
+        emit networkChanged(up);
+    }
 }
 
 void TorController::setState(TorController::CtlState state)
@@ -209,9 +302,12 @@ void TorController::setState(TorController::CtlState state)
 void TorController::setState(TorController::TorState state,
                              int progress, const QString& summary)
 {
-    if (tor_state_!= state) {
+    const bool changed = (tor_state_ != state);
+
+    // Bootstrap events report the progress within a state
+    if (changed || ((progress >= 0) && (progress != tor_progress_))) {
 
-        if (tor_state_ == TorState::READY) {
+        if (changed && (tor_state_ == TorState::READY)) {
             auto keys = service_map_.keys();
             for(const auto& k : keys) {
                 emit serviceStopped(k);
@@ -219,6 +315,7 @@ void TorController::setState(TorController::TorState state,
         }
 
         tor_state_ = state;
+        tor_progress_ = progress;
         emit torStateUpdate(tor_state_, progress, summary);
     }
 }
@@ -301,19 +398,23 @@ void TorController::OnAuthReply(const TorCtlReply &reply)
     if (reply.status == 250) {
         setState(CtlState::CONNECTED);
         emit autenticated();
-        ctl_->sendCommand("SETEVENTS STATUS_CLIENT", {});
+
+        // Our own instance exits when we close the control connection
+        if (config_.mode == TorConfig::Mode::PRIVATE) {
+            ctl_->sendCommand("TAKEOWNERSHIP", {});
+        }
+
+        Subscribe();
+        QuerySocksPort();
+
+        // The current state. Changes come as STATUS_CLIENT events.
         ctl_->sendCommand("GETINFO status/bootstrap-phase", [this](const TorCtlReply& reply) {
             if (reply.status == 250) {
                 auto map = reply.parse();
                 const auto summary = map.value("BOOTSTRAP").toMap().value("SUMMARY").toString();
                 const auto progress = map.value("BOOTSTRAP").toMap().value("PROGRESS").toInt();
 
-                setState(progress == 100 ? TorState::READY : TorState::INITIALIZING,
-                         progress, summary);
-                if (progress == 100) {
-                    setState(CtlState::ONLINE);
-                    emit ready();
-                }
+                OnBootstrap(progress, summary);
             } else {
                 throw TorError("tor command: 'SETEVENTS EXTENDED STATUS_CLIENT failed'");
             }
@@ -327,6 +428,90 @@ void TorController::OnAuthReply(const TorCtlReply &reply)
     }
 }
 
+void TorController::Subscribe()
+{
+    // Tor refuses the whole command if it does not know one of the
+    // events (NETWORK_LIVENESS came in 0.2.7.2).
+    ctl_->sendCommand("SETEVENTS STATUS_CLIENT NETWORK_LIVENESS HS_DESC CIRC",
+                      [this](const TorCtlReply& reply) {
+        if (reply.status != 250) {
+            LFLOG_WARN << "Tor refused our events with status " << reply.status
+                       << ". Subscribing without NETWORK_LIVENESS.";
+            ctl_->sendCommand("SETEVENTS STATUS_CLIENT HS_DESC CIRC", {});
+        }
+    });
+}
+
+void TorController::QuerySocksPort()
+{
+    ctl_->sendCommand("GETINFO net/listeners/socks", [this](const TorCtlReply& reply) {
+        QHostAddress host;
+        quint16 port = {};
+        if ((reply.status == 250) && parseSocksListener(reply, host, port)) {
+            LFLOG_DEBUG << "Tor is listening on SOCKS port " << host.toString() << ":" << port;
+            emit socksPortReady(host, port);
+        } else {
+            LFLOG_WARN << "Failed to get the SOCKS port from tor. Using "
+                       << config_.socks_host.toString() << ":" << config_.socks_port;
+        }
+    });
+}
+
+bool TorController::parseSocksListener(const TorCtlReply &reply,
+                                       QHostAddress &host, quint16 &port)
+{
+    // net/listeners/socks="127.0.0.1:9050" "[::1]:9050" "unix:/path"
+    if (reply.lines.empty()) {
+        return false;
+    }
+
+    const auto& line = reply.lines.front();
+    const auto eq = line.find('=');
+    if (eq == std::string::npos) {
+        return false;
+    }
+
+    const auto end = line.cend();
+    for(auto it = line.cbegin() + static_cast<std::string::difference_type>(eq + 1); it != end;) {
+        if (*it == ' ') {
+            ++it;
+            continue;
+        }
+
+        std::string listener;
+        if (*it == '"') {
+            size_t used = 0;
+            listener = TorCtlReply::unescape(it, end, &used);
+            it += static_cast<std::string::difference_type>(used);
+        } else {
+            const auto next = std::find(it, end, ' ');
+            listener.assign(it, next);
+            it = next;
+        }
+
+        const auto colon = listener.rfind(':');
+        if ((colon == std::string::npos) || (listener.compare(0, 5, "unix:") == 0)) {
+            continue;
+        }
+
+        auto address = QString::fromStdString(listener.substr(0, colon));
+        if (address.startsWith('[') && address.endsWith(']')) {
+            address = address.mid(1, address.size() - 2);
+        }
+
+        bool ok = false;
+        const auto p = QString::fromStdString(listener.substr(colon + 1)).toUShort(&ok);
+        const QHostAddress h{address};
+        if (ok && p && !h.isNull()) {
+            host = h;
+            port = p;
+            return true;
+        }
+    }
+
+    return false;
+}
+
 QByteArray TorController::GetCookie(const QString &path)
 {
     const auto size = QFileInfo(path).size();
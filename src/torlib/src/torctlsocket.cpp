@@ -1,7 +1,7 @@
 
-#include <regex>
+#include <algorithm>
 #include <cassert>
-#include <locale>
+#include <cctype>
 
 #include <QString>
 
@@ -11,6 +11,54 @@
 namespace ds {
 namespace tor {
 
+using namespace std;
+
+namespace {
+
+using cit_t = string::const_iterator;
+
+bool isWordChar(const char ch) noexcept
+{
+    return isalnum(static_cast<unsigned char>(ch)) || (ch == '_');
+}
+
+bool isPathChar(const char ch) noexcept
+{
+    return isWordChar(ch) || (ch == '-') || (ch == '/');
+}
+
+bool isBlank(const char ch) noexcept
+{
+    return (ch == ' ') || (ch == '\t');
+}
+
+bool isLineBreak(const char ch) noexcept
+{
+    return (ch == '\r') || (ch == '\n');
+}
+
+template <typename Fn>
+cit_t skipWhile(cit_t it, const cit_t end, const Fn& fn)
+{
+    while((it != end) && fn(*it)) {
+        ++it;
+    }
+    return it;
+}
+
+// Upper-case ASCII key
+QString toKey(cit_t it, const cit_t end)
+{
+    QString key;
+    key.reserve(static_cast<int>(end - it));
+    for(; it != end; ++it) {
+        key += QLatin1Char(static_cast<char>(toupper(static_cast<unsigned char>(*it))));
+    }
+    return key;
+}
+
+} // anonymous namespace
+
 
 TorCtlSocket::TorCtlSocket()
 {
@@ -55,6 +103,28 @@ void TorCtlSocket::processIn()
 
         line.chop(2);
 
+        // Data lines are raw, until a line with a single period.
+        // Lines starting with a period have an extra period added.
+        if (state_ == State::IN_DATA) {
+            if (line == ".") {
+                state_ = State::IN_REPLY;
+                continue;
+            }
+
+            const int skip = line.startsWith('.') ? 1 : 0;
+            auto& data = current_reply_.lines.back();
+            if ((data.size() + static_cast<size_t>(line.size())) > max_data_bytes_) {
+                setError(QStringLiteral("Invalid control reply syntax: Too verbose."));
+                return;
+            }
+
+            if (data_lines_++) {
+                data += '\n';
+            }
+            data.append(line.constData() + skip, static_cast<size_t>(line.size() - skip));
+            continue;
+        }
+
         if (line.size() < 4) {
             setError(QStringLiteral("Invalid control reply syntax: Too short."));
             return;
@@ -74,20 +144,6 @@ void TorCtlSocket::processIn()
             current_reply_.status = line.left(3).toInt();
         }
 
-        if (state_ == State::IN_DATA) {
-            if (line == ".") {
-                state_ = State::IN_REPLY;
-            } else {
-                current_reply_.lines.back() += line.mid(4).toStdString();
-                if (current_reply_.lines.back().size()
-                        > max_data_in_one_reply_line_) {
-                    setError(QStringLiteral("Invalid control reply syntax: Too verbose."));
-                    return;
-                }
-            }
-            continue;
-        }
-
         assert(state_ == State::IN_REPLY);
 
         if (current_reply_.lines.size() > max_reply_lines_) {
@@ -95,10 +151,12 @@ void TorCtlSocket::processIn()
             return;
         }
 
-        current_reply_.lines.push_back(line.mid(4).toStdString());
+        current_reply_.lines.emplace_back(line.constData() + 4,
+                                          static_cast<size_t>(line.size() - 4));
 
         if (line_type == '+') {
             state_ = State::IN_DATA;
+            data_lines_ = 0;
             continue;
         }
 
@@ -158,32 +216,46 @@ void TorCtlSocket::setError(const QString& errorMsg)
 
 TorCtlReply::map_t TorCtlReply::parse() const
 {
-    static const std::regex line_breakup(R"(^(([\w][\w\-\/]+)(=(\w+)) )?(\w+)( (.*))?$)");
     map_t rval;
 
     for(const auto& line: lines) {
-        // Get the first word
-        std::smatch m;
-        if (std::regex_match(line, m, line_breakup)) {
-            assert(m.size() == 8);
-            const std::string level = m[4].str();
-            const std::string key = m[5].str();
-            const std::string value = m[7].str();
-
-            map_t kv;
-
-            if (!level.empty()) {
-                rval[toKey(m[2].str())] = level.c_str();
+        // The normal form is "[path=LEVEL ]KEYWORD[ value]".
+        // Anything else is parsed as key=value pairs.
+        const auto begin = line.cbegin();
+        const auto end = line.cend();
+        auto it = begin;
+
+        const auto pathEnd = skipWhile(begin, end, isPathChar);
+        const bool leveled = (begin != end) && isWordChar(*begin)
+                && ((pathEnd - begin) >= 2) && (pathEnd != end) && (*pathEnd == '=');
+        auto levelEnd = pathEnd;
+        if (leveled) {
+            levelEnd = skipWhile(pathEnd + 1, end, isWordChar);
+            if ((levelEnd != (pathEnd + 1)) && (levelEnd != end) && (*levelEnd == ' ')) {
+                it = levelEnd + 1;
             }
+        }
 
-            if (parse(value, kv)) {
-                rval[toKey(key)] = QVariant(kv);
-            } else {
-                auto escaped_value = unescape(value);
-                rval[toKey(key)] = QString(escaped_value.c_str());
-            }
+        const auto keyEnd = skipWhile(it, end, isWordChar);
+        const bool keyword = (keyEnd != it)
+                && ((keyEnd == end)
+                    || ((*keyEnd == ' ') && (find_if(keyEnd, end, isLineBreak) == end)));
+
+        if (!keyword) {
+            parse(begin, end, rval);
+            continue;
+        }
+
+        if (it != begin) {
+            rval[toKey(begin, pathEnd)] = QString::fromStdString({pathEnd + 1, levelEnd});
+        }
+
+        const auto valueBegin = (keyEnd == end) ? end : keyEnd + 1;
+        map_t kv;
+        if (parse(valueBegin, end, kv)) {
+            rval[toKey(it, keyEnd)] = QVariant(kv);
         } else {
-            parse(line, rval);
+            rval[toKey(it, keyEnd)] = QString::fromStdString(unescape(valueBegin, end));
         }
     }
 
@@ -192,68 +264,60 @@ TorCtlReply::map_t TorCtlReply::parse() const
 
 bool TorCtlReply::parse(const std::string &data, TorCtlReply::map_t &kv) const
 {
-    std::locale loc;
-    enum class State {
-        SCANNING,
-        KEY,
-        VALUE
-    };
-
-    State state = State::SCANNING;
-    QByteArray key;
-    QByteArray value;
-
-    for(auto it = data.begin(); it != data.end(); ++it) {
-        if (state == State::SCANNING) {
-            if (*it == ' ' || *it == '\t') {
-                continue; // Skip whitespace
-            }
+    return parse(data.cbegin(), data.cend(), kv);
+}
 
-            if (std::isalpha(*it, loc)) {
-                state = State::KEY;
-                assert(key.isEmpty());
-                assert(value.isEmpty());
-            } else {
-                return false; // Not a strict key=value ... input
-            }
+bool TorCtlReply::parse(string::const_iterator it, const string::const_iterator end,
+                        TorCtlReply::map_t &kv)
+{
+    while(it != end) {
+        if (isBlank(*it)) {
+            ++it;
+            continue;
         }
 
-        if (state == State::KEY) {
-            if (*it == '=') {
-                state = State::VALUE;
-                continue;
-            }
+        if (!isalpha(static_cast<unsigned char>(*it))) {
+            return false; // Not a strict key=value ... input
+        }
 
-            key += *it;
+        // The key is everything up to the '='. A key without it ends the data.
+        const auto keyBegin = it;
+        const auto keyEnd = find(it, end, '=');
+        if (keyEnd == end) {
+            kv[toKey(keyBegin, end)] = QByteArray{};
+            break;
         }
 
-        if (state == State::VALUE) {
+        it = keyEnd + 1;
+        if (it == end) {
+            break;
+        }
+
+        QByteArray value;
+        while(it != end) {
             if (*it == '\"') {
+                // We assume that a key="..." only contain the quoted value
                 size_t used = 0;
-                auto escaped = unescape(it, data.end(), &used);
-                value += escaped.c_str();
+                const auto unescaped = unescape(it, end, &used);
                 assert(used > 0);
-
-                // we want to wrap past doublequote in the loop, not here
-                it += static_cast<int>(used) - 1;
-
-                // We assume that a key="..." only contain the quoted value
-                state = State::SCANNING;
-            } else if (*it == ' ' || *it == '\t') {
-                state = State::SCANNING;
-            } else {
-                value += *it;
+                value.append(unescaped.data(), static_cast<int>(unescaped.size()));
+                it += static_cast<int>(used);
+                break;
             }
-        }
 
-        if (state == State::SCANNING || (it + 1) == data.end()) {
-            if (!key.isEmpty()) {
-                kv[toKey(key)] = value;
+            if (isBlank(*it)) {
+                ++it;
+                break;
             }
 
-            key = "";
-            value.clear();
+            const auto runEnd = find_if(it, end, [](const char ch) {
+                return (ch == '\"') || isBlank(ch);
+            });
+            value.append(&*it, static_cast<int>(runEnd - it));
+            it = runEnd;
         }
+
+        kv[toKey(keyBegin, keyEnd)] = value;
     }
 
     return !kv.isEmpty();
@@ -0,0 +1,123 @@
+
+#include <cctype>
+
+#include "ds/torevents.h"
+
+using namespace std;
+
+namespace ds {
+namespace tor {
+
+namespace {
+
+using cit_t = string::const_iterator;
+
+bool isKeyChar(const char ch)
+{
+    return isalnum(static_cast<unsigned char>(ch)) || (ch == '_');
+}
+
+cit_t skipSpaces(cit_t it, const cit_t end)
+{
+    while((it != end) && (*it == ' ')) {
+        ++it;
+    }
+    return it;
+}
+
+cit_t findSpace(cit_t it, const cit_t end)
+{
+    while((it != end) && (*it != ' ')) {
+        ++it;
+    }
+    return it;
+}
+
+QByteArray toBytes(const cit_t begin, const cit_t end)
+{
+    if (begin == end) {
+        return {};
+    }
+    return QByteArray(&*begin, static_cast<int>(end - begin));
+}
+
+} // anonymous namespace
+
+TorEvent TorEvent::parse(const TorCtlReply &reply)
+{
+    if (reply.lines.empty()) {
+        throw TorCtlReply::ParseError("Empty event");
+    }
+
+    const auto& line = reply.lines.front();
+    const auto end = line.cend();
+    auto it = skipSpaces(line.cbegin(), end);
+
+    TorEvent ev;
+    auto tokenEnd = findSpace(it, end);
+    if (it == tokenEnd) {
+        throw TorCtlReply::ParseError("Missing event name");
+    }
+    ev.name = toBytes(it, tokenEnd);
+
+    for(it = skipSpaces(tokenEnd, end); it != end; it = skipSpaces(it, end)) {
+        auto keyEnd = it;
+        while((keyEnd != end) && isKeyChar(*keyEnd)) {
+            ++keyEnd;
+        }
+
+        if ((keyEnd == it) || (keyEnd == end) || (*keyEnd != '=')) {
+            // Positional argument, like a path or "$FP~nick"
+            tokenEnd = findSpace(it, end);
+            ev.args.push_back(toBytes(it, tokenEnd));
+            it = tokenEnd;
+            continue;
+        }
+
+        const auto key = toBytes(it, keyEnd);
+        it = keyEnd + 1;
+        if ((it != end) && (*it == '"')) {
+            size_t used = 0;
+            ev.kv[key] = QByteArray::fromStdString(TorCtlReply::unescape(it, end, &used));
+            it += static_cast<string::difference_type>(used);
+        } else {
+            tokenEnd = findSpace(it, end);
+            ev.kv[key] = toBytes(it, tokenEnd);
+            it = tokenEnd;
+        }
+    }
+
+    return ev;
+}
+
+StatusClientEvent::StatusClientEvent(const TorEvent &ev)
+    : severity{ev.arg(0)}, action{ev.arg(1)}, kv{ev.kv}
+{
+}
+
+NetworkLivenessEvent::NetworkLivenessEvent(const TorEvent &ev)
+    : up{ev.arg(0) == "UP"}
+{
+}
+
+HsDescEvent::HsDescEvent(const TorEvent &ev)
+    : action{ev.arg(0)}, address{ev.arg(1)}, authType{ev.arg(2)}
+    , hsDir{ev.arg(3)}, reason{ev.value("REASON")}
+{
+}
+
+CircEvent::CircEvent(const TorEvent &ev)
+    : id{ev.arg(0)}, status{ev.arg(1)}, purpose{ev.value("PURPOSE")}
+    , hsState{ev.value("HS_STATE")}, rendQuery{ev.value("REND_QUERY")}
+    , reason{ev.value("REASON")}
+{
+}
+
+bool CircEvent::isFailedClientCircuit() const
+{
+    return (status == "FAILED")
+            && !rendQuery.isEmpty()
+            && purpose.startsWith("HS_CLIENT");
+}
+
+}} // namespaces
@@ -29,10 +29,13 @@ TorController *TorMgr::getController() { return ctl_.get(); }
 
 void TorMgr::start()
 {
+    timings_ = {};
+    startTimer_.start();
+
     if (config_.mode == TorConfig::Mode::SYSTEM) {
         startUseSystemInstance();
     } else {
-        assert(false); // Not implemented
+        startPrivateInstance();
     }
 }
 
@@ -41,6 +44,10 @@ void TorMgr::stop()
     if (ctl_) {
         ctl_->stop();
     }
+
+    if (process_) {
+        process_->stop();
+    }
 }
 
 void TorMgr::updateConfig(const TorConfig &config)
@@ -97,11 +104,23 @@ void TorMgr::onStateUpdate(TorController::CtlState state)
     case TorController::CtlState::CONNECTING:
         break;
     case TorController::CtlState::AUTHENTICATING:
+        timings_.connected = elapsed();
         break;
     case TorController::CtlState::CONNECTED:
+        timings_.authenticated = elapsed();
         emit started();
         break;
     case TorController::CtlState::ONLINE:
+        if (timings_.online < 0) {
+            timings_.online = elapsed();
+
+            LFLOG_NOTICE << "Tor startup: process " << timings_.process
+                         << " ms, connected " << timings_.connected
+                         << " ms, authenticated " << timings_.authenticated
+                         << " ms, online " << timings_.online << " ms";
+
+            emit startupComplete(timings_);
+        }
         emit online();
         break;
     case TorController::CtlState::STOPPING:
@@ -155,9 +174,63 @@ void TorMgr::startUseSystemInstance()
     connect(ctl_.get(), &TorController::serviceStopped,
             this, &TorMgr::onServiceStopped);
 
+    connect(ctl_.get(), &TorController::networkChanged,
+            this, &TorMgr::networkChanged);
+
+    connect(ctl_.get(), &TorController::servicePublished,
+            this, &TorMgr::servicePublished);
+
+    connect(ctl_.get(), &TorController::rendezvousFailed,
+            this, &TorMgr::rendezvousFailed);
+
+    connect(ctl_.get(), &TorController::socksPortReady,
+            this, &TorMgr::socksPortReady);
+
     ctl_->start();
 
 }
 
+void TorMgr::startPrivateInstance()
+{
+    assert(!ctl_);
+
+    if (process_ && process_->isRunning()) {
+        LFLOG_WARN << "Our tor instance is already running";
+        return;
+    }
+
+    process_ = std::make_unique<TorProcess>(config_);
+
+    connect(process_.get(), &TorProcess::controlPortReady,
+            this, [this](const QHostAddress& host, const quint16 port) {
+        timings_.process = elapsed();
+
+        // Tor made the cookie file in the DataDirectory
+        config_.ctl_host = host;
+        config_.ctl_port = port;
+        config_.allowed_auth_methods = {"SAFECOOKIE"};
+        startUseSystemInstance();
+    });
+
+    connect(process_.get(), &TorProcess::failed,
+            this, [this](const QString& reason) {
+        emit startFailed(reason);
+    });
+
+    // If the controller is running, it's disconnected and will emit stopped()
+    connect(process_.get(), &TorProcess::stopped, this, [this] {
+        if (!ctl_) {
+            emit stopped();
+        }
+    });
+
+    try {
+        process_->start();
+    } catch(const TorProcess::StartError& ex) {
+        process_.reset();
+        emit startFailed(ex.what());
+    }
+}
+
 }} // namespaces
 
@@ -0,0 +1,210 @@
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+
+#include "ds/torprocess.h"
+
+#include "logfault/logfault.h"
+
+namespace ds {
+namespace tor {
+
+TorProcess::TorProcess(const TorConfig &config)
+    : config_{config}
+{
+    process_.setProcessChannelMode(QProcess::MergedChannels);
+
+    connect(&process_, &QProcess::readyRead, this, &TorProcess::onReadyRead);
+    connect(&process_, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, &TorProcess::onFinished);
+    connect(&process_, &QProcess::errorOccurred, this, &TorProcess::onError);
+
+    poll_.setInterval(poll_interval_ms_);
+    connect(&poll_, &QTimer::timeout, this, &TorProcess::checkControlPortFile);
+}
+
+TorProcess::~TorProcess()
+{
+    if (isRunning()) {
+        process_.kill();
+        process_.waitForFinished(1000);
+    }
+}
+
+void TorProcess::start()
+{
+    if (config_.data_dir.isEmpty()) {
+        throw StartError("No DataDirectory for tor");
+    }
+
+    if (!QDir().mkpath(config_.data_dir)) {
+        throw StartError(QStringLiteral("Failed to create %1").arg(config_.data_dir));
+    }
+
+    // Tor refuses a DataDirectory that others can read
+    QFile::setPermissions(config_.data_dir,
+                          QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner);
+
+    // Left over from the last run
+    QFile::remove(getControlPortFile());
+
+    ready_ = false;
+    failed_ = false;
+    elapsed_.start();
+
+    LFLOG_NOTICE << "Starting " << config_.tor_binary
+                 << " with DataDirectory " << config_.data_dir;
+
+    process_.start(config_.tor_binary, getArguments());
+    poll_.start();
+}
+
+void TorProcess::stop()
+{
+    poll_.stop();
+
+    if (!isRunning()) {
+        return;
+    }
+
+    LFLOG_DEBUG << "Stopping tor";
+    process_.terminate();
+
+    QTimer::singleShot(kill_timeout_ms_, this, [this] {
+        if (isRunning()) {
+            LFLOG_WARN << "Tor did not exit. Killing it.";
+            process_.kill();
+        }
+    });
+}
+
+bool TorProcess::isRunning() const
+{
+    return process_.state() != QProcess::NotRunning;
+}
+
+QStringList TorProcess::getArguments() const
+{
+    const QDir dir{config_.data_dir};
+
+    return {
+        "-f", dir.filePath("torrc"),
+        "--ignore-missing-torrc",
+        "--DataDirectory", config_.data_dir,
+        "--ControlPort", "auto",
+        "--ControlPortWriteToFile", getControlPortFile(),
+        "--CookieAuthentication", "1",
+        "--SocksPort", "auto",
+        "--__OwningControllerProcess", QString::number(QCoreApplication::applicationPid()),
+        "--Log", "notice stdout"
+    };
+}
+
+QString TorProcess::getControlPortFile() const
+{
+    return QDir{config_.data_dir}.filePath("control-port");
+}
+
+bool TorProcess::parseControlPort(const QByteArray &data, QHostAddress &host,
+                                  quint16 &port)
+{
+    for(const auto& line : data.split('\n')) {
+        const auto value = line.trimmed();
+        if (!value.startsWith("PORT=")) {
+            continue;
+        }
+
+        const auto address = value.mid(5);
+        const auto colon = address.lastIndexOf(':');
+        if (colon <= 0) {
+            return false;
+        }
+
+        bool ok = false;
+        const auto p = address.mid(colon + 1).toUShort(&ok);
+        auto name = QString::fromLatin1(address.left(colon));
+        if (name.startsWith('[') && name.endsWith(']')) {
+            name = name.mid(1, name.size() - 2);
+        }
+
+        const QHostAddress h{name};
+        if (!ok || !p || h.isNull()) {
+            return false;
+        }
+
+        host = h;
+        port = p;
+        return true;
+    }
+
+    return false;
+}
+
+void TorProcess::checkControlPortFile()
+{
+    // Tor writes the file to a temporary name and renames it, so it's
+    // complete when it shows up.
+    QFile file{getControlPortFile()};
+    if (file.open(QIODevice::ReadOnly)) {
+        QHostAddress host;
+        quint16 port = {};
+        if (parseControlPort(file.readAll(), host, port)) {
+            poll_.stop();
+            ready_ = true;
+
+            LFLOG_NOTICE << "Tor is listening on control port " << host.toString()
+                         << ":" << port << " after " << getElapsed() << " ms";
+
+            emit controlPortReady(host, port);
+            return;
+        }
+    }
+
+    if (elapsed_.elapsed() > config_.start_timeout_ms) {
+        fail(QStringLiteral("Tor did not open the control port within %1 ms")
+             .arg(config_.start_timeout_ms));
+        stop();
+    }
+}
+
+void TorProcess::onReadyRead()
+{
+    while(process_.canReadLine()) {
+        LFLOG_DEBUG << "tor: " << process_.readLine().trimmed();
+    }
+}
+
+void TorProcess::onFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+    poll_.stop();
+
+    LFLOG_NOTICE << "Tor exited with code " << exitCode
+                 << (exitStatus == QProcess::CrashExit ? " (crashed)" : "");
+
+    if (!ready_) {
+        fail(QStringLiteral("Tor exited with code %1 before it was ready").arg(exitCode));
+    }
+
+    emit stopped();
+}
+
+void TorProcess::onError(QProcess::ProcessError error)
+{
+    if (error == QProcess::FailedToStart) {
+        poll_.stop();
+        fail(QStringLiteral("Failed to start %1: %2")
+             .arg(config_.tor_binary, process_.errorString()));
+    }
+}
+
+void TorProcess::fail(const QString &reason)
+{
+    if (!failed_) {
+        failed_ = true;
+        LFLOG_ERROR << reason;
+        emit failed(reason);
+    }
+}
+
+}} // namespaces
@@ -34,12 +34,16 @@ DEFINES += QT_DEPRECATED_WARNINGS
 SOURCES += \
     src/tormgr.cpp \
     src/torctlsocket.cpp \
-    src/torcontroller.cpp
+    src/torcontroller.cpp \
+    src/torevents.cpp \
+    src/torprocess.cpp
 
 HEADERS += \
     include/ds/tormgr.h \
     include/ds/torctlsocket.h \
     include/ds/torcontroller.h \
+    include/ds/torevents.h \
+    include/ds/torprocess.h \
     include/ds/torconfig.h \
     include/ds/serviceproperties.h
 
@@ -0,0 +1,112 @@
+#include <sodium.h>
+
+#include "bench_certcache.h"
+#include "benchreport.h"
+#include "ds/certcache.h"
+#include "ds/dscert.h"
+
+using namespace std;
+using ds::core::CertCache;
+using ds::crypto::DsCert;
+
+namespace {
+
+constexpr size_t num_contacts = 64;
+constexpr int payload_bytes = 64;
+
+QByteArray toByteArray(const DsCert::safe_view_t& view) {
+    return {reinterpret_cast<const char *>(view.cdata()), static_cast<int>(view.size())};
+}
+
+} // anonymous namespace
+
+void BenchCertCache::initTestCase()
+{
+    identity_ = DsCert::create();
+
+    for(size_t i = 0; i < num_contacts; ++i) {
+        auto cert = DsCert::create();
+
+        // payload | pubkey | signature, sealed with the identitys pubkey
+        QByteArray payload(payload_bytes, static_cast<char>(i));
+        const auto pubkey = toByteArray(cert->getSigningPubKey());
+        const auto signature = cert->sign<QByteArray>({payload, pubkey});
+        const auto plaintext = payload + pubkey + signature;
+
+        QByteArray ciphertext(plaintext.size() + static_cast<int>(crypto_box_SEALBYTES), 0);
+        identity_->encrypt(ciphertext, plaintext);
+
+        hellos_.push_back({pubkey, ciphertext});
+        contacts_.push_back(move(cert));
+    }
+}
+
+void BenchCertCache::bench_get_cert_data()
+{
+    QTest::addColumn<bool>("cached");
+
+    QTest::newRow("uncached") << false;
+    QTest::newRow("cached") << true;
+}
+
+void BenchCertCache::bench_get_cert()
+{
+    QFETCH(bool, cached);
+
+    CertCache cache;
+    size_t next = 0;
+
+    const auto ns = BenchReport::instance().measure([&] {
+        const auto& pubkey = hellos_[next++ % hellos_.size()].pubkey;
+        auto cert = cached ? cache.getFromPubkey(pubkey) : DsCert::createFromPubkey(pubkey);
+        QVERIFY(cert);
+        if (cached) {
+            cache.add(pubkey, cert);
+        }
+    });
+
+    BenchReport::instance().add("certs", 1000000000.0 / ns, "certs/s");
+}
+
+void BenchCertCache::bench_handshake_data()
+{
+    QTest::addColumn<bool>("cached");
+
+    QTest::newRow("uncached") << false;
+    QTest::newRow("cached") << true;
+}
+
+void BenchCertCache::bench_handshake()
+{
+    QFETCH(bool, cached);
+
+    CertCache cache;
+    size_t next = 0;
+    size_t failed = 0;
+    const int pubkey_bytes = static_cast<int>(crypto_sign_PUBLICKEYBYTES);
+
+    const auto ns = BenchReport::instance().measure([&] {
+        const auto& hello = hellos_[next++ % hellos_.size()];
+
+        QByteArray plaintext(hello.ciphertext.size() - static_cast<int>(crypto_box_SEALBYTES), 0);
+        if (!identity_->decrypt(plaintext, hello.ciphertext)) {
+            ++failed;
+            return;
+        }
+
+        const auto payload = plaintext.left(payload_bytes);
+        const auto pubkey = plaintext.mid(payload_bytes, pubkey_bytes);
+        const auto signature = plaintext.mid(payload_bytes + pubkey_bytes);
+
+        auto cert = cached ? cache.getFromPubkey(pubkey) : DsCert::createFromPubkey(pubkey);
+        if (!cert->verify(signature, {payload, pubkey})) {
+            ++failed;
+        } else if (cached) {
+            cache.add(pubkey, cert);
+        }
+    });
+
+    QCOMPARE(failed, size_t{0});
+    BenchReport::instance().add("handshakes", 1000000000.0 / ns, "handshakes/s");
+    BenchReport::instance().add("cpu", ns / 1000.0, "us/handshake");
+}
@@ -0,0 +1,42 @@
+#ifndef BENCH_CERTCACHE_H
+#define BENCH_CERTCACHE_H
+
+#include <vector>
+
+#include <QtTest>
+
+#include "ds/dscert.h"
+
+/*! Cost of creating the peers cert in the handshake, with and without the cert cache.
+ *
+ * A number of contacts reconnect to one identity over and over. The
+ * handshake is the server side of the Hello, without the IO: decrypt
+ * the sealed payload, get the cert for the pubkey and verify the
+ * signature.
+ */
+class BenchCertCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    BenchCertCache() = default;
+
+private slots:
+    void initTestCase();
+    void bench_get_cert_data();
+    void bench_get_cert();
+    void bench_handshake_data();
+    void bench_handshake();
+
+private:
+    struct Hello {
+        QByteArray pubkey;
+        QByteArray ciphertext;
+    };
+
+    ds::crypto::DsCert::ptr_t identity_;
+    std::vector<ds::crypto::DsCert::ptr_t> contacts_;
+    std::vector<Hello> hellos_;
+};
+
+#endif // BENCH_CERTCACHE_H
@@ -0,0 +1,72 @@
+#include <vector>
+
+#include "bench_cipher.h"
+#include "benchreport.h"
+#include "ds/streamcipher.h"
+
+using namespace std;
+using namespace ds::prot;
+
+Q_DECLARE_METATYPE(StreamCipher::Suite)
+
+namespace {
+
+struct Stream {
+    Stream(const StreamCipher::Suite suite) {
+        vector<unsigned char> header(StreamCipher::header_bytes);
+        vector<unsigned char> key(StreamCipher::key_bytes);
+        out.initPush(header.data(), key.data());
+        in.initPull(header.data(), key.data());
+        out.setSuite(suite);
+        in.setSuite(suite);
+    }
+
+    StreamCipher out;
+    StreamCipher in;
+};
+
+void addSuites()
+{
+    QTest::addColumn<StreamCipher::Suite>("suite");
+    QTest::addColumn<int>("chunkSize");
+
+    for(const int size : {1024, 16 * 1024, 64 * 1024}) {
+        QTest::newRow(QStringLiteral("xchacha20poly1305-%1").arg(size).toLatin1())
+                << StreamCipher::Suite::XCHACHA20POLY1305 << size;
+        if (StreamCipher::isAesGcmAvailable()) {
+            QTest::newRow(QStringLiteral("aes256gcm-%1").arg(size).toLatin1())
+                    << StreamCipher::Suite::AES256GCM << size;
+        }
+    }
+}
+
+} // anonymous namespace
+
+void BenchCipher::bench_cipher_data()
+{
+    if (!StreamCipher::isAesGcmAvailable()) {
+        qInfo() << "No hardware support for AES-256-GCM on this CPU. Skipping those rows.";
+    }
+
+    addSuites();
+}
+
+void BenchCipher::bench_cipher()
+{
+    QFETCH(StreamCipher::Suite, suite);
+    QFETCH(int, chunkSize);
+
+    Stream stream{suite};
+    const auto size = static_cast<size_t>(chunkSize);
+    vector<unsigned char> data(size, 'x'), ciphertext(size + StreamCipher::abytes);
+    unsigned char tag = {};
+    bool ok = true;
+
+    // Reports the throughput of a push and a pull
+    BenchReport::instance().measure([&] {
+        stream.out.push(ciphertext.data(), data.data(), size, StreamCipher::tag_message);
+        ok &= stream.in.pull(data.data(), tag, ciphertext.data(), ciphertext.size());
+    }, size);
+
+    QVERIFY(ok);
+}
@@ -0,0 +1,23 @@
+#ifndef BENCH_CIPHER_H
+#define BENCH_CIPHER_H
+
+#include <QtTest>
+
+/*! Throughput of the stream cipher suites
+ *
+ * Encrypts and decrypts file-sized chunks with XChaCha20-Poly1305
+ * and, if the CPU supports it, AES-256-GCM.
+ */
+class BenchCipher : public QObject
+{
+    Q_OBJECT
+
+public:
+    BenchCipher() = default;
+
+private slots:
+    void bench_cipher_data();
+    void bench_cipher();
+};
+
+#endif // BENCH_CIPHER_H
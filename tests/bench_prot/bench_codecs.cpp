@@ -0,0 +1,61 @@
+#include <functional>
+#include <string>
+
+#include "bench_codecs.h"
+#include "benchreport.h"
+#include "ds/base32.h"
+#include "ds/base58.h"
+#include "ds/crypto.h"
+
+using namespace std;
+using namespace ds::crypto;
+
+using codec_fn_t = function<size_t ()>;
+Q_DECLARE_METATYPE(codec_fn_t)
+
+void BenchCodecs::bench_codec_data()
+{
+    QTest::addColumn<codec_fn_t>("fn");
+
+    const auto pubkey = Crypto::getRandomBytes(32);
+    const auto handle = b58check_enc<QByteArray>(pubkey, {249, 50}).toStdString();
+
+    // Identity with a v3 onion address and port
+    const auto identityBytes = Crypto::getRandomBytes(1 + 32 + 32 + 2);
+    const auto identity = b58check_enc<QByteArray>(identityBytes, {11, 176}).toStdString();
+
+    const auto onion16 = onion16encode(Crypto::getRandomBytes(10));
+    const auto onion56 = onionV3FromPubkey(pubkey);
+
+    QTest::newRow("b58-handle-encode") << codec_fn_t{[pubkey] {
+        return static_cast<size_t>(b58check_enc<QByteArray>(pubkey, {249, 50}).size());
+    }};
+    QTest::newRow("b58-handle-decode") << codec_fn_t{[handle] {
+        return static_cast<size_t>(b58tobin_check<QByteArray>(handle, 32, {249, 50}).size());
+    }};
+    QTest::newRow("b58-identity-decode") << codec_fn_t{[identity] {
+        return static_cast<size_t>(b58tobin_check<QByteArray>(identity, 67, {11, 176}).size());
+    }};
+    QTest::newRow("onion16-decode") << codec_fn_t{[onion16] {
+        return static_cast<size_t>(onion16decode(onion16).size());
+    }};
+    QTest::newRow("onion56-decode") << codec_fn_t{[onion56] {
+        return static_cast<size_t>(onion56decode(onion56).size());
+    }};
+    QTest::newRow("onion-v3-from-pubkey") << codec_fn_t{[pubkey] {
+        return static_cast<size_t>(onionV3FromPubkey(pubkey).size());
+    }};
+}
+
+void BenchCodecs::bench_codec()
+{
+    QFETCH(codec_fn_t, fn);
+
+    size_t bytes = 0;
+    const auto ns = BenchReport::instance().measure([&] {
+        bytes += fn();
+    });
+
+    QVERIFY(bytes > 0);
+    BenchReport::instance().add("ops", 1000000000.0 / ns, "ops/s");
+}
@@ -0,0 +1,23 @@
+#ifndef BENCH_CODECS_H
+#define BENCH_CODECS_H
+
+#include <QtTest>
+
+/*! The base58 and base32 codecs, with the inputs we actually use
+ *
+ * Contact handles (32 byte keys with base58 check), identities
+ * and onion addresses.
+ */
+class BenchCodecs : public QObject
+{
+    Q_OBJECT
+
+public:
+    BenchCodecs() = default;
+
+private slots:
+    void bench_codec_data();
+    void bench_codec();
+};
+
+#endif // BENCH_CODECS_H
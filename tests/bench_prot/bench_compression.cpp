@@ -0,0 +1,100 @@
+#include <random>
+
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include "bench_compression.h"
+#include "benchreport.h"
+#include "ds/compression.h"
+
+using namespace std;
+using ds::prot::Compression;
+
+namespace {
+
+// Typical channel 0 message
+QByteArray makeJsonMessage() {
+    QJsonObject obj{
+        {"type", "Message"},
+        {"message-id", "dGhpcyBpcyBhIG1lc3NhZ2UgaWQ="},
+        {"date", "2019-03-14T12:14:00"},
+        {"content", "Hi there! Did you get the files I sent you yesterday? "
+                    "Let me know if something is missing, and I will send it again."},
+        {"encoding", "utf-8"},
+        {"conversation", "Y29udmVyc2F0aW9uIGlkIGZvciB0ZXN0aW5n"},
+        {"from", "c2VuZGVyIGhhc2ggZm9yIHRlc3Rpbmc="},
+        {"signature", "c2lnbmF0dXJlIGZvciB0ZXN0aW5nIHNpZ25hdHVyZSBmb3IgdGVzdGluZw=="}
+    };
+    return QJsonDocument{obj}.toJson(QJsonDocument::Compact);
+}
+
+// Looks like a log-file
+QByteArray makeText(const int bytes) {
+    QByteArray data;
+    for(int i = 0; data.size() < bytes; ++i) {
+        data += QStringLiteral("2019-03-14 12:14:%1.%2 DEBUG 42 Peer.cpp:%3 Received chunk on connection {%4}\n")
+                .arg(i % 60).arg(i % 1000).arg(i % 700).arg(i * 7919).toUtf8();
+    }
+    data.resize(bytes);
+    return data;
+}
+
+// Incompressible, like a jpeg or zip file
+QByteArray makeRandom(const int bytes) {
+    mt19937 rnd{42};
+    QByteArray data(bytes, 0);
+    for(auto& ch : data) {
+        ch = static_cast<char>(rnd());
+    }
+    return data;
+}
+
+void addData() {
+    QTest::addColumn<QByteArray>("data");
+
+    QTest::newRow("json-message") << makeJsonMessage();
+    QTest::newRow("text-8k") << makeText(1024 * 8);
+    QTest::newRow("random-8k") << makeRandom(1024 * 8);
+    QTest::newRow("text-64k") << makeText(1024 * 64);
+}
+
+} // anonymous namespace
+
+void BenchCompression::bench_compress_data()
+{
+    addData();
+}
+
+void BenchCompression::bench_compress()
+{
+    QFETCH(QByteArray, data);
+
+    QByteArray compressed;
+    BenchReport::instance().measure([&] {
+        compressed = Compression::compress(data.constData(), static_cast<size_t>(data.size()));
+    }, static_cast<quint64>(data.size()));
+
+    BenchReport::instance().add("ratio", static_cast<double>(data.size()) / compressed.size(),
+                                "x");
+}
+
+void BenchCompression::bench_decompress_data()
+{
+    addData();
+}
+
+void BenchCompression::bench_decompress()
+{
+    QFETCH(QByteArray, data);
+
+    const auto compressed = Compression::compress(data.constData(), static_cast<size_t>(data.size()));
+
+    QByteArray result;
+    BenchReport::instance().measure([&] {
+        result = Compression::decompress(compressed.constData(),
+                                         static_cast<size_t>(compressed.size()),
+                                         static_cast<size_t>(data.size()));
+    }, static_cast<quint64>(data.size()));
+
+    QCOMPARE(result, data);
+}
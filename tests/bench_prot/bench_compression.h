@@ -0,0 +1,20 @@
+#ifndef BENCH_COMPRESSION_H
+#define BENCH_COMPRESSION_H
+
+#include <QtTest>
+
+class BenchCompression : public QObject
+{
+    Q_OBJECT
+
+public:
+    BenchCompression() = default;
+
+private slots:
+    void bench_compress_data();
+    void bench_compress();
+    void bench_decompress_data();
+    void bench_decompress();
+};
+
+#endif // BENCH_COMPRESSION_H
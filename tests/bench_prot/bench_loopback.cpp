@@ -0,0 +1,438 @@
+#include <vector>
+#include <sodium.h>
+
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QElapsedTimer>
+
+#include "bench_loopback.h"
+#include "benchreport.h"
+#include "ds/peer.h"
+#include "ds/loopbackprotocolmanager.h"
+#include "ds/transporthandle.h"
+#include "ds/cryptoexecutor.h"
+#include "ds/sessiontickets.h"
+
+using namespace std;
+using namespace ds::core;
+using ds::prot::Peer;
+using ds::prot::SessionTickets;
+
+namespace {
+
+constexpr int handshakes = 20;
+constexpr int concurrent_handshakes = 200;
+constexpr int roundtrips = 1000;
+constexpr int message_batch = 10000;
+constexpr quint64 frame_bytes = 1024 * 1024 * 16;
+constexpr size_t block_size = 1024 * 8; // Same as file transfers
+constexpr quint64 file_bytes = 1024 * 1024 * 64;
+constexpr quint32 bench_channel = 1000;
+constexpr int timeout_ms = 60000;
+
+class CountingChannel : public Peer::Channel {
+public:
+    CountingChannel(shared_ptr<quint64> bytes) : bytes_{move(bytes)} {}
+
+    void onIncoming(Peer&, const quint64, const Peer::mview_t& data, const bool) override {
+        *bytes_ += static_cast<quint64>(data.size());
+    }
+
+    uint64_t onOutgoing(Peer&) override {
+        return 0;
+    }
+
+private:
+    shared_ptr<quint64> bytes_;
+};
+
+QJsonDocument makeMessage(const int id) {
+    return QJsonDocument{QJsonObject{
+        {"type", "Message"},
+        {"message-id", QString{QByteArray::number(id).toBase64()}},
+        {"date", "2019-03-14T12:14:00"},
+        {"content", "Hi there! Did you get the files I sent you yesterday?"},
+        {"encoding", "utf-8"},
+        {"conversation", "Y29udmVyc2F0aW9uIGlkIGZvciB0ZXN0aW5n"},
+        {"from", "c2VuZGVyIGhhc2ggZm9yIHRlc3Rpbmc="},
+        {"signature", "c2lnbmF0dXJlIGZvciB0ZXN0aW5n"}
+    }};
+}
+
+Peer& toPeer(const PeerConnection::ptr_t& pc) {
+    auto peer = dynamic_cast<Peer *>(pc.get());
+    if (!peer) {
+        throw runtime_error("Not a Peer");
+    }
+    return *peer;
+}
+
+// Process events until done() returns true.
+// Unlike QTRY_VERIFY, this returns as soon as the condition is met,
+// so it can be used to measure latency.
+bool waitFor(const function<bool ()>& done, const int timeout = timeout_ms) {
+    QElapsedTimer timer;
+    timer.start();
+
+    // Make sure we wake up to check the timeout
+    QTimer ticker;
+    ticker.start(100);
+
+    while(!done()) {
+        if (timer.elapsed() > timeout) {
+            return false;
+        }
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+    }
+    return true;
+}
+
+// Wait until the output buffer is below the high watermark.
+bool waitForCanSendMore(Peer& peer) {
+    return waitFor([&peer] { return peer.canSendMore(); });
+}
+
+// Send bytes in blocks on the benchmark channel
+bool sendBlocks(Peer& peer, const QByteArray& block, const quint64 bytes) {
+    const auto size = static_cast<size_t>(block.size());
+    for(quint64 sent = 0; sent < bytes; sent += size) {
+        if (!waitForCanSendMore(peer)) {
+            return false;
+        }
+        peer.send(block.constData(), size, bench_channel, sent + size >= bytes);
+    }
+    return true;
+}
+
+QByteArray makeBlock(const size_t bytes) {
+    QByteArray block(static_cast<int>(bytes), '\0');
+    randombytes_buf(block.data(), bytes);
+    return block;
+}
+
+} // anonymous namespace
+
+void BenchLoopback::initTestCase()
+{
+    QVERIFY(dir_.isValid());
+    settings_ = make_unique<QSettings>(dir_.filePath("bench.ini"), QSettings::IniFormat);
+    settings_->setValue("transport", "loopback");
+    settings_->setValue("compression", false);
+
+    mgr_ = ProtocolManager::create(*settings_, ProtocolManager::Transport::TOR);
+    QVERIFY(dynamic_cast<ds::prot::LoopbackProtocolManager *>(mgr_.get()));
+    mgr_->start();
+    QVERIFY(mgr_->isOnline());
+
+    startService(alice_, "alice");
+    startService(bob_, "bob");
+
+    connect(mgr_.get(), &ProtocolManager::incomingPeer,
+            this, [this](const shared_ptr<PeerConnection>& peer) {
+        incoming_ = peer;
+        peer->authorize(true);
+    });
+
+    conn_ = connectPeers();
+    QVERIFY(conn_.client && conn_.server);
+
+    toPeer(conn_.server).addInChannel(bench_channel, make_shared<CountingChannel>(received_));
+}
+
+void BenchLoopback::cleanupTestCase()
+{
+    if (conn_.client) {
+        conn_.client->close();
+    }
+    conn_ = {};
+    incoming_.reset();
+
+    if (mgr_) {
+        mgr_->stop();
+    }
+}
+
+void BenchLoopback::startService(BenchLoopback::Endpoint &ep, const QString& name)
+{
+    TransportHandle th;
+    auto conn = connect(mgr_.get(), &ProtocolManager::transportHandleReady,
+                        this, [&th](const TransportHandle& handle) {
+        th = handle;
+    });
+
+    mgr_->createTransportHandle({name, ep.uuid});
+    disconnect(conn);
+
+    QCOMPARE(th.uuid, ep.uuid);
+    ep.address = th.data["address"].toByteArray();
+
+    bool started = false;
+    conn = connect(mgr_.get(), &ProtocolManager::serviceStarted,
+                   this, [&started, &ep](const QUuid& uuid, const bool) {
+        started = (uuid == ep.uuid);
+    });
+    mgr_->startService(ep.uuid, ep.cert, th.data);
+    disconnect(conn);
+
+    QVERIFY(started);
+}
+
+BenchLoopback::Connection BenchLoopback::connectPeers()
+{
+    ConnectData cd;
+    cd.service = bob_.uuid;
+    cd.address = alice_.address;
+    cd.identitysCert = bob_.cert;
+    cd.contactsCert = ds::crypto::DsCert::createFromPubkey(
+                alice_.cert->getSigningPubKey().toByteArray());
+
+    incoming_.reset();
+    Connection c;
+    c.client = mgr_->connectTo(cd);
+
+    bool connected = false;
+    auto conn = connect(c.client.get(), &PeerConnection::connectedToPeer,
+                        this, [&connected](const shared_ptr<PeerConnection>&) {
+        connected = true;
+    });
+
+    const auto ok = waitFor([&connected, this] { return connected && incoming_; });
+    disconnect(conn);
+    if (!ok) {
+        return {};
+    }
+
+    c.server = incoming_;
+    return c;
+}
+
+void BenchLoopback::bench_handshake_data()
+{
+    QTest::addColumn<bool>("resume");
+
+    QTest::newRow("full") << false;
+    QTest::newRow("resumed") << true;
+}
+
+void BenchLoopback::bench_handshake()
+{
+    QFETCH(bool, resume);
+
+    auto& tickets = SessionTickets::instance();
+    tickets.clear();
+
+    // Bob asks for a new ticket on each connection. Wait for it before
+    // the next connect, and throw it away if we want a full handshake.
+    auto previous = connectPeers();
+    QVERIFY(previous.client && previous.server);
+
+    qint64 elapsedNs = 0;
+    int resumed = 0;
+    QElapsedTimer timer;
+
+    for(int i = 0; i < handshakes; ++i) {
+        QVERIFY(waitFor([&tickets] { return tickets.size() > 0; }));
+        if (!resume) {
+            tickets.clear();
+        }
+        previous.client->close();
+
+        timer.start();
+        auto c = connectPeers();
+        elapsedNs += timer.nsecsElapsed();
+
+        QVERIFY(c.client && c.server);
+        if (toPeer(c.client).isResumed()) {
+            ++resumed;
+        }
+        previous = c;
+    }
+
+    previous.client->close();
+    QCOMPARE(resumed, resume ? handshakes : 0);
+
+    const auto ms = static_cast<double>(elapsedNs) / 1000000.0 / handshakes;
+    QTest::setBenchmarkResult(ms, QTest::WalltimeMilliseconds);
+    BenchReport::instance().add("time", ms, "ms", handshakes);
+}
+
+void BenchLoopback::bench_concurrent_handshakes_data()
+{
+    QTest::addColumn<int>("threads");
+
+    QTest::newRow("main-thread") << 0;
+    QTest::newRow("executor-2") << 2;
+    QTest::newRow("executor-4") << 4;
+}
+
+// Many peers connecting at once, like when we go online with many contacts.
+// Also reports the longest time the event-loop was blocked.
+void BenchLoopback::bench_concurrent_handshakes()
+{
+    QFETCH(int, threads);
+
+    auto& executor = CryptoExecutor::instance();
+    executor.setThreads(static_cast<size_t>(threads));
+
+    ConnectData cd;
+    cd.service = bob_.uuid;
+    cd.address = alice_.address;
+    cd.identitysCert = bob_.cert;
+    cd.contactsCert = ds::crypto::DsCert::createFromPubkey(
+                alice_.cert->getSigningPubKey().toByteArray());
+
+    qint64 maxStallUs = 0;
+    QElapsedTimer stall;
+    QTimer ticker;
+    connect(&ticker, &QTimer::timeout, this, [&] {
+        maxStallUs = max(maxStallUs, stall.nsecsElapsed() / 1000);
+        stall.restart();
+    });
+
+    int connected = 0;
+    vector<PeerConnection::ptr_t> clients;
+    vector<QMetaObject::Connection> conns;
+
+    QElapsedTimer timer;
+    timer.start();
+    stall.start();
+    ticker.start(1);
+
+    for(int i = 0; i < concurrent_handshakes; ++i) {
+        clients.push_back(mgr_->connectTo(cd));
+        conns.push_back(connect(clients.back().get(), &PeerConnection::connectedToPeer,
+                                this, [&connected](const shared_ptr<PeerConnection>&) {
+            ++connected;
+        }));
+    }
+
+    const auto ok = waitFor([&connected] { return connected == concurrent_handshakes; });
+    const auto ms = max<qint64>(timer.elapsed(), 1);
+    ticker.stop();
+
+    for(auto& conn : conns) {
+        disconnect(conn);
+    }
+    for(auto& client : clients) {
+        client->close();
+    }
+    executor.setThreads(0);
+
+    QVERIFY(ok);
+    QTest::setBenchmarkResult(static_cast<qreal>(ms), QTest::WalltimeMilliseconds);
+    BenchReport::instance().add("rate", concurrent_handshakes * 1000.0 / ms,
+                                "handshakes/s", concurrent_handshakes);
+    BenchReport::instance().add("max-stall", maxStallUs / 1000.0, "ms",
+                                concurrent_handshakes);
+}
+
+void BenchLoopback::bench_roundtrip()
+{
+    int acks = 0;
+    auto server = conn_.server;
+    auto onMessage = connect(server.get(), &PeerConnection::receivedMessage,
+                             this, [server](const PeerMessage& msg) {
+        server->sendAck("Message", "Received", QString::number(msg.requestId));
+    });
+
+    auto onAck = connect(conn_.client.get(), &PeerConnection::receivedAck,
+                         this, [&acks](const PeerAck&) {
+        ++acks;
+    });
+
+    auto& peer = toPeer(conn_.client);
+    QElapsedTimer timer;
+    timer.start();
+
+    for(int i = 0; i < roundtrips; ++i) {
+        peer.send(makeMessage(i));
+        QVERIFY(waitFor([&acks, i] { return acks > i; }));
+    }
+
+    const auto us = static_cast<double>(timer.nsecsElapsed()) / 1000.0 / roundtrips;
+    disconnect(onMessage);
+    disconnect(onAck);
+
+    QTest::setBenchmarkResult(us / 1000.0, QTest::WalltimeMilliseconds);
+    BenchReport::instance().add("latency", us, "us", roundtrips);
+}
+
+void BenchLoopback::bench_messages()
+{
+    int received = 0;
+    auto conn = connect(conn_.server.get(), &PeerConnection::receivedMessage,
+                        this, [&received](const PeerMessage&) {
+        ++received;
+    });
+
+    auto& peer = toPeer(conn_.client);
+    QElapsedTimer timer;
+    timer.start();
+
+    for(int i = 0; i < message_batch; ++i) {
+        QVERIFY(waitForCanSendMore(peer));
+        peer.send(makeMessage(i));
+    }
+
+    QVERIFY(waitFor([&received] { return received == message_batch; }));
+    const auto elapsed = max<qint64>(timer.elapsed(), 1);
+    disconnect(conn);
+
+    QTest::setBenchmarkResult(static_cast<qreal>(elapsed), QTest::WalltimeMilliseconds);
+    BenchReport::instance().add("rate", message_batch * 1000.0 / elapsed,
+                                "messages/s", message_batch);
+}
+
+void BenchLoopback::bench_frames_data()
+{
+    QTest::addColumn<int>("size");
+
+    QTest::newRow("16") << 16;
+    QTest::newRow("256") << 256;
+    QTest::newRow("1k") << 1024;
+    QTest::newRow("8k") << 1024 * 8;
+    QTest::newRow("32k") << 1024 * 32;
+    QTest::newRow("max") << 0xffff - 13; // Largest payload that fits in a frame
+}
+
+void BenchLoopback::bench_frames()
+{
+    QFETCH(int, size);
+
+    const auto block = makeBlock(static_cast<size_t>(size));
+    const auto bytes = max<quint64>(frame_bytes / static_cast<quint64>(size) * static_cast<quint64>(size),
+                                    static_cast<quint64>(size));
+    const auto frames = bytes / static_cast<quint64>(size);
+    auto& peer = toPeer(conn_.client);
+    *received_ = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QVERIFY(sendBlocks(peer, block, bytes));
+    QVERIFY(waitFor([this, bytes] { return *received_ == bytes; }));
+
+    const auto seconds = max<double>(timer.nsecsElapsed() / 1000000000.0, 0.000001);
+    QTest::setBenchmarkResult(seconds * 1000.0, QTest::WalltimeMilliseconds);
+    BenchReport::instance().add("rate", frames / seconds, "frames/s", frames);
+    BenchReport::instance().add("throughput", bytes / seconds / (1024 * 1024), "MB/s", frames);
+}
+
+void BenchLoopback::bench_file_transfer()
+{
+    const auto block = makeBlock(block_size);
+    auto& peer = toPeer(conn_.client);
+    *received_ = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QVERIFY(sendBlocks(peer, block, file_bytes));
+    QVERIFY(waitFor([this] { return *received_ == file_bytes; }));
+
+    const auto seconds = max<double>(timer.nsecsElapsed() / 1000000000.0, 0.000001);
+    const auto bytesPerSec = file_bytes / seconds;
+    QTest::setBenchmarkResult(bytesPerSec, QTest::BytesPerSecond);
+    BenchReport::instance().add("throughput", bytesPerSec / (1024 * 1024), "MB/s",
+                                file_bytes / block_size);
+}
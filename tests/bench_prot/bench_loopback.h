@@ -0,0 +1,69 @@
+#ifndef BENCH_LOOPBACK_H
+#define BENCH_LOOPBACK_H
+
+#include <memory>
+
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QSettings>
+
+#include "ds/protocolmanager.h"
+#include "ds/dscert.h"
+
+/*! Throughput of the DS protocol over the loopback transport.
+ *
+ * Two services (Alice and Bob) run in the same process and
+ * connect to each other over direct TCP. No Tor is involved, so
+ * this measures the overhead of our own code (encryption, framing,
+ * json) and the local TCP stack.
+ */
+class BenchLoopback : public QObject
+{
+    Q_OBJECT
+
+public:
+    BenchLoopback() = default;
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void bench_handshake_data();
+    void bench_handshake();
+    void bench_concurrent_handshakes_data();
+    void bench_concurrent_handshakes();
+    void bench_roundtrip();
+    void bench_messages();
+    void bench_frames_data();
+    void bench_frames();
+    void bench_file_transfer();
+
+private:
+    struct Endpoint {
+        QUuid uuid = QUuid::createUuid();
+        ds::crypto::DsCert::ptr_t cert = ds::crypto::DsCert::create();
+        QByteArray address;
+    };
+
+    struct Connection {
+        ds::core::PeerConnection::ptr_t client;
+        ds::core::PeerConnection::ptr_t server;
+    };
+
+    void startService(Endpoint& ep, const QString& name);
+
+    // Bob connects to Alice. Returns when both sides are connected.
+    Connection connectPeers();
+
+    QTemporaryDir dir_;
+    std::unique_ptr<QSettings> settings_;
+    ds::core::ProtocolManager::ptr_t mgr_;
+    Endpoint alice_;
+    Endpoint bob_;
+    Connection conn_;
+    ds::core::PeerConnection::ptr_t incoming_;
+
+    // Bytes received on the benchmark channel
+    std::shared_ptr<quint64> received_ = std::make_shared<quint64>(0);
+};
+
+#endif // BENCH_LOOPBACK_H
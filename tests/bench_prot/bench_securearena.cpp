@@ -0,0 +1,65 @@
+#include <algorithm>
+#include <vector>
+
+#include <QElapsedTimer>
+
+#include "bench_securearena.h"
+#include "benchreport.h"
+#include "ds/dscert.h"
+#include "ds/securearena.h"
+
+using namespace std;
+using ds::crypto::DsCert;
+using ds::crypto::SecureArena;
+
+void BenchSecureArena::cleanup()
+{
+    SecureArena::instance().setEnabled(true);
+    SecureArena::instance().trim();
+}
+
+void BenchSecureArena::bench_certs_data()
+{
+    QTest::addColumn<bool>("arena");
+    QTest::addColumn<int>("count");
+    QTest::addColumn<int>("alive");
+
+    QTest::newRow("sodium-100k") << false << 100000 << 1000;
+    QTest::newRow("arena-100k") << true << 100000 << 1000;
+}
+
+void BenchSecureArena::bench_certs()
+{
+    QFETCH(bool, arena);
+    QFETCH(int, count);
+    QFETCH(int, alive);
+
+    const auto blob = DsCert::create()->getCert();
+
+    SecureArena::instance().setEnabled(arena);
+    SecureArena::instance().trim();
+
+    vector<DsCert::ptr_t> certs(static_cast<size_t>(alive));
+    size_t maxPages = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    for(int i = 0; i < count; ++i) {
+        certs[static_cast<size_t>(i % alive)] = DsCert::create(blob);
+
+        if ((i % alive) == (alive - 1)) {
+            maxPages = max(maxPages, SecureArena::instance().getStats().lockedPages);
+        }
+    }
+
+    certs.clear();
+    const auto ns = timer.nsecsElapsed();
+
+    QCOMPARE(SecureArena::instance().getStats().slotsInUse, size_t{0});
+
+    auto& report = BenchReport::instance();
+    report.add("time", ns / 1000000.0, "ms");
+    report.add("certs", count * 1000000000.0 / ns, "certs/s");
+    report.add("locked", static_cast<double>(maxPages), "pages");
+}
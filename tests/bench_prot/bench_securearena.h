@@ -0,0 +1,24 @@
+#ifndef BENCH_SECUREARENA_H
+#define BENCH_SECUREARENA_H
+
+#include <QtTest>
+
+/*! Cost of the locked memory for certs, with and without the SecureArena.
+ *
+ * Creates and destroys 100k certs, with a window of them alive at
+ * any time, like peers that come and go.
+ */
+class BenchSecureArena : public QObject
+{
+    Q_OBJECT
+
+public:
+    BenchSecureArena() = default;
+
+private slots:
+    void cleanup();
+    void bench_certs_data();
+    void bench_certs();
+};
+
+#endif // BENCH_SECUREARENA_H
@@ -0,0 +1,120 @@
+#include <deque>
+#include <string>
+
+#include "bench_torctl.h"
+#include "benchreport.h"
+#include "ds/torctlsocket.h"
+
+using namespace std;
+using namespace ds::tor;
+
+namespace {
+
+// Feeds canned lines to the parser, without a connection
+class FeedTorCtlSocket : public TorCtlSocket
+{
+public:
+    void feed(const deque<QByteArray>& lines) {
+        lines_ = &lines;
+        next_ = 0;
+        processIn();
+    }
+
+protected:
+    bool canReadLine_() const override {
+        return next_ < lines_->size();
+    }
+
+    QByteArray readLine_(qint64) override {
+        return (*lines_)[next_++];
+    }
+
+    qint64 write_(const QByteArray& data) override { return data.size(); }
+
+private:
+    const deque<QByteArray> *lines_ = {};
+    size_t next_ = {};
+};
+
+// A network status with n relays, as a GETINFO ns/all reply
+deque<QByteArray> makeNsReply(const int relays, quint64& bytes)
+{
+    deque<QByteArray> lines;
+    lines.push_back("250+ns/all=\r\n");
+    for(int i = 0; i < relays; ++i) {
+        lines.push_back("r relay" + QByteArray::number(i)
+                        + " AAoQ1DAR6kkoo19hBAX5K0QztNw 3ZbF2nUSo5Gi1YvIbqtIm/OXv3U"
+                          " 2018-10-21 09:18:41 198.51.100." + QByteArray::number(i % 250)
+                        + " 9001 0\r\n");
+        lines.push_back("s Fast Guard HSDir Running Stable V2Dir Valid\r\n");
+        lines.push_back("w Bandwidth=" + QByteArray::number(1000 + i) + "\r\n");
+        lines.push_back(".dotted\r\n");
+    }
+    lines.push_back(".\r\n");
+    lines.push_back("250 OK\r\n");
+
+    bytes = 0;
+    for(const auto& line : lines) {
+        bytes += static_cast<quint64>(line.size());
+    }
+
+    return lines;
+}
+
+} // anonymous namespace
+
+void BenchTorCtl::bench_data_reply()
+{
+    quint64 bytes = 0;
+    const auto lines = makeNsReply(30000, bytes);
+    QVERIFY(bytes > 1024 * 1024 * 4);
+
+    FeedTorCtlSocket ctl;
+    size_t received = 0;
+    BenchReport::instance().measure([&] {
+        ctl.sendCommand("GETINFO ns/all", [&](const TorCtlReply& reply) {
+            received += reply.lines.front().size();
+        });
+        ctl.feed(lines);
+    }, bytes);
+
+    QVERIFY(received > 0);
+}
+
+void BenchTorCtl::bench_parse_data()
+{
+    QTest::addColumn<QStringList>("lines");
+
+    QTest::newRow("protocolinfo") << QStringList{
+        "PROTOCOLINFO 1",
+        "AUTH METHODS=COOKIE,SAFECOOKIE COOKIEFILE=\"/var/run/tor/control.authcookie\"",
+        "VERSION Tor=\"0.3.4.8\"",
+        "OK"};
+    QTest::newRow("bootstrap-event") << QStringList{
+        "STATUS_CLIENT NOTICE BOOTSTRAP PROGRESS=85 TAG=handshake_or"
+        " SUMMARY=\"Finishing handshake with first hop\""};
+    QTest::newRow("add-onion") << QStringList{
+        "ServiceID=3g2upl4pq6kufc4m3g2upl4pq6kufc4m3g2upl4pq6kufc4m3g2upl4p",
+        "PrivateKey=ED25519-V3:oOyd0dPrxZLcyHvmhbo0X5C9FsG3ABF1KCdxS2bNb1AqvYfDzvZH"
+        "/kiCLB3B7Ogq2k0DzZ0XfSfnDuBgCdxVA3NrTw==",
+        "OK"};
+}
+
+void BenchTorCtl::bench_parse()
+{
+    QFETCH(QStringList, lines);
+
+    TorCtlReply reply;
+    quint64 bytes = 0;
+    for(const auto& line : lines) {
+        reply.lines.push_back(line.toStdString());
+        bytes += static_cast<quint64>(line.size());
+    }
+
+    int keys = 0;
+    BenchReport::instance().measure([&] {
+        keys += reply.parse().size();
+    }, bytes);
+
+    QVERIFY(keys > 0);
+}
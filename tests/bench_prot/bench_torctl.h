@@ -0,0 +1,25 @@
+#ifndef BENCH_TORCTL_H
+#define BENCH_TORCTL_H
+
+#include <QtTest>
+
+/*! Parsing of replies from the Tor control port
+ *
+ * A multi-megabyte data reply, like GETINFO ns/all, fed line by
+ * line through the socket, and the key/value parsing of the
+ * replies and events we get all the time.
+ */
+class BenchTorCtl : public QObject
+{
+    Q_OBJECT
+
+public:
+    BenchTorCtl() = default;
+
+private slots:
+    void bench_data_reply();
+    void bench_parse_data();
+    void bench_parse();
+};
+
+#endif // BENCH_TORCTL_H
@@ -0,0 +1,77 @@
+#include <QDateTime>
+
+#include "bench_verify.h"
+#include "benchreport.h"
+#include "ds/batchverifier.h"
+#include "ds/dscert.h"
+
+using namespace std;
+using ds::crypto::BatchVerifier;
+using ds::crypto::DsCert;
+
+namespace {
+
+// Same size and layout as the signed part of a typical message
+vector<BatchVerifier::Item> makeItems(const DsCert& cert, const int count) {
+    vector<BatchVerifier::Item> items;
+    items.reserve(static_cast<size_t>(count));
+
+    for(int i = 0; i < count; ++i) {
+        BatchVerifier::Item item;
+        item.cert = &cert;
+        item.data = QByteArray("Y29udmVyc2F0aW9uIGlkIGZvciB0ZXN0aW5n")
+                + QByteArray::number(i).toBase64()
+                + QDateTime::currentDateTime().toString(Qt::ISODate).toUtf8()
+                + QByteArray("Hi there! Did you get the files I sent you yesterday?")
+                + QByteArray("c2VuZGVyIGhhc2ggZm9yIHRlc3Rpbmc=")
+                + QByteArray::number(1);
+        item.signature = cert.sign<QByteArray>({item.data});
+        items.push_back(move(item));
+    }
+
+    return items;
+}
+
+} // anonymous namespace
+
+void BenchVerify::initTestCase()
+{
+    cert_ = DsCert::create();
+}
+
+void BenchVerify::bench_verify_data()
+{
+    QTest::addColumn<int>("count");
+    QTest::addColumn<bool>("batched");
+
+    QTest::newRow("single-1000") << 1000 << false;
+    QTest::newRow("batched-1000") << 1000 << true;
+    QTest::newRow("single-10000") << 10000 << false;
+    QTest::newRow("batched-10000") << 10000 << true;
+}
+
+void BenchVerify::bench_verify()
+{
+    QFETCH(int, count);
+    QFETCH(bool, batched);
+
+    const auto items = makeItems(*cert_, count);
+    BatchVerifier verifier;
+    size_t verified = 0;
+
+    const auto ns = BenchReport::instance().measure([&] {
+        verified = 0;
+        if (batched) {
+            for(const auto ok : verifier.verify(items)) {
+                verified += ok;
+            }
+        } else {
+            for(const auto& item : items) {
+                verified += BatchVerifier::verify(item);
+            }
+        }
+    });
+
+    QCOMPARE(verified, items.size());
+    BenchReport::instance().add("verifies", count * 1000000000.0 / ns, "verifies/s");
+}
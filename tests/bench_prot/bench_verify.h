@@ -0,0 +1,26 @@
+#ifndef BENCH_VERIFY_H
+#define BENCH_VERIFY_H
+
+#include <memory>
+
+#include <QtTest>
+
+#include "ds/dscert.h"
+
+class BenchVerify : public QObject
+{
+    Q_OBJECT
+
+public:
+    BenchVerify() = default;
+
+private slots:
+    void initTestCase();
+    void bench_verify_data();
+    void bench_verify();
+
+private:
+    std::shared_ptr<ds::crypto::DsCert> cert_;
+};
+
+#endif // BENCH_VERIFY_H
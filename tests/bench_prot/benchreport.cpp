@@ -0,0 +1,93 @@
+#include <stdexcept>
+
+#include <QtTest>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include "benchreport.h"
+
+using namespace std;
+
+BenchReport &BenchReport::instance()
+{
+    static BenchReport report;
+    return report;
+}
+
+void BenchReport::add(const QString &metric, const double value,
+                      const QString &unit, const quint64 iterations)
+{
+    Result r;
+    r.suite = suite_;
+    r.test = QTest::currentTestFunction();
+    r.tag = QTest::currentDataTag();
+    r.metric = metric;
+    r.value = value;
+    r.unit = unit;
+    r.iterations = iterations;
+
+    qInfo().noquote() << r.test << r.tag << r.metric << ":" << r.value << r.unit;
+
+    results_.push_back(move(r));
+}
+
+double BenchReport::measure(const std::function<void ()>& fn,
+                            const quint64 bytes, const qint64 minMs)
+{
+    // Warm up
+    fn();
+
+    quint64 iterations = 0;
+    QElapsedTimer timer;
+    timer.start();
+    do {
+        fn();
+        ++iterations;
+    } while(timer.elapsed() < minMs);
+
+    const auto nsPerIteration = static_cast<double>(timer.nsecsElapsed()) / iterations;
+
+    QTest::setBenchmarkResult(nsPerIteration / 1000000.0, QTest::WalltimeMilliseconds);
+    add("time", nsPerIteration, "ns", iterations);
+
+    if (bytes) {
+        add("throughput", (bytes * 1000000000.0 / nsPerIteration) / (1024 * 1024),
+            "MB/s", iterations);
+    }
+
+    return nsPerIteration;
+}
+
+void BenchReport::write(const QString &path) const
+{
+    QJsonArray results;
+    for(const auto& r : results_) {
+        results.append(QJsonObject{
+            {"suite", r.suite},
+            {"test", r.test},
+            {"tag", r.tag},
+            {"metric", r.metric},
+            {"value", r.value},
+            {"unit", r.unit},
+            {"iterations", static_cast<double>(r.iterations)}
+        });
+    }
+
+    QJsonObject report{
+        {"date", QDateTime::currentDateTimeUtc().toString(Qt::ISODate)},
+        {"qt", qVersion()},
+        {"results", results}
+    };
+
+    QFile file{path};
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        throw runtime_error("Failed to open " + path.toStdString()
+                            + ": " + file.errorString().toStdString());
+    }
+
+    file.write(QJsonDocument{report}.toJson());
+}
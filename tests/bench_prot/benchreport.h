@@ -0,0 +1,57 @@
+#ifndef BENCHREPORT_H
+#define BENCHREPORT_H
+
+#include <functional>
+#include <vector>
+
+#include <QString>
+
+/*! Collects benchmark results and writes them in json format.
+ *
+ * QTest in Qt 5 has no json output, so each benchmark reports
+ * its results here. Enable with "-json <path>" on the command-line.
+ */
+class BenchReport
+{
+public:
+    struct Result {
+        QString suite;
+        QString test;
+        QString tag;
+        QString metric;
+        double value = {};
+        QString unit;
+        quint64 iterations = {};
+    };
+
+    static BenchReport& instance();
+
+    // Name of the test-class currently running
+    void setSuite(const QString& suite) { suite_ = suite; }
+
+    // Add a result for the current test function and data-tag
+    void add(const QString& metric, const double value,
+             const QString& unit, const quint64 iterations = 1);
+
+    /*! Run fn repeatedly for at least minMs milliseconds.
+     *
+     * Reports the time per iteration, and the throughput
+     * if bytes (per iteration) is given.
+     *
+     * \return Nanoseconds per iteration
+     */
+    double measure(const std::function<void ()>& fn,
+                   const quint64 bytes = 0,
+                   const qint64 minMs = 250);
+
+    // Write the results to path. Throws on error.
+    void write(const QString& path) const;
+
+private:
+    BenchReport() = default;
+
+    QString suite_;
+    std::vector<Result> results_;
+};
+
+#endif // BENCHREPORT_H
@@ -0,0 +1,73 @@
+#include <QtTest>
+
+#include <iostream>
+#include <vector>
+#include "ds/crypto.h"
+#include "bench_certcache.h"
+#include "bench_cipher.h"
+#include "bench_codecs.h"
+#include "bench_compression.h"
+#include "bench_loopback.h"
+#include "bench_securearena.h"
+#include "bench_torctl.h"
+#include "bench_verify.h"
+#include "benchreport.h"
+
+#include "logfault/logfault.h"
+
+namespace {
+
+template <typename T>
+int run(std::vector<char *>& args)
+{
+    T tc;
+    BenchReport::instance().setSuite(tc.metaObject()->className());
+    return QTest::qExec(&tc, static_cast<int>(args.size()), args.data());
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+    QCoreApplication app(argc, argv);
+
+    logfault::LogManager::Instance().AddHandler(
+                std::make_unique<logfault::StreamHandler>(
+                    std::clog, logfault::LogLevel::WARN));
+
+    // "-json <path>" is our own option. The rest goes to QTest.
+    QString jsonPath;
+    std::vector<char *> args;
+    for(int i = 0; i < argc; ++i) {
+        if ((std::string{argv[i]} == "-json") && (i + 1 < argc)) {
+            jsonPath = QString::fromLocal8Bit(argv[++i]);
+            continue;
+        }
+        args.push_back(argv[i]);
+    }
+
+    // initialize libsodium
+    ds::crypto::Crypto crypto;
+
+    int status = 0;
+
+    status |= run<BenchCertCache>(args);
+    status |= run<BenchCipher>(args);
+    status |= run<BenchCodecs>(args);
+    status |= run<BenchCompression>(args);
+    status |= run<BenchLoopback>(args);
+    status |= run<BenchSecureArena>(args);
+    status |= run<BenchTorCtl>(args);
+    status |= run<BenchVerify>(args);
+
+    if (!jsonPath.isEmpty()) {
+        try {
+            BenchReport::instance().write(jsonPath);
+        } catch(const std::exception& ex) {
+            std::cerr << ex.what() << std::endl;
+            status |= 1;
+        }
+    }
+
+    return status;
+}
@@ -0,0 +1,18 @@
+# A stand-in for the tor binary, for the tests of TorConfig::Mode::PRIVATE.
+# Speaks enough of the control protocol for TorController.
+
+QT += core network
+QT -= gui
+
+CONFIG += console
+CONFIG -= app_bundle
+
+unix {
+    CONFIG += c++14
+}
+
+TEMPLATE = app
+TARGET = faketor
+
+SOURCES += \
+    main.cpp
@@ -0,0 +1,294 @@
+/* Fake tor
+ *
+ * Accepts the command line we give tor in TorConfig::Mode::PRIVATE,
+ * writes the control port to the ControlPortWriteToFile file, and
+ * answers the control commands that TorController uses.
+ *
+ * The first run "bootstraps" for a few hundred milliseconds. It then
+ * leaves a cached consensus in the DataDirectory, so the next run is
+ * online right away, like the real thing.
+ */
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <random>
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QMessageAuthenticationCode>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+
+using namespace std;
+
+namespace {
+
+QByteArray randomBytes(const int len)
+{
+    static random_device rd;
+    QByteArray bytes;
+    for(int i = 0; i < len; ++i) {
+        bytes += static_cast<char>(rd() & 0xff);
+    }
+    return bytes;
+}
+
+QByteArray randomServiceId()
+{
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz234567";
+    QByteArray id;
+    for(const auto ch : randomBytes(56)) {
+        id += alphabet[static_cast<unsigned char>(ch) % 32];
+    }
+    return id;
+}
+
+class FakeTor
+{
+public:
+    FakeTor(const QString& dataDir, const QString& portFile)
+        : dataDir_{dataDir}, portFile_{portFile}
+        , warm_{QFile::exists(QDir{dataDir}.filePath("cached-consensus"))}
+    {
+    }
+
+    bool start()
+    {
+        cookie_ = randomBytes(32);
+        QFile cookieFile{cookiePath()};
+        if (!cookieFile.open(QIODevice::WriteOnly) || (cookieFile.write(cookie_) != 32)) {
+            return false;
+        }
+        cookieFile.close();
+
+        if (!socks_.listen(QHostAddress::LocalHost, 0)
+                || !control_.listen(QHostAddress::LocalHost, 0)) {
+            return false;
+        }
+
+        QObject::connect(&control_, &QTcpServer::newConnection, [this] {
+            while(auto socket = control_.nextPendingConnection()) {
+                onConnection(socket);
+            }
+        });
+
+        if (warm_) {
+            progress_ = 100;
+        }
+
+        // Like tor; write to a temporary file and rename it
+        const auto tmp = portFile_ + ".tmp";
+        QFile file{tmp};
+        if (!file.open(QIODevice::WriteOnly)) {
+            return false;
+        }
+        file.write("PORT=127.0.0.1:" + QByteArray::number(control_.serverPort()) + "\n");
+        file.close();
+        QFile::remove(portFile_);
+        return QFile::rename(tmp, portFile_);
+    }
+
+private:
+    struct Session {
+        bool authenticated = false;
+        bool owner = false;
+        bool events = false;
+        QByteArray clientHash;
+    };
+
+    QString cookiePath() const
+    {
+        return QDir{dataDir_}.filePath("control_auth_cookie");
+    }
+
+    void onConnection(QTcpSocket *socket)
+    {
+        sessions_[socket] = make_unique<Session>();
+
+        QObject::connect(socket, &QTcpSocket::readyRead, [this, socket] {
+            while(socket->canReadLine()) {
+                onCommand(*socket, *sessions_[socket], socket->readLine().trimmed());
+            }
+        });
+
+        QObject::connect(socket, &QTcpSocket::disconnected, [this, socket] {
+            const bool owner = sessions_[socket]->owner;
+            sessions_.erase(socket);
+            socket->deleteLater();
+            if (owner) {
+                QCoreApplication::exit(0);
+            }
+        });
+    }
+
+    void onCommand(QTcpSocket& socket, Session& session, const QByteArray& line)
+    {
+        const auto space = line.indexOf(' ');
+        const auto cmd = line.left(space).toUpper();
+        const auto args = (space > 0) ? line.mid(space + 1) : QByteArray{};
+
+        if (cmd == "PROTOCOLINFO") {
+            socket.write("250-PROTOCOLINFO 1\r\n"
+                         "250-AUTH METHODS=COOKIE,SAFECOOKIE COOKIEFILE=\""
+                         + cookiePath().toUtf8() + "\"\r\n"
+                         "250-VERSION Tor=\"0.4.8.0-fake\"\r\n"
+                         "250 OK\r\n");
+        } else if (cmd == "AUTHCHALLENGE") {
+            const auto clientNonce = QByteArray::fromHex(args.mid(args.indexOf(' ') + 1));
+            const auto serverNonce = randomBytes(32);
+            const auto message = cookie_ + clientNonce + serverNonce;
+            const auto serverHash = QMessageAuthenticationCode::hash(
+                        message, "Tor safe cookie authentication server-to-controller hash",
+                        QCryptographicHash::Sha256);
+            session.clientHash = QMessageAuthenticationCode::hash(
+                        message, "Tor safe cookie authentication controller-to-server hash",
+                        QCryptographicHash::Sha256);
+            socket.write("250 AUTHCHALLENGE SERVERHASH=" + serverHash.toHex().toUpper()
+                         + " SERVERNONCE=" + serverNonce.toHex().toUpper() + "\r\n");
+        } else if (cmd == "AUTHENTICATE") {
+            const auto hash = QByteArray::fromHex(args);
+            session.authenticated = (hash == cookie_)
+                    || (!session.clientHash.isEmpty() && (hash == session.clientHash));
+            socket.write(session.authenticated
+                         ? "250 OK\r\n" : "515 Authentication failed\r\n");
+        } else if (cmd == "QUIT") {
+            socket.write("250 closing connection\r\n");
+            socket.disconnectFromHost();
+        } else if (!session.authenticated) {
+            socket.write("514 Authentication required.\r\n");
+            socket.disconnectFromHost();
+        } else if (cmd == "TAKEOWNERSHIP") {
+            session.owner = true;
+            socket.write("250 OK\r\n");
+        } else if (cmd == "SETEVENTS") {
+            session.events = args.contains("STATUS_CLIENT");
+            socket.write("250 OK\r\n");
+            bootstrap();
+        } else if (cmd == "GETINFO") {
+            onGetInfo(socket, args);
+        } else if (cmd == "ADD_ONION") {
+            const auto serviceId = randomServiceId();
+            socket.write("250-ServiceID=" + serviceId + "\r\n");
+            if (args.startsWith("NEW:")) {
+                socket.write("250-PrivateKey=ED25519-V3:" + randomBytes(64).toBase64() + "\r\n");
+            }
+            socket.write("250 OK\r\n");
+            QTimer::singleShot(50, [this, serviceId] {
+                event("650 HS_DESC UPLOADED " + serviceId + " UNKNOWN $"
+                      + randomBytes(20).toHex().toUpper() + "~relay");
+            });
+        } else if (cmd == "DEL_ONION") {
+            socket.write("250 OK\r\n");
+        } else {
+            socket.write("510 Unrecognized command \"" + cmd + "\"\r\n");
+        }
+    }
+
+    void onGetInfo(QTcpSocket& socket, const QByteArray& key)
+    {
+        if (key == "status/bootstrap-phase") {
+            socket.write("250-status/bootstrap-phase=" + bootstrapStatus() + "\r\n250 OK\r\n");
+        } else if (key == "net/listeners/socks") {
+            socket.write("250-net/listeners/socks=\"127.0.0.1:"
+                         + QByteArray::number(socks_.serverPort()) + "\"\r\n250 OK\r\n");
+        } else {
+            socket.write("552 Unrecognized key \"" + key + "\"\r\n");
+        }
+    }
+
+    QByteArray bootstrapStatus() const
+    {
+        if (progress_ == 100) {
+            return "NOTICE BOOTSTRAP PROGRESS=100 TAG=done SUMMARY=\"Done\"";
+        }
+        return "NOTICE BOOTSTRAP PROGRESS=" + QByteArray::number(progress_)
+                + " TAG=loading_descriptors SUMMARY=\"Loading relay descriptors\"";
+    }
+
+    // Cold start. Done when the consensus is "downloaded".
+    void bootstrap()
+    {
+        if (bootstrapping_ || (progress_ == 100)) {
+            return;
+        }
+
+        bootstrapping_ = true;
+        auto timer = new QTimer;
+        timer->setInterval(100);
+        QObject::connect(timer, &QTimer::timeout, [this, timer] {
+            progress_ = min(100, progress_ + 25);
+            event("650 STATUS_CLIENT " + bootstrapStatus());
+
+            if (progress_ == 100) {
+                event("650 STATUS_CLIENT NOTICE CIRCUIT_ESTABLISHED");
+
+                QFile consensus{QDir{dataDir_}.filePath("cached-consensus")};
+                if (consensus.open(QIODevice::WriteOnly)) {
+                    consensus.write("fake\n");
+                }
+
+                timer->stop();
+                timer->deleteLater();
+            }
+        });
+        timer->start();
+    }
+
+    void event(const QByteArray& line)
+    {
+        for(auto& it : sessions_) {
+            if (it.second->events) {
+                it.first->write(line + "\r\n");
+            }
+        }
+    }
+
+    const QString dataDir_;
+    const QString portFile_;
+    const bool warm_;
+    QByteArray cookie_;
+    QTcpServer control_;
+    QTcpServer socks_;
+    map<QTcpSocket *, unique_ptr<Session>> sessions_;
+    int progress_ = 0;
+    bool bootstrapping_ = false;
+};
+
+} // anonymous namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    // Options with a value. The rest are flags.
+    std::map<QString, QString> options;
+    const auto args = app.arguments();
+    for(int i = 1; i < args.size(); ++i) {
+        if (args[i] == "--ignore-missing-torrc") {
+            continue;
+        }
+        if (args[i].startsWith('-') && (i + 1 < args.size())) {
+            options[args[i]] = args[i + 1];
+            ++i;
+        }
+    }
+
+    const auto dataDir = options["--DataDirectory"];
+    const auto portFile = options["--ControlPortWriteToFile"];
+    if (dataDir.isEmpty() || portFile.isEmpty()) {
+        qCritical("Usage: faketor --DataDirectory dir --ControlPortWriteToFile file");
+        return 1;
+    }
+
+    FakeTor tor{dataDir, portFile};
+    if (!tor.start()) {
+        qCritical("Failed to start");
+        return 1;
+    }
+
+    qInfo("Fake tor is running");
+    return app.exec();
+}
@@ -3,6 +3,23 @@
 #include <iostream>
 #include "ds/crypto.h"
 #include "tst_dsengine.h"
+#include "tst_transferscheduler.h"
+#include "tst_metrics.h"
+#include "tst_tracer.h"
+#include "tst_reconnectscheduler.h"
+#include "tst_timerwheel.h"
+#include "tst_collision.h"
+#include "tst_deadlines.h"
+#include "tst_keepalive.h"
+#include "tst_multiplexer.h"
+#include "tst_cryptoexecutor.h"
+#include "tst_sessiontickets.h"
+#include "tst_compression.h"
+#include "tst_certcache.h"
+#include "tst_streamcipher.h"
+#include "tst_tokenbucket.h"
+#include "tst_connectionsocket.h"
+#include "tst_hashtask.h"
 
 #include "logfault/logfault.h"
 
@@ -28,6 +45,91 @@ int main(int argc, char** argv)
          status |= QTest::qExec(&tc, argc, argv);
      }
 
+     {
+         TestTransferScheduler tc;
+         status |= QTest::qExec(&tc, argc, argv);
+     }
+
+     {
+         TestMetrics tc;
+         status |= QTest::qExec(&tc, argc, argv);
+     }
+
+     {
+         TestTracer tc;
+         status |= QTest::qExec(&tc, argc, argv);
+     }
+
+     {
+         TestReconnectScheduler tc;
+         status |= QTest::qExec(&tc, argc, argv);
+     }
+
+     {
+         TestTimerWheel tc;
+         status |= QTest::qExec(&tc, argc, argv);
+     }
+
+     {
+         TestCollision tc;
+         status |= QTest::qExec(&tc, argc, argv);
+     }
+
+     {
+         TestDeadlines tc;
+         status |= QTest::qExec(&tc, argc, argv);
+     }
+
+     {
+         TestKeepalive tc;
+         status |= QTest::qExec(&tc, argc, argv);
+     }
+
+     {
+         TestMultiplexer tc;
+         status |= QTest::qExec(&tc, argc, argv);
+     }
+
+     {
+         TestCryptoExecutor tc;
+         status |= QTest::qExec(&tc, argc, argv);
+     }
+
+     {
+         TestTokenBucket tc;
+         status |= QTest::qExec(&tc, argc, argv);
+     }
+
+     {
+         TestConnectionSocket tc;
+         status |= QTest::qExec(&tc, argc, argv);
+     }
+
+     {
+         TestHashTask tc;
+         status |= QTest::qExec(&tc, argc, argv);
+     }
+
+     {
+         TestSessionTickets tc;
+         status |= QTest::qExec(&tc, argc, argv);
+     }
+
+     {
+         TestCompression tc;
+         status |= QTest::qExec(&tc, argc, argv);
+     }
+
+     {
+         TestCertCache tc;
+         status |= QTest::qExec(&tc, argc, argv);
+     }
+
+     {
+         TestStreamCipher tc;
+         status |= QTest::qExec(&tc, argc, argv);
+     }
+
 
     return status;
 }
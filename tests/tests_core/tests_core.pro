@@ -7,10 +7,44 @@ TEMPLATE = app
 
 SOURCES +=  \
     main.cpp \
-    tst_dsengine.cpp
+    tst_dsengine.cpp \
+    tst_transferscheduler.cpp \
+    tst_metrics.cpp \
+    tst_reconnectscheduler.cpp \
+    tst_timerwheel.cpp \
+    tst_collision.cpp \
+    tst_tokenbucket.cpp \
+    tst_connectionsocket.cpp \
+    tst_hashtask.cpp \
+    tst_tracer.cpp \
+    tst_deadlines.cpp \
+    tst_keepalive.cpp \
+    tst_multiplexer.cpp \
+    tst_cryptoexecutor.cpp \
+    tst_sessiontickets.cpp \
+    tst_compression.cpp \
+    tst_certcache.cpp \
+    tst_streamcipher.cpp
 
 HEADERS += \
-    tst_dsengine.h
+    tst_dsengine.h \
+    tst_transferscheduler.h \
+    tst_metrics.h \
+    tst_reconnectscheduler.h \
+    tst_timerwheel.h \
+    tst_collision.h \
+    tst_tokenbucket.h \
+    tst_connectionsocket.h \
+    tst_hashtask.h \
+    tst_tracer.h \
+    tst_deadlines.h \
+    tst_keepalive.h \
+    tst_multiplexer.h \
+    tst_cryptoexecutor.h \
+    tst_sessiontickets.h \
+    tst_compression.h \
+    tst_certcache.h \
+    tst_streamcipher.h
 
 INCLUDEPATH += \
     $$PWD/../../dependencies/logfault/include \
@@ -71,4 +105,4 @@ else:win32:!win32-g++:CONFIG(release, debug|release): PRE_TARGETDEPS += $$OUT_PW
 else:win32:!win32-g++:CONFIG(debug, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../../src/torlib/debug/torlib.lib
 else:unix: PRE_TARGETDEPS += $$OUT_PWD/../../src/torlib/libtorlib.a
 
-LIBS += -lsodium
+LIBS += -lsodium -lz
@@ -0,0 +1,85 @@
+#include <vector>
+
+#include "tst_certcache.h"
+#include "ds/certcache.h"
+#include "ds/dscert.h"
+
+using namespace std;
+using ds::core::CertCache;
+using ds::crypto::DsCert;
+
+namespace {
+
+QByteArray toByteArray(const DsCert::safe_view_t& view) {
+    return {reinterpret_cast<const char *>(view.cdata()), static_cast<int>(view.size())};
+}
+
+} // anonymous namespace
+
+void TestCertCache::initTestCase()
+{
+    for(int i = 0; i < 16; ++i) {
+        pubkeys_.append(toByteArray(DsCert::create()->getSigningPubKey()));
+    }
+}
+
+void TestCertCache::test_lru()
+{
+    CertCache cache{4};
+
+    // Look up, and cache it as if the signature was verified
+    auto get = [&cache](const QByteArray& pubkey) {
+        auto cert = cache.getFromPubkey(pubkey);
+        cache.add(pubkey, cert);
+        return cert;
+    };
+
+    const auto first = get(pubkeys_[0]);
+    QCOMPARE(cache.getFromPubkey(pubkeys_[0]), first);
+    QCOMPARE(toByteArray(first->getSigningPubKey()), pubkeys_[0]);
+
+    // Keep #0 recently used while the others push out the oldest
+    const auto second = get(pubkeys_[1]);
+    for(int i = 2; i < 8; ++i) {
+        get(pubkeys_[0]);
+        get(pubkeys_[i]);
+    }
+
+    QCOMPARE(cache.size(), size_t{4});
+    QCOMPARE(cache.getFromPubkey(pubkeys_[0]), first);
+
+    // Evicted, so we get a new instance
+    QVERIFY(get(pubkeys_[1]) != second);
+    QCOMPARE(cache.size(), size_t{4});
+
+    // Invalid keys are not cached
+    QVERIFY_EXCEPTION_THROWN(cache.getFromPubkey("too short"), std::exception);
+    QCOMPARE(cache.size(), size_t{4});
+
+    cache.setCapacity(0);
+    QCOMPARE(cache.size(), size_t{0});
+    const auto uncached = get(pubkeys_[0]);
+    QVERIFY(uncached != get(pubkeys_[0]));
+    QCOMPARE(cache.size(), size_t{0});
+}
+
+void TestCertCache::test_lookup_does_not_evict()
+{
+    CertCache cache{4};
+
+    vector<DsCert::ptr_t> known;
+    for(int i = 0; i < 4; ++i) {
+        known.push_back(cache.getFromPubkey(pubkeys_[i]));
+        cache.add(pubkeys_[i], known.back());
+    }
+
+    // Pubkeys that never proved anything must not push out the known ones
+    for(int i = 4; i < pubkeys_.size(); ++i) {
+        QVERIFY(cache.getFromPubkey(pubkeys_[i]));
+    }
+
+    QCOMPARE(cache.size(), size_t{4});
+    for(int i = 0; i < 4; ++i) {
+        QCOMPARE(cache.getFromPubkey(pubkeys_[i]), known[static_cast<size_t>(i)]);
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef TST_CERTCACHE_H
+#define TST_CERTCACHE_H
+
+#include <QtTest>
+
+class TestCertCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestCertCache() = default;
+
+private slots:
+    void initTestCase();
+    void test_lru();
+    void test_lookup_does_not_evict();
+
+private:
+    QList<QByteArray> pubkeys_;
+};
+
+#endif // TST_CERTCACHE_H
@@ -0,0 +1,115 @@
+#include <set>
+#include <vector>
+
+#include "tst_collision.h"
+#include "ds/loopbackprotocolmanager.h"
+#include "ds/transporthandle.h"
+
+using namespace std;
+using namespace ds::core;
+
+void TestCollision::initTestCase()
+{
+    QVERIFY(dir_.isValid());
+    settings_ = make_unique<QSettings>(dir_.filePath("collision.ini"), QSettings::IniFormat);
+    settings_->setValue("transport", "loopback");
+
+    mgr_ = ProtocolManager::create(*settings_, ProtocolManager::Transport::TOR);
+    QVERIFY(dynamic_cast<ds::prot::LoopbackProtocolManager *>(mgr_.get()));
+    mgr_->start();
+    QVERIFY(mgr_->isOnline());
+
+    startService(alice_, "alice");
+    startService(bob_, "bob");
+}
+
+void TestCollision::cleanupTestCase()
+{
+    if (mgr_) {
+        mgr_->stop();
+    }
+}
+
+void TestCollision::test_simultaneous_connect()
+{
+    vector<PeerConnection::ptr_t> incoming;
+    auto onIncoming = connect(mgr_.get(), &ProtocolManager::incomingPeer,
+                              this, [&incoming](const shared_ptr<PeerConnection>& peer) {
+        incoming.push_back(peer);
+        peer->authorize(true);
+    });
+
+    // Connect both ways before any of the handshakes can progress
+    const auto aliceToBob = mgr_->connectTo(getConnectData(alice_, bob_));
+    const auto bobToAlice = mgr_->connectTo(getConnectData(bob_, alice_));
+
+    // A peer may report the disconnect more than once
+    vector<PeerConnection *> connected;
+    set<PeerConnection *> disconnected;
+    for(const auto& client : {aliceToBob, bobToAlice}) {
+        connect(client.get(), &PeerConnection::connectedToPeer,
+                this, [&connected](const shared_ptr<PeerConnection>& peer) {
+            connected.push_back(peer.get());
+        });
+        connect(client.get(), &PeerConnection::disconnectedFromPeer,
+                this, [&disconnected](const shared_ptr<PeerConnection>& peer) {
+            disconnected.insert(peer.get());
+        });
+    }
+
+    QTRY_VERIFY_WITH_TIMEOUT((connected.size() == 1) && (disconnected.size() == 1), 10000);
+
+    // Let any late decisions play out
+    QTest::qWait(500);
+
+    QCOMPARE(connected.size(), size_t{1});
+    QCOMPARE(disconnected.size(), size_t{1});
+    QCOMPARE(incoming.size(), size_t{1});
+    QVERIFY(disconnected.count(connected.front()) == 0);
+
+    auto survivor = connected.front() == aliceToBob.get() ? aliceToBob : bobToAlice;
+    QVERIFY(survivor->isConnected());
+    QVERIFY(incoming.front()->isConnected());
+    QCOMPARE(incoming.front()->getIdentityId(),
+             survivor == aliceToBob ? bob_.uuid : alice_.uuid);
+
+    disconnect(onIncoming);
+    survivor->close();
+}
+
+void TestCollision::startService(TestCollision::Endpoint &ep, const QString &name)
+{
+    TransportHandle th;
+    auto conn = connect(mgr_.get(), &ProtocolManager::transportHandleReady,
+                        this, [&th](const TransportHandle& handle) {
+        th = handle;
+    });
+
+    mgr_->createTransportHandle({name, ep.uuid});
+    disconnect(conn);
+
+    QCOMPARE(th.uuid, ep.uuid);
+    ep.address = th.data["address"].toByteArray();
+
+    bool started = false;
+    conn = connect(mgr_.get(), &ProtocolManager::serviceStarted,
+                   this, [&started, &ep](const QUuid& uuid, const bool) {
+        started = (uuid == ep.uuid);
+    });
+    mgr_->startService(ep.uuid, ep.cert, th.data);
+    disconnect(conn);
+
+    QVERIFY(started);
+}
+
+ConnectData TestCollision::getConnectData(const TestCollision::Endpoint &from,
+                                          const TestCollision::Endpoint &to) const
+{
+    ConnectData cd;
+    cd.service = from.uuid;
+    cd.address = to.address;
+    cd.identitysCert = from.cert;
+    cd.contactsCert = ds::crypto::DsCert::createFromPubkey(
+                to.cert->getSigningPubKey().toByteArray());
+    return cd;
+}
@@ -0,0 +1,101 @@
+#include <stdexcept>
+
+#include <QtEndian>
+
+#include "tst_compression.h"
+#include "ds/compression.h"
+
+using namespace std;
+using ds::prot::Compression;
+
+namespace {
+
+constexpr size_t max_bytes = 1024 * 256;
+
+// Looks like a log-file
+QByteArray makeText(const int bytes) {
+    QByteArray data;
+    for(int i = 0; data.size() < bytes; ++i) {
+        data += QStringLiteral("2019-03-14 12:14:%1.%2 DEBUG 42 Peer.cpp:%3 Received chunk\n")
+                .arg(i % 60).arg(i % 1000).arg(i % 700).toUtf8();
+    }
+    data.resize(bytes);
+    return data;
+}
+
+QByteArray compress(const QByteArray& data) {
+    return Compression::compress(data.constData(), static_cast<size_t>(data.size()));
+}
+
+QByteArray decompress(const QByteArray& data) {
+    return Compression::decompress(data.constData(), static_cast<size_t>(data.size()), max_bytes);
+}
+
+// Replace the uncompressed length in the header
+void setHeader(QByteArray& data, const quint32 bytes) {
+    qToBigEndian(bytes, reinterpret_cast<uchar *>(data.data()));
+}
+
+} // anonymous namespace
+
+void TestCompression::test_roundtrip()
+{
+    const auto data = makeText(1024 * 8);
+    const auto compressed = compress(data);
+    QVERIFY(compressed.size() < data.size());
+    QCOMPARE(decompress(compressed), data);
+}
+
+void TestCompression::test_empty()
+{
+    const auto compressed = compress({});
+    QVERIFY(decompress(compressed).isEmpty());
+}
+
+void TestCompression::test_is_compressible()
+{
+    QVERIFY(Compression::isCompressible("server.log"));
+    QVERIFY(Compression::isCompressible("README"));
+    QVERIFY(!Compression::isCompressible("cutecat.JPG"));
+    QVERIFY(!Compression::isCompressible("backup.tar.gz"));
+}
+
+void TestCompression::test_reject_oversized()
+{
+    const QByteArray data(1024 * 1024, 'x');
+    QVERIFY_EXCEPTION_THROWN(decompress(compress(data)), runtime_error);
+}
+
+void TestCompression::test_reject_understated_size()
+{
+    // Expands to 32 MB, but claims to be tiny
+    const QByteArray data(1024 * 1024 * 32, 'x');
+    auto compressed = compress(data);
+    QVERIFY(static_cast<size_t>(compressed.size()) < max_bytes);
+
+    setHeader(compressed, 16);
+    QVERIFY_EXCEPTION_THROWN(decompress(compressed), runtime_error);
+
+    setHeader(compressed, static_cast<quint32>(max_bytes));
+    QVERIFY_EXCEPTION_THROWN(decompress(compressed), runtime_error);
+}
+
+void TestCompression::test_reject_overstated_size()
+{
+    const auto data = makeText(1024 * 8);
+    auto compressed = compress(data);
+
+    setHeader(compressed, static_cast<quint32>(data.size() + 1));
+    QVERIFY_EXCEPTION_THROWN(decompress(compressed), runtime_error);
+}
+
+void TestCompression::test_reject_truncated()
+{
+    const auto data = makeText(1024 * 8);
+    auto compressed = compress(data);
+
+    compressed.chop(8);
+    QVERIFY_EXCEPTION_THROWN(decompress(compressed), runtime_error);
+
+    QVERIFY_EXCEPTION_THROWN(decompress(compressed.left(3)), runtime_error);
+}
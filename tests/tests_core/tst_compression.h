@@ -0,0 +1,23 @@
+#ifndef TST_COMPRESSION_H
+#define TST_COMPRESSION_H
+
+#include <QtTest>
+
+class TestCompression : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestCompression() = default;
+
+private slots:
+    void test_roundtrip();
+    void test_empty();
+    void test_is_compressible();
+    void test_reject_oversized();
+    void test_reject_understated_size();
+    void test_reject_overstated_size();
+    void test_reject_truncated();
+};
+
+#endif // TST_COMPRESSION_H
@@ -0,0 +1,116 @@
+#include "tst_connectionsocket.h"
+
+#include "ds/metrics.h"
+
+using namespace std;
+using ds::prot::ConnectionSocket;
+
+namespace {
+
+constexpr int kb = 1024;
+
+} // anonymous namespace
+
+void TestConnectionSocket::init()
+{
+    server_ = make_unique<QTcpServer>();
+    QVERIFY(server_->listen(QHostAddress::LocalHost));
+
+    client_ = make_unique<ConnectionSocket>("127.0.0.1", server_->serverPort());
+    QSignalSpy spy_connected(client_.get(), SIGNAL(connectedToHost(QUuid)));
+    client_->connectToDefaultHost();
+
+    QVERIFY(server_->waitForNewConnection(5000));
+    peer_ = server_->nextPendingConnection();
+    QVERIFY(peer_);
+    QVERIFY(spy_connected.count() || spy_connected.wait(5000));
+
+    received_.clear();
+    connect(peer_, &QTcpSocket::readyRead, this, [this] {
+        received_ += peer_->readAll();
+    });
+}
+
+void TestConnectionSocket::cleanup()
+{
+    client_.reset();
+    server_.reset();
+    peer_ = {};
+}
+
+QByteArray TestConnectionSocket::makeData(const int size) const
+{
+    QByteArray data;
+    data.reserve(size);
+    for(int i = 0; i < size; ++i) {
+        data += static_cast<char>(i % 251);
+    }
+    return data;
+}
+
+void TestConnectionSocket::test_chunked_output()
+{
+    const auto data = makeData(1024 * kb);
+
+    client_->write(data);
+
+    // Only a limited part of the buffer is handed over to QTcpSocket
+    QVERIFY(client_->bytesToWrite() <= 64 * kb);
+    QCOMPARE(static_cast<qint64>(client_->getOutputBufferSize()) + client_->bytesToWrite(),
+             static_cast<qint64>(data.size()));
+
+    QTRY_COMPARE_WITH_TIMEOUT(received_.size(), data.size(), 10000);
+    QCOMPARE(received_, data);
+    QCOMPARE(client_->getOutputBufferSize(), static_cast<size_t>(0));
+}
+
+void TestConnectionSocket::test_watermarks()
+{
+    client_->setWatermarks(64 * kb, 256 * kb);
+    QSignalSpy spy_low(client_.get(), SIGNAL(belowLowWatermark()));
+    QSignalSpy spy_empty(client_.get(), SIGNAL(outputBufferEmptied()));
+
+    const auto block = makeData(64 * kb);
+    int blocks = 0;
+    while(!client_->isAboveHighWatermark()) {
+        client_->write(block);
+        ++blocks;
+    }
+
+    QVERIFY(blocks > 4);
+    QVERIFY(!client_->isBelowLowWatermark());
+    QCOMPARE(spy_low.count(), 0);
+
+    QTRY_COMPARE_WITH_TIMEOUT(spy_low.count(), 1, 10000);
+    QTRY_COMPARE_WITH_TIMEOUT(received_.size(), blocks * block.size(), 10000);
+    QTRY_VERIFY_WITH_TIMEOUT(spy_empty.count() > 0, 10000);
+
+    // Only once for each time we cross the high watermark
+    QCOMPARE(spy_low.count(), 1);
+}
+
+void TestConnectionSocket::test_no_low_watermark_below_high()
+{
+    client_->setWatermarks(64 * kb, 256 * kb);
+    QSignalSpy spy_low(client_.get(), SIGNAL(belowLowWatermark()));
+
+    const auto data = makeData(128 * kb);
+    client_->write(data);
+
+    QTRY_COMPARE_WITH_TIMEOUT(received_.size(), data.size(), 10000);
+    QCOMPARE(spy_low.count(), 0);
+}
+
+void TestConnectionSocket::test_hard_limit_closes()
+{
+    auto& overflows = ds::core::Metrics::instance().counter("prot.socket.overflows");
+    const auto before = overflows.get();
+    QSignalSpy spy_disconnected(peer_, SIGNAL(disconnected()));
+
+    // The producer ignores the watermarks
+    client_->write(makeData(5 * 1024 * kb));
+
+    QCOMPARE(overflows.get(), before + 1);
+    QVERIFY(!client_->isOpen());
+    QVERIFY(spy_disconnected.count() || spy_disconnected.wait(5000));
+}
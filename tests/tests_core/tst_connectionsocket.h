@@ -0,0 +1,36 @@
+#ifndef TST_CONNECTIONSOCKET_H
+#define TST_CONNECTIONSOCKET_H
+
+#include <memory>
+
+#include <QtTest>
+#include <QTcpServer>
+
+#include "ds/connectionsocket.h"
+
+/*! The output queue of ConnectionSocket, over a local TCP connection */
+class TestConnectionSocket : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestConnectionSocket() = default;
+
+private slots:
+    void init();
+    void cleanup();
+    void test_chunked_output();
+    void test_watermarks();
+    void test_no_low_watermark_below_high();
+    void test_hard_limit_closes();
+
+private:
+    QByteArray makeData(const int size) const;
+
+    std::unique_ptr<QTcpServer> server_;
+    std::unique_ptr<ds::prot::ConnectionSocket> client_;
+    QTcpSocket *peer_ = {};
+    QByteArray received_;
+};
+
+#endif // TST_CONNECTIONSOCKET_H
@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "tst_cryptoexecutor.h"
+
+using namespace std;
+using ds::core::CryptoExecutor;
+
+namespace {
+
+QString whatOf(const exception_ptr& failure) {
+    try {
+        rethrow_exception(failure);
+    } catch(const std::exception& ex) {
+        return ex.what();
+    }
+
+    return {};
+}
+
+} // anonymous namespace
+
+void TestCryptoExecutor::cleanup()
+{
+    CryptoExecutor::instance().setThreads(0);
+}
+
+void TestCryptoExecutor::test_without_threads()
+{
+    auto& executor = CryptoExecutor::instance();
+    executor.setThreads(0);
+    QVERIFY(!executor.isEnabled());
+
+    // Both run before post() returns
+    QObject context;
+    bool ran = false, done = false;
+    executor.post(this, [&ran] {
+        ran = true;
+    }, &context, [&done](const exception_ptr& failure) {
+        done = !failure;
+    });
+
+    QVERIFY(ran);
+    QVERIFY(done);
+
+    exception_ptr failure;
+    executor.post(this, [] {
+        throw runtime_error("failed");
+    }, &context, [&failure](const exception_ptr& f) {
+        failure = f;
+    });
+
+    QVERIFY(failure);
+    QCOMPARE(whatOf(failure), QStringLiteral("failed"));
+}
+
+void TestCryptoExecutor::test_per_key_ordering()
+{
+    auto& executor = CryptoExecutor::instance();
+    executor.setThreads(4);
+    QCOMPARE(executor.getThreads(), size_t{4});
+
+    constexpr size_t num_keys = 8;
+    constexpr size_t jobs_per_key = 100;
+    const array<int, num_keys> keys = {};
+
+    mutex lock;
+    map<const void *, vector<int>> ran; // Sequence numbers, in the order the jobs ran
+    map<const void *, vector<int>> completed;
+    bool onMainThread = true;
+
+    QObject context;
+    for(int seq = 0; seq < static_cast<int>(jobs_per_key); ++seq) {
+        for(const auto& k : keys) {
+            const void *key = &k;
+            executor.post(key, [&lock, &ran, key, seq] {
+                lock_guard<mutex> guard{lock};
+                ran[key].push_back(seq);
+            }, &context, [&completed, &onMainThread, key, seq](const exception_ptr& failure) {
+                onMainThread &= (QThread::currentThread() == qApp->thread());
+                if (!failure) {
+                    completed[key].push_back(seq);
+                }
+            });
+        }
+    }
+
+    QTRY_VERIFY_WITH_TIMEOUT(completed.size() == num_keys
+                             && all_of(completed.begin(), completed.end(), [](const auto& it) {
+                                    return it.second.size() == jobs_per_key;
+                             }), 10000);
+    QVERIFY(onMainThread);
+
+    vector<int> expected(jobs_per_key);
+    iota(expected.begin(), expected.end(), 0);
+
+    lock_guard<mutex> guard{lock};
+    QCOMPARE(ran.size(), num_keys);
+    for(const auto& it : ran) {
+        QCOMPARE(it.second, expected);
+        QCOMPARE(completed[it.first], expected);
+    }
+}
+
+void TestCryptoExecutor::test_failure_is_passed_to_done()
+{
+    auto& executor = CryptoExecutor::instance();
+    executor.setThreads(2);
+
+    QObject context;
+    bool done = false;
+    exception_ptr failure;
+    executor.post(this, [] {
+        throw runtime_error("Failed to encrypt");
+    }, &context, [&done, &failure](const exception_ptr& f) {
+        done = true;
+        failure = f;
+    });
+
+    // The next job with the same key still runs
+    bool nextDone = false;
+    executor.post(this, [] {}, &context, [&nextDone](const exception_ptr& f) {
+        nextDone = !f;
+    });
+
+    QTRY_VERIFY(done && nextDone);
+    QVERIFY(failure);
+    QCOMPARE(whatOf(failure), QStringLiteral("Failed to encrypt"));
+}
+
+void TestCryptoExecutor::test_done_dropped_when_context_deleted()
+{
+    auto& executor = CryptoExecutor::instance();
+    executor.setThreads(2);
+
+    atomic_bool release{false};
+    atomic_bool ran{false};
+    bool done = false;
+
+    auto context = make_unique<QObject>();
+    executor.post(this, [&release, &ran] {
+        while(!release) {
+            this_thread::yield();
+        }
+        ran = true;
+    }, context.get(), [&done](const exception_ptr&) {
+        done = true;
+    });
+
+    // Deleted while the job is running
+    context.reset();
+    release = true;
+
+    // A later job with the same key completes, so the first completion would have been delivered
+    QObject other;
+    bool otherDone = false;
+    executor.post(this, [] {}, &other, [&otherDone](const exception_ptr&) {
+        otherDone = true;
+    });
+
+    QTRY_VERIFY(otherDone);
+    QVERIFY(ran);
+    QVERIFY(!done);
+}
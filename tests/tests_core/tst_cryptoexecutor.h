@@ -0,0 +1,23 @@
+#ifndef TST_CRYPTOEXECUTOR_H
+#define TST_CRYPTOEXECUTOR_H
+
+#include <QtTest>
+
+#include "ds/cryptoexecutor.h"
+
+class TestCryptoExecutor : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestCryptoExecutor() = default;
+
+private slots:
+    void cleanup();
+    void test_without_threads();
+    void test_per_key_ordering();
+    void test_failure_is_passed_to_done();
+    void test_done_dropped_when_context_deleted();
+};
+
+#endif // TST_CRYPTOEXECUTOR_H
@@ -0,0 +1,163 @@
+#include <QElapsedTimer>
+#include <QTcpSocket>
+
+#include "tst_deadlines.h"
+#include "ds/loopbackprotocolmanager.h"
+#include "ds/transporthandle.h"
+#include "ds/metrics.h"
+
+using namespace std;
+using namespace ds::core;
+
+namespace {
+
+// The peers share a timer wheel with one second ticks.
+// The client is in the handshake phase until the server is authorized,
+// so its deadline must be longer than the authorization deadline.
+constexpr int handshake_timeout_ms = 2000;
+constexpr int timeout_ms = 300;
+constexpr int wait_ms = 10000;
+
+quint64 getCounter(const char *name) {
+    return Metrics::instance().counter(name).get();
+}
+
+} // anonymous namespace
+
+void TestDeadlines::initTestCase()
+{
+    QVERIFY(dir_.isValid());
+    settings_ = make_unique<QSettings>(dir_.filePath("deadlines.ini"), QSettings::IniFormat);
+    settings_->setValue("transport", "loopback");
+    settings_->setValue("handshakeTimeout", handshake_timeout_ms);
+    settings_->setValue("authorizationTimeout", timeout_ms);
+    settings_->setValue("idleTimeout", timeout_ms);
+    settings_->setValue("keepaliveInterval", 0);
+
+    mgr_ = ProtocolManager::create(*settings_, ProtocolManager::Transport::TOR);
+    QVERIFY(dynamic_cast<ds::prot::LoopbackProtocolManager *>(mgr_.get()));
+    mgr_->start();
+    QVERIFY(mgr_->isOnline());
+
+    startService(alice_, "alice");
+    startService(bob_, "bob");
+}
+
+void TestDeadlines::cleanupTestCase()
+{
+    if (mgr_) {
+        mgr_->stop();
+    }
+}
+
+void TestDeadlines::test_handshake_deadline()
+{
+    const auto reaped = getCounter("prot.reaped.handshake");
+
+    // Connect, and never send a Hello
+    QTcpSocket socket;
+    socket.connectToHost(QHostAddress::LocalHost, bob_.port);
+    QVERIFY(socket.waitForConnected(wait_ms));
+
+    QElapsedTimer timer;
+    timer.start();
+    QTRY_VERIFY_WITH_TIMEOUT(socket.state() == QAbstractSocket::UnconnectedState, wait_ms);
+    QVERIFY(timer.elapsed() >= handshake_timeout_ms);
+    QCOMPARE(getCounter("prot.reaped.handshake"), reaped + 1);
+}
+
+void TestDeadlines::test_authorization_deadline()
+{
+    const auto reaped = getCounter("prot.reaped.authorization");
+
+    // Bob never decides if Alice is welcome
+    PeerConnection::ptr_t incoming;
+    auto onIncoming = connect(mgr_.get(), &ProtocolManager::incomingPeer,
+                              this, [&incoming](const shared_ptr<PeerConnection>& peer) {
+        incoming = peer;
+    });
+
+    auto client = mgr_->connectTo(getConnectData(alice_, bob_));
+    bool disconnected = false;
+    connect(client.get(), &PeerConnection::disconnectedFromPeer,
+            this, [&disconnected](const shared_ptr<PeerConnection>&) {
+        disconnected = true;
+    });
+
+    QTRY_VERIFY_WITH_TIMEOUT(incoming, wait_ms);
+    QTRY_VERIFY_WITH_TIMEOUT(disconnected, wait_ms);
+    QVERIFY(!incoming->isConnected());
+    QCOMPARE(getCounter("prot.reaped.authorization"), reaped + 1);
+
+    disconnect(onIncoming);
+}
+
+void TestDeadlines::test_idle_deadline()
+{
+    const auto reaped = getCounter("prot.reaped.idle");
+
+    PeerConnection::ptr_t incoming;
+    auto onIncoming = connect(mgr_.get(), &ProtocolManager::incomingPeer,
+                              this, [&incoming](const shared_ptr<PeerConnection>& peer) {
+        incoming = peer;
+        peer->authorize(true);
+    });
+
+    auto client = mgr_->connectTo(getConnectData(alice_, bob_));
+    bool connected = false, disconnected = false;
+    connect(client.get(), &PeerConnection::connectedToPeer,
+            this, [&connected](const shared_ptr<PeerConnection>&) {
+        connected = true;
+    });
+    connect(client.get(), &PeerConnection::disconnectedFromPeer,
+            this, [&disconnected](const shared_ptr<PeerConnection>&) {
+        disconnected = true;
+    });
+
+    QTRY_VERIFY_WITH_TIMEOUT(connected, wait_ms);
+
+    // Nothing is sent, so the connection is closed
+    QTRY_VERIFY_WITH_TIMEOUT(disconnected, wait_ms);
+    QVERIFY(!incoming->isConnected());
+    QVERIFY(getCounter("prot.reaped.idle") > reaped);
+
+    disconnect(onIncoming);
+}
+
+void TestDeadlines::startService(TestDeadlines::Endpoint &ep, const QString &name)
+{
+    TransportHandle th;
+    auto conn = connect(mgr_.get(), &ProtocolManager::transportHandleReady,
+                        this, [&th](const TransportHandle& handle) {
+        th = handle;
+    });
+
+    mgr_->createTransportHandle({name, ep.uuid});
+    disconnect(conn);
+
+    QCOMPARE(th.uuid, ep.uuid);
+    ep.address = th.data["address"].toByteArray();
+    ep.port = static_cast<quint16>(th.data["port"].toUInt());
+
+    bool started = false;
+    conn = connect(mgr_.get(), &ProtocolManager::serviceStarted,
+                   this, [&started, &ep](const QUuid& uuid, const bool) {
+        started = (uuid == ep.uuid);
+    });
+    mgr_->startService(ep.uuid, ep.cert, th.data);
+    disconnect(conn);
+
+    QVERIFY(started);
+}
+
+ConnectData TestDeadlines::getConnectData(const TestDeadlines::Endpoint &from,
+                                          const TestDeadlines::Endpoint &to) const
+{
+    ConnectData cd;
+    cd.service = from.uuid;
+    cd.address = to.address;
+    cd.identitysCert = from.cert;
+    cd.contactsCert = ds::crypto::DsCert::createFromPubkey(
+                to.cert->getSigningPubKey().toByteArray());
+    return cd;
+}
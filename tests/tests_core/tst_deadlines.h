@@ -0,0 +1,50 @@
+#ifndef TST_DEADLINES_H
+#define TST_DEADLINES_H
+
+#include <memory>
+
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QSettings>
+
+#include "ds/protocolmanager.h"
+#include "ds/dscert.h"
+
+/*! Peers are closed when their deadlines expire.
+ *
+ * Alice and Bob run in the same process on the loopback
+ * transport, with very short timeouts.
+ */
+class TestDeadlines : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestDeadlines() = default;
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void test_handshake_deadline();
+    void test_authorization_deadline();
+    void test_idle_deadline();
+
+private:
+    struct Endpoint {
+        QUuid uuid = QUuid::createUuid();
+        ds::crypto::DsCert::ptr_t cert = ds::crypto::DsCert::create();
+        QByteArray address;
+        quint16 port = {};
+    };
+
+    void startService(Endpoint& ep, const QString& name);
+    ds::core::ConnectData getConnectData(const Endpoint& from, const Endpoint& to) const;
+
+    QTemporaryDir dir_;
+    std::unique_ptr<QSettings> settings_;
+    ds::core::ProtocolManager::ptr_t mgr_;
+    Endpoint alice_;
+    Endpoint bob_;
+};
+
+#endif // TST_DEADLINES_H
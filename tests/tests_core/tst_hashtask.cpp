@@ -0,0 +1,122 @@
+#include <memory>
+
+#include <QTemporaryDir>
+#include <sodium.h>
+
+#include "tst_hashtask.h"
+#include "ds/metrics.h"
+
+using namespace std;
+using ds::core::File;
+using ds::core::FileData;
+using ds::core::HashTask;
+using ds::core::Metrics;
+
+namespace {
+
+QByteArray sha256(const QByteArray& data) {
+    QByteArray out;
+    out.resize(crypto_hash_sha256_BYTES);
+    crypto_hash_sha256(reinterpret_cast<uint8_t *>(out.data()),
+                       reinterpret_cast<const uint8_t *>(data.constData()),
+                       static_cast<unsigned long long>(data.size()));
+    return out;
+}
+
+File::ptr_t makeFile(QObject& parent, const QString& path,
+                     const File::State state = File::FS_HASHING) {
+    auto data = make_unique<FileData>();
+    data->state = state;
+    data->path = path;
+    return make_shared<File>(parent, move(data));
+}
+
+} // anonymous namespace
+
+void TestHashTask::test_hash_data()
+{
+    QTest::addColumn<int>("size");
+
+    QTest::newRow("empty") << 0;
+    QTest::newRow("small") << 17;
+    QTest::newRow("one-block") << 1024 * 8;
+    QTest::newRow("many-blocks") << 1024 * 8 * 10 + 3;
+}
+
+void TestHashTask::test_hash()
+{
+    QFETCH(int, size);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    QByteArray content(size, '\0');
+    for(int i = 0; i < size; ++i) {
+        content[i] = static_cast<char>(i * 7);
+    }
+
+    const auto path = dir.filePath("file.bin");
+    {
+        QFile out{path};
+        QVERIFY(out.open(QIODevice::WriteOnly));
+        QCOMPARE(out.write(content), static_cast<qint64>(size));
+    }
+
+    QObject owner;
+    auto file = makeFile(owner, path);
+    HashTask task{&owner, file};
+    QSignalSpy spy(&task, &HashTask::hashed);
+
+    auto& hashedBytes = Metrics::instance().counter("file.hash.bytes");
+    const auto bytesBefore = hashedBytes.get();
+
+    task.run();
+
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.at(0).at(1).toString(), QString{});
+    QCOMPARE(spy.at(0).at(0).toByteArray(), sha256(content));
+
+    // The content was read, not just the file opened
+    QCOMPARE(hashedBytes.get() - bytesBefore, static_cast<quint64>(size));
+}
+
+void TestHashTask::test_missing_file()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    QObject owner;
+    auto file = makeFile(owner, dir.filePath("nonexistent.bin"));
+    HashTask task{&owner, file};
+    QSignalSpy spy(&task, &HashTask::hashed);
+
+    task.run();
+
+    QCOMPARE(spy.count(), 1);
+    QVERIFY(spy.at(0).at(0).toByteArray().isEmpty());
+    QCOMPARE(spy.at(0).at(1).toString(), QStringLiteral("Failed to open file"));
+}
+
+void TestHashTask::test_abort_when_not_hashing()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    const auto path = dir.filePath("file.bin");
+    {
+        QFile out{path};
+        QVERIFY(out.open(QIODevice::WriteOnly));
+        out.write(QByteArray(1024, 'x'));
+    }
+
+    QObject owner;
+    auto file = makeFile(owner, path, File::FS_CANCELLED);
+    HashTask task{&owner, file};
+    QSignalSpy spy(&task, &HashTask::hashed);
+
+    task.run();
+
+    QCOMPARE(spy.count(), 1);
+    QVERIFY(spy.at(0).at(0).toByteArray().isEmpty());
+    QCOMPARE(spy.at(0).at(1).toString(), QStringLiteral("Aborted"));
+}
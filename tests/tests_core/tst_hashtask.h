@@ -0,0 +1,22 @@
+#ifndef TST_HASHTASK_H
+#define TST_HASHTASK_H
+
+#include <QtTest>
+
+#include "ds/hashtask.h"
+
+class TestHashTask : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestHashTask() = default;
+
+private slots:
+    void test_hash_data();
+    void test_hash();
+    void test_missing_file();
+    void test_abort_when_not_hashing();
+};
+
+#endif // TST_HASHTASK_H
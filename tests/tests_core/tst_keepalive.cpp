@@ -0,0 +1,123 @@
+#include "tst_keepalive.h"
+#include "ds/loopbackprotocolmanager.h"
+#include "ds/transporthandle.h"
+#include "ds/metrics.h"
+
+using namespace std;
+using namespace ds::core;
+
+namespace {
+
+// The peers share a timer wheel with one second ticks
+constexpr int keepalive_ms = 100;
+constexpr int wait_ms = 10000;
+
+quint64 getCounter(const char *name) {
+    return Metrics::instance().counter(name).get();
+}
+
+} // anonymous namespace
+
+void TestKeepalive::initTestCase()
+{
+    QVERIFY(dir_.isValid());
+    settings_ = make_unique<QSettings>(dir_.filePath("keepalive.ini"), QSettings::IniFormat);
+    settings_->setValue("transport", "loopback");
+    settings_->setValue("keepaliveInterval", keepalive_ms);
+    settings_->setValue("keepaliveTimeout", wait_ms);
+
+    mgr_ = ProtocolManager::create(*settings_, ProtocolManager::Transport::TOR);
+    QVERIFY(dynamic_cast<ds::prot::LoopbackProtocolManager *>(mgr_.get()));
+    mgr_->start();
+    QVERIFY(mgr_->isOnline());
+
+    startService(alice_, "alice");
+    startService(bob_, "bob");
+}
+
+void TestKeepalive::cleanupTestCase()
+{
+    if (mgr_) {
+        mgr_->stop();
+    }
+}
+
+void TestKeepalive::test_ping_pong()
+{
+    const auto pings = getCounter("prot.keepalive.pings");
+    const auto timeouts = getCounter("prot.keepalive.timeouts");
+
+    PeerConnection::ptr_t incoming;
+    vector<int> incomingRtts;
+    auto onIncoming = connect(mgr_.get(), &ProtocolManager::incomingPeer,
+                              this, [this, &incoming, &incomingRtts](const shared_ptr<PeerConnection>& peer) {
+        incoming = peer;
+        connect(peer.get(), &PeerConnection::rttMeasured, this, [&incomingRtts](const int msec) {
+            incomingRtts.push_back(msec);
+        });
+        peer->authorize(true);
+    });
+
+    auto client = mgr_->connectTo(getConnectData(alice_, bob_));
+    QCOMPARE(client->getRtt(), -1);
+
+    vector<int> clientRtts;
+    connect(client.get(), &PeerConnection::rttMeasured, this, [&clientRtts](const int msec) {
+        clientRtts.push_back(msec);
+    });
+
+    // Both sides probe the connection, and measure the round-trip time
+    QTRY_VERIFY_WITH_TIMEOUT(!clientRtts.empty() && !incomingRtts.empty(), wait_ms);
+    QVERIFY(clientRtts.front() >= 0);
+    QCOMPARE(client->getRtt(), clientRtts.back());
+    QVERIFY(incomingRtts.front() >= 0);
+    QCOMPARE(incoming->getRtt(), incomingRtts.back());
+    QVERIFY(getCounter("prot.keepalive.pings") >= pings + 2);
+
+    // The connection is kept open by the pongs, and keeps being probed
+    const auto measured = clientRtts.size();
+    QTRY_VERIFY_WITH_TIMEOUT(clientRtts.size() > measured, wait_ms);
+    QVERIFY(client->isConnected());
+    QVERIFY(incoming->isConnected());
+    QCOMPARE(getCounter("prot.keepalive.timeouts"), timeouts);
+
+    disconnect(onIncoming);
+    client->close();
+}
+
+void TestKeepalive::startService(TestKeepalive::Endpoint &ep, const QString &name)
+{
+    TransportHandle th;
+    auto conn = connect(mgr_.get(), &ProtocolManager::transportHandleReady,
+                        this, [&th](const TransportHandle& handle) {
+        th = handle;
+    });
+
+    mgr_->createTransportHandle({name, ep.uuid});
+    disconnect(conn);
+
+    QCOMPARE(th.uuid, ep.uuid);
+    ep.address = th.data["address"].toByteArray();
+
+    bool started = false;
+    conn = connect(mgr_.get(), &ProtocolManager::serviceStarted,
+                   this, [&started, &ep](const QUuid& uuid, const bool) {
+        started = (uuid == ep.uuid);
+    });
+    mgr_->startService(ep.uuid, ep.cert, th.data);
+    disconnect(conn);
+
+    QVERIFY(started);
+}
+
+ConnectData TestKeepalive::getConnectData(const TestKeepalive::Endpoint &from,
+                                          const TestKeepalive::Endpoint &to) const
+{
+    ConnectData cd;
+    cd.service = from.uuid;
+    cd.address = to.address;
+    cd.identitysCert = from.cert;
+    cd.contactsCert = ds::crypto::DsCert::createFromPubkey(
+                to.cert->getSigningPubKey().toByteArray());
+    return cd;
+}
@@ -0,0 +1,47 @@
+#ifndef TST_KEEPALIVE_H
+#define TST_KEEPALIVE_H
+
+#include <memory>
+
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QSettings>
+
+#include "ds/protocolmanager.h"
+#include "ds/dscert.h"
+
+/*! Keepalive Ping / Pong between two services.
+ *
+ * Alice and Bob run in the same process on the loopback
+ * transport, with a short keepalive interval.
+ */
+class TestKeepalive : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestKeepalive() = default;
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void test_ping_pong();
+
+private:
+    struct Endpoint {
+        QUuid uuid = QUuid::createUuid();
+        ds::crypto::DsCert::ptr_t cert = ds::crypto::DsCert::create();
+        QByteArray address;
+    };
+
+    void startService(Endpoint& ep, const QString& name);
+    ds::core::ConnectData getConnectData(const Endpoint& from, const Endpoint& to) const;
+
+    QTemporaryDir dir_;
+    std::unique_ptr<QSettings> settings_;
+    ds::core::ProtocolManager::ptr_t mgr_;
+    Endpoint alice_;
+    Endpoint bob_;
+};
+
+#endif // TST_KEEPALIVE_H
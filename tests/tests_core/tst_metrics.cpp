@@ -0,0 +1,66 @@
+#include "tst_metrics.h"
+
+using namespace std;
+using namespace ds::core;
+
+void TestMetrics::test_counter_and_gauge()
+{
+    auto& counter = Metrics::instance().counter("test.counter");
+    counter.add();
+    counter.add(9);
+    QCOMPARE(counter.get(), quint64{10});
+
+    // Same name gives the same instance
+    QCOMPARE(&Metrics::instance().counter("test.counter"), &counter);
+
+    auto& gauge = Metrics::instance().gauge("test.gauge");
+    gauge.add(5);
+    gauge.add(-7);
+    QCOMPARE(gauge.get(), qint64{-2});
+    gauge.set(3);
+    QCOMPARE(gauge.get(), qint64{3});
+
+    Metrics::instance().remove("test.");
+}
+
+void TestMetrics::test_histogram_percentiles()
+{
+    Histogram histogram;
+    QCOMPARE(histogram.getPercentile(50), quint64{0});
+
+    for(int i = 0; i < 99; ++i) {
+        histogram.record(100);
+    }
+    histogram.record(5000);
+
+    QCOMPARE(histogram.getCount(), quint64{100});
+    QCOMPARE(histogram.getSum(), quint64{99 * 100 + 5000});
+    QCOMPARE(histogram.getMax(), quint64{5000});
+
+    // 100 is in the bucket [64, 127]
+    QCOMPARE(histogram.getPercentile(50), quint64{127});
+    QCOMPARE(histogram.getPercentile(99), quint64{127});
+
+    // Never above the largest recorded value
+    QCOMPARE(histogram.getPercentile(100), quint64{5000});
+}
+
+void TestMetrics::test_remove_by_prefix()
+{
+    Metrics::instance().counter("test.peer.a.bytes").add(1);
+    Metrics::instance().counter("test.peer.b.bytes").add(2);
+    Metrics::instance().histogram("test.peer.a.time").record(1);
+
+    Metrics::instance().remove("test.peer.a.");
+
+    bool haveA = false, haveB = false;
+    for(const auto& sample : Metrics::instance().snapshot()) {
+        haveA |= sample.name.startsWith("test.peer.a.");
+        haveB |= (sample.name == "test.peer.b.bytes") && (sample.value == 2);
+    }
+
+    QVERIFY(!haveA);
+    QVERIFY(haveB);
+
+    Metrics::instance().remove("test.");
+}
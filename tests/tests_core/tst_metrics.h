@@ -0,0 +1,21 @@
+#ifndef TST_METRICS_H
+#define TST_METRICS_H
+
+#include <QtTest>
+
+#include "ds/metrics.h"
+
+class TestMetrics : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestMetrics() = default;
+
+private slots:
+    void test_counter_and_gauge();
+    void test_histogram_percentiles();
+    void test_remove_by_prefix();
+};
+
+#endif // TST_METRICS_H
@@ -0,0 +1,316 @@
+#include <sodium.h>
+
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include "tst_multiplexer.h"
+#include "ds/loopbackprotocolmanager.h"
+#include "ds/transporthandle.h"
+#include "ds/metrics.h"
+
+using namespace std;
+using namespace ds::core;
+using ds::prot::Peer;
+using ds::prot::MuxSession;
+
+namespace {
+
+constexpr quint32 test_channel = 1000;
+constexpr int wait_ms = 10000;
+
+quint64 getCounter(const char *name) {
+    return Metrics::instance().counter(name).get();
+}
+
+QByteArray pubkeyOf(const ds::crypto::DsCert& cert) {
+    return cert.getSigningPubKey().toByteArray();
+}
+
+class CollectingChannel : public Peer::Channel {
+public:
+    void onIncoming(Peer&, const quint64, const Peer::mview_t& data, const bool) override {
+        received.append(reinterpret_cast<const char *>(data.cdata()),
+                        static_cast<int>(data.size()));
+    }
+
+    uint64_t onOutgoing(Peer&) override {
+        return 0;
+    }
+
+    QByteArray received;
+};
+
+} // anonymous namespace
+
+void TestMultiplexer::initTestCase()
+{
+    QVERIFY(dir_.isValid());
+    settings_ = make_unique<QSettings>(dir_.filePath("multiplexer.ini"), QSettings::IniFormat);
+    settings_->setValue("transport", "loopback");
+    settings_->setValue("multiplexIdentities", true);
+
+    mgr_ = ProtocolManager::create(*settings_, ProtocolManager::Transport::TOR);
+    QVERIFY(dynamic_cast<ds::prot::LoopbackProtocolManager *>(mgr_.get()));
+    mgr_->start();
+    QVERIFY(mgr_->isOnline());
+
+    startService(alice_, "alice");
+    startService(carol_, "carol");
+    startService(bob_, "bob");
+
+    connect(mgr_.get(), &ProtocolManager::incomingPeer,
+            this, [this](const shared_ptr<PeerConnection>& peer) {
+        incoming_.push_back(peer);
+        peer->authorize(authorize_);
+    });
+
+    auto client = mgr_->connectTo(getConnectData(alice_, bob_));
+    transport_ = dynamic_pointer_cast<Peer>(client);
+    QVERIFY(transport_);
+    QVERIFY(!dynamic_cast<MuxSession *>(transport_.get()));
+
+    // Both sides must know which identities the other accepts sessions for
+    QTRY_VERIFY_WITH_TIMEOUT(incoming_.size() == 1, wait_ms);
+    bobsTransport_ = dynamic_pointer_cast<Peer>(incoming_.front());
+    QVERIFY(bobsTransport_);
+    QTRY_VERIFY_WITH_TIMEOUT(transport_->getMuxIdentities().count(pubkeyOf(*bob_.cert))
+                             && bobsTransport_->getMuxIdentities().count(pubkeyOf(*carol_.cert)),
+                             wait_ms);
+    QVERIFY(!transport_->getChannelBinding().isEmpty());
+    QCOMPARE(transport_->getChannelBinding(), bobsTransport_->getChannelBinding());
+}
+
+void TestMultiplexer::cleanupTestCase()
+{
+    if (transport_) {
+        transport_->close();
+    }
+
+    if (mgr_) {
+        mgr_->stop();
+    }
+}
+
+void TestMultiplexer::init()
+{
+    QVERIFY(transport_->isConnected());
+    incoming_.clear();
+    authorize_ = true;
+}
+
+void TestMultiplexer::test_open_and_accept()
+{
+    const auto accepted = getCounter("prot.mux.accepted");
+
+    auto session = openSession();
+    QVERIFY(session);
+
+    bool connected = false;
+    connect(session.get(), &PeerConnection::connectedToPeer,
+            this, [&connected](const shared_ptr<PeerConnection>&) {
+        connected = true;
+    });
+
+    QTRY_VERIFY_WITH_TIMEOUT(connected, wait_ms);
+    QCOMPARE(incoming_.size(), size_t{1});
+    QCOMPARE(getCounter("prot.mux.accepted"), accepted + 1);
+
+    auto remote = dynamic_pointer_cast<MuxSession>(incoming_.front());
+    QVERIFY(remote);
+    auto& mux = dynamic_cast<MuxSession&>(*session);
+    QCOMPARE(remote->getSessionId(), mux.getSessionId());
+    QCOMPARE(remote->getTransport(), getOtherEnd(mux));
+    QCOMPARE(remote->getPeerCert()->getSigningPubKey().toByteArray(), pubkeyOf(*carol_.cert));
+    QCOMPARE(remote->getIdentityId(), bob_.uuid);
+
+    session->close();
+}
+
+void TestMultiplexer::test_reject()
+{
+    const auto rejected = getCounter("prot.mux.rejected");
+    authorize_ = false;
+
+    auto session = openSession();
+    QVERIFY(session);
+
+    bool connected = false, disconnected = false;
+    connect(session.get(), &PeerConnection::connectedToPeer,
+            this, [&connected](const shared_ptr<PeerConnection>&) {
+        connected = true;
+    });
+    connect(session.get(), &PeerConnection::disconnectedFromPeer,
+            this, [&disconnected](const shared_ptr<PeerConnection>&) {
+        disconnected = true;
+    });
+
+    QTRY_VERIFY_WITH_TIMEOUT(disconnected, wait_ms);
+    QVERIFY(!connected);
+    QCOMPARE(getCounter("prot.mux.rejected"), rejected + 1);
+
+    // The connection carrying the session is not affected
+    QVERIFY(transport_->isConnected());
+    auto& mux = dynamic_cast<MuxSession&>(*session);
+    QVERIFY(!mux.getTransport()->getSession(mux.getSessionId()));
+}
+
+void TestMultiplexer::test_remote_close()
+{
+    auto session = openSession();
+    QVERIFY(session);
+
+    bool connected = false, disconnected = false;
+    connect(session.get(), &PeerConnection::connectedToPeer,
+            this, [&connected](const shared_ptr<PeerConnection>&) {
+        connected = true;
+    });
+    connect(session.get(), &PeerConnection::disconnectedFromPeer,
+            this, [&disconnected](const shared_ptr<PeerConnection>&) {
+        disconnected = true;
+    });
+
+    QTRY_VERIFY_WITH_TIMEOUT(connected, wait_ms);
+    QCOMPARE(incoming_.size(), size_t{1});
+
+    // Bob closes the session
+    incoming_.front()->close();
+
+    QTRY_VERIFY_WITH_TIMEOUT(disconnected, wait_ms);
+    QVERIFY(transport_->isConnected());
+    QVERIFY(bobsTransport_->isConnected());
+}
+
+void TestMultiplexer::test_bad_signature()
+{
+    const auto rejected = getCounter("prot.mux.rejected");
+
+    const auto to = pubkeyOf(*bob_.cert);
+    QByteArray nonce(static_cast<int>(MuxSession::nonce_bytes), '\0');
+    randombytes_buf(nonce.data(), MuxSession::nonce_bytes);
+
+    const auto sendOpen = [&](const quint32 sessionId, const QByteArray& signature) {
+        transport_->send(QJsonDocument{QJsonObject{
+            {"type", "MuxOpen"},
+            {"session", QString::number(sessionId)},
+            {"from", QString{pubkeyOf(*carol_.cert).toBase64()}},
+            {"to", QString{to.toBase64()}},
+            {"nonce", QString{nonce.toBase64()}},
+            {"signature", QString{signature.toBase64()}}
+        }});
+    };
+
+    // Signed by someone else
+    const quint32 firstId = 201, secondId = 203;
+    sendOpen(firstId, alice_.cert->sign<QByteArray>({
+        QByteArray{"MuxOpen"}, QByteArray::number(firstId), to, nonce,
+        transport_->getChannelBinding()}));
+
+    // Signed by Carol, but for another connection, like a replayed MuxOpen
+    sendOpen(secondId, carol_.cert->sign<QByteArray>({
+        QByteArray{"MuxOpen"}, QByteArray::number(secondId), to, nonce,
+        QByteArray(crypto_generichash_BYTES, 'x')}));
+
+    QTRY_VERIFY_WITH_TIMEOUT(getCounter("prot.mux.rejected") == rejected + 2, wait_ms);
+    QTest::qWait(100);
+    QVERIFY(incoming_.empty());
+    QVERIFY(!bobsTransport_->getSession(firstId));
+    QVERIFY(!bobsTransport_->getSession(secondId));
+    QVERIFY(transport_->isConnected());
+}
+
+void TestMultiplexer::test_data_routed_to_session()
+{
+    auto session = openSession();
+    QVERIFY(session);
+
+    bool connected = false;
+    connect(session.get(), &PeerConnection::connectedToPeer,
+            this, [&connected](const shared_ptr<PeerConnection>&) {
+        connected = true;
+    });
+
+    QTRY_VERIFY_WITH_TIMEOUT(connected, wait_ms);
+    QCOMPARE(incoming_.size(), size_t{1});
+    auto remote = dynamic_pointer_cast<Peer>(incoming_.front());
+    QVERIFY(remote);
+
+    auto& mux = dynamic_cast<MuxSession&>(*session);
+    auto onTransport = make_shared<CollectingChannel>();
+    auto onSession = make_shared<CollectingChannel>();
+    getOtherEnd(mux)->addInChannel(test_channel, onTransport);
+    remote->addInChannel(test_channel, onSession);
+
+    // The same channel number on the connection and in the session
+    const QByteArray toTransport{"To the connection"}, toSession{"To the session"};
+    mux.getTransport()->send(toTransport.constData(), static_cast<size_t>(toTransport.size()),
+                             test_channel);
+    mux.send(toSession.constData(), static_cast<size_t>(toSession.size()), test_channel);
+
+    QTRY_VERIFY_WITH_TIMEOUT((onTransport->received.size() == toTransport.size())
+                             && (onSession->received.size() == toSession.size()), wait_ms);
+    QCOMPARE(onTransport->received, toTransport);
+    QCOMPARE(onSession->received, toSession);
+
+    session->close();
+}
+
+PeerConnection::ptr_t TestMultiplexer::openSession()
+{
+    auto session = mgr_->connectTo(getConnectData(carol_, bob_));
+
+    // Carried by Alice's connection, without a new handshake.
+    auto mux = dynamic_pointer_cast<MuxSession>(session);
+    if (!mux) {
+        return {};
+    }
+
+    if ((mux->getTransport() != transport_) && (mux->getTransport() != bobsTransport_)) {
+        return {};
+    }
+
+    return session;
+}
+
+shared_ptr<Peer> TestMultiplexer::getOtherEnd(const MuxSession &session) const
+{
+    // Both ends of Alice's connection are in this process, and
+    // either of them may carry the session.
+    return session.getTransport() == transport_ ? bobsTransport_ : transport_;
+}
+
+void TestMultiplexer::startService(TestMultiplexer::Endpoint &ep, const QString &name)
+{
+    TransportHandle th;
+    auto conn = connect(mgr_.get(), &ProtocolManager::transportHandleReady,
+                        this, [&th](const TransportHandle& handle) {
+        th = handle;
+    });
+
+    mgr_->createTransportHandle({name, ep.uuid});
+    disconnect(conn);
+
+    QCOMPARE(th.uuid, ep.uuid);
+    ep.address = th.data["address"].toByteArray();
+
+    bool started = false;
+    conn = connect(mgr_.get(), &ProtocolManager::serviceStarted,
+                   this, [&started, &ep](const QUuid& uuid, const bool) {
+        started = (uuid == ep.uuid);
+    });
+    mgr_->startService(ep.uuid, ep.cert, th.data);
+    disconnect(conn);
+
+    QVERIFY(started);
+}
+
+ConnectData TestMultiplexer::getConnectData(const TestMultiplexer::Endpoint &from,
+                                            const TestMultiplexer::Endpoint &to) const
+{
+    ConnectData cd;
+    cd.service = from.uuid;
+    cd.address = to.address;
+    cd.identitysCert = from.cert;
+    cd.contactsCert = ds::crypto::DsCert::createFromPubkey(
+                to.cert->getSigningPubKey().toByteArray());
+    return cd;
+}
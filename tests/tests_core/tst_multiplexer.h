@@ -0,0 +1,62 @@
+#ifndef TST_MULTIPLEXER_H
+#define TST_MULTIPLEXER_H
+
+#include <memory>
+#include <vector>
+
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QSettings>
+
+#include "ds/protocolmanager.h"
+#include "ds/dscert.h"
+#include "ds/multiplexer.h"
+
+/*! Sessions over a shared connection.
+ *
+ * Alice, Carol and Bob run in the same process on the loopback
+ * transport, with multiplexing enabled. Alice connects to Bob,
+ * and Carol opens sessions to Bob over that connection.
+ */
+class TestMultiplexer : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestMultiplexer() = default;
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void init();
+    void test_open_and_accept();
+    void test_reject();
+    void test_remote_close();
+    void test_bad_signature();
+    void test_data_routed_to_session();
+
+private:
+    struct Endpoint {
+        QUuid uuid = QUuid::createUuid();
+        ds::crypto::DsCert::ptr_t cert = ds::crypto::DsCert::create();
+        QByteArray address;
+    };
+
+    void startService(Endpoint& ep, const QString& name);
+    ds::core::ConnectData getConnectData(const Endpoint& from, const Endpoint& to) const;
+    ds::core::PeerConnection::ptr_t openSession();
+    std::shared_ptr<ds::prot::Peer> getOtherEnd(const ds::prot::MuxSession& session) const;
+
+    QTemporaryDir dir_;
+    std::unique_ptr<QSettings> settings_;
+    ds::core::ProtocolManager::ptr_t mgr_;
+    Endpoint alice_;
+    Endpoint carol_;
+    Endpoint bob_;
+    std::shared_ptr<ds::prot::Peer> transport_; // Alice's connection to Bob
+    std::shared_ptr<ds::prot::Peer> bobsTransport_;
+    std::vector<ds::core::PeerConnection::ptr_t> incoming_;
+    bool authorize_ = true;
+};
+
+#endif // TST_MULTIPLEXER_H
@@ -0,0 +1,159 @@
+#include <vector>
+
+#include "tst_reconnectscheduler.h"
+
+using namespace std;
+using namespace std::chrono;
+using ds::core::ReconnectScheduler;
+
+namespace {
+
+ReconnectScheduler::Config getTestConfig(const size_t maxConcurrent)
+{
+    ReconnectScheduler::Config config;
+    config.maxConcurrent = maxConcurrent;
+    config.startupSpread = milliseconds{0};
+    config.minDelay = milliseconds{10};
+    config.maxDelay = milliseconds{40};
+    return config;
+}
+
+} // anonymous namespace
+
+void TestReconnectScheduler::test_concurrent_attempts_are_limited()
+{
+    vector<QUuid> started;
+    ReconnectScheduler scheduler{getTestConfig(2), [&](const QUuid& uuid) {
+        started.push_back(uuid);
+        return true;
+    }};
+
+    for(int i = 0; i < 5; ++i) {
+        scheduler.schedule(QUuid::createUuid());
+    }
+
+    QTRY_COMPARE(started.size(), size_t{2});
+    QTest::qWait(50);
+    QCOMPARE(started.size(), size_t{2});
+    QCOMPARE(scheduler.getConnecting(), size_t{2});
+
+    // A successful connection frees a slot
+    scheduler.connected(started.front());
+    QTRY_COMPARE(started.size(), size_t{3});
+    QCOMPARE(scheduler.getConnecting(), size_t{2});
+    QCOMPARE(scheduler.size(), size_t{4});
+
+    scheduler.clear();
+    QCOMPARE(scheduler.getConnecting(), size_t{0});
+}
+
+void TestReconnectScheduler::test_priority_contacts_first()
+{
+    vector<QUuid> started;
+    ReconnectScheduler scheduler{getTestConfig(1), [&](const QUuid& uuid) {
+        started.push_back(uuid);
+        return true;
+    }};
+
+    for(int i = 0; i < 3; ++i) {
+        scheduler.schedule(QUuid::createUuid());
+    }
+
+    const auto important = QUuid::createUuid();
+    scheduler.schedule(important, true);
+
+    QTRY_COMPARE(started.size(), size_t{1});
+    QCOMPARE(started.front(), important);
+}
+
+void TestReconnectScheduler::test_fastest_contacts_first()
+{
+    vector<QUuid> started;
+    ReconnectScheduler scheduler{getTestConfig(1), [&](const QUuid& uuid) {
+        started.push_back(uuid);
+        return true;
+    }};
+
+    const auto unknown = QUuid::createUuid();
+    const auto slow = QUuid::createUuid();
+    const auto fast = QUuid::createUuid();
+
+    scheduler.schedule(unknown);
+    scheduler.schedule(slow);
+    scheduler.schedule(fast);
+    scheduler.setRtt(slow, milliseconds{900});
+    scheduler.setRtt(fast, milliseconds{150});
+
+    QTRY_COMPARE(started.size(), size_t{1});
+    QCOMPARE(started.front(), fast);
+
+    scheduler.connected(fast);
+    QTRY_COMPARE(started.size(), size_t{2});
+    QCOMPARE(started.back(), slow);
+}
+
+void TestReconnectScheduler::test_failed_attempt_is_retried()
+{
+    vector<QUuid> started;
+    ReconnectScheduler scheduler{getTestConfig(1), [&](const QUuid& uuid) {
+        started.push_back(uuid);
+        return true;
+    }};
+
+    const auto contact = QUuid::createUuid();
+    scheduler.schedule(contact);
+    QTRY_COMPARE(started.size(), size_t{1});
+    QVERIFY(scheduler.isConnecting(contact));
+
+    scheduler.failed(contact);
+    QVERIFY(!scheduler.isConnecting(contact));
+    QVERIFY(scheduler.isScheduled(contact));
+
+    QTRY_COMPARE(started.size(), size_t{2});
+
+    scheduler.connected(contact);
+    QVERIFY(!scheduler.isScheduled(contact));
+}
+
+void TestReconnectScheduler::test_retry_failed()
+{
+    auto config = getTestConfig(1);
+    config.maxDelay = minutes{10};
+
+    vector<QUuid> started;
+    ReconnectScheduler scheduler{config, [&](const QUuid& uuid) {
+        started.push_back(uuid);
+        return true;
+    }};
+
+    const auto contact = QUuid::createUuid();
+    scheduler.schedule(contact);
+
+    // Fail until the next attempt is at least 320 ms away
+    for(size_t attempt = 1; attempt <= 6; ++attempt) {
+        QTRY_COMPARE(started.size(), attempt);
+        scheduler.failed(contact);
+    }
+
+    scheduler.retryFailed();
+    QTRY_COMPARE_WITH_TIMEOUT(started.size(), size_t{7}, 200);
+}
+
+void TestReconnectScheduler::test_backoff_bounds()
+{
+    ReconnectScheduler scheduler{getTestConfig(1), [](const QUuid&) {
+        return false;
+    }};
+
+    for(int i = 0; i < 100; ++i) {
+        const auto first = scheduler.getBackoff(0).count();
+        QVERIFY(first >= 5 && first <= 10);
+
+        const auto second = scheduler.getBackoff(1).count();
+        QVERIFY(second >= 10 && second <= 20);
+
+        // Capped by maxDelay
+        const auto capped = scheduler.getBackoff(30).count();
+        QVERIFY(capped >= 20 && capped <= 40);
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef TST_RECONNECTSCHEDULER_H
+#define TST_RECONNECTSCHEDULER_H
+
+#include <QtTest>
+
+#include "ds/reconnectscheduler.h"
+
+class TestReconnectScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestReconnectScheduler() = default;
+
+private slots:
+    void test_concurrent_attempts_are_limited();
+    void test_priority_contacts_first();
+    void test_fastest_contacts_first();
+    void test_failed_attempt_is_retried();
+    void test_retry_failed();
+    void test_backoff_bounds();
+};
+
+#endif // TST_RECONNECTSCHEDULER_H
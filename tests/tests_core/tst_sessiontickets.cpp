@@ -0,0 +1,317 @@
+#include <array>
+#include <thread>
+
+#include "tst_sessiontickets.h"
+#include "ds/loopbackprotocolmanager.h"
+#include "ds/sessiontickets.h"
+#include "ds/transporthandle.h"
+#include "ds/metrics.h"
+
+using namespace std;
+using namespace ds::core;
+using ds::prot::SessionTickets;
+
+namespace {
+
+constexpr int wait_ms = 10000;
+constexpr size_t message_bytes = 200;
+
+// Stand-ins for the version, stream key and header in a Hello or Olleh
+struct Body {
+    Body() {
+        randombytes_buf(buffer.data(), buffer.size());
+    }
+
+    array<uint8_t, 1 + 32 + 24> buffer;
+    SessionTickets::mview_t version{buffer.data(), 1};
+    SessionTickets::mview_t key{buffer.data() + 1, 32};
+    SessionTickets::mview_t header{buffer.data() + 33, 24};
+};
+
+const QByteArray server_pubkey(static_cast<int>(SessionTickets::pubkey_bytes), 's');
+const QByteArray client_pubkey(static_cast<int>(SessionTickets::pubkey_bytes), 'c');
+
+QByteArray makeResume(const SessionTickets::Ticket& ticket, const Body& body)
+{
+    return SessionTickets::sealResume(ticket, message_bytes,
+                                      body.version, body.key, body.header);
+}
+
+bool open(SessionTickets& tickets, const QByteArray& serverPubkey,
+          const QByteArray& message, SessionTickets::Resumed& resumed)
+{
+    Body out;
+    return tickets.openResume(serverPubkey, message,
+                              out.version, out.key, out.header, resumed);
+}
+
+quint64 getCounter(const char *name) {
+    return Metrics::instance().counter(name).get();
+}
+
+void sleepFor(const chrono::milliseconds duration)
+{
+    // The ticket times are in wall-clock seconds
+    this_thread::sleep_for(duration);
+}
+
+} // anonymous namespace
+
+void TestSessionTickets::initTestCase()
+{
+    QVERIFY(dir_.isValid());
+    settings_ = make_unique<QSettings>(dir_.filePath("sessiontickets.ini"), QSettings::IniFormat);
+    settings_->setValue("transport", "loopback");
+    settings_->setValue("sessionTickets", true);
+
+    mgr_ = ProtocolManager::create(*settings_, ProtocolManager::Transport::TOR);
+    QVERIFY(dynamic_cast<ds::prot::LoopbackProtocolManager *>(mgr_.get()));
+    mgr_->start();
+    QVERIFY(mgr_->isOnline());
+
+    startService(alice_, "alice");
+    startService(bob_, "bob");
+}
+
+void TestSessionTickets::cleanupTestCase()
+{
+    if (mgr_) {
+        mgr_->stop();
+    }
+    SessionTickets::instance().clear();
+}
+
+void TestSessionTickets::test_resume()
+{
+    SessionTickets tickets;
+    tickets.store(client_pubkey, server_pubkey, tickets.issue(server_pubkey, client_pubkey));
+    QCOMPARE(tickets.size(), size_t{1});
+
+    SessionTickets::Ticket ticket;
+    QVERIFY(tickets.take(client_pubkey, server_pubkey, ticket));
+    QCOMPARE(tickets.size(), size_t{0});
+    QVERIFY(!tickets.take(client_pubkey, server_pubkey, ticket));
+
+    // The server gets the client's stream setup and the secret
+    const Body hello;
+    auto message = makeResume(ticket, hello);
+    QCOMPARE(static_cast<size_t>(message.size()), message_bytes);
+
+    Body in;
+    SessionTickets::Resumed resumed;
+    QVERIFY(tickets.openResume(server_pubkey, message,
+                               in.version, in.key, in.header, resumed));
+    QVERIFY(in.buffer == hello.buffer);
+    QCOMPARE(resumed.clientPubkey, client_pubkey);
+    QVERIFY(resumed.secret == ticket.secret);
+
+    // And the client gets the server's
+    const Body olleh;
+    auto reply = SessionTickets::sealReply(resumed.secret, message_bytes,
+                                                 olleh.version, olleh.key, olleh.header);
+    Body out;
+    QVERIFY(SessionTickets::openReply(ticket.secret, reply, out.version, out.key, out.header));
+    QVERIFY(out.buffer == olleh.buffer);
+
+    // The directions use different nonces, so the resume message is not a valid reply
+    QVERIFY(!SessionTickets::openReply(ticket.secret, message, out.version, out.key, out.header));
+}
+
+void TestSessionTickets::test_replay()
+{
+    SessionTickets tickets;
+    const auto rejected = getCounter("prot.tickets.rejected");
+    const auto message = makeResume(tickets.issue(server_pubkey, client_pubkey), Body{});
+
+    SessionTickets::Resumed resumed;
+    QVERIFY(open(tickets, server_pubkey, message, resumed));
+    QVERIFY(!open(tickets, server_pubkey, message, resumed));
+    QCOMPARE(getCounter("prot.tickets.rejected"), rejected + 1);
+
+    // Also with a new body under the same ticket
+    SessionTickets::Ticket ticket;
+    ticket.ticket = message.left(static_cast<int>(SessionTickets::ticket_bytes));
+    ticket.secret = resumed.secret;
+    QVERIFY(!open(tickets, server_pubkey, makeResume(ticket, Body{}), resumed));
+    QCOMPARE(getCounter("prot.tickets.rejected"), rejected + 2);
+}
+
+void TestSessionTickets::test_expiry()
+{
+    SessionTickets tickets;
+    tickets.setLifetime(chrono::seconds{1});
+    const auto rejected = getCounter("prot.tickets.rejected");
+
+    auto ticket = tickets.issue(server_pubkey, client_pubkey);
+    const auto message = makeResume(ticket, Body{});
+    tickets.store(client_pubkey, server_pubkey, move(ticket));
+
+    sleepFor(chrono::milliseconds{1100});
+
+    // The client drops it
+    SessionTickets::Ticket taken;
+    QVERIFY(!tickets.take(client_pubkey, server_pubkey, taken));
+    QCOMPARE(tickets.size(), size_t{0});
+
+    // The server can still open it with the previous key, but it has expired
+    SessionTickets::Resumed resumed;
+    QVERIFY(!open(tickets, server_pubkey, message, resumed));
+    QCOMPARE(getCounter("prot.tickets.rejected"), rejected + 1);
+}
+
+void TestSessionTickets::test_key_rotation()
+{
+    SessionTickets tickets;
+    tickets.setLifetime(chrono::seconds{2});
+    const auto rejected = getCounter("prot.tickets.rejected");
+
+    // Issued late in the lifetime of the first key, so they outlive it
+    sleepFor(chrono::milliseconds{1100});
+    const auto first = makeResume(tickets.issue(server_pubkey, client_pubkey), Body{});
+    const auto second = makeResume(tickets.issue(server_pubkey, client_pubkey), Body{});
+
+    // The key is rotated, and the tickets are opened with the previous key
+    sleepFor(chrono::milliseconds{1000});
+    SessionTickets::Resumed resumed;
+    QVERIFY(open(tickets, server_pubkey, first, resumed));
+
+    // Rotated again. The first key is gone.
+    sleepFor(chrono::milliseconds{2100});
+    QVERIFY(!open(tickets, server_pubkey, second, resumed));
+
+    // A server restart forgets all the keys
+    const auto fresh = makeResume(tickets.issue(server_pubkey, client_pubkey), Body{});
+    tickets.clear();
+    QVERIFY(!open(tickets, server_pubkey, fresh, resumed));
+
+    // None of them could be opened, so they were not counted as rejected
+    QCOMPARE(getCounter("prot.tickets.rejected"), rejected);
+}
+
+void TestSessionTickets::test_identity_binding()
+{
+    SessionTickets tickets;
+    const QByteArray other_pubkey(static_cast<int>(SessionTickets::pubkey_bytes), 'o');
+
+    // The ticket only opens for the identity that issued it
+    const auto message = makeResume(tickets.issue(server_pubkey, client_pubkey), Body{});
+    SessionTickets::Resumed resumed;
+    QVERIFY(!open(tickets, other_pubkey, message, resumed));
+    QVERIFY(open(tickets, server_pubkey, message, resumed));
+    QCOMPARE(resumed.clientPubkey, client_pubkey);
+
+    // The client only uses it with the identities it was stored for
+    tickets.store(client_pubkey, server_pubkey, tickets.issue(server_pubkey, client_pubkey));
+    SessionTickets::Ticket ticket;
+    QVERIFY(!tickets.take(client_pubkey, other_pubkey, ticket));
+    QVERIFY(!tickets.take(other_pubkey, server_pubkey, ticket));
+    QVERIFY(tickets.take(client_pubkey, server_pubkey, ticket));
+
+    // Tickets are for signing pubkeys only
+    QVERIFY_EXCEPTION_THROWN(tickets.issue(server_pubkey, "too short"), std::runtime_error);
+}
+
+void TestSessionTickets::test_corrupt_body()
+{
+    SessionTickets tickets;
+    const auto rejected = getCounter("prot.tickets.rejected");
+    const auto message = makeResume(tickets.issue(server_pubkey, client_pubkey), Body{});
+    const auto ticket_bytes = static_cast<int>(SessionTickets::ticket_bytes);
+    SessionTickets::Resumed resumed;
+
+    // A corrupt ticket looks like a Hello
+    auto corrupt = message;
+    corrupt[ticket_bytes / 2] = static_cast<char>(corrupt.at(ticket_bytes / 2) ^ 1);
+    QVERIFY(!open(tickets, server_pubkey, corrupt, resumed));
+    QCOMPARE(getCounter("prot.tickets.rejected"), rejected);
+
+    // A valid ticket with a corrupt body is rejected
+    corrupt = message;
+    corrupt[ticket_bytes + 1] = static_cast<char>(corrupt.at(ticket_bytes + 1) ^ 1);
+    QVERIFY(!open(tickets, server_pubkey, corrupt, resumed));
+    QCOMPARE(getCounter("prot.tickets.rejected"), rejected + 1);
+
+    // So is a message that is too short for the body
+    QVERIFY(!open(tickets, server_pubkey, message.left(ticket_bytes + 8), resumed));
+    QVERIFY(!open(tickets, server_pubkey, message.left(ticket_bytes - 1), resumed));
+    QVERIFY(resumed.clientPubkey.isEmpty());
+}
+
+void TestSessionTickets::test_rejected_ticket_falls_back_to_hello()
+{
+    auto& tickets = SessionTickets::instance();
+    tickets.clear();
+
+    int incoming = 0;
+    auto onIncoming = connect(mgr_.get(), &ProtocolManager::incomingPeer,
+                              this, [&incoming](const shared_ptr<PeerConnection>& peer) {
+        ++incoming;
+        peer->authorize(true);
+    });
+
+    // The first connection gets Alice a ticket
+    auto first = mgr_->connectTo(getConnectData(alice_, bob_));
+    QTRY_VERIFY_WITH_TIMEOUT(tickets.size() > 0, wait_ms);
+    first->close();
+
+    // As if Bob was restarted: the ticket can't be opened anymore
+    const auto ours = alice_.cert->getSigningPubKey().toByteArray();
+    const auto theirs = bob_.cert->getSigningPubKey().toByteArray();
+    SessionTickets::Ticket ticket;
+    QVERIFY(tickets.take(ours, theirs, ticket));
+    ticket.ticket[0] = static_cast<char>(ticket.ticket.at(0) ^ 1);
+    tickets.store(ours, theirs, move(ticket));
+
+    // Alice retries with a full Hello right away, on the same peer
+    incoming = 0;
+    const auto resumedCount = getCounter("prot.tickets.resumed");
+    auto client = mgr_->connectTo(getConnectData(alice_, bob_));
+    int disconnects = 0;
+    connect(client.get(), &PeerConnection::disconnectedFromPeer, this, [&disconnects] {
+        ++disconnects;
+    });
+
+    QTRY_VERIFY_WITH_TIMEOUT(client->isConnected() && (incoming == 1), wait_ms);
+    QCOMPARE(disconnects, 0);
+    QCOMPARE(getCounter("prot.tickets.resumed"), resumedCount);
+
+    disconnect(onIncoming);
+    client->close();
+}
+
+void TestSessionTickets::startService(TestSessionTickets::Endpoint &ep, const QString &name)
+{
+    TransportHandle th;
+    auto conn = connect(mgr_.get(), &ProtocolManager::transportHandleReady,
+                        this, [&th](const TransportHandle& handle) {
+        th = handle;
+    });
+
+    mgr_->createTransportHandle({name, ep.uuid});
+    disconnect(conn);
+
+    QCOMPARE(th.uuid, ep.uuid);
+    ep.address = th.data["address"].toByteArray();
+
+    bool started = false;
+    conn = connect(mgr_.get(), &ProtocolManager::serviceStarted,
+                   this, [&started, &ep](const QUuid& uuid, const bool) {
+        started = (uuid == ep.uuid);
+    });
+    mgr_->startService(ep.uuid, ep.cert, th.data);
+    disconnect(conn);
+
+    QVERIFY(started);
+}
+
+ConnectData TestSessionTickets::getConnectData(const TestSessionTickets::Endpoint &from,
+                                               const TestSessionTickets::Endpoint &to) const
+{
+    ConnectData cd;
+    cd.service = from.uuid;
+    cd.address = to.address;
+    cd.identitysCert = from.cert;
+    cd.contactsCert = ds::crypto::DsCert::createFromPubkey(
+                to.cert->getSigningPubKey().toByteArray());
+    return cd;
+}
@@ -0,0 +1,54 @@
+#ifndef TST_SESSIONTICKETS_H
+#define TST_SESSIONTICKETS_H
+
+#include <memory>
+
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QSettings>
+
+#include "ds/protocolmanager.h"
+#include "ds/dscert.h"
+
+/*! Session tickets, and resuming the handshake with them.
+ *
+ * The unit tests use their own SessionTickets instance. The
+ * fallback test runs Alice and Bob in the same process on the
+ * loopback transport, with the shared instance.
+ */
+class TestSessionTickets : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestSessionTickets() = default;
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void test_resume();
+    void test_replay();
+    void test_expiry();
+    void test_key_rotation();
+    void test_identity_binding();
+    void test_corrupt_body();
+    void test_rejected_ticket_falls_back_to_hello();
+
+private:
+    struct Endpoint {
+        QUuid uuid = QUuid::createUuid();
+        ds::crypto::DsCert::ptr_t cert = ds::crypto::DsCert::create();
+        QByteArray address;
+    };
+
+    void startService(Endpoint& ep, const QString& name);
+    ds::core::ConnectData getConnectData(const Endpoint& from, const Endpoint& to) const;
+
+    QTemporaryDir dir_;
+    std::unique_ptr<QSettings> settings_;
+    ds::core::ProtocolManager::ptr_t mgr_;
+    Endpoint alice_;
+    Endpoint bob_;
+};
+
+#endif // TST_SESSIONTICKETS_H
@@ -0,0 +1,230 @@
+#include <vector>
+
+#include "tst_streamcipher.h"
+#include "ds/loopbackprotocolmanager.h"
+#include "ds/peer.h"
+#include "ds/streamcipher.h"
+#include "ds/transporthandle.h"
+
+using namespace std;
+using namespace ds::core;
+using ds::prot::Peer;
+using ds::prot::StreamCipher;
+
+Q_DECLARE_METATYPE(StreamCipher::Suite)
+
+namespace {
+
+constexpr int wait_ms = 10000;
+
+struct Stream {
+    Stream(const StreamCipher::Suite suite) {
+        vector<unsigned char> header(StreamCipher::header_bytes);
+        vector<unsigned char> key(StreamCipher::key_bytes);
+        out.initPush(header.data(), key.data());
+        in.initPull(header.data(), key.data());
+        out.setSuite(suite);
+        in.setSuite(suite);
+    }
+
+    StreamCipher out;
+    StreamCipher in;
+};
+
+void addSuites()
+{
+    QTest::addColumn<StreamCipher::Suite>("suite");
+
+    QTest::newRow("xchacha20poly1305") << StreamCipher::Suite::XCHACHA20POLY1305;
+    QTest::newRow("aes256gcm") << StreamCipher::Suite::AES256GCM;
+}
+
+bool isAvailable(const StreamCipher::Suite suite)
+{
+    return (suite != StreamCipher::Suite::AES256GCM) || StreamCipher::isAesGcmAvailable();
+}
+
+} // anonymous namespace
+
+void TestStreamCipher::initTestCase()
+{
+    QVERIFY(dir_.isValid());
+    settings_ = make_unique<QSettings>(dir_.filePath("streamcipher.ini"), QSettings::IniFormat);
+    settings_->setValue("transport", "loopback");
+
+    // Every connection does the full handshake
+    settings_->setValue("sessionTickets", false);
+
+    mgr_ = ProtocolManager::create(*settings_, ProtocolManager::Transport::TOR);
+    QVERIFY(dynamic_cast<ds::prot::LoopbackProtocolManager *>(mgr_.get()));
+    mgr_->start();
+    QVERIFY(mgr_->isOnline());
+
+    startService(aesAlice_, "alice", true);
+    startService(aesBob_, "bob", true);
+    startService(chachaCarol_, "carol", false);
+}
+
+void TestStreamCipher::cleanupTestCase()
+{
+    if (mgr_) {
+        mgr_->stop();
+    }
+}
+
+void TestStreamCipher::test_roundtrip_data()
+{
+    addSuites();
+}
+
+void TestStreamCipher::test_roundtrip()
+{
+    QFETCH(StreamCipher::Suite, suite);
+
+    if (!isAvailable(suite)) {
+        QSKIP("No hardware support for AES-256-GCM on this CPU");
+    }
+
+    Stream stream{suite};
+    QCOMPARE(stream.out.getSuite(), suite);
+    QCOMPARE(stream.in.getSuite(), suite);
+
+    for(const size_t size : {size_t{1}, size_t{1024}, size_t{64 * 1024}}) {
+        vector<unsigned char> ciphertext(size + StreamCipher::abytes);
+        vector<unsigned char> received(size);
+
+        for(int i = 0; i < 3; ++i) {
+            const vector<unsigned char> data(size, static_cast<unsigned char>('a' + i));
+            const auto sentTag = (i == 2) ? StreamCipher::tag_push : StreamCipher::tag_message;
+            unsigned char tag = {};
+
+            stream.out.push(ciphertext.data(), data.data(), size, sentTag);
+            QVERIFY(stream.in.pull(received.data(), tag, ciphertext.data(), ciphertext.size()));
+            QCOMPARE(tag, sentTag);
+            QVERIFY(received == data);
+        }
+    }
+}
+
+void TestStreamCipher::test_tampered_data()
+{
+    addSuites();
+}
+
+void TestStreamCipher::test_tampered()
+{
+    QFETCH(StreamCipher::Suite, suite);
+
+    if (!isAvailable(suite)) {
+        QSKIP("No hardware support for AES-256-GCM on this CPU");
+    }
+
+    const size_t size = 256;
+    const vector<unsigned char> data(size, 'z');
+    vector<unsigned char> received(size);
+    unsigned char tag = {};
+
+    // Any modified byte must be rejected, including the tag
+    for(const size_t offset : {size_t{0}, size / 2, size + StreamCipher::abytes - 1}) {
+        Stream stream{suite};
+        vector<unsigned char> ciphertext(size + StreamCipher::abytes);
+        stream.out.push(ciphertext.data(), data.data(), size, StreamCipher::tag_message);
+        ciphertext[offset] ^= 1;
+        QVERIFY(!stream.in.pull(received.data(), tag, ciphertext.data(), ciphertext.size()));
+    }
+
+    // So must a replayed message
+    Stream stream{suite};
+    vector<unsigned char> ciphertext(size + StreamCipher::abytes);
+    stream.out.push(ciphertext.data(), data.data(), size, StreamCipher::tag_message);
+    QVERIFY(stream.in.pull(received.data(), tag, ciphertext.data(), ciphertext.size()));
+    QVERIFY(!stream.in.pull(received.data(), tag, ciphertext.data(), ciphertext.size()));
+}
+
+void TestStreamCipher::test_handshake_data()
+{
+    QTest::addColumn<bool>("clientAesGcm");
+    QTest::addColumn<bool>("serverAesGcm");
+
+    QTest::newRow("both") << true << true;
+    QTest::newRow("client-only") << true << false;
+    QTest::newRow("server-only") << false << true;
+}
+
+void TestStreamCipher::test_handshake()
+{
+    QFETCH(bool, clientAesGcm);
+    QFETCH(bool, serverAesGcm);
+
+    const auto& from = clientAesGcm ? aesAlice_ : chachaCarol_;
+    const auto& to = serverAesGcm ? aesBob_ : chachaCarol_;
+
+    const auto expected = (clientAesGcm && serverAesGcm && StreamCipher::isAesGcmAvailable())
+            ? StreamCipher::Suite::AES256GCM : StreamCipher::Suite::XCHACHA20POLY1305;
+
+    shared_ptr<Peer> server;
+    QByteArray received;
+    auto onIncoming = connect(mgr_.get(), &ProtocolManager::incomingPeer,
+                              this, [&](const shared_ptr<PeerConnection>& peer) {
+        server = dynamic_pointer_cast<Peer>(peer);
+        connect(peer.get(), &PeerConnection::receivedAck, this, [&received](const PeerAck& ack) {
+            received = ack.what;
+        });
+        peer->authorize(true);
+    });
+
+    auto client = dynamic_pointer_cast<Peer>(mgr_->connectTo(getConnectData(from, to)));
+    QVERIFY(client);
+    QTRY_VERIFY_WITH_TIMEOUT(client->isConnected() && server, wait_ms);
+
+    QCOMPARE(client->getCipherSuite(), expected);
+    QCOMPARE(server->getCipherSuite(), expected);
+
+    // Both sides must use the suite they agreed on
+    client->sendAck("CipherTest", "Ok");
+    QTRY_COMPARE_WITH_TIMEOUT(received, QByteArray{"CipherTest"}, wait_ms);
+
+    disconnect(onIncoming);
+    client->close();
+    server->close();
+}
+
+void TestStreamCipher::startService(TestStreamCipher::Endpoint &ep, const QString &name,
+                                    const bool aesGcm)
+{
+    settings_->setValue("aesGcm", aesGcm);
+
+    TransportHandle th;
+    auto conn = connect(mgr_.get(), &ProtocolManager::transportHandleReady,
+                        this, [&th](const TransportHandle& handle) {
+        th = handle;
+    });
+
+    mgr_->createTransportHandle({name, ep.uuid});
+    disconnect(conn);
+
+    QCOMPARE(th.uuid, ep.uuid);
+    ep.address = th.data["address"].toByteArray();
+
+    bool started = false;
+    conn = connect(mgr_.get(), &ProtocolManager::serviceStarted,
+                   this, [&started, &ep](const QUuid& uuid, const bool) {
+        started = (uuid == ep.uuid);
+    });
+    mgr_->startService(ep.uuid, ep.cert, th.data);
+    disconnect(conn);
+
+    QVERIFY(started);
+}
+
+ConnectData TestStreamCipher::getConnectData(const TestStreamCipher::Endpoint &from,
+                                             const TestStreamCipher::Endpoint &to) const
+{
+    ConnectData cd;
+    cd.service = from.uuid;
+    cd.address = to.address;
+    cd.identitysCert = from.cert;
+    cd.contactsCert = ds::crypto::DsCert::createFromPubkey(
+                to.cert->getSigningPubKey().toByteArray());
+    return cd;
+}
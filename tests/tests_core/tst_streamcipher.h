@@ -0,0 +1,54 @@
+#ifndef TST_STREAMCIPHER_H
+#define TST_STREAMCIPHER_H
+
+#include <memory>
+
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QSettings>
+
+#include "ds/protocolmanager.h"
+#include "ds/dscert.h"
+
+/*! The cipher suites for the encrypted stream, and the negotiation.
+ *
+ * The handshake test runs the peers in the same process on the
+ * loopback transport. The aesGcm setting is read when a service
+ * starts, so each endpoint has its own.
+ */
+class TestStreamCipher : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestStreamCipher() = default;
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void test_roundtrip_data();
+    void test_roundtrip();
+    void test_tampered_data();
+    void test_tampered();
+    void test_handshake_data();
+    void test_handshake();
+
+private:
+    struct Endpoint {
+        QUuid uuid = QUuid::createUuid();
+        ds::crypto::DsCert::ptr_t cert = ds::crypto::DsCert::create();
+        QByteArray address;
+    };
+
+    void startService(Endpoint& ep, const QString& name, const bool aesGcm);
+    ds::core::ConnectData getConnectData(const Endpoint& from, const Endpoint& to) const;
+
+    QTemporaryDir dir_;
+    std::unique_ptr<QSettings> settings_;
+    ds::core::ProtocolManager::ptr_t mgr_;
+    Endpoint aesAlice_;
+    Endpoint aesBob_;
+    Endpoint chachaCarol_;
+};
+
+#endif // TST_STREAMCIPHER_H
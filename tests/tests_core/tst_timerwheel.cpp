@@ -0,0 +1,84 @@
+#include <QElapsedTimer>
+
+#include "tst_timerwheel.h"
+
+using namespace std;
+using namespace std::chrono;
+using ds::core::TimerWheel;
+
+void TestTimerWheel::test_deadline_expires()
+{
+    TimerWheel wheel{milliseconds{10}, 8};
+
+    QElapsedTimer timer;
+    timer.start();
+    qint64 elapsed = -1;
+    wheel.add(milliseconds{50}, [&] {
+        elapsed = timer.elapsed();
+    });
+
+    QCOMPARE(wheel.size(), size_t{1});
+    QTRY_VERIFY(elapsed >= 0);
+    QVERIFY(elapsed >= 50);
+    QCOMPARE(wheel.size(), size_t{0});
+}
+
+void TestTimerWheel::test_cancel()
+{
+    TimerWheel wheel{milliseconds{10}, 8};
+
+    bool cancelledFired = false, otherFired = false;
+    const auto id = wheel.add(milliseconds{20}, [&] {
+        cancelledFired = true;
+    });
+    wheel.add(milliseconds{40}, [&] {
+        otherFired = true;
+    });
+
+    QVERIFY(wheel.cancel(id));
+    QVERIFY(!wheel.cancel(id));
+
+    QTRY_VERIFY(otherFired);
+    QVERIFY(!cancelledFired);
+}
+
+void TestTimerWheel::test_timeout_longer_than_wheel()
+{
+    // 4 slots of 10ms; 100ms requires more than two turns of the wheel
+    TimerWheel wheel{milliseconds{10}, 4};
+
+    QElapsedTimer timer;
+    timer.start();
+    qint64 shortElapsed = -1, longElapsed = -1;
+
+    wheel.add(milliseconds{100}, [&] {
+        longElapsed = timer.elapsed();
+    });
+    wheel.add(milliseconds{20}, [&] {
+        shortElapsed = timer.elapsed();
+    });
+
+    QTRY_VERIFY(longElapsed >= 0);
+    QVERIFY(shortElapsed >= 20);
+    QVERIFY(longElapsed >= 100);
+    QVERIFY(shortElapsed < longElapsed);
+}
+
+void TestTimerWheel::test_never_early_between_ticks()
+{
+    TimerWheel wheel{milliseconds{100}, 8};
+
+    // Keep the wheel turning, and add the deadline just before a tick
+    wheel.add(seconds{10}, [] {});
+    QTest::qWait(90);
+
+    QElapsedTimer timer;
+    timer.start();
+    qint64 elapsed = -1;
+    wheel.add(milliseconds{100}, [&] {
+        elapsed = timer.elapsed();
+    });
+
+    QTRY_VERIFY(elapsed >= 0);
+    QVERIFY(elapsed >= 100);
+}
@@ -0,0 +1,22 @@
+#ifndef TST_TIMERWHEEL_H
+#define TST_TIMERWHEEL_H
+
+#include <QtTest>
+
+#include "ds/timerwheel.h"
+
+class TestTimerWheel : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestTimerWheel() = default;
+
+private slots:
+    void test_deadline_expires();
+    void test_cancel();
+    void test_timeout_longer_than_wheel();
+    void test_never_early_between_ticks();
+};
+
+#endif // TST_TIMERWHEEL_H
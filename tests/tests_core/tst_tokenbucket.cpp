@@ -0,0 +1,107 @@
+#include <memory>
+
+#include "tst_tokenbucket.h"
+
+using namespace std;
+using namespace std::chrono;
+using ds::core::TokenBucket;
+using ds::core::BandwidthShaper;
+
+namespace {
+
+constexpr quint64 kb = 1024;
+
+} // anonymous namespace
+
+void TestTokenBucket::test_unlimited()
+{
+    TokenBucket bucket;
+
+    QVERIFY(bucket.isUnlimited());
+    bucket.consume(1024 * 1024 * kb);
+    QCOMPARE(bucket.getDelay().count(), static_cast<milliseconds::rep>(0));
+
+    // It still measures
+    QCOMPARE(bucket.getMeter().getTotal(), 1024 * 1024 * kb);
+}
+
+void TestTokenBucket::test_burst()
+{
+    TokenBucket bucket{64 * kb, 128 * kb};
+
+    QVERIFY(!bucket.isUnlimited());
+    QCOMPARE(bucket.getLimit(), 64 * kb);
+
+    // A full bucket allows the burst without delay
+    bucket.consume(128 * kb);
+    QCOMPARE(bucket.getDelay().count(), static_cast<milliseconds::rep>(0));
+
+    bucket.consume(kb);
+    QVERIFY(bucket.getDelay().count() > 0);
+}
+
+void TestTokenBucket::test_delay()
+{
+    TokenBucket bucket{64 * kb};
+
+    // Empty the bucket, and go one second into debt
+    bucket.consume(64 * kb);
+    bucket.consume(64 * kb);
+
+    const auto delay = bucket.getDelay().count();
+    QVERIFY(delay > 900);
+    QVERIFY(delay <= 1000);
+}
+
+void TestTokenBucket::test_refill()
+{
+    TokenBucket bucket{64 * kb};
+
+    bucket.consume(64 * kb);
+    bucket.consume(64 * kb);
+    const auto before = bucket.getDelay().count();
+
+    QTest::qWait(300);
+
+    // The bucket is refilled with the rate while we wait
+    const auto after = bucket.getDelay().count();
+    QVERIFY(after <= before - 250);
+    QVERIFY(after > 0);
+
+    QTRY_COMPARE_WITH_TIMEOUT(bucket.getDelay().count(), static_cast<milliseconds::rep>(0), 2000);
+}
+
+void TestTokenBucket::test_refill_is_capped_by_burst()
+{
+    // Refills 100 KB in 100 ms, but holds at most 64 KB
+    TokenBucket bucket{1024 * kb, 64 * kb};
+
+    QTest::qWait(100);
+
+    bucket.consume(64 * kb);
+    QCOMPARE(bucket.getDelay().count(), static_cast<milliseconds::rep>(0));
+
+    bucket.consume(100 * kb);
+    QVERIFY(bucket.getDelay().count() >= 90);
+}
+
+void TestTokenBucket::test_shaper_uses_slowest_bucket()
+{
+    auto unlimited = make_shared<TokenBucket>();
+    auto fast = make_shared<TokenBucket>(1024 * kb, 64 * kb);
+    auto slow = make_shared<TokenBucket>(64 * kb, 64 * kb);
+
+    BandwidthShaper shaper{{unlimited, fast, slow}};
+
+    shaper.consume(64 * kb);
+    QCOMPARE(shaper.getDelay().count(), static_cast<milliseconds::rep>(0));
+
+    shaper.consume(64 * kb);
+    QVERIFY(fast->getDelay() < slow->getDelay());
+    QVERIFY(shaper.getDelay().count() > 900);
+
+    // All the buckets are charged
+    QCOMPARE(unlimited->getMeter().getTotal(), 128 * kb);
+    QCOMPARE(fast->getMeter().getTotal(), 128 * kb);
+    QCOMPARE(slow->getMeter().getTotal(), 128 * kb);
+}
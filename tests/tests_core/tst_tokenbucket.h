@@ -0,0 +1,24 @@
+#ifndef TST_TOKENBUCKET_H
+#define TST_TOKENBUCKET_H
+
+#include <QtTest>
+
+#include "ds/ratelimiter.h"
+
+class TestTokenBucket : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestTokenBucket() = default;
+
+private slots:
+    void test_unlimited();
+    void test_burst();
+    void test_delay();
+    void test_refill();
+    void test_refill_is_capped_by_burst();
+    void test_shaper_uses_slowest_bucket();
+};
+
+#endif // TST_TOKENBUCKET_H
@@ -0,0 +1,104 @@
+#include "tst_tracer.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+
+using namespace std;
+using namespace ds::core;
+
+void TestTracer::cleanup()
+{
+    Tracer::instance().enable(false);
+    Tracer::instance().clear();
+}
+
+void TestTracer::test_disabled()
+{
+    auto& tracer = Tracer::instance();
+    const QByteArray id{"msg"};
+
+    QVERIFY(!tracer.isEnabled());
+    {
+        TraceSpan span{"disabled", "test", id};
+    }
+    tracer.mark("disabled", "test", id);
+
+    QVERIFY(tracer.events().empty());
+    QCOMPARE(tracer.getDropped(), size_t{0});
+}
+
+void TestTracer::test_spans()
+{
+    auto& tracer = Tracer::instance();
+    const QByteArray id{"msg"};
+
+    tracer.enable(true);
+    tracer.begin("delivery", "test", id);
+    {
+        TraceSpan span{"stage", "test", id};
+    }
+    tracer.end("delivery", "test", id);
+    tracer.enable(false);
+
+    const auto events = tracer.events();
+    QCOMPARE(events.size(), size_t{3});
+
+    QCOMPARE(events.at(0).phase, 'b');
+    QCOMPARE(events.at(0).name, QStringLiteral("delivery"));
+    QCOMPARE(events.at(1).phase, 'X');
+    QCOMPARE(events.at(1).name, QStringLiteral("stage"));
+    QCOMPARE(events.at(1).category, QStringLiteral("test"));
+    QCOMPARE(events.at(1).id, QString::fromLatin1(id.toBase64()));
+    QCOMPARE(events.at(2).phase, 'e');
+    QVERIFY(events.at(0).ts <= events.at(1).ts);
+    QVERIFY(events.at(1).ts + events.at(1).dur <= events.at(2).ts);
+}
+
+void TestTracer::test_drop_when_full()
+{
+    auto& tracer = Tracer::instance();
+    const QByteArray id{"msg"};
+
+    tracer.enable(true, 3);
+    for(int i = 0; i < 5; ++i) {
+        tracer.mark("mark", "test", id);
+    }
+    tracer.enable(false);
+
+    QCOMPARE(tracer.events().size(), size_t{3});
+    QCOMPARE(tracer.events().at(0).phase, 'i');
+    QCOMPARE(tracer.getDropped(), size_t{2});
+
+    tracer.clear();
+    QVERIFY(tracer.events().empty());
+    QCOMPARE(tracer.getDropped(), size_t{0});
+}
+
+void TestTracer::test_write()
+{
+    auto& tracer = Tracer::instance();
+    const QByteArray id{"msg"};
+
+    tracer.enable(true);
+    tracer.begin("delivery", "test", id);
+    {
+        TraceSpan span{"stage", "test", id};
+    }
+    tracer.end("delivery", "test", id);
+    tracer.enable(false);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const auto path = dir.filePath("trace.json");
+    tracer.write(path);
+
+    QFile file{path};
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const auto json = QJsonDocument::fromJson(file.readAll()).object();
+    const auto events = json.value("traceEvents").toArray();
+    QCOMPARE(events.size(), 3);
+    QCOMPARE(events.at(0).toObject().value("ph").toString(), QStringLiteral("b"));
+    QCOMPARE(events.at(1).toObject().value("name").toString(), QStringLiteral("stage"));
+}
@@ -0,0 +1,23 @@
+#ifndef TST_TRACER_H
+#define TST_TRACER_H
+
+#include <QtTest>
+
+#include "ds/tracer.h"
+
+class TestTracer : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestTracer() = default;
+
+private slots:
+    void cleanup();
+    void test_disabled();
+    void test_spans();
+    void test_drop_when_full();
+    void test_write();
+};
+
+#endif // TST_TRACER_H
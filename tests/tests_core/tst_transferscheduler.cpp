@@ -0,0 +1,166 @@
+#include <memory>
+#include <set>
+
+#include "tst_transferscheduler.h"
+
+using namespace std;
+using scheduler_t = ds::core::TransferScheduler<TestTransferScheduler::MockTransfer>;
+
+namespace {
+
+constexpr size_t block_size = 1024 * 8;
+
+quint64 remaining(const TestTransferScheduler::MockTransfer& t) {
+    return t.size - t.sent;
+}
+
+size_t sendBlock(TestTransferScheduler::MockTransfer& t) {
+    const auto bytes = min<quint64>(remaining(t), block_size);
+    t.sent += bytes;
+    return static_cast<size_t>(bytes);
+}
+
+// Run one round, and count the rounds where each transfer was served
+size_t runRound(scheduler_t& scheduler) {
+    set<const TestTransferScheduler::MockTransfer *> served;
+    return scheduler.runRound([&](TestTransferScheduler::MockTransfer& t) {
+        if (served.insert(&t).second) {
+            ++t.rounds;
+        }
+        return sendBlock(t);
+    });
+}
+
+} // anonymous namespace
+
+void TestTransferScheduler::test_small_file_completes_while_large_in_flight()
+{
+    scheduler_t scheduler{remaining, block_size};
+
+    // The large file is added first, and would previously starve the small one.
+    auto large = make_shared<MockTransfer>(1024ULL * 1024 * 1024);
+    auto small = make_shared<MockTransfer>(1024);
+
+    QVERIFY(scheduler.insert(large));
+    QVERIFY(scheduler.insert(small));
+    QVERIFY(!scheduler.insert(small));
+
+    int rounds = 0;
+    while(remaining(*small) > 0) {
+        QVERIFY(runRound(scheduler) > 0);
+        QVERIFY(++rounds < 3);
+    }
+
+    QCOMPARE(rounds, 1);
+    QCOMPARE(small->rounds, 1);
+    QCOMPARE(large->rounds, 1);
+    QCOMPARE(small->sent, static_cast<quint64>(1024));
+    QVERIFY(large->sent > 0);
+    QVERIFY(remaining(*large) > 0);
+}
+
+void TestTransferScheduler::test_fair_share_for_equal_files()
+{
+    scheduler_t scheduler{remaining, block_size};
+
+    auto first = make_shared<MockTransfer>(512ULL * 1024 * 1024);
+    auto second = make_shared<MockTransfer>(512ULL * 1024 * 1024);
+
+    scheduler.insert(first);
+    scheduler.insert(second);
+
+    for(int i = 0; i < 100; ++i) {
+        runRound(scheduler);
+    }
+
+    QCOMPARE(first->rounds, 100);
+    QCOMPARE(second->rounds, 100);
+    QCOMPARE(first->sent, second->sent);
+    QCOMPARE(first->sent, static_cast<quint64>(100 * block_size));
+}
+
+void TestTransferScheduler::test_large_file_served_every_round()
+{
+    scheduler_t scheduler{remaining, block_size};
+
+    // The small files get a larger quantum, but never starve the large one
+    auto large = make_shared<MockTransfer>(1024ULL * 1024 * 1024);
+    vector<shared_ptr<MockTransfer>> small;
+    for(int i = 0; i < 10; ++i) {
+        small.push_back(make_shared<MockTransfer>(512 * 1024));
+        scheduler.insert(small.back());
+    }
+    scheduler.insert(large);
+
+    for(int i = 0; i < 50; ++i) {
+        runRound(scheduler);
+    }
+
+    QCOMPARE(large->rounds, 50);
+    QCOMPARE(large->sent, static_cast<quint64>(50 * block_size));
+    for(const auto& t : small) {
+        QCOMPARE(t->rounds, 15);
+        QCOMPARE(t->sent, t->size);
+    }
+}
+
+void TestTransferScheduler::test_remove_during_round()
+{
+    scheduler_t scheduler{remaining, block_size};
+
+    auto first = make_shared<MockTransfer>(1024 * 1024);
+    auto second = make_shared<MockTransfer>(1024 * 1024);
+
+    scheduler.insert(first);
+    scheduler.insert(second);
+
+    // Simulate a state-change that removes both transfers while the first one is sending
+    const auto sent = scheduler.runRound([&](MockTransfer& t) -> size_t {
+        scheduler.erase(first);
+        scheduler.erase(second);
+        return sendBlock(t);
+    });
+
+    QCOMPARE(sent, block_size);
+    QVERIFY(scheduler.empty());
+    QCOMPARE(second->sent, static_cast<quint64>(0));
+}
+
+void TestTransferScheduler::test_progress_with_backpressure()
+{
+    scheduler_t scheduler{remaining, block_size};
+
+    // Like the output buffer of a connection, that only takes
+    // a few blocks before we must wait for it to drain.
+    constexpr size_t blocks_per_round = 3;
+
+    vector<shared_ptr<MockTransfer>> transfers;
+    for(int i = 0; i < 4; ++i) {
+        transfers.push_back(make_shared<MockTransfer>(32ULL * 1024 * 1024));
+        scheduler.insert(transfers.back());
+    }
+
+    constexpr int rounds = 40;
+    for(int i = 0; i < rounds; ++i) {
+        size_t budget = blocks_per_round;
+        const auto sent = scheduler.runRound([&](MockTransfer& t) -> size_t {
+            if (budget == 0) {
+                return 0;
+            }
+            --budget;
+            return sendBlock(t);
+        });
+
+        QCOMPARE(sent, blocks_per_round * block_size);
+    }
+
+    quint64 least = transfers.front()->sent, most = 0;
+    for(const auto& t : transfers) {
+        QVERIFY(t->sent > 0);
+        least = min(least, t->sent);
+        most = max(most, t->sent);
+    }
+
+    // No flow gets more than one quantum ahead of the others
+    QVERIFY(most - least <= scheduler.getQuantum(32ULL * 1024 * 1024));
+}
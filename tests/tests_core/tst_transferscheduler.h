@@ -0,0 +1,31 @@
+#ifndef TST_TRANSFERSCHEDULER_H
+#define TST_TRANSFERSCHEDULER_H
+
+#include <QtTest>
+
+#include "ds/transferscheduler.h"
+
+class TestTransferScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct MockTransfer {
+        MockTransfer(quint64 bytes) : size{bytes} {}
+
+        quint64 size = 0;
+        quint64 sent = 0;
+        int rounds = 0; // Rounds where the transfer got to send
+    };
+
+    TestTransferScheduler() = default;
+
+private slots:
+    void test_small_file_completes_while_large_in_flight();
+    void test_fair_share_for_equal_files();
+    void test_large_file_served_every_round();
+    void test_remove_during_round();
+    void test_progress_with_backpressure();
+};
+
+#endif // TST_TRANSFERSCHEDULER_H
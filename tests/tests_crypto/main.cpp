@@ -3,6 +3,9 @@
 #include <iostream>
 #include "ds/crypto.h"
 #include "tst_certs.h"
+#include "tst_encoding.h"
+#include "tst_batchverifier.h"
+#include "tst_safememory.h"
 #include "logfault/logfault.h"
 
 int main(int argc, char** argv)
@@ -27,6 +30,21 @@ int main(int argc, char** argv)
          status |= QTest::qExec(&tc, argc, argv);
      }
 
+     {
+         TestEncoding tc;
+         status |= QTest::qExec(&tc, argc, argv);
+     }
+
+     {
+         TestBatchVerifier tc;
+         status |= QTest::qExec(&tc, argc, argv);
+     }
+
+     {
+         TestSafeMemory tc;
+         status |= QTest::qExec(&tc, argc, argv);
+     }
+
 
     return status;
 }
@@ -11,14 +11,20 @@ INCLUDEPATH += $$PWD/../../src/cryptolib/include
 
 SOURCES +=  \
     main.cpp \
-    tst_certs.cpp
+    tst_certs.cpp \
+    tst_encoding.cpp \
+    tst_batchverifier.cpp \
+    tst_safememory.cpp
 
 INCLUDEPATH += $$PWD/../../src/cryptolib
 DEPENDPATH += $$PWD/../../src/cryptolib
 
 
 HEADERS += \
-    tst_certs.h
+    tst_certs.h \
+    tst_encoding.h \
+    tst_batchverifier.h \
+    tst_safememory.h
 
 win32:CONFIG(release, debug|release): LIBS += -L$$OUT_PWD/../../src/cryptolib/release/ -lcryptolib
 else:win32:CONFIG(debug, debug|release): LIBS += -L$$OUT_PWD/../../src/cryptolib/debug/ -lcryptolib
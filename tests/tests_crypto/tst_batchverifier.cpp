@@ -0,0 +1,94 @@
+#include <set>
+#include <vector>
+
+#include "tst_batchverifier.h"
+#include "ds/batchverifier.h"
+#include "ds/dscert.h"
+
+using namespace std;
+using namespace ds::crypto;
+
+namespace {
+
+vector<BatchVerifier::Item> makeItems(const DsCert& cert, const int count) {
+    vector<BatchVerifier::Item> items;
+    items.reserve(static_cast<size_t>(count));
+
+    for(int i = 0; i < count; ++i) {
+        BatchVerifier::Item item;
+        item.cert = &cert;
+        item.data = QByteArray("Message #") + QByteArray::number(i);
+        item.signature = cert.sign<QByteArray>({item.data});
+        items.push_back(move(item));
+    }
+
+    return items;
+}
+
+} // anonymous namespace
+
+void TestBatchVerifier::test_empty_batch()
+{
+    QVERIFY(BatchVerifier{}.verify(vector<BatchVerifier::Item>{}).empty());
+    QVERIFY(BatchVerifier{4}.verify(vector<BatchVerifier::Item>{}).empty());
+}
+
+void TestBatchVerifier::test_results_in_order_data()
+{
+    QTest::addColumn<int>("count");
+    QTest::addColumn<int>("threads");
+
+    const auto min_parallel = static_cast<int>(BatchVerifier::min_parallel);
+
+    QTest::newRow("one") << 1 << 4;
+    QTest::newRow("below-parallel") << min_parallel - 1 << 4;
+    QTest::newRow("parallel") << min_parallel << 4;
+    QTest::newRow("uneven-chunks") << min_parallel * 5 + 3 << 4;
+    QTest::newRow("one-thread") << 200 << 1;
+    QTest::newRow("default-threads") << 200 << 0;
+}
+
+void TestBatchVerifier::test_results_in_order()
+{
+    QFETCH(int, count);
+    QFETCH(int, threads);
+
+    auto cert = DsCert::create();
+    auto items = makeItems(*cert, count);
+
+    // Every third item is invalid, so a result in the wrong place is detected
+    for(size_t i = 0; i < items.size(); i += 3) {
+        items[i].data[0] = 'x';
+    }
+
+    const auto results = BatchVerifier{static_cast<size_t>(threads)}.verify(items);
+    QCOMPARE(results.size(), items.size());
+
+    for(size_t i = 0; i < items.size(); ++i) {
+        QCOMPARE(results[i], (i % 3) != 0);
+        QCOMPARE(results[i], BatchVerifier::verify(items[i]));
+    }
+}
+
+void TestBatchVerifier::test_mixed_valid_invalid()
+{
+    auto cert = DsCert::create();
+    auto other = DsCert::create();
+    auto items = makeItems(*cert, 40);
+
+    items[1].data[0] = 'x'; // Modified data
+    items[3].signature.resize(10); // Truncated signature
+    items[5].signature[0] = static_cast<char>(items[5].signature[0] ^ 1); // Modified signature
+    items[7].cert = nullptr; // No cert
+    items[9].cert = other.get(); // Signed by someone else
+    items[11].signature = items[12].signature; // Signature for another item
+
+    const set<size_t> invalid = {1, 3, 5, 7, 9, 11};
+
+    const auto results = BatchVerifier{4}.verify(items);
+    QCOMPARE(results.size(), items.size());
+
+    for(size_t i = 0; i < items.size(); ++i) {
+        QCOMPARE(results[i], invalid.count(i) == 0);
+    }
+}
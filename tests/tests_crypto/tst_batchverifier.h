@@ -0,0 +1,19 @@
+#ifndef TST_BATCHVERIFIER_H
+#define TST_BATCHVERIFIER_H
+
+#include <QtTest>
+
+class TestBatchVerifier : public QObject
+{
+    Q_OBJECT
+public:
+    TestBatchVerifier() = default;
+
+private slots:
+    void test_empty_batch();
+    void test_results_in_order_data();
+    void test_results_in_order();
+    void test_mixed_valid_invalid();
+};
+
+#endif // TST_BATCHVERIFIER_H
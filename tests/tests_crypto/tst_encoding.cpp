@@ -0,0 +1,155 @@
+#include <random>
+#include <string>
+
+#include "tst_encoding.h"
+#include "ds/base32.h"
+#include "ds/base58.h"
+#include "ds/dscert.h"
+
+using namespace std;
+using namespace ds::crypto;
+
+namespace {
+
+constexpr int fuzz_rounds = 5000;
+
+// Random data, often with leading zeros as they are encoded differently
+QByteArray randomBytes(mt19937& rng, const int maxLen) {
+    QByteArray data(static_cast<int>(rng() % static_cast<unsigned>(maxLen + 1)), 0);
+    const auto zeros = static_cast<int>(rng() % 4);
+    for(int i = zeros; i < data.size(); ++i) {
+        data[i] = static_cast<char>(rng());
+    }
+    return data;
+}
+
+} // anonymous namespace
+
+void TestEncoding::test_base58_vectors()
+{
+    // From the bitcoin test-vectors
+    QCOMPARE(b58enc<string>(QByteArray{}), string{});
+    QCOMPARE(b58enc<string>(QByteArray::fromHex("61")), string{"2g"});
+    QCOMPARE(b58enc<string>(QByteArray::fromHex("626262")), string{"a3gV"});
+    QCOMPARE(b58enc<string>(QByteArray::fromHex("636363")), string{"aPEr"});
+    QCOMPARE(b58enc<string>(QByteArray::fromHex("73696d706c792061206c6f6e6720737472696e67")),
+             string{"2cFupjhnEsSn59qHXstmK2ffpLv2"});
+    QCOMPARE(b58enc<string>(QByteArray::fromHex("00eb15231dfceb60925886b67d065299925915aeb172c06647")),
+             string{"1NS17iag9jJgTHD1VXjvLCEnZuQ3rJDE9L"});
+    QCOMPARE(b58enc<string>(QByteArray::fromHex("516b6fcd0f")), string{"ABnLTmg"});
+    QCOMPARE(b58enc<string>(QByteArray::fromHex("000000")), string{"111"});
+    QCOMPARE(b58enc<string>(QByteArray::fromHex("00000000000000000000")), string{"1111111111"});
+
+    QCOMPARE(b58tobin<QByteArray>("1NS17iag9jJgTHD1VXjvLCEnZuQ3rJDE9L", 25),
+             QByteArray::fromHex("00eb15231dfceb60925886b67d065299925915aeb172c06647"));
+}
+
+void TestEncoding::test_base58_roundtrip()
+{
+    mt19937 rng{58};
+    for(int i = 0; i < fuzz_rounds; ++i) {
+        const auto data = randomBytes(rng, 100);
+        const auto b58 = b58enc<string>(data);
+        QCOMPARE(b58tobin<QByteArray>(b58, static_cast<size_t>(data.size())), data);
+    }
+}
+
+void TestEncoding::test_base58_invalid()
+{
+    // Not in the alphabet
+    for(const auto& b58 : {"0abc", "abcI", "lO", "abc def", "\xc3\xa6\xc3\xb8"}) {
+        QVERIFY(b58tobin<QByteArray>(b58, 8).isEmpty());
+    }
+
+    // Too large for the output
+    QVERIFY(b58tobin<QByteArray>("zzzzzzzzzzzz", 4).isEmpty());
+
+    // Random garbage must never crash or overflow
+    mt19937 rng{13};
+    for(int i = 0; i < fuzz_rounds; ++i) {
+        string garbage(rng() % 120, ' ');
+        for(auto& ch : garbage) {
+            ch = static_cast<char>(rng());
+        }
+        b58tobin<QByteArray>(garbage, 32);
+    }
+}
+
+void TestEncoding::test_base58check_roundtrip()
+{
+    mt19937 rng{11};
+    for(int i = 0; i < fuzz_rounds; ++i) {
+        const auto data = randomBytes(rng, 80);
+        const auto b58 = b58check_enc<string>(data, {249, 50});
+        QCOMPARE(b58tobin_check<QByteArray>(b58, static_cast<size_t>(data.size()), {249, 50}), data);
+
+        // A modified digit must fail the checksum
+        if (!data.isEmpty()) {
+            auto broken = b58;
+            auto& ch = broken[broken.size() / 2];
+            ch = (ch == 'z') ? 'y' : 'z';
+            QVERIFY(b58tobin_check<QByteArray>(broken, static_cast<size_t>(data.size()), {249, 50})
+                    != data);
+        }
+    }
+
+    // Contact handles
+    auto cert = DsCert::create();
+    const auto handle = cert->getB58PubKey();
+    QCOMPARE(handle.left(2), QByteArray{"ds"});
+    QCOMPARE(b58tobin_check<QByteArray>(handle.toStdString(), 32, {249, 50}),
+             cert->getSigningPubKey().toByteArray());
+}
+
+void TestEncoding::test_onion16()
+{
+    const auto bytes = QByteArray::fromHex("0102030405060708090a");
+    QCOMPARE(onion16encode(bytes), QByteArray{"aebagbafaydqqcik"});
+    QCOMPARE(onion16decode("aebagbafaydqqcik"), bytes);
+
+    QVERIFY_EXCEPTION_THROWN(onion16decode("aebagbafaydqqci1"), std::runtime_error);
+    QVERIFY_EXCEPTION_THROWN(onion16decode("aebagbafaydqqci"), std::runtime_error);
+    QVERIFY_EXCEPTION_THROWN(onion16encode("short"), std::runtime_error);
+}
+
+void TestEncoding::test_onion56_roundtrip()
+{
+    mt19937 rng{56};
+    for(int i = 0; i < fuzz_rounds; ++i) {
+        QByteArray data(35, 0);
+        for(auto& ch : data) {
+            ch = static_cast<char>(rng());
+        }
+
+        const auto address = onion56encode(data);
+        QCOMPARE(address.size(), 56);
+        QCOMPARE(onion56decode(address), data);
+
+        QByteArray legacy = data.left(10);
+        QCOMPARE(onion16decode(onion16encode(legacy)), legacy);
+    }
+
+    QVERIFY_EXCEPTION_THROWN(onion56decode(QByteArray(56, 'A')), std::runtime_error);
+    QVERIFY_EXCEPTION_THROWN(onion56decode(QByteArray(55, 'a')), std::runtime_error);
+}
+
+void TestEncoding::test_onion_v3()
+{
+    const QByteArray address{"duckduckgogg42xjoc72x3sjasowoarfbgcmvfimaftt6twagswzczad"};
+
+    const auto pubkey = onionV3ToPubkey(address);
+    QCOMPARE(pubkey.size(), 32);
+    QCOMPARE(onionV3FromPubkey(pubkey), address);
+
+    // Wrong checksum
+    auto broken = address;
+    broken[5] = 'e';
+    QVERIFY_EXCEPTION_THROWN(onionV3ToPubkey(broken), std::runtime_error);
+
+    // Wrong version
+    auto bytes = onion56decode(address);
+    bytes[34] = 4;
+    QVERIFY_EXCEPTION_THROWN(onionV3ToPubkey(onion56encode(bytes)), std::runtime_error);
+
+    QVERIFY_EXCEPTION_THROWN(onionV3FromPubkey("short"), std::runtime_error);
+}
@@ -0,0 +1,22 @@
+#ifndef TST_ENCODING_H
+#define TST_ENCODING_H
+
+#include <QtTest>
+
+class TestEncoding : public QObject
+{
+    Q_OBJECT
+public:
+    TestEncoding() = default;
+
+private slots:
+    void test_base58_vectors();
+    void test_base58_roundtrip();
+    void test_base58_invalid();
+    void test_base58check_roundtrip();
+    void test_onion16();
+    void test_onion56_roundtrip();
+    void test_onion_v3();
+};
+
+#endif // TST_ENCODING_H
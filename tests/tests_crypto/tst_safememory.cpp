@@ -0,0 +1,147 @@
+#include <algorithm>
+
+#include "tst_safememory.h"
+#include "ds/safememory.h"
+#include "ds/securearena.h"
+
+using namespace std;
+using namespace ds::crypto;
+
+namespace {
+
+bool isZero(const uint8_t *data, const size_t bytes) {
+    return all_of(data, data + bytes, [](const uint8_t v) { return v == 0; });
+}
+
+} // anonymous namespace
+
+void TestSafeMemory::cleanup()
+{
+    SecureArena::instance().setEnabled(true);
+}
+
+void TestSafeMemory::test_append_data()
+{
+    QTest::addColumn<int>("first");
+    QTest::addColumn<int>("second");
+
+    QTest::newRow("empty") << 0 << 10;
+    QTest::newRow("same-slot") << 4 << 8;
+    QTest::newRow("16-to-32") << 16 << 1;
+    QTest::newRow("16-to-64") << 6 << 40;
+    QTest::newRow("slot-to-large") << 1000 << 100;
+    QTest::newRow("large-to-large") << 2000 << 3000;
+}
+
+void TestSafeMemory::test_append()
+{
+    QFETCH(int, first);
+    QFETCH(int, second);
+
+    const QByteArray a(first, 'a');
+    const QByteArray b(second, 'b');
+
+    SafeMemory<uint8_t> mem{a};
+    mem.append(b);
+
+    QCOMPARE(mem.size(), static_cast<size_t>(first + second));
+    QCOMPARE(mem.toByteArray(), a + b);
+
+    // And once more, to grow from a non-empty buffer of the new size
+    mem.append(a);
+    QCOMPARE(mem.toByteArray(), a + b + a);
+}
+
+void TestSafeMemory::test_append_wide()
+{
+    const uint32_t first[] = {0x01020304, 0x05060708, 0x090a0b0c};
+    const uint32_t second[] = {0xdeadbeef, 0xcafebabe, 0x0badf00d, 0xfeedface};
+
+    SafeMemory<uint32_t> mem{first, 3};
+    mem.append(second, 4);
+
+    QCOMPARE(mem.size(), size_t{7});
+    QVERIFY(equal(first, first + 3, mem.cbegin()));
+    QVERIFY(equal(second, second + 4, mem.cbegin() + 3));
+}
+
+void TestSafeMemory::test_resize()
+{
+    auto& arena = SecureArena::instance();
+    const auto before = arena.getStats();
+
+    {
+        SafeMemory<uint8_t> mem{QByteArray("secret")};
+
+        // Grows across the slot sizes, and keeps the data
+        const size_t sizes[] = {16, 17, 64, 512, SecureArena::max_slot, SecureArena::max_slot + 1};
+        for(const auto size : sizes) {
+            mem.resize(size);
+            QCOMPARE(mem.size(), size);
+            QCOMPARE(mem.toByteArray().left(6), QByteArray("secret"));
+            QCOMPARE(arena.getStats().slotsInUse + arena.getStats().largeInUse,
+                     before.slotsInUse + before.largeInUse + 1);
+        }
+
+        // Shrinking zeroes the tail
+        mem.resize(64);
+        memset(mem.data() + 6, 'x', 58);
+        mem.resize(6);
+        QCOMPARE(mem.toByteArray(), QByteArray("secret"));
+        QVERIFY(isZero(mem.cdata() + 6, 58));
+    }
+
+    QCOMPARE(arena.getStats().slotsInUse, before.slotsInUse);
+    QCOMPARE(arena.getStats().largeInUse, before.largeInUse);
+}
+
+void TestSafeMemory::test_resize_from_zero()
+{
+    auto& arena = SecureArena::instance();
+    const auto before = arena.getStats();
+
+    {
+        SafeMemory<uint8_t> mem{QByteArray("secret")};
+        mem.resize(0);
+        QVERIFY(mem.empty());
+
+        // The slot from before the resize(0) must be given back
+        mem.resize(100);
+        QCOMPARE(arena.getStats().slotsInUse, before.slotsInUse + 1);
+
+        mem.resize(0);
+        mem.append(QByteArray("again"));
+        QCOMPARE(mem.toByteArray(), QByteArray("again"));
+        QCOMPARE(arena.getStats().slotsInUse, before.slotsInUse + 1);
+    }
+
+    QCOMPARE(arena.getStats().slotsInUse, before.slotsInUse);
+}
+
+void TestSafeMemory::test_slot_reuse()
+{
+    const uint8_t *ptr = {};
+    {
+        SafeMemory<uint8_t> mem{QByteArray(20, 'a')};
+        ptr = mem.cdata();
+    }
+
+    // The last freed slot of a size is the next one handed out
+    SafeMemory<uint8_t> mem{20};
+    QCOMPARE(mem.cdata(), ptr);
+    QVERIFY(isZero(mem.cdata(), mem.size()));
+}
+
+void TestSafeMemory::test_wiped_on_free()
+{
+    const QByteArray secret{"This is a very secret key"};
+    const uint8_t *ptr = {};
+    {
+        SafeMemory<uint8_t> mem{secret};
+        ptr = mem.cdata();
+        QCOMPARE(mem.toByteArray(), secret);
+    }
+
+    // The region is still mapped, so we can look at the slot
+    QVERIFY(isZero(ptr, static_cast<size_t>(secret.size())));
+}
@@ -0,0 +1,23 @@
+#ifndef TST_SAFEMEMORY_H
+#define TST_SAFEMEMORY_H
+
+#include <QtTest>
+
+class TestSafeMemory : public QObject
+{
+    Q_OBJECT
+public:
+    TestSafeMemory() = default;
+
+private slots:
+    void cleanup();
+    void test_append_data();
+    void test_append();
+    void test_append_wide();
+    void test_resize();
+    void test_resize_from_zero();
+    void test_slot_reuse();
+    void test_wiped_on_free();
+};
+
+#endif // TST_SAFEMEMORY_H
@@ -90,4 +90,4 @@ else:win32:!win32-g++:CONFIG(release, debug|release): PRE_TARGETDEPS += $$OUT_PW
 else:win32:!win32-g++:CONFIG(debug, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../../src/torlib/debug/torlib.lib
 else:unix: PRE_TARGETDEPS += $$OUT_PWD/../../src/torlib/libtorlib.a
 
-LIBS += -lsodium
+LIBS += -lsodium -lz
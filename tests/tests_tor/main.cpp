@@ -1,10 +1,12 @@
 #include <QtTest>
 #include <iostream>
 #include "logfault/logfault.h"
+#include "ds/crypto.h"
 
 #include "tst_torctlsocket.h"
 #include "tst_tormanager.h"
 #include "tst_torcontroller.h"
+#include "tst_torevents.h"
 
 // Note: This is equivalent to QTEST_APPLESS_MAIN for multiple test classes.
 int main(int argc, char** argv)
@@ -17,6 +19,9 @@ int main(int argc, char** argv)
 
     LFLOG_DEBUG << "Pwd is " << app.applicationDirPath();
 
+    // initialize libsodium, for the certs in the protocol manager tests
+    ds::crypto::Crypto crypto;
+
     int status = 0;
 
     {
@@ -24,6 +29,11 @@ int main(int argc, char** argv)
         status |= QTest::qExec(&tc, argc, argv);
     }
 
+    {
+        TestTorEvents tc;
+        status |= QTest::qExec(&tc, argc, argv);
+    }
+
     {
         TestTorManager tc;
         status |= QTest::qExec(&tc, argc, argv);
@@ -1,23 +1,57 @@
-QT += testlib network
-QT -= gui
+QT += testlib network sql
 INCLUDEPATH += $$PWD/../../dependencies/logfault/include/
 CONFIG += qt console warn_on depend_includepath testcase
 CONFIG -= app_bundle
 
 TEMPLATE = app
 
-INCLUDEPATH += $$PWD/../../src/torlib/include
+INCLUDEPATH += $$PWD/../../src/torlib/include \
+    $$PWD/../../src/cryptolib/include \
+    $$PWD/../../src/corelib/include \
+    $$PWD/../../src/protlib/include
+
+# Stand-in for tor in TorConfig::Mode::PRIVATE. Build tests/faketor first.
+DEFINES += FAKETOR_PATH=\\\"$$OUT_PWD/../faketor/faketor\\\"
 
 SOURCES +=  \
     tst_tormanager.cpp \
     tst_torctlsocket.cpp \
     main.cpp \
-    tst_torcontroller.cpp
+    tst_torcontroller.cpp \
+    tst_torevents.cpp
 
 HEADERS += \
     tst_torctlsocket.h \
     tst_tormanager.h \
-    tst_torcontroller.h
+    tst_torcontroller.h \
+    tst_torevents.h
+
+# The protocol manager tests in tst_torcontroller
+win32:CONFIG(release, debug|release): LIBS += -L$$OUT_PWD/../../src/corelib/release/ -lcorelib
+else:win32:CONFIG(debug, debug|release): LIBS += -L$$OUT_PWD/../../src/corelib/debug/ -lcorelib
+else:unix: LIBS += -L$$OUT_PWD/../../src/corelib/ -lcorelib
+
+INCLUDEPATH += $$PWD/../../src/corelib
+DEPENDPATH += $$PWD/../../src/corelib
+
+win32-g++:CONFIG(release, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../../src/corelib/release/libcorelib.a
+else:win32-g++:CONFIG(debug, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../../src/corelib/debug/libcorelib.a
+else:win32:!win32-g++:CONFIG(release, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../../src/corelib/release/corelib.lib
+else:win32:!win32-g++:CONFIG(debug, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../../src/corelib/debug/corelib.lib
+else:unix: PRE_TARGETDEPS += $$OUT_PWD/../../src/corelib/libcorelib.a
+
+win32:CONFIG(release, debug|release): LIBS += -L$$OUT_PWD/../../src/protlib/release/ -lprotlib
+else:win32:CONFIG(debug, debug|release): LIBS += -L$$OUT_PWD/../../src/protlib/debug/ -lprotlib
+else:unix: LIBS += -L$$OUT_PWD/../../src/protlib/ -lprotlib
+
+INCLUDEPATH += $$PWD/../../src/protlib
+DEPENDPATH += $$PWD/../../src/protlib
+
+win32-g++:CONFIG(release, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../../src/protlib/release/libprotlib.a
+else:win32-g++:CONFIG(debug, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../../src/protlib/debug/libprotlib.a
+else:win32:!win32-g++:CONFIG(release, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../../src/protlib/release/protlib.lib
+else:win32:!win32-g++:CONFIG(debug, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../../src/protlib/debug/protlib.lib
+else:unix: PRE_TARGETDEPS += $$OUT_PWD/../../src/protlib/libprotlib.a
 
 win32:CONFIG(release, debug|release): LIBS += -L$$OUT_PWD/../../src/torlib/release/ -ltorlib
 else:win32:CONFIG(debug, debug|release): LIBS += -L$$OUT_PWD/../../src/torlib/debug/ -ltorlib
@@ -46,4 +80,4 @@ else:win32:!win32-g++:CONFIG(release, debug|release): PRE_TARGETDEPS += $$OUT_PW
 else:win32:!win32-g++:CONFIG(debug, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../../src/cryptolib/debug/cryptolib.lib
 else:unix: PRE_TARGETDEPS += $$OUT_PWD/../../src/cryptolib/libcryptolib.a
 
-LIBS += -lsodium
+LIBS += -lsodium -lz
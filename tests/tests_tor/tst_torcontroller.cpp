@@ -1,7 +1,20 @@
+#include <memory>
+#include <vector>
+
+#include <QPointer>
+#include <QSettings>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+
 #include "tst_torcontroller.h"
 
 #include "ds/torcontroller.h"
 #include "ds/torconfig.h"
+#include "ds/dscert.h"
+#include "ds/metrics.h"
+#include "ds/protocolmanager.h"
+#include "ds/transporthandle.h"
 
 void TestTorController::test_auth_cookie()
 {
@@ -102,3 +115,409 @@ void TestTorController::test_start_service()
     QCOMPARE(spy_started.wait(2000), true);
     ctl.stop();
 }
+
+void TestTorController::test_parse_socks_listener()
+{
+    using ds::tor::TorController;
+
+    QHostAddress host;
+    quint16 port = {};
+    ds::tor::TorCtlReply reply;
+    reply.status = 250;
+
+    reply.lines = {R"(net/listeners/socks="127.0.0.1:9050")", "OK"};
+    QVERIFY(TorController::parseSocksListener(reply, host, port));
+    QCOMPARE(host, QHostAddress{QHostAddress::LocalHost});
+    QCOMPARE(port, static_cast<quint16>(9050));
+
+    reply.lines = {R"(net/listeners/socks="unix:/run/tor/socks" "[::1]:39051")", "OK"};
+    QVERIFY(TorController::parseSocksListener(reply, host, port));
+    QCOMPARE(host, QHostAddress{QHostAddress::LocalHostIPv6});
+    QCOMPARE(port, static_cast<quint16>(39051));
+
+    reply.lines = {"net/listeners/socks=127.0.0.1:40000", "OK"};
+    QVERIFY(TorController::parseSocksListener(reply, host, port));
+    QCOMPARE(port, static_cast<quint16>(40000));
+
+    reply.lines = {"net/listeners/socks=", "OK"};
+    QVERIFY(!TorController::parseSocksListener(reply, host, port));
+
+    reply.lines = {R"(net/listeners/socks="unix:/run/tor/socks")", "OK"};
+    QVERIFY(!TorController::parseSocksListener(reply, host, port));
+}
+
+namespace {
+
+using ds::tor::TorController;
+using ds::core::ProtocolManager;
+
+constexpr int wait_ms = 5000;
+const QByteArray passwd = "secret";
+
+/* Answers the control commands that TorController uses, like tor would.
+ *
+ * Events are pushed with event(). Every command is recorded.
+ */
+class MockTorCtl
+{
+public:
+    MockTorCtl()
+    {
+        QObject::connect(&server_, &QTcpServer::newConnection, [this] {
+            while(auto socket = server_.nextPendingConnection()) {
+                socket_ = socket;
+                QObject::connect(socket, &QTcpSocket::readyRead, [this, socket] {
+                    while(socket->canReadLine()) {
+                        onCommand(*socket, socket->readLine().trimmed());
+                    }
+                });
+            }
+        });
+
+        server_.listen(QHostAddress::LocalHost, 0);
+        socks_.listen(QHostAddress::LocalHost, 0);
+    }
+
+    ds::tor::TorConfig getConfig() const
+    {
+        ds::tor::TorConfig config;
+        config.ctl_port = server_.serverPort();
+        config.ctl_passwd = QString::fromUtf8(passwd);
+        config.allowed_auth_methods = {"HASHEDPASSWORD"};
+        return config;
+    }
+
+    quint16 getPort() const { return server_.serverPort(); }
+
+    void event(const QByteArray& line)
+    {
+        QVERIFY(socket_);
+        socket_->write("650 " + line + "\r\n");
+    }
+
+    void bootstrap(const int progress)
+    {
+        event("STATUS_CLIENT NOTICE BOOTSTRAP " + bootstrapStatus(progress));
+    }
+
+    static QByteArray bootstrapStatus(const int progress)
+    {
+        return "PROGRESS=" + QByteArray::number(progress)
+                + " TAG=loading_descriptors SUMMARY=\"Loading relay descriptors\"";
+    }
+
+    bool hasCommand(const QByteArray& cmd) const { return commands.contains(cmd); }
+
+    int progress = 100; // Reported by GETINFO status/bootstrap-phase
+    bool networkLiveness = true; // False for tor older than 0.2.7.2
+    QList<QByteArray> commands;
+    QList<QByteArray> serviceIds;
+
+private:
+    void onCommand(QTcpSocket& socket, const QByteArray& line)
+    {
+        commands.append(line);
+
+        const auto space = line.indexOf(' ');
+        const auto cmd = line.left(space);
+        const auto args = (space > 0) ? line.mid(space + 1) : QByteArray{};
+
+        if (cmd == "PROTOCOLINFO") {
+            socket.write("250-PROTOCOLINFO 1\r\n"
+                         "250-AUTH METHODS=HASHEDPASSWORD\r\n"
+                         "250-VERSION Tor=\"0.4.8.0-mock\"\r\n"
+                         "250 OK\r\n");
+        } else if (cmd == "AUTHENTICATE") {
+            socket.write(args == '"' + passwd + '"'
+                         ? "250 OK\r\n" : "515 Authentication failed\r\n");
+        } else if (cmd == "SETEVENTS") {
+            socket.write(!networkLiveness && args.contains("NETWORK_LIVENESS")
+                         ? "552 Unrecognized event \"NETWORK_LIVENESS\"\r\n" : "250 OK\r\n");
+        } else if (line == "GETINFO status/bootstrap-phase") {
+            socket.write("250-status/bootstrap-phase=NOTICE BOOTSTRAP "
+                         + bootstrapStatus(progress) + "\r\n250 OK\r\n");
+        } else if (line == "GETINFO net/listeners/socks") {
+            socket.write("250-net/listeners/socks=\"127.0.0.1:"
+                         + QByteArray::number(socks_.serverPort()) + "\"\r\n250 OK\r\n");
+        } else if (cmd == "ADD_ONION") {
+            // Looks like a v3 onion address
+            auto serviceId = QByteArray(55, 'a') + static_cast<char>('b' + serviceIds.size());
+            serviceIds.append(serviceId);
+            socket.write("250-ServiceID=" + serviceId + "\r\n");
+            if (args.startsWith("NEW:")) {
+                socket.write("250-PrivateKey=ED25519-V3:" + QByteArray(64, 'k').toBase64() + "\r\n");
+            }
+            socket.write("250 OK\r\n");
+        } else if ((cmd == "DEL_ONION") || (cmd == "TAKEOWNERSHIP")) {
+            socket.write("250 OK\r\n");
+        } else {
+            socket.write("510 Unrecognized command \"" + cmd + "\"\r\n");
+        }
+    }
+
+    QTcpServer server_;
+    QTcpServer socks_; // Accepts connections, but never completes the SOCKS handshake
+    QPointer<QTcpSocket> socket_;
+};
+
+// Start the controller, and wait until it has authenticated
+bool startController(TorController& ctl)
+{
+    bool authenticated = false;
+    auto conn = QObject::connect(&ctl, &TorController::autenticated, [&authenticated] {
+        authenticated = true;
+    });
+
+    ctl.start();
+    QTest::qWaitFor([&authenticated] { return authenticated; }, wait_ms);
+    QObject::disconnect(conn);
+    return authenticated;
+}
+
+// A TorProtocolManager that uses the mock as its system tor
+struct TorTransport {
+    TorTransport(const MockTorCtl& mock)
+    {
+        settings = std::make_unique<QSettings>(dir.filePath("tor.ini"), QSettings::IniFormat);
+        settings->setValue("torCtlPort", mock.getPort());
+        settings->setValue("torCtlPasswd", QString::fromUtf8(passwd));
+        settings->setValue("torCtlAuthMode", 1);
+        settings->setValue("torMaxCircuitFailures", 3);
+
+        mgr = ProtocolManager::create(*settings, ProtocolManager::Transport::TOR);
+        QObject::connect(mgr.get(), &ProtocolManager::stateChanged,
+                         [this](const ProtocolManager::State, const ProtocolManager::State current) {
+            states.push_back(current);
+        });
+    }
+
+    ~TorTransport()
+    {
+        mgr->stop();
+    }
+
+    QTemporaryDir dir;
+    std::unique_ptr<QSettings> settings;
+    std::vector<ProtocolManager::State> states;
+    ProtocolManager::ptr_t mgr;
+};
+
+quint64 getCounter(const char *name) {
+    return ds::core::Metrics::instance().counter(name).get();
+}
+
+} // anonymous namespace
+
+void TestTorController::test_bootstrap_events()
+{
+    MockTorCtl mock;
+    mock.progress = 10;
+
+    TorController ctl(mock.getConfig());
+    std::vector<int> progress;
+    connect(&ctl, &TorController::torStateUpdate, this,
+            [&progress](TorController::TorState, int value, const QString&) {
+        progress.push_back(value);
+    });
+    int ready = 0;
+    connect(&ctl, &TorController::ready, this, [&ready] { ++ready; });
+
+    QVERIFY(startController(ctl));
+    QTRY_COMPARE_WITH_TIMEOUT(progress.size(), size_t{1}, wait_ms);
+
+    // Progress within the state is reported as it comes
+    mock.bootstrap(50);
+    mock.bootstrap(80);
+    mock.bootstrap(80);
+    QTRY_COMPARE_WITH_TIMEOUT(progress, (std::vector<int>{10, 50, 80}), wait_ms);
+    QCOMPARE(ctl.getTorState(), TorController::TorState::INITIALIZING);
+    QCOMPARE(ctl.getCtlState(), TorController::CtlState::CONNECTED);
+    QCOMPARE(ready, 0);
+
+    // Online when tor is done
+    mock.bootstrap(100);
+    QTRY_COMPARE_WITH_TIMEOUT(ready, 1, wait_ms);
+    QCOMPARE(progress.back(), 100);
+    QCOMPARE(ctl.getTorState(), TorController::TorState::READY);
+    QCOMPARE(ctl.getCtlState(), TorController::CtlState::ONLINE);
+
+    ctl.stop();
+}
+
+void TestTorController::test_online_when_bootstrapped()
+{
+    MockTorCtl mock;
+    TorController ctl(mock.getConfig());
+    int ready = 0;
+    connect(&ctl, &TorController::ready, this, [&ready] { ++ready; });
+
+    QVERIFY(startController(ctl));
+    QTRY_COMPARE_WITH_TIMEOUT(ready, 1, wait_ms);
+    QCOMPARE(ctl.getCtlState(), TorController::CtlState::ONLINE);
+    QVERIFY(mock.hasCommand("SETEVENTS STATUS_CLIENT NETWORK_LIVENESS HS_DESC CIRC"));
+
+    // Later bootstrap events don't make it ready again
+    mock.bootstrap(100);
+    QTest::qWait(100);
+    QCOMPARE(ready, 1);
+
+    ctl.stop();
+}
+
+void TestTorController::test_subscribe_fallback()
+{
+    MockTorCtl mock;
+    mock.networkLiveness = false;
+
+    TorController ctl(mock.getConfig());
+    QVERIFY(startController(ctl));
+
+    // Without NETWORK_LIVENESS, but with the events we need for the services
+    QTRY_VERIFY_WITH_TIMEOUT(mock.hasCommand("SETEVENTS STATUS_CLIENT HS_DESC CIRC"), wait_ms);
+
+    ctl.stop();
+}
+
+void TestTorController::test_service_published_once()
+{
+    MockTorCtl mock;
+    TorController ctl(mock.getConfig());
+    int ready = 0;
+    connect(&ctl, &TorController::ready, this, [&ready] { ++ready; });
+    QVERIFY(startController(ctl));
+    QTRY_COMPARE_WITH_TIMEOUT(ready, 1, wait_ms);
+
+    ds::tor::ServiceProperties service;
+    connect(&ctl, &TorController::serviceCreated, this,
+            [&service](const ds::tor::ServiceProperties& sp) {
+        service = sp;
+    });
+    std::vector<QUuid> published;
+    connect(&ctl, &TorController::servicePublished, this, [&published](const QUuid& uuid) {
+        published.push_back(uuid);
+    });
+
+    const auto uuid = QUuid::createUuid();
+    ctl.createService(uuid);
+    QTRY_COMPARE_WITH_TIMEOUT(service.uuid, uuid, wait_ms);
+
+    // Tor uploads the descriptor to several HSDirs
+    const auto upload = "HS_DESC UPLOADED " + service.service_id + " UNKNOWN $AAAA~relay";
+    mock.event(upload);
+    mock.event("HS_DESC UPLOADED " + QByteArray(56, 'z') + " UNKNOWN $BBBB~relay");
+    mock.event(upload);
+    QTRY_COMPARE_WITH_TIMEOUT(published.size(), size_t{1}, wait_ms);
+    QTest::qWait(100);
+    QCOMPARE(published, std::vector<QUuid>{uuid});
+
+    ctl.stop();
+}
+
+void TestTorController::test_network_changes()
+{
+    MockTorCtl mock;
+    TorController ctl(mock.getConfig());
+    std::vector<bool> changes;
+    connect(&ctl, &TorController::networkChanged, this, [&changes](const bool up) {
+        changes.push_back(up);
+    });
+    QVERIFY(startController(ctl));
+    QTRY_COMPARE_WITH_TIMEOUT(ctl.getCtlState(), TorController::CtlState::ONLINE, wait_ms);
+
+    mock.event("STATUS_CLIENT NOTICE CIRCUIT_NOT_ESTABLISHED REASON=CLOCK_JUMPED");
+    mock.event("NETWORK_LIVENESS DOWN");
+    QTRY_COMPARE_WITH_TIMEOUT(changes, std::vector<bool>{false}, wait_ms);
+    QVERIFY(!ctl.isNetworkUp());
+
+    // Still connected to tor
+    QCOMPARE(ctl.getCtlState(), TorController::CtlState::ONLINE);
+
+    mock.event("NETWORK_LIVENESS UP");
+    mock.event("STATUS_CLIENT NOTICE CIRCUIT_ESTABLISHED");
+    QTRY_COMPARE_WITH_TIMEOUT(changes, (std::vector<bool>{false, true}), wait_ms);
+    QVERIFY(ctl.isNetworkUp());
+
+    ctl.stop();
+}
+
+void TestTorController::test_outage_states()
+{
+    MockTorCtl mock;
+    TorTransport tor{mock};
+    using State = ProtocolManager::State;
+
+    tor.mgr->start();
+    QTRY_COMPARE_WITH_TIMEOUT(tor.mgr->getState(), State::ONLINE, wait_ms);
+    tor.states.clear();
+
+    // Tor is still running, but can't reach the network
+    mock.event("NETWORK_LIVENESS DOWN");
+    QTRY_COMPARE_WITH_TIMEOUT(tor.mgr->getState(), State::CONNECTED, wait_ms);
+
+    mock.event("NETWORK_LIVENESS UP");
+    QTRY_COMPARE_WITH_TIMEOUT(tor.mgr->getState(), State::ONLINE, wait_ms);
+
+    // And the same for circuits
+    mock.event("STATUS_CLIENT NOTICE CIRCUIT_NOT_ESTABLISHED REASON=CLOCK_JUMPED");
+    QTRY_COMPARE_WITH_TIMEOUT(tor.mgr->getState(), State::CONNECTED, wait_ms);
+
+    mock.event("STATUS_CLIENT NOTICE CIRCUIT_ESTABLISHED");
+    QTRY_COMPARE_WITH_TIMEOUT(tor.mgr->getState(), State::ONLINE, wait_ms);
+
+    QCOMPARE(tor.states, (std::vector<State>{State::CONNECTED, State::ONLINE,
+                                             State::CONNECTED, State::ONLINE}));
+}
+
+void TestTorController::test_rendezvous_giveup()
+{
+    MockTorCtl mock;
+    TorTransport tor{mock};
+
+    tor.mgr->start();
+    QTRY_VERIFY_WITH_TIMEOUT(tor.mgr->isOnline(), wait_ms);
+
+    // Create and start a service to connect from
+    ds::core::TransportHandle th;
+    connect(tor.mgr.get(), &ProtocolManager::transportHandleReady,
+            this, [&th](const ds::core::TransportHandle& handle) {
+        th = handle;
+    });
+
+    const auto uuid = QUuid::createUuid();
+    tor.mgr->createTransportHandle({"alice", uuid});
+    QTRY_COMPARE_WITH_TIMEOUT(th.uuid, uuid, wait_ms);
+
+    auto cert = ds::crypto::DsCert::create();
+    tor.mgr->startService(uuid, cert, th.data);
+
+    // The connection is stuck in the SOCKS handshake, like while tor builds circuits
+    const QByteArray onion(56, 'p');
+    ds::core::ConnectData cd;
+    cd.service = uuid;
+    cd.address = "onion:" + onion + ":1234";
+    cd.identitysCert = cert;
+    cd.contactsCert = ds::crypto::DsCert::create();
+    auto client = tor.mgr->connectTo(cd);
+
+    bool disconnected = false;
+    connect(client.get(), &ds::core::PeerConnection::disconnectedFromPeer, this, [&disconnected] {
+        disconnected = true;
+    });
+
+    const auto giveups = getCounter("prot.rendezvous.giveups");
+    const auto failed = "CIRC 42 FAILED $AAAA~a PURPOSE=HS_CLIENT_REND"
+                        " HS_STATE=HSCR_CONNECTING REND_QUERY=" + onion + " REASON=TIMEOUT";
+
+    // Circuits to other hosts don't count
+    mock.event("CIRC 41 FAILED $AAAA~a PURPOSE=HS_CLIENT_REND REND_QUERY="
+               + QByteArray(56, 'q') + " REASON=TIMEOUT");
+    mock.event(failed);
+    mock.event(failed);
+    QTest::qWait(200);
+    QVERIFY(!disconnected);
+    QCOMPARE(getCounter("prot.rendezvous.giveups"), giveups);
+
+    mock.event(failed);
+    QTRY_VERIFY_WITH_TIMEOUT(disconnected, wait_ms);
+    QCOMPARE(getCounter("prot.rendezvous.giveups"), giveups + 1);
+}
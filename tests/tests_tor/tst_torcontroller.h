@@ -22,6 +22,16 @@ private slots:
     void test_ready();
     void test_create_service();
     void test_start_service();
+    void test_parse_socks_listener();
+
+    // With a scripted control port instead of tor
+    void test_bootstrap_events();
+    void test_online_when_bootstrapped();
+    void test_subscribe_fallback();
+    void test_service_published_once();
+    void test_network_changes();
+    void test_outage_states();
+    void test_rendezvous_giveup();
 };
 
 
@@ -1,3 +1,5 @@
+#include <random>
+
 #include "tst_torctlsocket.h"
 
 TestTorCtlSocket::TestTorCtlSocket()
@@ -94,4 +96,82 @@ void TestTorCtlSocket::test_reply_map_parser()
     QCOMPARE(4, map.size());
 }
 
+void TestTorCtlSocket::test_reply_parser_level()
+{
+    ds::tor::TorCtlReply reply;
+
+    reply.lines = {R"(status/bootstrap-phase=NOTICE BOOTSTRAP PROGRESS=100 TAG=done SUMMARY="Done")"};
+    const auto map = reply.parse();
+    QCOMPARE(QString("NOTICE"), map.value("STATUS/BOOTSTRAP-PHASE").toString());
+    const auto bootstrap = map.value("BOOTSTRAP").toMap();
+    QCOMPARE(QString("100"), bootstrap.value("PROGRESS").toString());
+    QCOMPARE(QString("done"), bootstrap.value("TAG").toString());
+    QCOMPARE(QString("Done"), bootstrap.value("SUMMARY").toString());
+    QCOMPARE(2, map.size());
+}
 
+void TestTorCtlSocket::test_data_reply()
+{
+    MockTorCtlSocket ctl({"250+onions/current=\r\n",
+                          "abc\r\n",
+                          "..dot\r\n",
+                          ".\r\n",
+                          "250 OK\r\n"});
+    bool in_lambda = false;
+    ctl.sendCommand("GETINFO onions/current", [&](const ds::tor::TorCtlReply& reply) {
+        QVERIFY(reply.status == 250);
+        QCOMPARE(reply.lines.size(), static_cast<size_t>(2));
+        QCOMPARE(reply.lines.front(), std::string("onions/current=abc\n.dot"));
+        QCOMPARE(reply.lines.back(), std::string("OK"));
+        in_lambda = true;
+    });
+    ctl.mockReceiving();
+    QVERIFY(in_lambda);
+}
+
+// Garbage must give a ParseError or a map, never a crash
+void TestTorCtlSocket::test_reply_parser_fuzz()
+{
+    static const std::string alphabet = "aZ09_-/.= \"\\\t\r\nx\001";
+    std::mt19937 rnd{42};
+
+    for(int i = 0; i < 20000; ++i) {
+        ds::tor::TorCtlReply reply;
+        std::string line;
+        const auto len = rnd() % 48;
+        for(size_t j = 0; j < len; ++j) {
+            line += (i % 2) ? static_cast<char>(rnd() % 256)
+                            : alphabet[rnd() % alphabet.size()];
+        }
+        reply.lines.push_back(line);
+
+        try {
+            reply.parse();
+        } catch(const ds::tor::TorCtlReply::ParseError&) {
+            ;
+        }
+    }
+
+    // Same, through the socket
+    for(int i = 0; i < 2000; ++i) {
+        std::vector<std::string> lines;
+        for(int j = rnd() % 8; j > 0; --j) {
+            std::string line = (rnd() % 2) ? "250" : "650";
+            line += " -+."[rnd() % 4];
+            for(auto len = rnd() % 32; len > 0; --len) {
+                line += alphabet[rnd() % alphabet.size()];
+            }
+            lines.push_back(line + "\r\n");
+        }
+
+        MockTorCtlSocket ctl(move(lines));
+        ctl.sendCommand("GETINFO version", [](const ds::tor::TorCtlReply& reply) {
+            try {
+                reply.parse();
+            } catch(const ds::tor::TorCtlReply::ParseError&) {
+                ;
+            }
+        });
+        ctl.mockReceiving();
+    }
+}
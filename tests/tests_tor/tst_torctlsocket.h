@@ -52,6 +52,9 @@ private slots:
     void test_reply_parser_1();
     void test_reply_parser_unescape();
     void test_reply_map_parser();
+    void test_reply_parser_level();
+    void test_data_reply();
+    void test_reply_parser_fuzz();
 
 };
 
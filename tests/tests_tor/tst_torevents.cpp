@@ -0,0 +1,95 @@
+#include "tst_torevents.h"
+
+using namespace ds::tor;
+
+namespace {
+
+TorEvent makeEvent(const std::string& line)
+{
+    TorCtlReply reply;
+    reply.status = 650;
+    reply.lines.push_back(line);
+    return TorEvent::parse(reply);
+}
+
+} // anonymous namespace
+
+void TestTorEvents::test_status_client()
+{
+    const auto event = makeEvent(R"(STATUS_CLIENT NOTICE BOOTSTRAP PROGRESS=85 TAG=handshake_or SUMMARY="Finishing handshake with first hop")");
+    QCOMPARE(event.name, QByteArray("STATUS_CLIENT"));
+
+    StatusClientEvent sc{event};
+    QCOMPARE(sc.severity, QByteArray("NOTICE"));
+    QCOMPARE(sc.action, QByteArray("BOOTSTRAP"));
+    QCOMPARE(sc.kv.value("PROGRESS"), QByteArray("85"));
+    QCOMPARE(sc.kv.value("TAG"), QByteArray("handshake_or"));
+    QCOMPARE(sc.kv.value("SUMMARY"), QByteArray("Finishing handshake with first hop"));
+
+    StatusClientEvent lost{makeEvent("STATUS_CLIENT NOTICE CIRCUIT_NOT_ESTABLISHED REASON=CLOCK_JUMPED")};
+    QCOMPARE(lost.action, QByteArray("CIRCUIT_NOT_ESTABLISHED"));
+    QCOMPARE(lost.kv.value("REASON"), QByteArray("CLOCK_JUMPED"));
+}
+
+void TestTorEvents::test_network_liveness()
+{
+    QVERIFY(NetworkLivenessEvent{makeEvent("NETWORK_LIVENESS UP")}.up);
+    QVERIFY(!NetworkLivenessEvent{makeEvent("NETWORK_LIVENESS DOWN")}.up);
+}
+
+void TestTorEvents::test_hs_desc()
+{
+    HsDescEvent uploaded{makeEvent("HS_DESC UPLOADED 3g2upl4pq6kufc4m3g2upl4pq6kufc4m3g2upl4pq6kufc4m3g2upl4p UNKNOWN"
+                                   " $F0E8A3D7F2B5A3D6C8E4F1A2B3C4D5E6F7A8B9C0~relay")};
+    QCOMPARE(uploaded.action, QByteArray("UPLOADED"));
+    QCOMPARE(uploaded.address, QByteArray("3g2upl4pq6kufc4m3g2upl4pq6kufc4m3g2upl4pq6kufc4m3g2upl4p"));
+    QCOMPARE(uploaded.authType, QByteArray("UNKNOWN"));
+    QCOMPARE(uploaded.hsDir, QByteArray("$F0E8A3D7F2B5A3D6C8E4F1A2B3C4D5E6F7A8B9C0~relay"));
+    QVERIFY(uploaded.reason.isEmpty());
+
+    // Old style LongName with '=' is a positional argument
+    HsDescEvent failed{makeEvent("HS_DESC FAILED abc NO_AUTH $F0E8=relay"
+                                 " jzbk7ydw5pbyllvsixpatcimrd2rg3e5 REASON=NOT_FOUND")};
+    QCOMPARE(failed.action, QByteArray("FAILED"));
+    QCOMPARE(failed.hsDir, QByteArray("$F0E8=relay"));
+    QCOMPARE(failed.reason, QByteArray("NOT_FOUND"));
+}
+
+void TestTorEvents::test_circ()
+{
+    CircEvent failed{makeEvent("CIRC 42 FAILED $AAAA~a,$BBBB~b BUILD_FLAGS=IS_INTERNAL,NEED_CAPACITY"
+                               " PURPOSE=HS_CLIENT_REND HS_STATE=HSCR_CONNECTING"
+                               " REND_QUERY=abcdefghijklmnop TIME_CREATED=2018-10-21T09:18:41.123456"
+                               " REASON=TIMEOUT")};
+    QCOMPARE(failed.id, QByteArray("42"));
+    QCOMPARE(failed.status, QByteArray("FAILED"));
+    QCOMPARE(failed.purpose, QByteArray("HS_CLIENT_REND"));
+    QCOMPARE(failed.hsState, QByteArray("HSCR_CONNECTING"));
+    QCOMPARE(failed.rendQuery, QByteArray("abcdefghijklmnop"));
+    QCOMPARE(failed.reason, QByteArray("TIMEOUT"));
+    QVERIFY(failed.isFailedClientCircuit());
+
+    CircEvent general{makeEvent("CIRC 7 FAILED $AAAA~a PURPOSE=GENERAL REASON=TIMEOUT")};
+    QVERIFY(!general.isFailedClientCircuit());
+
+    CircEvent built{makeEvent("CIRC 42 BUILT $AAAA~a PURPOSE=HS_CLIENT_REND REND_QUERY=abcdefghijklmnop")};
+    QVERIFY(!built.isFailedClientCircuit());
+}
+
+void TestTorEvents::test_invalid()
+{
+    {
+        auto fun = [] { TorEvent::parse(TorCtlReply{}); };
+        QVERIFY_EXCEPTION_THROWN(fun(), TorCtlReply::ParseError);
+    }
+
+    {
+        auto fun = [] { makeEvent(R"(STATUS_CLIENT NOTICE BOOTSTRAP SUMMARY="Unterminated)"); };
+        QVERIFY_EXCEPTION_THROWN(fun(), TorCtlReply::ParseError);
+    }
+
+    {
+        auto fun = [] { makeEvent(""); };
+        QVERIFY_EXCEPTION_THROWN(fun(), TorCtlReply::ParseError);
+    }
+}
@@ -0,0 +1,23 @@
+#ifndef TST_TOREVENTS_H
+#define TST_TOREVENTS_H
+
+#include <QtTest>
+
+#include "ds/torevents.h"
+
+class TestTorEvents : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestTorEvents() = default;
+
+private slots:
+    void test_status_client();
+    void test_network_liveness();
+    void test_hs_desc();
+    void test_circ();
+    void test_invalid();
+};
+
+#endif // TST_TOREVENTS_H
@@ -1,5 +1,12 @@
 #include "tst_tormanager.h"
 
+#include <QDir>
+#include <QTemporaryDir>
+
+#include "ds/torprocess.h"
+
+using namespace ds::tor;
+
 TestTorManager::TestTorManager()
 {
 
@@ -14,3 +21,129 @@ void TestTorManager::test_case1()
 {
 
 }
+
+void TestTorManager::test_parse_control_port()
+{
+    QHostAddress host;
+    quint16 port = {};
+
+    QVERIFY(TorProcess::parseControlPort("PORT=127.0.0.1:9151\n", host, port));
+    QCOMPARE(host, QHostAddress{QHostAddress::LocalHost});
+    QCOMPARE(port, static_cast<quint16>(9151));
+
+    QVERIFY(TorProcess::parseControlPort("\nPORT=[::1]:1234\n", host, port));
+    QCOMPARE(host, QHostAddress{QHostAddress::LocalHostIPv6});
+    QCOMPARE(port, static_cast<quint16>(1234));
+
+    QVERIFY(!TorProcess::parseControlPort("", host, port));
+    QVERIFY(!TorProcess::parseControlPort("PORT=127.0.0.1", host, port));
+    QVERIFY(!TorProcess::parseControlPort("PORT=127.0.0.1:0", host, port));
+    QVERIFY(!TorProcess::parseControlPort("PORT=127.0.0.1:70000", host, port));
+    QVERIFY(!TorProcess::parseControlPort("PORT=localhost:9151", host, port));
+}
+
+void TestTorManager::startPrivateInstance(const QString& dataDir, qint64& online)
+{
+    TorConfig cfg;
+    cfg.mode = TorConfig::Mode::PRIVATE;
+    cfg.tor_binary = FAKETOR_PATH;
+    cfg.data_dir = dataDir;
+
+    TorMgr mgr{cfg};
+    QSignalSpy spy_online(&mgr, SIGNAL(online()));
+    QSignalSpy spy_socks(&mgr, SIGNAL(socksPortReady(QHostAddress, quint16)));
+    QSignalSpy spy_stopped(&mgr, SIGNAL(stopped()));
+
+    mgr.start();
+    QVERIFY(spy_online.wait(5000));
+
+    const auto& timings = mgr.getStartupTimings();
+    QVERIFY(timings.process >= 0);
+    QVERIFY(timings.connected >= timings.process);
+    QVERIFY(timings.authenticated >= timings.connected);
+    QVERIFY(timings.online >= timings.authenticated);
+    online = timings.online;
+
+    QTRY_COMPARE_WITH_TIMEOUT(spy_socks.count(), 1, 1000);
+    const auto socksPort = spy_socks.front().at(1).value<quint16>();
+    QVERIFY(socksPort != 0);
+    QVERIFY(socksPort != cfg.socks_port);
+
+    mgr.stop();
+    QTRY_VERIFY_WITH_TIMEOUT(spy_stopped.count() > 0, 5000);
+}
+
+void TestTorManager::test_private_instance()
+{
+    if (!QFile::exists(FAKETOR_PATH)) {
+        QSKIP("Build tests/faketor to run this test");
+    }
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    qint64 online = -1;
+    startPrivateInstance(dir.filePath("tor"), online);
+    QVERIFY(online >= 0);
+
+    QVERIFY(QFile::exists(dir.filePath("tor/control_auth_cookie")));
+}
+
+// The second start reuses the DataDirectory, with what tor cached in it
+void TestTorManager::test_private_instance_warm_start()
+{
+    if (!QFile::exists(FAKETOR_PATH)) {
+        QSKIP("Build tests/faketor to run this test");
+    }
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const auto dataDir = dir.filePath("tor");
+
+    // Tor is told where to keep its state
+    TorConfig cfg;
+    cfg.mode = TorConfig::Mode::PRIVATE;
+    cfg.data_dir = dataDir;
+    const auto args = TorProcess{cfg}.getArguments();
+    const auto ix = args.indexOf("--DataDirectory");
+    QVERIFY(ix >= 0);
+    QVERIFY(ix + 1 < args.size());
+    QCOMPARE(args.at(ix + 1), dataDir);
+
+    qint64 cold = -1, warm = -1;
+    startPrivateInstance(dataDir, cold);
+    QVERIFY(cold >= 0);
+
+    const QDir data{dataDir};
+    QVERIFY(data.exists("control_auth_cookie"));
+    QVERIFY(data.exists("cached-consensus"));
+    QFile consensus{data.filePath("cached-consensus")};
+    QVERIFY(consensus.open(QIODevice::ReadOnly));
+    const auto cached = consensus.readAll();
+    consensus.close();
+
+    // Nothing is removed when tor stops, and the next run uses the cache as is
+    startPrivateInstance(dataDir, warm);
+    QVERIFY(warm >= 0);
+    QVERIFY(data.exists("cached-consensus"));
+    QVERIFY(consensus.open(QIODevice::ReadOnly));
+    QCOMPARE(consensus.readAll(), cached);
+}
+
+void TestTorManager::test_private_instance_missing_binary()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    TorConfig cfg;
+    cfg.mode = TorConfig::Mode::PRIVATE;
+    cfg.tor_binary = dir.filePath("no-such-tor");
+    cfg.data_dir = dir.filePath("tor");
+
+    TorMgr mgr{cfg};
+    QSignalSpy spy_failed(&mgr, SIGNAL(startFailed(QString)));
+
+    mgr.start();
+    QVERIFY(spy_failed.wait(5000));
+    QCOMPARE(mgr.getStartupTimings().online, static_cast<qint64>(-1));
+}
@@ -17,6 +17,13 @@ public:
 
 private slots:
     void test_case1();
+    void test_parse_control_port();
+    void test_private_instance();
+    void test_private_instance_warm_start();
+    void test_private_instance_missing_binary();
+
+private:
+    void startPrivateInstance(const QString& dataDir, qint64& online);
 
 };
 